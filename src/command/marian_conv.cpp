@@ -4,6 +4,7 @@
 #include "onnx/expression_graph_onnx_exporter.h"
 #include "layers/lsh.h"
 #include "data/shortlist.h"
+#include "rescorer/precision_calibration.h"
 #include <sstream>
 
 int main(int argc, char** argv) {
@@ -30,7 +31,19 @@ int main(int argc, char** argv) {
     cli->add<std::vector<std::string>>("--add-lsh", 
                                        "Encode output matrix and optional rotation matrix into model file. "
                                        "arg1: number of bits in LSH encoding, arg2: name of output weights matrix")->implicit_val("1024 Wemb");
-    cli->add<std::vector<std::string>>("--vocabs,-V", "Vocabulary file, required for ONNX export");
+    cli->add<std::vector<std::string>>("--block-sparse",
+                                       "Store pruned weight matrices additionally in block-sparse format. "
+                                       "arg1: block shape rows x columns, arg2: maximum fraction of non-zero blocks for a matrix to be stored block-sparse")->implicit_val("16x1 0.5");
+    cli->add<std::vector<std::string>>("--calibration-sets",
+                                       "Choose the GEMM type of each weight matrix with this calibration set (source target) "
+                                       "instead of --gemm-type, see --precision-candidates and --precision-budget. Requires --vocabs");
+    cli->add<std::vector<std::string>>("--precision-candidates",
+                                       "GEMM types for --calibration-sets, fastest first: variants of intgemm8 and intgemm16, packed16",
+                                       {"intgemm8", "intgemm16"});
+    cli->add<float>("--precision-budget",
+                    "Largest increase of the cost per target word on --calibration-sets caused by quantized matrices",
+                    0.01f);
+    cli->add<std::vector<std::string>>("--vocabs,-V", "Vocabulary file, required for ONNX export and --calibration-sets");
     cli->add<std::vector<std::string>>("--shortlist,-s", "Shortlist conversion: filePath firstNum bestNum threshold");
     cli->add<std::string>("--dump-shortlist,-d", "Binary shortlist dump path","lex.bin");
     cli->parse(argc, argv);
@@ -71,6 +84,19 @@ int main(int argc, char** argv) {
       lshOutputWeights = lshParams[1];
   }
   
+  bool blockSparse = options->hasAndNotEmpty("block-sparse");
+  int blockRows = 16, blockCols = 1;
+  float maxBlockDensity = 0.5f;
+  if(blockSparse) {
+    auto blockParams = options->get<std::vector<std::string>>("block-sparse");
+    auto blockShape  = utils::split(blockParams[0], "x");
+    ABORT_IF(blockShape.size() != 2, "Block shape needs to be given as rows x columns, e.g. 16x1, not {}", blockParams[0]);
+    blockRows = std::stoi(blockShape[0]);
+    blockCols = std::stoi(blockShape[1]);
+    if(blockParams.size() > 1)
+      maxBlockDensity = std::stof(blockParams[1]);
+  }
+
   // We accept any type here and will later croak during packAndSave if the type cannot be used for conversion
   Type saveGemmType = typeFromString(options->get<std::string>("gemm-type", "float32"));
 
@@ -102,6 +128,20 @@ int main(int argc, char** argv) {
       lsh::overwriteDummyParameters(graph, /*weights=*/lshOutputWeights);
     }
 
+    if(blockSparse)
+      graph->setBlockSparse(blockRows, blockCols, maxBlockDensity);
+
+    // per-matrix GEMM types from the quality on a calibration set. The plan covers every matrix that one of the
+    // candidates can store, including those it keeps in float32, so --gemm-type only applies to the other matrices.
+    if(options->hasAndNotEmpty("calibration-sets")) {
+      PrecisionCalibration calibration(modelFrom,
+                                       options->get<std::vector<std::string>>("calibration-sets"),
+                                       vocabPaths,
+                                       options->get<std::vector<std::string>>("precision-candidates"),
+                                       options->get<float>("precision-budget"));
+      graph->setPrecisionPlan(calibration.plan());
+    }
+
     // added a flag if the weights needs to be packed or not
     graph->packAndSave(modelTo, configStr.str(), /* --gemm-type */ saveGemmType, Type::float32);
   }
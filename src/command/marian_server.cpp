@@ -1,9 +1,12 @@
 #include "marian.h"
 #include "translator/beam_search.h"
+#include "translator/speculative_search.h"
 #include "translator/translator.h"
 #include "common/timer.h"
 #include "common/utils.h"
 
+#include <algorithm>
+
 #include "3rd_party/simple-websocket-server/server_ws.hpp"
 
 typedef SimpleWeb::SocketServer<SimpleWeb::WS> WSServer;
@@ -13,7 +16,11 @@ int main(int argc, char **argv) {
 
   // Initialize translation task
   auto options = parseOptions(argc, argv, cli::mode::server, true);
-  auto task = New<TranslateService<BeamSearch>>(options);
+  Ptr<ModelServiceTask> task;
+  if(options->hasAndNotEmpty("speculative-draft"))
+    task = New<TranslateService<SpeculativeSearch>>(options);
+  else
+    task = New<TranslateService<BeamSearch>>(options);
   auto quiet = options->get<bool>("quiet-translation");
 
   // Initialize web server
@@ -42,6 +49,44 @@ int main(int argc, char **argv) {
     });
   };
 
+  // Prefix decoding: a message "session ID <TAB> source line <TAB> confirmed target prefix" is answered
+  // with a translation that starts with the prefix. The states after the prefix are kept for the session,
+  // so that translating the same line again with a longer prefix only decodes the new words.
+  auto &translatePrefix = server.endpoint["^/translate-prefix/?$"];
+
+  translatePrefix.on_message = [&task, quiet](Ptr<WSServer::Connection> connection,
+                                              Ptr<WSServer::InMessage> message) {
+    auto inputText = message->string();
+    auto sendStream = std::make_shared<WSServer::OutMessage>();
+
+    // a malformed message is answered with an error instead of stopping the server
+    size_t numFields = std::count(inputText.begin(), inputText.end(), '\t') + 1;
+    if(numFields != 3) {
+      LOG(warn, "Prefix translation request with {} instead of 3 tab-separated fields", numFields);
+      *sendStream << "Error: expected session ID, source line and target prefix separated by tabs, got "
+                  << numFields << " field(s)" << std::endl;
+    } else {
+      std::vector<std::string> fields;
+      utils::splitTsv(inputText, fields, 3);
+
+      timer::Timer timer;
+      auto outputText = task->run(fields[1], fields[2], fields[0]);
+      *sendStream << outputText << std::endl;
+      if(!quiet)
+        LOG(info, "Translation with prefix took: {:.5f}s", timer.elapsed());
+    }
+
+    connection->send(sendStream, [](const SimpleWeb::error_code &ec) {
+      if(ec)
+        LOG(error, "Error sending message: ({}) {}", ec.value(), ec.message());
+    });
+  };
+
+  translatePrefix.on_error = [](Ptr<WSServer::Connection> /*connection*/,
+                                const SimpleWeb::error_code &ec) {
+    LOG(error, "Connection error: ({}) {}", ec.value(), ec.message());
+  };
+
   // Error Codes for error code meanings
   // http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html
   translate.on_error = [](Ptr<WSServer::Connection> /*connection*/,
@@ -162,6 +162,10 @@ void ConfigParser::addOptionsServer(cli::CLIWrapper& cli) {
   cli.add<size_t>("--port,-p",
       "Port number for web socket server",
       8080);
+  cli.add<size_t>("--prefix-sessions",
+      "Maximum number of prefix decoding sessions (/translate-prefix) kept in memory, "
+      "the least recently used one is dropped first",
+      64);
   cli.switchGroup(previous_group);
   // clang-format on
 }
@@ -571,6 +575,15 @@ void ConfigParser::addOptionsValidation(cli::CLIWrapper& cli) {
       {"cross-entropy"});
   cli.add<bool>("--valid-reset-stalled",
      "Reset all stalled validation metrics when the training is restarted");
+  cli.add<size_t>("--valid-async",
+     "Validate a snapshot of the (smoothed) parameters in the background while training continues, "
+     "with at most  arg  validations outstanding. 0 validates synchronously",
+     0);
+  cli.add<std::vector<size_t>>("--valid-async-devices",
+     "GPU ids used for asynchronous validation. If empty, --valid-async-cpu-threads CPU threads are used");
+  cli.add<size_t>("--valid-async-cpu-threads",
+     "Number of CPU threads used for asynchronous validation without --valid-async-devices",
+     1);
   cli.add<size_t>("--early-stopping",
      "Stop if the first validation metric does not improve for  arg  consecutive validation steps",
      10);
@@ -651,6 +664,15 @@ void ConfigParser::addOptionsTranslation(cli::CLIWrapper& cli) {
   cli.add<float>("--max-length-factor",
       "Maximum target length as source length times factor",
       3);
+  cli.add<float>("--beam-prune-relative",
+      "Drop hypotheses whose probability is below arg times that of the best hypothesis of their beam (0 = off)",
+      0);
+  cli.add<float>("--beam-prune-absolute",
+      "Drop hypotheses whose path score is more than arg below that of the best hypothesis of their beam (0 = off)",
+      0);
+  cli.add<size_t>("--beam-max-candidates",
+      "Keep at most arg continuations of the same hypothesis in a beam (0 = off)",
+      0);
   cli.add<float>("--word-penalty",
       "Subtract (arg * translation length) from translation score");
   cli.add<bool>("--allow-unk",
@@ -667,6 +689,18 @@ void ConfigParser::addOptionsTranslation(cli::CLIWrapper& cli) {
   cli.add<std::string/*SchedulerPeriod*/>("--stat-freq",
     "Display speed information every arg mini-batches. Disabled by default with 0, set to value larger than 0 to activate",
     "0");
+  cli.add<std::string>("--decode-schedule",
+    "Order in which the worker threads decode the batches of each maxi-batch: in-order, or cost to split batches that "
+    "exceed a fair share of the estimated decoding cost and start with the most expensive ones. The output order is unchanged",
+    "in-order");
+  cli.add<size_t>("--split-long-inputs",
+    "Split input lines longer than arg source tokens at the boundaries given by --split-rules, translate the parts "
+    "as separate sentences and join their translations with a space (0 = off)",
+    0);
+  cli.add<std::vector<std::string>>("--split-rules",
+    "Regular expressions matching the boundaries at which --split-long-inputs splits a line, most preferred first. "
+    "A line is split at all matches of a rule only where the parts of the previous rules are still too long",
+    {"[.!?]+[\"')\\]]*\\s+", "[;:]\\s+", ",\\s+", "\\s+"});
 #ifdef USE_SENTENCEPIECE
   cli.add<bool>("--no-spm-decode",
       "Keep the output segmented into SentencePiece subwords");
@@ -689,21 +723,48 @@ void ConfigParser::addOptionsTranslation(cli::CLIWrapper& cli) {
      "Use softmax shortlist: path first best prune");
   cli.add<std::vector<float>>("--weights",
       "Scorer weights");
+  cli.add<bool>("--ensemble-parallel",
+      "Step the models of an ensemble concurrently, each on its own graph and thread (CPU only). "
+      "Translations are identical to the sequential ensemble. Each model reserves a full --workspace");
   cli.add<bool>("--output-sampling",
      "Noise output layer with gumbel noise",
       false);
+  cli.add<std::string>("--speculative-draft",
+     "Path to a small draft model with the same target vocabulary for speculative greedy or small-beam decoding: "
+     "the draft proposes --speculative-k words per hypothesis which the main model verifies in a single step. "
+     "Output equals that of decoding with the main model alone");
+  cli.add<size_t>("--speculative-k",
+     "Number of words proposed by the draft model per speculative decoding step",
+     4);
   cli.add<std::vector<int>>("--output-approx-knn",
-     "Use approximate knn search in output layer (currently only in transformer)")
+     "Use approximate knn search in output layer (currently only in transformer): k nbits [probes]. "
+     "With probes > 0 only that many LSH buckets closest to the query are searched")
      ->implicit_val("100 1024");
 
   // parameters for on-line quantization
   cli.add<bool>("--optimize",
       "Optimize the graph on-the-fly", false);
   cli.add<std::string>("--gemm-type,-g",
-     "GEMM Type to be used for on-line quantization/packing: float32, packed16, packed8", "float32");
+     "GEMM Type to be used for on-line quantization/packing: float32, packed16, packed8. "
+     "auto times the available types per matrix shape and uses the fastest", "float32");
+  cli.add<std::string>("--gemm-tuning-file",
+     "File that keeps the decisions of --gemm-type auto, loaded if it exists and extended with new decisions. "
+     "Only valid for the same build and CPU");
   cli.add<float>("--quantize-range",
      "Range for the on-line quantiziation of weight matrix in multiple of this range and standard deviation, 0.0 means min/max quantization",
      0.f);
+  cli.add<std::string>("--batched-gemm-type",
+     "GEMM Type for batched products of two activations (e.g. attention), both operands are quantized on-the-fly: float32, intgemm8, intgemm16",
+     "float32");
+  cli.add<std::string>("--shortlist-gemm-type",
+     "GEMM Type for the output layer with a lexical shortlist, the output embeddings are quantized once and the "
+     "shortlisted columns are selected from them: float32, intgemm8, intgemm16",
+     "float32");
+  cli.add<float>("--block-sparse-max-density",
+     "Multiply weight matrices stored by marian-conv --block-sparse with the block-sparse kernel (CPU only) if their "
+     "fraction of non-zero blocks is below arg, and with the dense matrix otherwise. 0 disables the kernel, "
+     "test_block_sparse measures the break-even density",
+     0.25f);
 
 #if 0 // @TODO: Ask Hany if there are any decoding-time options
   // add ULR settings
@@ -734,6 +795,9 @@ void ConfigParser::addOptionsScoring(cli::CLIWrapper& cli) {
       "Score n-best list instead of plain text corpus");
   cli.add<std::string>("--n-best-feature",
       "Feature name to be inserted into n-best list", "Score");
+  cli.add<bool>("--n-best-shared-encoder",
+      "Encode each source sentence of an n-best list only once and share it across its hypotheses. "
+      "Implies --maxi-batch-sort none to keep hypotheses of the same source together");
   cli.add<bool>("--normalize,-n",
       "Divide translation score by translation length");
   cli.add<std::string>("--summary",
@@ -790,6 +854,33 @@ void ConfigParser::addOptionsEmbedding(cli::CLIWrapper& cli) {
       "Expect two inputs and compute cosine similarity instead of outputting embedding vector");
   cli.add<bool>("--binary",
       "Output vectors as binary floats");
+  cli.add<std::string>("--npy",
+      "Write the vectors as a memory-mappable .npy matrix with one row per input line to --output: "
+      "float32 or float16",
+      "")->implicit_val("float32");
+  cli.add<bool>("--l2-normalize",
+      "Scale output vectors to unit length");
+  cli.add<bool>("--mine",
+      "Expect two inputs, embed both and output the --mine-k nearest target sentences of each source sentence "
+      "with their margin scores as lines: source-id target-id score");
+  cli.add<size_t>("--mine-k",
+      "Number of nearest neighbours per sentence for --mine, also used for the margin",
+      4);
+  cli.add<std::string>("--mine-margin",
+      "Margin score for --mine: ratio, distance or absolute (cosine similarity)",
+      "ratio");
+  cli.add<std::string>("--mine-index",
+      "Nearest neighbour search for --mine: exact (blocked matrix products) or lsh (approximate)",
+      "exact");
+  cli.add<int>("--mine-lsh-bits",
+      "Number of bits of the LSH codes for --mine-index lsh",
+      256);
+  cli.add<int>("--mine-lsh-probes",
+      "Number of LSH buckets searched per sentence for --mine-index lsh, 0 searches all",
+      0);
+  cli.add<size_t>("--mine-lsh-candidates",
+      "Number of LSH candidates per sentence that are re-ranked by cosine similarity for --mine-index lsh",
+      64);
 
   addSuboptionsInputLength(cli);
   addSuboptionsTSV(cli);
@@ -856,6 +947,14 @@ void ConfigParser::addSuboptionsBatching(cli::CLIWrapper& cli) {
   cli.add<int>("--mini-batch-words",
       "Set mini-batch size based on words instead of sentences");
 
+  if(mode_ == cli::mode::translation) {
+    cli.add<bool>("--mini-batch-fit",
+      "Determine mini-batch size automatically based on sentence-length to fit reserved memory, "
+      "probed with the beam size and length limit of the search. --mini-batch times --maxi-batch sentences are read ahead");
+    cli.add<size_t>("--mini-batch-fit-step",
+      "Step size for mini-batch-fit statistics",
+      10);
+  }
   if(mode_ == cli::mode::training) {
     cli.add<bool>("--mini-batch-fit",
       "Determine mini-batch size automatically based on sentence-length to fit reserved memory");
@@ -66,6 +66,13 @@ void ConfigValidator::validateOptionsTranslation() const {
     filesystem::Path vocabPath(vocabFile);
     ABORT_IF(!filesystem::exists(vocabPath), "Vocabulary file does not exist: " + vocabFile);
   }
+
+  // these outputs refer to the words or IDs of a single sentence, not to the lines joined by data::Segmenter
+  if(get<size_t>("split-long-inputs") > 0) {
+    ABORT_IF(get<bool>("n-best"), "--split-long-inputs cannot be used with --n-best");
+    ABORT_IF(has("alignment") && !get<std::string>("alignment").empty(), "--split-long-inputs cannot be used with --alignment");
+    ABORT_IF(get<bool>("word-scores"), "--split-long-inputs cannot be used with --word-scores");
+  }
 }
 
 void ConfigValidator::validateOptionsParallelData() const {
@@ -203,6 +203,23 @@ std::string withCommas(size_t n) {
   return res;
 }
 
+void appendInt(std::string& out, size_t value) {
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+  do {
+    *--p = (char)('0' + value % 10);
+    value /= 10;
+  } while(value > 0);
+  out.append(p, end);
+}
+
+void appendFloat(std::string& out, float value, bool fixed /*= false*/, int precision /*= 6*/) {
+  char buffer[64];
+  int n = snprintf(buffer, sizeof(buffer), fixed ? "%.*f" : "%.*g", precision, value);
+  out.append(buffer, std::min((size_t)std::max(n, 0), sizeof(buffer) - 1));
+}
+
 bool beginsWith(const std::string& text, const std::string& prefix) {
   return text.size() >= prefix.size()
          && !text.compare(0, prefix.size(), prefix);
@@ -44,6 +44,11 @@ std::string exec(const std::string& cmd, const std::vector<std::string>& args =
 std::pair<std::string, int> hostnameAndProcessId();
 
 std::string withCommas(size_t n);
+
+// Append a number to a string as operator<< formats it, i.e. %g or with std::fixed %f for floats,
+// without a stream, so that reused strings keep their capacity
+void appendInt(std::string& out, size_t value);
+void appendFloat(std::string& out, float value, bool fixed = false, int precision = 6);
 bool beginsWith(const std::string& text, const std::string& prefix);
 bool endsWith(const std::string& text, const std::string& suffix);
 
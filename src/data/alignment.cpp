@@ -23,13 +23,19 @@ void WordAlignment::sort() {
 }
 
 std::string WordAlignment::toString() const {
-  std::stringstream str;
+  std::string str;
+  appendTo(str);
+  return str;
+}
+
+void WordAlignment::appendTo(std::string& out) const {
   for(auto p = begin(); p != end(); ++p) {
     if(p != begin())
-      str << " ";
-    str << p->srcPos << "-" << p->tgtPos;
+      out += ' ';
+    utils::appendInt(out, p->srcPos);
+    out += '-';
+    utils::appendInt(out, p->tgtPos);
   }
-  return str.str();
 }
 
 WordAlignment ConvertSoftAlignToHardAlign(SoftAlignment alignSoft,
@@ -66,19 +72,21 @@ WordAlignment ConvertSoftAlignToHardAlign(SoftAlignment alignSoft,
 }
 
 std::string SoftAlignToString(SoftAlignment align) {
-  std::stringstream str;
-  bool first = true;
+  std::string str;
+  AppendSoftAlign(str, align);
+  return str;
+}
+
+void AppendSoftAlign(std::string& out, const SoftAlignment& align) {
   for(size_t t = 0; t < align.size(); ++t) {
-    if(!first)
-      str << " ";
+    if(t != 0)
+      out += ' ';
     for(size_t s = 0; s < align[t].size(); ++s) {
       if(s != 0)
-        str << ",";
-      str << align[t][s];
+        out += ',';
+      utils::appendFloat(out, align[t][s]);
     }
-    first = false;
   }
-  return str.str();
 }
 
 }  // namespace data
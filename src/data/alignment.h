@@ -50,6 +50,11 @@ public:
    * @brief Returns textual representation.
    */
   std::string toString() const;
+
+  /**
+   * @brief Appends the textual representation to a string.
+   */
+  void appendTo(std::string& out) const;
 };
 
 // soft alignment = P(src pos|trg pos) for each beam and batch index, stored in a flattened CPU-side array
@@ -60,6 +65,7 @@ WordAlignment ConvertSoftAlignToHardAlign(SoftAlignment alignSoft,
                                           float threshold = 1.f);
 
 std::string SoftAlignToString(SoftAlignment align);
+void AppendSoftAlign(std::string& out, const SoftAlignment& align);
 
 }  // namespace data
 }  // namespace marian
@@ -43,8 +43,10 @@ public:
     std::vector<size_t> lengths;
     for(size_t i = 0; i < batch->sets(); ++i)
       lengths.push_back((*batch)[i]->batchWidth());
-    size_t batchSize = (size_t)ceil((double)batch->size() * multiplier);
+    add(lengths, (size_t)ceil((double)batch->size() * multiplier));
+  }
 
+  void add(const std::vector<size_t>& lengths, size_t batchSize) {
     if(map_[lengths] < batchSize)
       map_[lengths] = batchSize;
   }
@@ -15,7 +15,12 @@ Corpus::Corpus(Ptr<Options> options, bool translate /*= false*/, size_t seed /*=
     : CorpusBase(options, translate, seed),
         shuffleInRAM_(options_->get<bool>("shuffle-in-ram", false)),
         allCapsEvery_(options_->get<size_t>("all-caps-every", 0)),
-        titleCaseEvery_(options_->get<size_t>("english-title-case-every", 0)) {}
+        titleCaseEvery_(options_->get<size_t>("english-title-case-every", 0)) {
+  if(translate && options_->get<size_t>("split-long-inputs", 0) > 0) {
+    ABORT_IF(paths_.size() != 1 || tsv_, "--split-long-inputs is only supported for a single input file");
+    segmenter_ = New<Segmenter>(options_, vocabs_[0]);
+  }
+}
 
 Corpus::Corpus(std::vector<std::string> paths,
                std::vector<Ptr<Vocab>> vocabs,
@@ -56,6 +61,12 @@ SentenceTuple Corpus::next() {
     ++tsvNumAllFields;
   std::vector<std::string> fields(tsvNumAllFields);
 
+  if(!segments_.empty()) {
+    SentenceTuple tup = segments_.front();
+    segments_.pop_front();
+    return tup;
+  }
+
   for(;;) { // (this is a retry loop for skipping invalid sentences)
     // get index of the current sentence
     size_t curId = pos_; // note: at end, pos_  == total size
@@ -115,6 +126,13 @@ SentenceTuple Corpus::next() {
           if(weightFileIdx_ > -1)
             addWeightsToSentenceTuple(fields[weightFileIdx_], tup);
 
+        } else if(segmenter_) { // the only stream, see constructor
+          preprocessLine(line, i);
+          for(const auto& segment : segmenter_->split(line)) {
+            SentenceTuple words(0);
+            addWordsToSentenceTuple(segment, i, words);
+            segments_.push_back(words);
+          }
         } else {
           preprocessLine(line, i);
           addWordsToSentenceTuple(line, i, tup);
@@ -126,6 +144,24 @@ SentenceTuple Corpus::next() {
       return SentenceTuple(0);
     ABORT_IF(eofsHit != 0, "not all input files have the same number of lines");
 
+    // the segments of a line are skipped or returned together, with the IDs assigned by the segmenter
+    if(segmenter_) {
+      std::deque<SentenceTuple> segments;
+      segments.swap(segments_);
+      if(!std::all_of(segments.begin(), segments.end(), [=](SentenceTuple& segment) {
+           return segment[0].size() > 0 && segment[0].size() <= maxLength_;
+         }))
+        continue;
+      size_t segmentId = segmenter_->add(curId, segments.size());
+      for(auto& segment : segments) {
+        segments_.emplace_back(segmentId++);
+        segments_.back().push_back(segment[0]);
+      }
+      SentenceTuple first = segments_.front();
+      segments_.pop_front();
+      return first;
+    }
+
     // check if all streams are valid, that is, non-empty and no longer than maximum allowed length
     if(std::all_of(tup.begin(), tup.end(), [=](const Words& words) {
          return words.size() > 0 && words.size() <= maxLength_;
@@ -151,6 +187,7 @@ void Corpus::shuffle() {
 void Corpus::reset() {
   corpusInRAM_.clear();
   ids_.clear();
+  segments_.clear();
   if (pos_ == 0) // no data read yet
     return;
   pos_ = 0;
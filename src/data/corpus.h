@@ -11,8 +11,11 @@
 #include "data/batch.h"
 #include "data/corpus_base.h"
 #include "data/dataset.h"
+#include "data/segmenter.h"
 #include "data/vocab.h"
 
+#include <deque>
+
 namespace marian {
 namespace data {
 
@@ -32,6 +35,10 @@ private:
   size_t titleCaseEvery_{0}; // ditto for title case (source only)
   void preprocessLine(std::string& line, size_t streamId);
 
+  // for translation with --split-long-inputs
+  Ptr<Segmenter> segmenter_;
+  std::deque<SentenceTuple> segments_; // segments of the last line not returned yet
+
 public:
   // @TODO: check if translate can be replaced by an option in options
   Corpus(Ptr<Options> options, 
@@ -66,6 +73,9 @@ public:
 
   std::vector<Ptr<Vocab>>& getVocabs() override { return vocabs_; }
 
+  // Maps the IDs of the returned tuples back to line numbers if long lines are split, otherwise null
+  Ptr<Segmenter> getSegmenter() { return segmenter_; }
+
   batch_ptr toBatch(const std::vector<Sample>& batchVector) override;
 };
 }  // namespace data
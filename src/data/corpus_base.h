@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+
 #include "common/definitions.h"
 #include "common/file_stream.h"
 #include "common/options.h"
@@ -225,6 +227,32 @@ public:
 
   void setWords(size_t words) { words_ = words; }
 
+  /**
+   * @brief Creates a sub-batch from the given sentences of this sub-batch, in the given order.
+   * The width is reduced to the longest selected sentence.
+   */
+  Ptr<SubBatch> select(const std::vector<size_t>& batchIndices) const {
+    size_t subSize = batchIndices.size();
+    size_t subWidth = 0;
+    for(size_t s = 0; s < width_; ++s)
+      for(auto b : batchIndices)
+        if(mask_[locate(b, s)] != 0)
+          subWidth = s + 1;
+
+    auto sb = New<SubBatch>(subSize, subWidth, vocab_);
+    size_t words = 0;
+    for(size_t s = 0; s < subWidth; ++s) {
+      for(size_t i = 0; i < subSize; ++i) {
+        sb->data()[locate(i, s, subSize)] = indices_[locate(batchIndices[i], s)];
+        sb->mask()[locate(i, s, subSize)] = mask_[locate(batchIndices[i], s)];
+        if(mask_[locate(batchIndices[i], s)] != 0)
+          words++;
+      }
+    }
+    sb->setWords(words);
+    return sb;
+  }
+
   // experimental: hide inline-fix source tokens from cross attention
   std::vector<float> crossMaskWithInlineFixSourceSuppressed() const;
 };
@@ -454,6 +482,49 @@ public:
     return splits;
   }
 
+  /**
+   * @brief Creates a batch that holds every distinct source side (all streams but the last) only
+   * once, e.g. for the hypotheses of an n-best list that share the same source sentence.
+   *
+   * @param sourceIndices filled with the position of each sentence's source in the returned batch
+   *
+   * @return Batch of distinct sources; its target stream holds the first target of each source.
+   */
+  Ptr<CorpusBatch> uniqueSources(std::vector<IndexType>& sourceIndices) const {
+    size_t numSources = subBatches_.size() - 1;
+    ABORT_IF(numSources == 0, "Batch has no source stream");
+
+    std::map<std::vector<Words>, IndexType> seen;
+    std::vector<size_t> firsts;
+    sourceIndices.resize(size());
+    for(size_t b = 0; b < size(); ++b) {
+      std::vector<Words> key(numSources);
+      for(size_t i = 0; i < numSources; ++i) {
+        const auto& sb = subBatches_[i];
+        for(size_t s = 0; s < sb->batchWidth() && sb->mask()[sb->locate(b, s)] != 0; ++s)
+          key[i].push_back(sb->data()[sb->locate(b, s)]);
+      }
+      auto it = seen.find(key);
+      if(it == seen.end()) {
+        it = seen.emplace(key, (IndexType)firsts.size()).first;
+        firsts.push_back(b);
+      }
+      sourceIndices[b] = it->second;
+    }
+
+    std::vector<Ptr<SubBatch>> subBatches;
+    for(auto sb : subBatches_)
+      subBatches.push_back(sb->select(firsts));
+    auto batch = New<CorpusBatch>(subBatches);
+
+    std::vector<size_t> ids;
+    if(!sentenceIds_.empty())
+      for(auto b : firsts)
+        ids.push_back(sentenceIds_[b]);
+    batch->setSentenceIds(ids);
+    return batch;
+  }
+
   const std::vector<float>& getGuidedAlignment() const { return guidedAlignment_; }  // [dimSrcWords, dimBatch, dimTrgWords] flattened
   void setGuidedAlignment(std::vector<float>&& aln) override {
     guidedAlignment_ = std::move(aln);
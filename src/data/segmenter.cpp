@@ -0,0 +1,124 @@
+#include "data/segmenter.h"
+
+#include "common/logging.h"
+
+namespace marian {
+namespace data {
+
+Segmenter::Segmenter(Ptr<Options> options, Ptr<const Vocab> vocab)
+    : vocab_(vocab), maxLength_(options->get<size_t>("split-long-inputs")) {
+  ABORT_IF(maxLength_ == 0, "Splitting of long inputs requires a positive length");
+  for(const auto& rule : options->get<std::vector<std::string>>("split-rules")) {
+    try {
+      rules_.emplace_back(rule);
+    } catch(const std::regex_error& e) {
+      ABORT("Invalid split rule '{}': {}", rule, e.what());
+    }
+  }
+}
+
+size_t Segmenter::length(const std::string& text) const {
+  return vocab_->encode(text, /*addEOS=*/false, /*inference=*/true).size();
+}
+
+void Segmenter::split(const std::string& text, size_t rule, std::vector<std::string>& pieces) const {
+  if(rule == rules_.size() || length(text) <= maxLength_) {
+    pieces.push_back(text);
+    return;
+  }
+
+  size_t start = 0;
+  for(std::sregex_iterator it(text.begin(), text.end(), rules_[rule]), end; it != end; ++it) {
+    size_t stop = it->position() + it->length();
+    if(it->length() == 0 || stop == text.size())
+      continue;
+    split(text.substr(start, stop - start), rule + 1, pieces);
+    start = stop;
+  }
+  split(text.substr(start), rule + 1, pieces);
+}
+
+std::vector<std::string> Segmenter::split(const std::string& line) const {
+  if(length(line) <= maxLength_)
+    return {line};
+
+  std::vector<std::string> pieces;
+  split(line, 0, pieces);
+
+  // merge neighbouring pieces up to the limit, token counts of pieces add up closely enough
+  std::vector<std::string> segments;
+  size_t segmentLength = 0;
+  for(const auto& piece : pieces) {
+    size_t pieceLength = length(piece);
+    if(!segments.empty() && segmentLength + pieceLength <= maxLength_) {
+      segments.back() += piece;
+      segmentLength += pieceLength;
+    } else {
+      segments.push_back(piece);
+      segmentLength = pieceLength;
+    }
+  }
+
+  // whitespace at the cuts belongs to the rules, not to the segments
+  std::vector<std::string> trimmed;
+  for(const auto& segment : segments) {
+    size_t last = segment.find_last_not_of(" \t");
+    if(last != std::string::npos)
+      trimmed.push_back(segment.substr(0, last + 1));
+  }
+  return trimmed.empty() ? std::vector<std::string>({line}) : trimmed;
+}
+
+size_t Segmenter::add(size_t lineId, size_t segments) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t id = nextId_;
+  nextId_ += segments;
+  if(segments > 1 || find(id).lineId != lineId)
+    runs_[id] = {lineId, segments};
+  return id;
+}
+
+Segmenter::Segment Segmenter::locate(size_t segmentId) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return find(segmentId);
+}
+
+Segmenter::Segment Segmenter::find(size_t segmentId) const {
+  auto it = runs_.upper_bound(segmentId);
+  if(it == runs_.begin()) // no line split before
+    return {segmentId, 0, 1};
+  --it;
+  size_t offset = segmentId - it->first;
+  if(offset < it->second.segments)
+    return {it->second.lineId, offset, it->second.segments};
+  return {it->second.lineId + 1 + offset - it->second.segments, 0, 1};
+}
+
+bool Segmenter::join(size_t segmentId, const std::string& translation, size_t& lineId, std::string& line) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto segment = find(segmentId);
+  lineId = segment.lineId;
+  if(segment.segments == 1) {
+    line = translation;
+    return true;
+  }
+
+  auto it = partials_.find(lineId);
+  if(it == partials_.end())
+    it = partials_.insert({lineId, {std::vector<std::string>(segment.segments), segment.segments}}).first;
+  it->second.translations[segment.index] = translation;
+  if(--it->second.missing > 0)
+    return false;
+
+  line.clear();
+  for(const auto& part : it->second.translations) {
+    if(!line.empty() && !part.empty())
+      line += ' ';
+    line += part;
+  }
+  partials_.erase(it);
+  return true;
+}
+
+}  // namespace data
+}  // namespace marian
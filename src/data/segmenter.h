@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common/definitions.h"
+#include "common/options.h"
+#include "data/vocab.h"
+
+#include <map>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace marian {
+namespace data {
+
+/**
+ * Splits source lines longer than --split-long-inputs tokens for translation, so that they are
+ * decoded as several independent sentences that can share batches with other lines.
+ *
+ * A line is cut at every match of the first rule of --split-rules, pieces that are still too long
+ * at every match of the next rule and so on. A match stays with the piece to its left. Adjacent
+ * pieces are then merged again as long as they fit into the limit. Pieces without any boundary
+ * left remain too long.
+ *
+ * Segments get consecutive IDs which replace the line numbers in the batches. The Segmenter keeps
+ * the mapping back to the lines, which the output collectors use to join the translations of all
+ * segments of a line with a space.
+ */
+class Segmenter {
+public:
+  struct Segment {
+    size_t lineId;   // input line the segment belongs to
+    size_t index;    // position of the segment within its line
+    size_t segments; // number of segments of the line
+  };
+
+  Segmenter(Ptr<Options> options, Ptr<const Vocab> vocab);
+
+  // Segments of the line in order, or the line itself if it is not longer than the limit
+  std::vector<std::string> split(const std::string& line) const;
+
+  // Registers the next line with the given number of segments, returns the ID of its first segment
+  size_t add(size_t lineId, size_t segments);
+
+  Segment locate(size_t segmentId) const;
+
+  // Collects the translation of a segment. Returns true with the line number and the translations of
+  // all segments joined once the last segment of a line has arrived, in any order and from any thread.
+  bool join(size_t segmentId, const std::string& translation, size_t& lineId, std::string& line);
+
+private:
+  Ptr<const Vocab> vocab_;
+  size_t maxLength_;               // in source tokens, without EOS
+  std::vector<std::regex> rules_;  // boundaries, most preferred first
+
+  size_t length(const std::string& text) const;
+  void split(const std::string& text, size_t rule, std::vector<std::string>& pieces) const;
+
+  // Each entry starts a run of segment IDs: the first ones are the segments of a split line, the
+  // following ones are unsplit lines with consecutive line numbers up to the next entry. Entries are
+  // only added for split lines and gaps in the line numbers, so the map stays small.
+  struct Run {
+    size_t lineId;
+    size_t segments;
+  };
+  std::map<size_t, Run> runs_;
+  Segment find(size_t segmentId) const;
+  size_t nextId_{0};
+
+  struct Partial {
+    std::vector<std::string> translations; // [segment index]
+    size_t missing;
+  };
+  std::map<size_t, Partial> partials_; // by line number, lines with translated segments missing
+
+  mutable std::mutex mutex_; // segments are added by the batch generator and joined by the workers
+};
+
+}  // namespace data
+}  // namespace marian
@@ -2,6 +2,7 @@
 #include "microsoft/shortlist/utils/ParameterTree.h"
 #include "marian.h"
 #include "layers/lsh.h"
+#include "tensors/cpu/intgemm_interface.h"
 
 #include <queue>
 
@@ -19,6 +20,7 @@ const T* get(const void*& current, size_t num = 1) {
 //////////////////////////////////////////////////////////////////////////////////////
 Shortlist::Shortlist(const std::vector<WordIndex>& indices)
   : indices_(indices), 
+    indicesHash_(util::hashMem<WordIndex, size_t>(indices.data(), indices.size())),
     initialized_(false) {}
 
 Shortlist::~Shortlist() {}
@@ -38,48 +40,100 @@ void Shortlist::filter(Expr input, Expr weights, bool isLegacyUntransposedW, Exp
     return;
   }
 
-  auto forward = [this](Expr out, const std::vector<Expr>& ) {
-    out->val()->set(indices_);
+  // capture a copy, memoized nodes may outlive this shortlist
+  std::vector<WordIndex> indices = indices_;
+  auto forward = [indices](Expr out, const std::vector<Expr>& ) {
+    out->val()->set(indices);
   };
 
   int k = (int) indices_.size();
   Shape kShape({k});
-  indicesExpr_ = lambda({input, weights}, kShape, Type::uint32, forward);
+  if(weights->graph()->isInference()) {
+    // Depends on the weights only and is identified by the content of the shortlist. The node and the gathered
+    // tensors below are memoized in the graph, so a later batch with the same shortlist reuses them.
+    indicesExpr_ = lambda({weights}, kShape, Type::uint32, forward, indicesHash_);
+  } else {
+    indicesExpr_ = lambda({input, weights}, kShape, Type::uint32, forward);
+  }
 
   createCachedTensors(weights, isLegacyUntransposedW, b, lemmaEt, k);
   initialized_ = true;
 }
 
+void Shortlist::forget() {
+  for(auto& node : memoized_)
+    if(node && node->graph())
+      node->graph()->forget(node);
+  memoized_.clear();
+}
+
 Expr Shortlist::getIndicesExpr() const {
   int k = indicesExpr_->shape()[0];
   Expr out = reshape(indicesExpr_, {1, 1, k});
   return out;
 }
 
+Type Shortlist::shortlistGemmType(Expr weights, int k) const {
+  auto graph = weights->graph();
+  if(!graph->isInference() || graph->getDeviceId().type != DeviceType::cpu)
+    return Type::float32;
+
+  Type gemmType = graph->getBackend()->getShortlistGemmType();
+  if(!isIntgemm(gemmType) || !isFloat(weights->value_type()))
+    return Type::float32;
+
+  // intgemm needs the embedding size to be a multiple of the register width and the vocabulary
+  // as well as the shortlist to be a multiple of 8, otherwise fall back to float32
+  int dimModel = weights->shape()[-1];
+  int dimVocab = weights->shape()[-2];
+  int widthMult = sizeOf(gemmType) == 1 ? 64 : 32;
+  if(dimModel % widthMult != 0 || dimVocab % 8 != 0 || k % 8 != 0) {
+    LOG_ONCE(info, "[data] Shortlisted output layer stays float32, {} requires a multiple of {} for the "
+             "embedding size ({}) and of 8 for the vocabulary ({}) and the shortlist ({})",
+             gemmType, widthMult, dimModel, dimVocab, k);
+    return Type::float32;
+  }
+  return gemmType;
+}
+
 void Shortlist::createCachedTensors(Expr weights,
                           bool isLegacyUntransposedW,
                           Expr b,
                           Expr lemmaEt,
                           int k) {
   ABORT_IF(isLegacyUntransposedW, "Legacy untranspose W not yet tested");
-  cachedShortWt_ = index_select(weights, isLegacyUntransposedW ? -1 : 0, indicesExpr_);
-  cachedShortWt_ = reshape(cachedShortWt_, {1, 1, cachedShortWt_->shape()[0], cachedShortWt_->shape()[1]});
+  memoized_.push_back(indicesExpr_);
+
+  Type gemmType = shortlistGemmType(weights, k);
+  if(isIntgemm(gemmType)) {
+    // columns of the output embeddings that were quantized once, [dim x k] in intgemm format
+    cachedShortWt_ = cpu::integer::selectColumnsB(gemmType, weights, /*transB=*/true, indicesExpr_);
+    memoized_.push_back(cachedShortWt_);
+  } else {
+    cachedShortWt_ = index_select(weights, isLegacyUntransposedW ? -1 : 0, indicesExpr_);
+    memoized_.push_back(cachedShortWt_);
+    cachedShortWt_ = reshape(cachedShortWt_, {1, 1, cachedShortWt_->shape()[0], cachedShortWt_->shape()[1]});
+    memoized_.push_back(cachedShortWt_);
+  }
 
   if (b) {
     cachedShortb_ = index_select(b, -1, indicesExpr_);
+    memoized_.push_back(cachedShortb_);
   }
 
   if (lemmaEt) {
     cachedShortLemmaEt_ = index_select(lemmaEt, -1, indicesExpr_);
+    memoized_.push_back(cachedShortLemmaEt_);
     cachedShortLemmaEt_ = reshape(cachedShortLemmaEt_, {1, 1, cachedShortLemmaEt_->shape()[0], k});
+    memoized_.push_back(cachedShortLemmaEt_);
   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-LSHShortlist::LSHShortlist(int k, int nbits, size_t lemmaSize)
+LSHShortlist::LSHShortlist(int k, int nbits, size_t lemmaSize, int probes)
 : Shortlist(std::vector<WordIndex>()), 
-  k_(k), nbits_(nbits), lemmaSize_(lemmaSize) {
+  k_(k), nbits_(nbits), lemmaSize_(lemmaSize), probes_(probes) {
 }
 
 WordIndex LSHShortlist::reverseMap(int beamIdx, int batchIdx, int idx) const {
@@ -99,7 +153,7 @@ void LSHShortlist::filter(Expr input, Expr weights, bool isLegacyUntransposedW,
   ABORT_IF(input->graph()->getDeviceId().type == DeviceType::gpu,
            "LSH index (--output-approx-knn) currently not implemented for GPU");
 
-  indicesExpr_ = callback(lsh::search(input, weights, k_, nbits_, (int)lemmaSize_), 
+  indicesExpr_ = callback(lsh::search(input, weights, k_, nbits_, (int)lemmaSize_, probes_), 
                           [this](Expr node) { 
                             node->val()->get(indices_); // set the value of the field indices_ whenever the graph traverses this node
                           });
@@ -135,12 +189,12 @@ void LSHShortlist::createCachedTensors(Expr weights,
   }
 }
 
-LSHShortlistGenerator::LSHShortlistGenerator(int k, int nbits, size_t lemmaSize) 
-  : k_(k), nbits_(nbits), lemmaSize_(lemmaSize) {
+LSHShortlistGenerator::LSHShortlistGenerator(int k, int nbits, size_t lemmaSize, int probes) 
+  : k_(k), nbits_(nbits), lemmaSize_(lemmaSize), probes_(probes) {
 }
 
 Ptr<Shortlist> LSHShortlistGenerator::generate(Ptr<data::CorpusBatch> batch) const {
-  return New<LSHShortlist>(k_, nbits_, lemmaSize_);
+  return New<LSHShortlist>(k_, nbits_, lemmaSize_, probes_);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -206,10 +260,10 @@ Ptr<Shortlist> QuicksandShortlistGenerator::generate(Ptr<data::CorpusBatch> batc
   auto srcBatch = (*batch)[srcIdx_];
   auto maxShortlistSize = trgVocab_->size();
 
-  std::unordered_set<int32_t> indexSet;
+  ShortlistBitset indexSet(maxShortlistSize);
   for(int32_t i = 0; i < numDefaultIds_ && i < maxShortlistSize; ++i) {
     int32_t id = defaultIds_[i];
-    indexSet.insert(id);
+    indexSet.set((WordIndex)id);
   }
 
   // State
@@ -236,8 +290,8 @@ Ptr<Shortlist> QuicksandShortlistGenerator::generate(Ptr<data::CorpusBatch> batc
   }
         
   // collect the actual shortlist mappings
-  for (int32_t i = 0; i < maxLength && indexSet.size() < maxShortlistSize; i++) {
-    for (int32_t j = 0; j < curShortlists.size() && indexSet.size() < maxShortlistSize; j++) {
+  for (int32_t i = 0; i < maxLength && indexSet.count() < maxShortlistSize; i++) {
+    for (int32_t j = 0; j < curShortlists.size() && indexSet.count() < maxShortlistSize; j++) {
       int32_t length = curShortlists[j].second;
       if (i < length) {
         const uint8_t* source_shortlist_ids_bytes = curShortlists[j].first;
@@ -250,19 +304,13 @@ Ptr<Shortlist> QuicksandShortlistGenerator::generate(Ptr<data::CorpusBatch> batc
           const int32_t* source_shortlist_ids = reinterpret_cast<const int32_t*>(source_shortlist_ids_bytes);
           id = source_shortlist_ids[i];
         }
-        indexSet.insert(id);
+        indexSet.set((WordIndex)id);
       }
     }
   }
 
-  // turn into vector and sort (selected indices)
-  std::vector<WordIndex> indices;
-  indices.reserve(indexSet.size());
-  for(auto i : indexSet)
-    indices.push_back((WordIndex)i);
-
-  std::sort(indices.begin(), indices.end());
-  return New<Shortlist>(indices);
+  // selected indices, already sorted
+  return New<Shortlist>(indexSet.toIndices());
 }
 
 Ptr<ShortlistGenerator> createShortlistGenerator(Ptr<Options> options,
@@ -273,9 +321,10 @@ Ptr<ShortlistGenerator> createShortlistGenerator(Ptr<Options> options,
                                                  size_t trgIdx,
                                                  bool shared) {
   if (lshOpts.size()) {
-    assert(lshOpts.size() == 2);
+    assert(lshOpts.size() == 2 || lshOpts.size() == 3);
     size_t lemmaSize = trgVocab->lemmaSize();
-    return New<LSHShortlistGenerator>(lshOpts[0], lshOpts[1], lemmaSize);
+    int probes = lshOpts.size() == 3 ? lshOpts[2] : 0;
+    return New<LSHShortlistGenerator>(lshOpts[0], lshOpts[1], lemmaSize, probes);
   }
   else {                                                   
     std::vector<std::string> vals = options->get<std::vector<std::string>>("shortlist");
@@ -414,52 +463,32 @@ Ptr<Shortlist> BinaryShortlistGenerator::generate(Ptr<data::CorpusBatch> batch)
   size_t trgVocabSize = trgVocab_->size();
 
   // Since V=trgVocab_->size() is not large, anchor the time and space complexity to O(V).
-  // Attempt to squeeze the truth tables into CPU cache
-  std::vector<bool> srcTruthTable(srcVocabSize, 0);  // holds selected source words
-  std::vector<bool> trgTruthTable(trgVocabSize, 0);  // holds selected target words
+  // The bitsets take V/8 bytes each and fit into CPU cache
+  ShortlistBitset srcTruthTable(srcVocabSize);  // holds selected source words
+  ShortlistBitset trgTruthTable(trgVocabSize);  // holds selected target words
 
   // add firstNum most frequent words
-  for(WordIndex i = 0; i < firstNum_ && i < trgVocabSize; ++i)
-    trgTruthTable[i] = 1;
+  trgTruthTable.setRange(0, (WordIndex)firstNum_);
 
   // collect unique words from source
-  // add aligned target words: mark trgTruthTable[word] to 1
+  // add aligned target words: set the bits of the target words in the skip list of each new source word
   for(auto word : srcBatch->data()) {
     WordIndex srcIndex = word.toWordIndex();
     if(shared_)
-      trgTruthTable[srcIndex] = 1;
+      trgTruthTable.set(srcIndex);
     // If srcIndex has not been encountered, add the corresponding target words
-    if (!srcTruthTable[srcIndex]) {
-      for (uint64_t j = wordToOffset_[srcIndex]; j < wordToOffset_[srcIndex+1]; j++)
-        trgTruthTable[shortLists_[j]] = 1;
-      srcTruthTable[srcIndex] = 1;
+    if (!srcTruthTable.test(srcIndex)) {
+      trgTruthTable.set(&shortLists_[wordToOffset_[srcIndex]], &shortLists_[wordToOffset_[srcIndex+1]]);
+      srcTruthTable.set(srcIndex);
     }
   }
 
-  // Due to the 'multiple-of-eight' issue, the following O(N) patch is inserted
-  size_t trgTruthTableOnes = 0;   // counter for no. of selected target words
-  for (size_t i = 0; i < trgVocabSize; i++) {
-    if(trgTruthTable[i])
-      trgTruthTableOnes++;
-  }
-
   // Ensure that the generated vocabulary items from a shortlist are a multiple-of-eight
   // This is necessary until intgemm supports non-multiple-of-eight matrices.
-  for (size_t i = firstNum_; i < trgVocabSize && trgTruthTableOnes%8!=0; i++){
-    if (!trgTruthTable[i]){
-      trgTruthTable[i] = 1;
-      trgTruthTableOnes++;
-    }
-  }
-
-  // turn selected indices into vector and sort (Bucket sort: O(V))
-  std::vector<WordIndex> indices;
-  for (WordIndex i = 0; i < trgVocabSize; i++) {
-    if(trgTruthTable[i])
-      indices.push_back(i);
-  }
+  trgTruthTable.padToMultiple(8, (WordIndex)firstNum_);
 
-  return New<Shortlist>(indices);
+  // selected indices, already sorted
+  return New<Shortlist>(trgTruthTable.toIndices());
 }
 
 void BinaryShortlistGenerator::dump(const std::string& fileName) const {
@@ -15,23 +15,108 @@
 #include <algorithm>
 #include <limits>
 
-namespace faiss {
-  struct IndexLSH;
-}
-
 namespace marian {
 namespace data {
 
+// Set of target word indices stored as a bitset over the vocabulary. Shortlist generators use this to build
+// the union of per-source-word candidate lists in O(V/64) memory without hashing, and the set bits come out
+// already sorted, so no std::sort is needed either. Candidate lists are added one index at a time, ranges
+// and other bitsets one 64-bit word at a time.
+class ShortlistBitset {
+private:
+  std::vector<uint64_t> bits_;
+  size_t size_{0};   // vocabulary size
+  size_t count_{0};  // number of set bits
+
+  static inline size_t popcount64(uint64_t x) {
+#ifdef _MSC_VER
+    return (size_t)__popcnt64(x);
+#else
+    return (size_t)__builtin_popcountll(x);
+#endif
+  }
+
+  // sets the bits of mask in the i-th word
+  void setBits(size_t i, uint64_t mask) {
+    count_ += popcount64(mask & ~bits_[i]);
+    bits_[i] |= mask;
+  }
+
+public:
+  ShortlistBitset(size_t size) : bits_((size + 63) / 64, 0), size_(size) {}
+
+  bool test(WordIndex i) const { return (bits_[i >> 6] >> (i & 63)) & 1; }
+
+  void set(WordIndex i) {
+    uint64_t& word = bits_[i >> 6];
+    uint64_t mask = (uint64_t)1 << (i & 63);
+    count_ += (word & mask) == 0;
+    word |= mask;
+  }
+
+  template <typename Iterator>
+  void set(Iterator begin, Iterator end) {
+    for(auto it = begin; it != end; ++it)
+      set((WordIndex)*it);
+  }
+
+  // Sets all indices in [begin, end), clipped to the vocabulary
+  void setRange(WordIndex begin, WordIndex end) {
+    end = (WordIndex)std::min((size_t)end, size_);
+    for(WordIndex i = begin; i < end;) {
+      size_t bit = i & 63;
+      size_t bits = std::min((size_t)64 - bit, (size_t)(end - i));
+      uint64_t mask = bits == 64 ? ~(uint64_t)0 : (((uint64_t)1 << bits) - 1) << bit;
+      setBits(i >> 6, mask);
+      i += (WordIndex)bits;
+    }
+  }
+
+  // Union with a bitset over the same or a smaller vocabulary
+  ShortlistBitset& operator|=(const ShortlistBitset& other) {
+    ABORT_IF(other.size_ > size_, "Cannot add a bitset of size {} to a bitset of size {}", other.size_, size_);
+    for(size_t i = 0; i < other.bits_.size(); ++i)
+      setBits(i, other.bits_[i]);
+    return *this;
+  }
+
+  size_t size() const { return size_; }
+  size_t count() const { return count_; }
+
+  // Set additional indices starting from 'from' until count() is a multiple of 'multiple' (or the vocabulary is exhausted)
+  void padToMultiple(size_t multiple, WordIndex from) {
+    for(WordIndex i = from; i < size_ && count_ % multiple != 0; ++i)
+      set(i);
+  }
+
+  // Sorted list of set indices
+  std::vector<WordIndex> toIndices() const {
+    std::vector<WordIndex> indices;
+    indices.reserve(count_);
+    for(size_t i = 0; i < bits_.size(); ++i) {
+      uint64_t w = bits_[i];
+      for(WordIndex j = (WordIndex)(i * 64); w; w >>= 1, ++j) // skips empty words entirely
+        if(w & 1)
+          indices.push_back(j);
+    }
+    return indices;
+  }
+};
+
 class Shortlist {
 protected:
   std::vector<WordIndex> indices_;    // // [packed shortlist index] -> word index, used to select columns from output embeddings
+  size_t indicesHash_{0}; // hash of indices_, identical shortlists of consecutive batches share their gathered output matrices
+  std::vector<Expr> memoized_; // gathered tensors that are kept by the graph across batches, see forget()
   Expr indicesExpr_;    // cache an expression that contains the short list indices
 
   Expr cachedShortWt_;  // short-listed version, cached (cleared by clear())
   Expr cachedShortb_;   // these match the current value of shortlist_
   Expr cachedShortLemmaEt_;
   bool initialized_; // used by batch-level shortlist. Only initialize with 1st call then skip all subsequent calls for same batch
-  
+
+  // GEMM type of the shortlisted output layer, see --shortlist-gemm-type, float32 where intgemm does not apply
+  Type shortlistGemmType(Expr weights, int k) const;
   void createCachedTensors(Expr weights,
                            bool isLegacyUntransposedW,
                            Expr b,
@@ -51,6 +136,13 @@ public:
   virtual Expr getCachedShortWt() const { return cachedShortWt_; }
   virtual Expr getCachedShortb() const { return cachedShortb_; }
   virtual Expr getCachedShortLemmaEt() const { return cachedShortLemmaEt_; }
+
+  size_t getIndicesHash() const { return indicesHash_; }
+
+  // In inference graphs the gathered output matrices are memoized, so that the next batch with an identical
+  // shortlist (e.g. consecutive sentences of the same document) skips the gather. Call this when the shortlist
+  // changes to release them, otherwise every distinct shortlist would stay in memory.
+  virtual void forget();
 };
 
 class ShortlistGenerator {
@@ -74,8 +166,7 @@ private:
   int k_; // number of candidates returned from each input 
   int nbits_; // length of hash
   size_t lemmaSize_; // vocab size
-  static Ptr<faiss::IndexLSH> index_; // LSH index to store all possible candidates
-  static std::mutex mutex_;
+  int probes_; // number of buckets for multi-probe search, 0 for exhaustive search (see lsh::Index)
 
   void createCachedTensors(Expr weights,
                            bool isLegacyUntransposedW,
@@ -84,7 +175,7 @@ private:
                            int k);
 
 public:
-  LSHShortlist(int k, int nbits, size_t lemmaSize);
+  LSHShortlist(int k, int nbits, size_t lemmaSize, int probes = 0);
   virtual WordIndex reverseMap(int beamIdx, int batchIdx, int idx) const override;
 
   virtual void filter(Expr input, Expr weights, bool isLegacyUntransposedW, Expr b, Expr lemmaEt) override;
@@ -97,8 +188,9 @@ private:
   int k_;
   int nbits_;
   size_t lemmaSize_;
+  int probes_;
 public:
-  LSHShortlistGenerator(int k, int nbits, size_t lemmaSize);
+  LSHShortlistGenerator(int k, int nbits, size_t lemmaSize, int probes = 0);
   Ptr<Shortlist> generate(Ptr<data::CorpusBatch> batch) const override;
 };
 
@@ -290,42 +382,35 @@ public:
 
   virtual Ptr<Shortlist> generate(Ptr<data::CorpusBatch> batch) const override {
     auto srcBatch = (*batch)[srcIdx_];
+    size_t trgVocabSize = trgVocab_->size();
 
     // add firstNum most frequent words
-    std::unordered_set<WordIndex> indexSet;
-    for(WordIndex i = 0; i < firstNum_ && i < trgVocab_->size(); ++i)
-      indexSet.insert(i);
+    ShortlistBitset indexSet(trgVocabSize);
+    indexSet.setRange(0, (WordIndex)firstNum_);
 
     // add all words from ground truth
     // for(auto i : trgBatch->data())
     //  indexSet.insert(i.toWordIndex());
 
     // collect unique words form source
-    std::unordered_set<WordIndex> srcSet;
+    ShortlistBitset srcSet(srcVocab_->size());
     for(auto i : srcBatch->data())
-      srcSet.insert(i.toWordIndex());
-
-    // add aligned target words
-    for(auto i : srcSet) {
-      if(shared_)
-        indexSet.insert(i);
-      for(auto& it : data_[i])
-        indexSet.insert(it.first);
+      srcSet.set(i.toWordIndex());
+
+    // add source words for shared vocabularies and aligned target words
+    if(shared_)
+      indexSet |= srcSet;
+    for(auto i : srcSet.toIndices()) {
+      if(i < data_.size())
+        for(auto& it : data_[i])
+          indexSet.set(it.first);
     }
     // Ensure that the generated vocabulary items from a shortlist are a multiple-of-eight
     // This is necessary until intgemm supports non-multiple-of-eight matrices.
-    // TODO better solution here? This could potentially be slow.
-    WordIndex i = static_cast<WordIndex>(firstNum_);
-    while (indexSet.size() % 8 != 0) {
-      indexSet.insert(i);
-      i++;
-    }
-
-    // turn into vector and sort (selected indices)
-    std::vector<WordIndex> indices(indexSet.begin(), indexSet.end());
-    std::sort(indices.begin(), indices.end());
+    indexSet.padToMultiple(8, static_cast<WordIndex>(firstNum_));
 
-    return New<Shortlist>(indices);
+    // selected indices, already sorted
+    return New<Shortlist>(indexSet.toIndices());
   }
 };
 
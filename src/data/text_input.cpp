@@ -31,28 +31,56 @@ TextInput::TextInput(std::vector<std::string> inputs,
   // texts not paths!
   for(const auto& text : paths_)
     files_.emplace_back(new std::istringstream(text));
+
+  if(options_->get<size_t>("split-long-inputs", 0) > 0) {
+    ABORT_IF(files_.size() != 1, "--split-long-inputs is only supported for a single input");
+    segmenter_ = New<Segmenter>(options_, vocabs_[0]);
+  }
+}
+
+Words TextInput::encode(const std::string& line, size_t i) const {
+  Words words = vocabs_[i]->encode(line, /*addEOS=*/true, /*inference=*/inference_);
+  if(this->maxLengthCrop_ && words.size() > this->maxLength_) {
+    words.resize(maxLength_);
+    words.back() = vocabs_.back()->getEosId();  // note: this will not work with class-labels
+  }
+  ABORT_IF(words.empty(),   "No words (not even EOS) found in string??");
+  return words;
 }
 
 // TextInput is mainly used for inference in the server mode, not for training, so skipping too long
 // or ill-formed inputs is not necessary here
 SentenceTuple TextInput::next() {
+  if(!segments_.empty()) {
+    SentenceTuple tup = segments_.front();
+    segments_.pop_front();
+    return tup;
+  }
+
   // get index of the current sentence
   size_t curId = pos_++;
 
+  // the only input, see constructor
+  if(segmenter_) {
+    std::string line;
+    if(!io::getline(*files_[0], line))
+      return SentenceTuple(0);
+    auto segments = segmenter_->split(line);
+    size_t segmentId = segmenter_->add(curId, segments.size());
+    for(const auto& segment : segments) {
+      segments_.emplace_back(segmentId++);
+      segments_.back().push_back(encode(segment, 0));
+    }
+    return next();
+  }
+
   // fill up the sentence tuple with source and/or target sentences
   SentenceTuple tup(curId);
   for(size_t i = 0; i < files_.size(); ++i) {
     std::string line;
     if(io::getline(*files_[i], line)) {
-      Words words = vocabs_[i]->encode(line, /*addEOS=*/true, /*inference=*/inference_);
-      if(this->maxLengthCrop_ && words.size() > this->maxLength_) {
-        words.resize(maxLength_);
-        words.back() = vocabs_.back()->getEosId();  // note: this will not work with class-labels
-      }
-
-      ABORT_IF(words.empty(),   "No words (not even EOS) found in string??");
       ABORT_IF(tup.size() != i, "Previous tuple elements are missing.");
-      tup.push_back(words);
+      tup.push_back(encode(line, i));
     }
   }
 
@@ -2,6 +2,9 @@
 
 #include "data/iterator_facade.h"
 #include "data/corpus.h"
+#include "data/segmenter.h"
+
+#include <deque>
 
 namespace marian {
 namespace data {
@@ -36,6 +39,11 @@ private:
   size_t maxLength_{0};
   bool maxLengthCrop_{false};
 
+  Ptr<Segmenter> segmenter_;           // with --split-long-inputs
+  std::deque<SentenceTuple> segments_; // segments of the last line not returned yet
+
+  Words encode(const std::string& line, size_t i) const;
+
 public:
   typedef SentenceTuple Sample;
 
@@ -50,6 +58,9 @@ public:
   iterator begin() override { return iterator(*this); }
   iterator end() override { return iterator(); }
 
+  // Maps the IDs of the returned tuples back to line numbers if long lines are split, otherwise null
+  Ptr<Segmenter> getSegmenter() { return segmenter_; }
+
   // TODO: There are half dozen functions called toBatch(), which are very
   // similar. Factor them.
   batch_ptr toBatch(const std::vector<Sample>& batchVector) override {
@@ -9,6 +9,7 @@
 #include "data/corpus_nbest.h"
 #include "models/costs.h"
 #include "models/model_task.h"
+#include "embedder/miner.h"
 #include "embedder/vector_collector.h"
 #include "training/scheduler.h"
 #include "training/validator.h"
@@ -20,7 +21,9 @@ using namespace data;
 /*
  * The tool is used to create output sentence embeddings from available
  * Marian encoders. With --compute-similiarity and can return the cosine
- * similarity between two sentences provided from two sources.
+ * similarity between two sentences provided from two sources. With --mine
+ * both sources are embedded separately and the nearest target sentences of
+ * each source sentence are searched, see mining::Miner.
  */
 class Embedder {
 private:
@@ -49,6 +52,7 @@ class Embed : public ModelTask {
 private:
   Ptr<Options> options_;
   Ptr<CorpusBase> corpus_;
+  std::vector<Ptr<CorpusBase>> sides_; // source and target corpus for --mine
   std::vector<Ptr<ExpressionGraph>> graphs_;
   std::vector<Ptr<Model>> models_;
 
@@ -73,8 +77,28 @@ public:
                                 "input-types", std::vector<std::string>(vVocabs.size(), "sequence"));
     }
 
-    corpus_ = New<Corpus>(options_);
-    corpus_->prepare();
+    if(options_->get<bool>("mine", false)) {
+      // both sides go through the same encoder, each side is read as a corpus of its own
+      ABORT_IF(options_->get<bool>("compute-similarity"), "--mine cannot be used with --compute-similarity");
+      ABORT_IF(options_->get<bool>("tsv", false), "--mine does not support --tsv, provide two files");
+      auto vSets       = options_->get<std::vector<std::string>>("train-sets");
+      auto vVocabs     = options_->get<std::vector<std::string>>("vocabs");
+      auto vDimVocabs  = options_->get<std::vector<size_t>>("dim-vocabs", {});
+      ABORT_IF(vSets.size() != 2, "--mine expects two inputs, source and target sentences");
+      for(size_t i = 0; i < vSets.size(); ++i) {
+        size_t v = std::min(i, vVocabs.size() - 1);
+        auto sideOptions = options_->with("train-sets", std::vector<std::string>({vSets[i]}),
+                                          "vocabs",     std::vector<std::string>({vVocabs[v]}));
+        if(!vDimVocabs.empty())
+          sideOptions = sideOptions->with("dim-vocabs",
+                                          std::vector<size_t>({vDimVocabs[std::min(i, vDimVocabs.size() - 1)]}));
+        sides_.push_back(New<Corpus>(sideOptions));
+        sides_.back()->prepare();
+      }
+    } else {
+      corpus_ = New<Corpus>(options_);
+      corpus_->prepare();
+    }
 
     auto devices = Config::getDevices(options_);
 
@@ -103,20 +127,38 @@ public:
   }
 
   void run() override {
-    LOG(info, "Embedding");
     timer::Timer timer;
-    
-    auto batchGenerator = New<BatchGenerator<CorpusBase>>(corpus_, options_);
-    batchGenerator->prepare();
 
-    auto output = New<VectorCollector>(options_);
+    if(!sides_.empty()) {
+      LOG(info, "Embedding source and target sentences for mining");
+      // cosine similarities are dot products of unit-length vectors
+      mining::EmbeddingMatrix src, trg;
+      embed(sides_[0], src, /*l2Normalize=*/true);
+      embed(sides_[1], trg, /*l2Normalize=*/true);
+      LOG(info, "Embedding took {:.5f}s wall", timer.elapsed());
+      mining::Miner(options_).mine(src, trg);
+    } else {
+      LOG(info, "Embedding");
+      auto output = VectorCollector::Create(options_);
+      bool l2Normalize = options_->get<bool>("l2-normalize", false);
+      ABORT_IF(l2Normalize && options_->get<bool>("compute-similarity"),
+               "--l2-normalize cannot be used with --compute-similarity");
+      embed(corpus_, *output, l2Normalize);
+    }
+    LOG(info, "Total time: {:.5f}s wall", timer.elapsed());
+  }
+
+private:
+  void embed(Ptr<CorpusBase> corpus, VectorCollector& output, bool l2Normalize) {
+    auto batchGenerator = New<BatchGenerator<CorpusBase>>(corpus, options_);
+    batchGenerator->prepare();
 
     size_t batchId = 0;
     {
       ThreadPool pool(graphs_.size(), graphs_.size());
 
       for(auto batch : *batchGenerator) {
-        auto task = [=](size_t id) {
+        auto task = [=, &output](size_t id) {
           thread_local Ptr<ExpressionGraph> graph;
           thread_local Ptr<Model> builder;
 
@@ -138,8 +180,17 @@ public:
               auto beg = i * embSize;
               auto end = (i + 1) * embSize;
               std::vector<float> sentVector(sentVectors.begin() + beg, sentVectors.begin() + end);
-              output->Write((long)batch->getSentenceIds()[i],
-                            sentVector);
+              if(l2Normalize) {
+                float norm = 0.f;
+                for(auto v : sentVector)
+                  norm += v * v;
+                norm = std::sqrt(norm);
+                if(norm > 0.f)
+                  for(auto& v : sentVector)
+                    v /= norm;
+              }
+              output.Write((long)batch->getSentenceIds()[i],
+                           sentVector);
           }
         
           // progress heartbeat for MS-internal Philly compute cluster
@@ -156,7 +207,6 @@ public:
         pool.enqueue(task, batchId++);
       }
     }
-    LOG(info, "Total time: {:.5f}s wall", timer.elapsed());
   }
 
 };
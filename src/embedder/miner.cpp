@@ -0,0 +1,268 @@
+#include "embedder/miner.h"
+
+#include "3rd_party/threadpool.h"
+#include "common/file_stream.h"
+#include "common/logging.h"
+#include "common/timer.h"
+#include "tensors/cpu/prod_blas.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace marian {
+namespace mining {
+
+namespace {
+
+const size_t QUERY_BLOCK = 64;  // query rows per task
+const size_t KEY_BLOCK = 1024;  // key rows per GEMM, a [QUERY_BLOCK x KEY_BLOCK] tile fits into L2
+
+// Keeps the k highest scoring ids seen so far in a min-heap
+class TopK {
+private:
+  size_t k_;
+  std::vector<std::pair<float, uint32_t>> heap_;
+
+public:
+  TopK(size_t k) : k_(k) { heap_.reserve(k + 1); }
+
+  void add(float sim, uint32_t id) {
+    if(heap_.size() == k_ && sim <= heap_.front().first)
+      return;
+    heap_.emplace_back(sim, id);
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<std::pair<float, uint32_t>>());
+    if(heap_.size() > k_) {
+      std::pop_heap(heap_.begin(), heap_.end(), std::greater<std::pair<float, uint32_t>>());
+      heap_.pop_back();
+    }
+  }
+
+  // writes the ids and similarities best first and clears the heap
+  void extract(uint32_t* ids, float* sims) {
+    std::sort_heap(heap_.begin(), heap_.end(), std::greater<std::pair<float, uint32_t>>());
+    for(size_t i = 0; i < heap_.size(); ++i) {
+      sims[i] = heap_[i].first;
+      ids[i]  = heap_[i].second;
+    }
+    heap_.clear();
+  }
+};
+
+// c[m x n] = a[m x d] * b[n x d]^T, all row-major
+void gemmNT(const float* a, const float* b, float* c, size_t m, size_t n, size_t d) {
+#if BLAS_FOUND
+  sgemm(false, true, (int)m, (int)n, (int)d, 1.f,
+        const_cast<float*>(a), (int)d, const_cast<float*>(b), (int)d, 0.f, c, (int)n);
+#else
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j) {
+      float sum = 0.f;
+      for(size_t l = 0; l < d; ++l)
+        sum += a[i * d + l] * b[j * d + l];
+      c[i * n + j] = sum;
+    }
+#endif
+}
+
+float dot(const float* a, const float* b, size_t d) {
+  float sum = 0.f;
+  for(size_t l = 0; l < d; ++l)
+    sum += a[l] * b[l];
+  return sum;
+}
+
+// runs f(begin, end) for consecutive blocks of [0, n) on the given number of threads
+void forBlocks(size_t n, size_t block, size_t threads, const std::function<void(size_t, size_t)>& f) {
+  ThreadPool pool(threads);
+  for(size_t begin = 0; begin < n; begin += block)
+    pool.enqueue([&f, begin, block, n]() { f(begin, std::min(begin + block, n)); });
+}
+
+void checkNeighbours(const EmbeddingMatrix& queries, const EmbeddingMatrix& keys, size_t k) {
+  ABORT_IF(queries.cols() != keys.cols(),
+           "Embedding sizes of queries ({}) and keys ({}) differ", queries.cols(), keys.cols());
+  ABORT_IF(k == 0 || k > keys.rows(), "Cannot return {} nearest neighbours from {} sentences", k, keys.rows());
+}
+
+}  // namespace
+
+void EmbeddingMatrix::Write(long id, const std::vector<float>& vec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(cols_ == 0)
+    cols_ = vec.size();
+  ABORT_IF(vec.size() != cols_, "Embedding of sentence {} has size {}, expected {}", id, vec.size(), cols_);
+  if((size_t)id >= rows_) {
+    rows_ = (size_t)id + 1;
+    data_.resize(rows_ * cols_, 0.f);
+  }
+  std::copy(vec.begin(), vec.end(), data_.begin() + id * cols_);
+}
+
+Neighbours ExactIndex::search(const EmbeddingMatrix& queries, size_t k) const {
+  checkNeighbours(queries, keys_, k);
+  const size_t dim = keys_.cols();
+
+  Neighbours result;
+  result.k = k;
+  result.ids.resize(queries.rows() * k);
+  result.sims.resize(queries.rows() * k);
+
+  forBlocks(queries.rows(), QUERY_BLOCK, threads_, [&](size_t begin, size_t end) {
+    size_t m = end - begin;
+    std::vector<float> tile(m * KEY_BLOCK);
+    std::vector<TopK> best(m, TopK(k));
+    for(size_t k0 = 0; k0 < keys_.rows(); k0 += KEY_BLOCK) {
+      size_t n = std::min(KEY_BLOCK, keys_.rows() - k0);
+      gemmNT(queries.row(begin), keys_.row(k0), tile.data(), m, n, dim);
+      for(size_t i = 0; i < m; ++i)
+        for(size_t j = 0; j < n; ++j)
+          best[i].add(tile[i * n + j], (uint32_t)(k0 + j));
+    }
+    for(size_t i = 0; i < m; ++i)
+      best[i].extract(result.ids.data() + (begin + i) * k, result.sims.data() + (begin + i) * k);
+  });
+  return result;
+}
+
+LshIndex::LshIndex(const EmbeddingMatrix& keys, int nbits, int probes, size_t candidates, size_t threads)
+    : keys_(keys), nbits_(nbits), probes_(probes), candidates_(candidates), threads_(threads) {
+  ABORT_IF(nbits_ <= 0, "Number of LSH bits must be positive");
+
+  // fixed seed so that queries and keys of all runs are hashed identically
+  std::mt19937 rng(1234);
+  std::normal_distribution<float> normal(0.f, 1.f);
+  hyperplanes_.resize(nbits_ * keys_.cols());
+  for(auto& v : hyperplanes_)
+    v = normal(rng);
+
+  auto codes = encode(keys_);
+  index_ = New<lsh::Index>(codes.data(), (int)keys_.rows(), lsh::bytesPerVector(nbits_));
+}
+
+std::vector<uint8_t> LshIndex::encode(const EmbeddingMatrix& vectors) const {
+  const size_t dim = vectors.cols();
+  const size_t bytes = lsh::bytesPerVector(nbits_);
+  std::vector<uint8_t> codes(vectors.rows() * bytes, 0);
+
+  forBlocks(vectors.rows(), KEY_BLOCK, threads_, [&](size_t begin, size_t end) {
+    size_t m = end - begin;
+    std::vector<float> projections(m * nbits_);
+    gemmNT(vectors.row(begin), hyperplanes_.data(), projections.data(), m, nbits_, dim);
+    for(size_t i = 0; i < m; ++i)
+      for(int b = 0; b < nbits_; ++b)
+        if(projections[i * nbits_ + b] > 0.f)
+          codes[(begin + i) * bytes + b / 8] |= (uint8_t)(1 << (b % 8));
+  });
+  return codes;
+}
+
+Neighbours LshIndex::search(const EmbeddingMatrix& queries, size_t k) const {
+  checkNeighbours(queries, keys_, k);
+  const size_t dim = keys_.cols();
+  const size_t bytes = lsh::bytesPerVector(nbits_);
+  const size_t candidates = std::min(std::max(candidates_, k), keys_.rows());
+
+  auto codes = encode(queries);
+
+  Neighbours result;
+  result.k = k;
+  result.ids.resize(queries.rows() * k);
+  result.sims.resize(queries.rows() * k);
+
+  forBlocks(queries.rows(), QUERY_BLOCK, threads_, [&](size_t begin, size_t end) {
+    std::vector<uint32_t> ids(candidates);
+    TopK best(k);
+    for(size_t i = begin; i < end; ++i) {
+      index_->search(codes.data() + i * bytes, (int)candidates, probes_, /*firstNRows=*/0, ids.data());
+      for(auto id : ids)
+        best.add(dot(queries.row(i), keys_.row(id), dim), id);
+      best.extract(result.ids.data() + i * k, result.sims.data() + i * k);
+    }
+  });
+  return result;
+}
+
+Ptr<Index> createIndex(Ptr<Options> options, const EmbeddingMatrix& keys) {
+  size_t threads = options->get<size_t>("cpu-threads", 0);
+  if(threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  auto type = options->get<std::string>("mine-index", "exact");
+  if(type == "exact")
+    return New<ExactIndex>(keys, threads);
+  else if(type == "lsh")
+    return New<LshIndex>(keys,
+                         options->get<int>("mine-lsh-bits", 256),
+                         options->get<int>("mine-lsh-probes", 0),
+                         options->get<size_t>("mine-lsh-candidates", 64),
+                         threads);
+  ABORT("Unknown mining index type: {}", type);
+}
+
+Miner::Miner(Ptr<Options> options)
+    : options_(options),
+      k_(options->get<size_t>("mine-k", 4)),
+      margin_(options->get<std::string>("mine-margin", "ratio")) {
+  ABORT_IF(margin_ != "ratio" && margin_ != "distance" && margin_ != "absolute",
+           "Unknown margin type {}, expected ratio, distance or absolute", margin_);
+}
+
+void Miner::mine(const EmbeddingMatrix& src, const EmbeddingMatrix& trg) {
+  timer::Timer timer;
+  LOG(info, "Searching {} nearest neighbours of {} source and {} target sentences",
+      k_, src.rows(), trg.rows());
+
+  auto forward = createIndex(options_, trg)->search(src, k_);
+
+  // the backward direction is only needed for the average similarity of target sentences
+  std::vector<float> srcAvg(src.rows(), 0.f), trgAvg(trg.rows(), 0.f);
+  if(margin_ != "absolute") {
+    auto backward = createIndex(options_, src)->search(trg, k_);
+    for(size_t i = 0; i < src.rows(); ++i)
+      for(size_t j = 0; j < k_; ++j)
+        srcAvg[i] += forward.sims[i * k_ + j] / k_;
+    for(size_t i = 0; i < trg.rows(); ++i)
+      for(size_t j = 0; j < k_; ++j)
+        trgAvg[i] += backward.sims[i * k_ + j] / k_;
+  }
+
+  UPtr<std::ostream> out;
+  if(options_->get<std::string>("output") == "stdout")
+    out.reset(new std::ostream(std::cout.rdbuf()));
+  else
+    out.reset(new io::OutputFileStream(options_->get<std::string>("output")));
+
+  std::vector<std::pair<float, uint32_t>> scored(k_);
+  std::string line;
+  char buffer[64];
+  for(size_t i = 0; i < src.rows(); ++i) {
+    for(size_t j = 0; j < k_; ++j) {
+      uint32_t id = forward.ids[i * k_ + j];
+      float sim   = forward.sims[i * k_ + j];
+      float avg   = (srcAvg[i] + trgAvg[id]) / 2.f;
+      float score = margin_ == "ratio" ? sim / avg : margin_ == "distance" ? sim - avg : sim;
+      scored[j] = std::make_pair(score, id);
+    }
+    // margins can reorder the candidates found by cosine similarity
+    std::stable_sort(scored.begin(), scored.end(), std::greater<std::pair<float, uint32_t>>());
+
+    for(const auto& candidate : scored) {
+      int n = std::snprintf(buffer, sizeof(buffer), "%zu\t%u\t%.6f\n", i, candidate.second, candidate.first);
+      line.append(buffer, std::min((size_t)std::max(n, 0), sizeof(buffer) - 1));
+    }
+    if(line.size() > 64 * 1024) {
+      *out << line;
+      line.clear();
+    }
+  }
+  *out << line << std::flush;
+
+  LOG(info, "Mining took {:.5f}s wall", timer.elapsed());
+}
+
+}  // namespace mining
+}  // namespace marian
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "common/definitions.h"
+#include "common/options.h"
+#include "embedder/vector_collector.h"
+#include "layers/lsh.h"
+
+#include <vector>
+
+namespace marian {
+namespace mining {
+
+// Collects the unit-length embeddings of one side of the corpus in memory, one row per sentence ID.
+// Rows may arrive in any order from the embedding threads.
+class EmbeddingMatrix : public VectorCollector {
+public:
+  EmbeddingMatrix() {}
+
+  virtual void Write(long id, const std::vector<float>& vec) override;
+
+  size_t rows() const { return rows_; }
+  size_t cols() const { return cols_; }
+  const float* data() const { return data_.data(); }
+  const float* row(size_t i) const { return data_.data() + i * cols_; }
+
+private:
+  size_t rows_{0};
+  size_t cols_{0};
+  std::vector<float> data_; // [rows_ x cols_]
+};
+
+// k nearest keys of each query row, best first
+struct Neighbours {
+  size_t k{0};
+  std::vector<uint32_t> ids; // [queries x k]
+  std::vector<float> sims;   // [queries x k] cosine similarities
+};
+
+// Nearest neighbour search by cosine similarity over the rows of an EmbeddingMatrix
+class Index {
+public:
+  virtual ~Index() {}
+  virtual Neighbours search(const EmbeddingMatrix& queries, size_t k) const = 0;
+};
+
+// Brute-force search: similarities are computed block-wise with a GEMM of query and key rows,
+// so that blocks stay in cache, and only the k best keys of each query are kept.
+class ExactIndex : public Index {
+public:
+  ExactIndex(const EmbeddingMatrix& keys, size_t threads) : keys_(keys), threads_(threads) {}
+  virtual Neighbours search(const EmbeddingMatrix& queries, size_t k) const override;
+
+private:
+  const EmbeddingMatrix& keys_;
+  size_t threads_;
+};
+
+// Approximate search: keys are hashed with random hyperplanes into bit codes and the candidates
+// closest in Hamming distance are found with lsh::Index. Candidates are re-ranked by their exact
+// cosine similarity.
+class LshIndex : public Index {
+public:
+  LshIndex(const EmbeddingMatrix& keys, int nbits, int probes, size_t candidates, size_t threads);
+  virtual Neighbours search(const EmbeddingMatrix& queries, size_t k) const override;
+
+private:
+  const EmbeddingMatrix& keys_;
+  int nbits_;
+  int probes_;
+  size_t candidates_;
+  size_t threads_;
+  std::vector<float> hyperplanes_; // [nbits x cols] normals of the hyperplanes
+  Ptr<const lsh::Index> index_;
+
+  std::vector<uint8_t> encode(const EmbeddingMatrix& vectors) const;
+};
+
+// Creates the index selected by --mine-index over the given keys
+Ptr<Index> createIndex(Ptr<Options> options, const EmbeddingMatrix& keys);
+
+/**
+ * Bitext mining: for each source sentence the k nearest target sentences are scored with the
+ * margin criterion of Artetxe and Schwenk (2019), which normalizes the cosine similarity of a pair
+ * by the average similarity of both sentences to their own k nearest neighbours:
+ *   absolute: cos(x, y)
+ *   distance: cos(x, y) - (avg_knn(x) + avg_knn(y)) / 2
+ *   ratio:    cos(x, y) / ((avg_knn(x) + avg_knn(y)) / 2)
+ * Writes one line "srcId<TAB>trgId<TAB>score" per candidate pair, best candidates first.
+ */
+class Miner {
+public:
+  Miner(Ptr<Options> options);
+  void mine(const EmbeddingMatrix& src, const EmbeddingMatrix& trg);
+
+private:
+  Ptr<Options> options_;
+  size_t k_;
+  std::string margin_;
+};
+
+}  // namespace mining
+}  // namespace marian
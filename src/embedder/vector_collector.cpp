@@ -3,6 +3,8 @@
 #include "common/logging.h"
 #include "common/utils.h"
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 
@@ -68,4 +70,86 @@ void VectorCollector::WriteVector(const std::vector<float>& vec) {
   }
 }
 
+Ptr<VectorCollector> VectorCollector::Create(const Ptr<Options>& options) {
+  if(options->hasAndNotEmpty("npy"))
+    return New<NpyVectorCollector>(options);
+  return New<VectorCollector>(options);
+}
+
+NpyVectorCollector::NpyVectorCollector(const Ptr<Options>& options)
+    : fileName_(options->get<std::string>("output")),
+      type_(typeFromString(options->get<std::string>("npy"))) {
+  ABORT_IF(type_ != Type::float32 && type_ != Type::float16,
+           "--npy supports float32 or float16, not {}", type_);
+  ABORT_IF(fileName_ == "stdout" || fileName_ == "-", "--npy requires an output file, see --output");
+
+  // one row per input line, the matrix size has to be known for the header
+  auto inputs = options->get<std::vector<std::string>>("train-sets");
+  ABORT_IF(inputs.empty() || inputs[0] == "stdin" || inputs[0] == "-",
+           "--npy requires the input to be a file, the number of lines is needed to size the output matrix");
+  io::InputFileStream in(inputs[0]);
+  std::string line;
+  while(io::getline(in, line))
+    rows_++;
+  LOG(info, "Writing {} embeddings as {} .npy matrix to {}", rows_, type_, fileName_);
+}
+
+NpyVectorCollector::~NpyVectorCollector() {
+  if(written_ < rows_)
+    LOG(warn, "Only {} of the {} rows of {} have been written, the other rows are zero", written_.load(), rows_, fileName_);
+}
+
+void NpyVectorCollector::create(size_t cols) {
+  cols_ = cols;
+
+  // .npy version 1.0 header, padded to a multiple of 64 bytes so that the data is aligned
+  std::string dict = std::string("{'descr': '<") + (type_ == Type::float32 ? "f4" : "f2")
+                     + "', 'fortran_order': False, 'shape': (" + std::to_string(rows_) + ", "
+                     + std::to_string(cols_) + "), }";
+  size_t preamble = 10; // magic string, version, header length
+  dict.append(63 - (preamble + dict.size()) % 64, ' ');
+  dict += '\n';
+  headerSize_ = preamble + dict.size();
+
+  std::string header = std::string(1, (char)0x93) + "NUMPY"; // magic string
+  header += (char)1; // major version
+  header += (char)0; // minor version
+  header += (char)(dict.size() & 0xff);
+  header += (char)(dict.size() >> 8);
+  header += dict;
+
+  size_t fileSize = headerSize_ + rows_ * cols_ * sizeOf(type_);
+  {
+    std::ofstream out(fileName_, std::ios::binary | std::ios::trunc);
+    ABORT_IF(!out, "Could not create {}", fileName_);
+    out.write(header.data(), header.size());
+    if(fileSize > header.size()) { // extend the file to its final size
+      out.seekp(fileSize - 1);
+      out.put('\0');
+    }
+  }
+
+  if(rows_ * cols_ > 0) {
+    std::error_code error;
+    map_.map(fileName_, error);
+    ABORT_IF(error, "Could not memory-map {}: {}", fileName_, error.message());
+  }
+}
+
+void NpyVectorCollector::Write(long id, const std::vector<float>& vec) {
+  std::call_once(created_, [&]() { create(vec.size()); });
+  ABORT_IF(vec.size() != cols_, "Embedding size changed from {} to {}??", cols_, vec.size());
+  ABORT_IF(id < 0 || (size_t)id >= rows_, "Sentence {} is out of the {} rows of the output matrix", id, rows_);
+
+  char* row = map_.data() + headerSize_ + (size_t)id * cols_ * sizeOf(type_);
+  if(type_ == Type::float32) {
+    std::memcpy(row, vec.data(), cols_ * sizeof(float));
+  } else {
+    auto out = reinterpret_cast<float16*>(row);
+    for(size_t i = 0; i < cols_; ++i)
+      out[i] = float16(vec[i]);
+  }
+  written_++;
+}
+
 }  // namespace marian
@@ -3,7 +3,11 @@
 #include "common/options.h"
 #include "common/definitions.h"
 #include "common/file_stream.h"
+#include "common/types.h"
 
+#include "3rd_party/mio/mio.hpp"
+
+#include <atomic>
 #include <map>
 #include <mutex>
 
@@ -19,7 +23,12 @@ public:
   
   virtual void Write(long id, const std::vector<float>& vec);
 
+  // VectorCollector or NpyVectorCollector depending on --npy
+  static Ptr<VectorCollector> Create(const Ptr<Options>& options);
+
 protected:
+  VectorCollector() {} // for subclasses that do not write to a stream
+
   long nextId_{0};
   UPtr<std::ostream> outStrm_;
   bool binary_; // output binary floating point vectors if set
@@ -31,4 +40,30 @@ protected:
 
   virtual void WriteVector(const std::vector<float>& vec);
 };
+
+// Writes the vectors as a float32 or float16 .npy matrix with one row per sentence ID, which can be
+// memory-mapped by downstream tools, e.g. numpy.load(file, mmap_mode='r'). The file is sized for
+// all lines of the input and mapped into memory when the first vector arrives. Each row is written
+// in place by the thread that computed it, without ordering or locking. Rows that are never written
+// stay zero; the destructor warns about them, as the matrix then does not match the input lines.
+class NpyVectorCollector : public VectorCollector {
+public:
+  NpyVectorCollector(const Ptr<Options>& options);
+  virtual ~NpyVectorCollector();
+
+  virtual void Write(long id, const std::vector<float>& vec) override;
+
+private:
+  std::string fileName_;
+  Type type_;           // float32 or float16
+  size_t rows_{0};      // number of input lines
+  size_t cols_{0};      // embedding size, known with the first vector
+  size_t headerSize_{0};
+  std::atomic<size_t> written_{0}; // number of rows written
+
+  std::once_flag created_;
+  mio::mmap_sink map_;
+
+  void create(size_t cols);
+};
 }  // namespace marian
@@ -0,0 +1,51 @@
+#include "graph/auto_tuner.h"
+
+#include "common/logging.h"
+
+#include <fstream>
+#include <map>
+
+namespace marian {
+
+AutoTunerDatabase::AutoTunerDatabase(const std::string& file) : file_(file) {
+  if(file_.empty())
+    return;
+  std::ifstream in(file_);
+  size_t operation, algorithm;
+  while(in >> operation >> algorithm)
+    decisions_[operation] = algorithm;
+  if(!decisions_.empty())
+    LOG(info, "[autotuner] Loaded {} tuning decisions from {}", decisions_.size(), file_);
+}
+
+bool AutoTunerDatabase::find(size_t operation, size_t& algorithm) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = decisions_.find(operation);
+  if(it == decisions_.end())
+    return false;
+  algorithm = it->second;
+  return true;
+}
+
+void AutoTunerDatabase::add(size_t operation, size_t algorithm) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(!decisions_.emplace(operation, algorithm).second)
+    return; // another thread has decided first
+  if(!file_.empty()) {
+    std::ofstream out(file_, std::ios::app);
+    ABORT_IF(!out, "Cannot write tuning decisions to {}", file_);
+    out << operation << " " << algorithm << std::endl;
+  }
+}
+
+Ptr<AutoTunerDatabase> AutoTunerDatabase::get(const std::string& file) {
+  static std::mutex mutex;
+  static std::map<std::string, Ptr<AutoTunerDatabase>> databases;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& database = databases[file];
+  if(!database)
+    database = New<AutoTunerDatabase>(file);
+  return database;
+}
+
+}  // namespace marian
@@ -1,14 +1,38 @@
 #pragma once
 
+#include "common/definitions.h"
 #include "common/timer.h"
 
 #include <chrono>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace marian {
 
+// Decisions of AutoTuners, i.e. the hash of the fastest algorithm for each operation hash, shared by
+// all threads of a process. If a file is given, decisions from earlier runs are loaded from it and
+// new decisions are appended, one "operation algorithm" pair of hashes per line. The hashes depend
+// on the shapes and the available algorithms, so a file is only meaningful for the same build and CPU.
+class AutoTunerDatabase {
+private:
+  std::string file_;
+  std::mutex mutex_;
+  std::unordered_map<size_t, size_t> decisions_;
+
+public:
+  AutoTunerDatabase(const std::string& file);
+
+  bool find(size_t operation, size_t& algorithm);
+  void add(size_t operation, size_t algorithm);
+
+  // returns the shared database for the given file, or the in-memory database for an empty name
+  static Ptr<AutoTunerDatabase> get(const std::string& file);
+};
+
 class AutoTunerRecorder {
 public:
   virtual void start(size_t hash) = 0;
@@ -49,7 +73,21 @@ private:
 
   std::vector<HashedAlgorithm> algorithms_;
 
+  Ptr<AutoTunerDatabase> database_;
+  size_t operation_{0}; // hash of the operation the current algorithms implement
+
   size_t choose() {
+    size_t decided;
+    if(database_ && database_->find(operation_, decided)) {
+      for(size_t i = 0; i < algorithms_.size(); ++i) {
+        if(algorithms_[i].hash == decided) {
+          for(auto& a : algorithms_)
+            done_[a.hash] = i;
+          return i;
+        }
+      }
+    }
+
     size_t best = 0;
     double bestTime = std::numeric_limits<double>::max();
 
@@ -79,6 +117,9 @@ private:
     for(auto& a : algorithms_)
       done_[a.hash] = best;
 
+    if(database_)
+      database_->add(operation_, algorithms_[best].hash);
+
     return best;
   }
 
@@ -87,6 +128,15 @@ public:
 
   void clear() { algorithms_.clear(); }
 
+  // start with a new set of algorithms for the operation with the given hash, whose decision is
+  // looked up in and stored to the database if there is one
+  void clear(size_t operation) {
+    algorithms_.clear();
+    operation_ = operation;
+  }
+
+  void setDatabase(Ptr<AutoTunerDatabase> database) { database_ = database; }
+
   Return run(Args... args) { return algorithms_[choose()].algorithm(args...); }
 
   void start(size_t hash) override {
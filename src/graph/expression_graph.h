@@ -11,6 +11,7 @@
 #include "graph/node_operators.h"
 #include "graph/parameters.h"
 
+#include <algorithm>
 #include <map>
 #include <unordered_set>
 
@@ -72,7 +73,11 @@ public:
       tensors_->allocate(node->grad(), node->shape(), node->value_type());
   }
 
-  void free(const Tensor& tensor) { tensors_->free(tensor); }
+  void free(const Tensor& tensor) {
+    // memoized nodes live in the cache, their memory is released when they are forgotten
+    if(!tensors_->free(tensor))
+      cache_->free(tensor);
+  }
 
   Ptr<Allocator>       getAllocator() { return tensors_->allocator(); }
   Ptr<TensorAllocator> getTensorAllocator() { return tensors_; }
@@ -117,6 +122,17 @@ public:
   void clearShorttermMemory() { shortterm_->clear(); }
 
   void clearLongtermMemory() { longterm_->clear(); }
+
+  // remove a single memoized node from the long-term memory
+  void forget(Expr node) {
+    auto it = longterm_->find(node->hash());
+    if(it == longterm_->end())
+      return;
+    auto& nodes = it->second;
+    nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+    if(nodes.empty())
+      longterm_->erase(it);
+  }
 };
 
 typedef std::map<Type, Ptr<Parameters>> ElementTypeParamsMap; // keep it sorted, hence map not unordered map
@@ -284,6 +300,23 @@ public:
     return true;
   }
 
+  /**
+   * Run the forward pass on the nodes added since the last one, but return false instead of
+   * growing the workspace if they do not fit into it. Used to search for the largest batches
+   * that can be translated within the given workspace memory.
+   */
+  bool forwardFits() {
+    try {
+      tensors_->throwAtReallocation(true);
+      forward();
+      tensors_->throwAtReallocation(false);
+    } catch(AllocationException&) {
+      tensors_->throwAtReallocation(false);
+      return false;
+    }
+    return true;
+  }
+
   /**
    * Check whether the memory allocated for a tensor object contains a NaN or infinite value.
    * @param t a Tensor object
@@ -717,6 +750,15 @@ public:
    */
   Ptr<TensorAllocator> getTensorAllocator() { return tensors_->getTensorAllocator(); }
 
+  /**
+   * Remove a memoized node from the graph. Its memory is released once the node is no longer referenced.
+   * @param node a pointer to a memoized expression node
+   */
+  void forget(Expr node) {
+    if(tensors_)
+      tensors_->forget(node);
+  }
+
   /** Clear everything apart from parameters and memoized nodes */
   void clear() {
     count_ = 0;
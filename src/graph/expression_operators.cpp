@@ -9,6 +9,7 @@
 
 #include "graph/auto_tuner.h"
 #include "tensors/cpu/intgemm_interface.h"
+#include "tensors/cpu/block_sparse.h"
 #include "tensors/cpu/fbgemm/expanded_gemm.h"
 
 #if USE_FBGEMM
@@ -477,6 +478,92 @@ Expr weighted_average(Expr in, Expr weights, int ax) {
   return p / s;
 }
 
+// --gemm-type auto: a product of a float activation with a float matrix on CPU is run with each available
+// GEMM variant for a number of times per (m, n, k, transpose) shape before the fastest variant is used for
+// this shape, see AutoTuner. Rows are rounded up to a power of two, so that decoding with changing batch
+// and beam sizes does not restart the exploration for every step. Decisions are shared by all threads and
+// kept in --gemm-tuning-file across runs.
+Expr affineDefault(Expr a, Expr b, Expr bias, bool transA, bool transB, float scale);
+
+static Expr tunedAffineOrDot(Expr a, Expr b, Expr bias, bool transA, bool transB, float scale) {
+  auto backend = a->graph()->getBackend();
+
+  // one tuner per thread, as each thread builds and runs its own graphs. It is replaced when the thread
+  // runs a graph with another --gemm-tuning-file, so that decisions are never read from the wrong file.
+  thread_local Ptr<AutoTuner<Expr>> tuner;
+  thread_local std::string tuningFile;
+  if(!tuner || tuningFile != backend->getGemmTuningFile()) {
+    tuningFile = backend->getGemmTuningFile();
+    tuner = New<AutoTuner<Expr>>();
+    tuner->setDatabase(AutoTunerDatabase::get(tuningFile));
+  }
+
+  int k = transA ? a->shape()[-2] : a->shape()[-1];
+  int m = a->shape().elements() / k;
+  int n = transB ? b->shape()[-2] : b->shape()[-1];
+  int rows = 1;
+  while(rows < m)
+    rows *= 2;
+
+  size_t operation = util::hash<int>()(rows);
+  util::hash_combine(operation, n);
+  util::hash_combine(operation, k);
+  util::hash_combine(operation, transA);
+  util::hash_combine(operation, transB);
+  util::hash_combine(operation, (bool)bias);
+  util::hash_combine(operation, b->memoize()); // packed variants are only available for parameters
+  tuner->clear(operation);
+
+  // registers a variant, the timing starts with the first and ends with the last recorded node
+  auto insert = [&](size_t variant, std::function<Expr(std::function<Expr(Expr, bool)>)> build) {
+    size_t hash = operation;
+    util::hash_combine(hash, variant);
+    Ptr<AutoTuner<Expr>> recorder = tuner;
+    auto record = [recorder, hash](Expr e, bool stop) {
+      e->record(recorder, hash, stop);
+      return e;
+    };
+    tuner->insert({hash, [build, record]() { return build(record); }});
+  };
+
+  // 1: float32 (MKL or CBlas)
+  insert(1, [=](std::function<Expr(Expr, bool)> record) {
+    return record(bias ? affineDefault(a, b, bias, transA, transB, scale)
+                       : Expression<DotNodeOp>(a, b, transA, transB, scale), true);
+  });
+
+#if USE_FBGEMM
+  // 2, 3: fbgemm packed16 and packed8, packing of the parameter matrix is memoized and not timed
+  if(b->memoize() && fbgemm::fbgemmHasAvx2Support()) {
+    insert(2, [=](std::function<Expr(Expr, bool)> record) {
+      auto packedB = cpu::variant::pack(marian::Type::packed16, b, cpu::variant::PackMatrix::B, transB);
+      return record(bias ? cpu::variant::affine(marian::Type::packed16, a, packedB, b->shape(), bias, transA, transB, scale)
+                         : cpu::variant::dot(marian::Type::packed16, a, packedB, b->shape(), transA, transB, scale), true);
+    });
+    insert(3, [=](std::function<Expr(Expr, bool)> record) {
+      Type packed8 = fbgemm::fbgemmHasAvx512Support() ? marian::Type::packed8avx512 : marian::Type::packed8avx2;
+      auto packedB = cpu::variant::pack(packed8, b, cpu::variant::PackMatrix::B, transB, backend->getQuantizeRange());
+      return record(bias ? cpu::variant::affine(packed8, a, packedB, b->shape(), bias, transA, transB, scale)
+                         : cpu::variant::dot(packed8, a, packedB, b->shape(), transA, transB, scale), true);
+    });
+  }
+#endif  // USE_FBGEMM
+
+  // 4: intgemm8 with a parameter matrix that is prepared once (memoized and not timed) as for intgemm models,
+  // the timing covers the quantization of the activation and the product. Intgemm requires k to be a multiple
+  // of 64 and n a multiple of 8.
+  if(b->memoize() && k % 64 == 0 && n % 8 == 0) {
+    insert(4, [=](std::function<Expr(Expr, bool)> record) {
+      auto preparedB = cpu::integer::prepareB(Type::intgemm8, b, transB);
+      auto out = cpu::integer::affineOrDot(a, preparedB, bias, transA, transB, scale);
+      record(out->child(0), false); // quantized activation
+      return record(out, true);
+    });
+  }
+
+  return tuner->run();
+}
+
 Expr dot(Expr a, Expr b, bool transA, bool transB, float scale) {
   auto device = a->graph()->getDeviceId().type;
   // added support for packed GEMM API (fp16, int8)
@@ -486,8 +573,16 @@ Expr dot(Expr a, Expr b, bool transA, bool transB, float scale) {
   // Currently only true when command line options
   // --optimize --cpu-thread=N with N > 0 are set.
   if(device == DeviceType::cpu) {
-    if(isFloat(aElementType) && isFloat(bElementType)) {
-      if(b->memoize() && (a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed ||
+    Expr bsrValues, bsrIndices, bsrOffsets, bsrDensity;
+    float maxDensity = a->graph()->getBackend()->getBlockSparseMaxDensity();
+    if(isFloat(aElementType) && isFloat(bElementType) && !transB && a->graph()->isInference()
+       && maxDensity > 0.f && cpu::blocksparse::find(b, bsrValues, bsrIndices, bsrOffsets, bsrDensity)) {
+      // B has also been stored block-sparse by marian-conv --block-sparse, the node picks the kernel by its density
+      return cpu::blocksparse::affine(a, b, bsrValues, bsrIndices, bsrOffsets, bsrDensity, nullptr, transA, scale, maxDensity);
+    } else if(isFloat(aElementType) && isFloat(bElementType)) {
+      if(a->graph()->isInference() && a->graph()->getBackend()->getGemmType() == GemmType::Auto) {
+        return tunedAffineOrDot(a, b, nullptr, transA, transB, scale);
+      } else if(b->memoize() && (a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed ||
         a->graph()->getBackend()->getGemmType() == GemmType::FbInt8Packed)) {
 #if USE_FBGEMM
         if(a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed) {
@@ -559,6 +654,15 @@ Expr dot(Expr a, Expr b, bool transA, bool transB, float scale) {
 }
 
 Expr bdot(Expr a, Expr b, bool transA, bool transB, float scale) {
+  auto device = a->graph()->getDeviceId().type;
+  // on-the-fly quantized batched products, only during inference as the integer path has no backward step.
+  // Currently only set with --batched-gemm-type intgemm8|intgemm16.
+  if(device == DeviceType::cpu && a->graph()->isInference()
+     && isFloat(a->value_type()) && isFloat(b->value_type())) {
+    Type batchedGemmType = a->graph()->getBackend()->getBatchedGemmType();
+    if(isIntgemm(batchedGemmType))
+      return cpu::integer::bdot(batchedGemmType, a, b, transA, transB, scale);
+  }
   return Expression<DotBatchedNodeOp>(a, b, transA, transB, scale);
 }
 
@@ -587,8 +691,16 @@ Expr affine(Expr a, Expr b, Expr bias, bool transA, bool transB, float scale) {
   Type bElementType = b->value_type();
 
   if(device == DeviceType::cpu) {
-    if(isFloat(aElementType) && isFloat(bElementType)) {
-      if(a->graph()->getBackend()->isOptimized()) {
+    Expr bsrValues, bsrIndices, bsrOffsets, bsrDensity;
+    float maxDensity = a->graph()->getBackend()->getBlockSparseMaxDensity();
+    if(isFloat(aElementType) && isFloat(bElementType) && !transB && a->graph()->isInference()
+       && maxDensity > 0.f && cpu::blocksparse::find(b, bsrValues, bsrIndices, bsrOffsets, bsrDensity)) {
+      // B has also been stored block-sparse by marian-conv --block-sparse, the node picks the kernel by its density
+      return cpu::blocksparse::affine(a, b, bsrValues, bsrIndices, bsrOffsets, bsrDensity, bias, transA, scale, maxDensity);
+    } else if(isFloat(aElementType) && isFloat(bElementType)) {
+      if(a->graph()->isInference() && a->graph()->getBackend()->getGemmType() == GemmType::Auto) {
+        return tunedAffineOrDot(a, b, bias, transA, transB, scale);
+      } else if(a->graph()->getBackend()->isOptimized()) {
         if(b->memoize() && (a->graph()->getBackend()->getGemmType() == GemmType::FbFp16Packed ||
           a->graph()->getBackend()->getGemmType() == GemmType::FbInt8Packed)) {
 #if USE_FBGEMM
@@ -850,6 +962,33 @@ Expr rmsNorm(Expr x,
   return Expression<RMSNormalizationOp>(nodes, eps);
 }
 
+static Expr addNormalization(Expr x, Expr residual, Expr gamma, Expr beta, Expr mask, bool rms, float eps) {
+  std::vector<Expr> nodes = {x, residual, gamma};
+  if(beta)
+    nodes.push_back(beta);
+  if(mask)
+    nodes.push_back(mask);
+  return Expression<AddNormalizationOp>(nodes, (bool)beta, (bool)mask, rms, eps);
+}
+
+Expr addLayerNorm(Expr x,
+                  Expr residual,
+                  Expr gamma,
+                  Expr beta /*= nullptr*/,
+                  Expr mask /*= nullptr*/,
+                  float eps /*= 1e-9*/) {
+  return addNormalization(x, residual, gamma, beta, mask, /*rms=*/false, eps);
+}
+
+Expr addRmsNorm(Expr x,
+                Expr residual,
+                Expr gamma,
+                Expr beta /*= nullptr*/,
+                Expr mask /*= nullptr*/,
+                float eps /*= 1e-9*/) {
+  return addNormalization(x, residual, gamma, beta, mask, /*rms=*/true, eps);
+}
+
 Expr highway(Expr y, Expr x, Expr t) {
   std::vector<Expr> nodes = {y, x, t};
   return Expression<HighwayNodeOp>(nodes);
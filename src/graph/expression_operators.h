@@ -944,6 +944,21 @@ Expr layerNorm(Expr x, Expr gamma, Expr beta = nullptr, float eps = 1e-9);
  */
 Expr rmsNorm(Expr x, Expr gamma, Expr beta = nullptr, float eps = 1e-9);
 
+/**
+ * Fused residual connection with optional dropout followed by layer normalization,
+ * equivalent to layerNorm(dropout(x, mask) + residual, gamma, beta, eps) but computed in a single pass.
+ * @p mask is a dropout mask of the same shape as @p x or nullptr, @p beta may be nullptr.
+ * @see AddNormalizationOp
+ */
+Expr addLayerNorm(Expr x, Expr residual, Expr gamma, Expr beta = nullptr, Expr mask = nullptr, float eps = 1e-9);
+
+/**
+ * Fused residual connection with optional dropout followed by RMS normalization,
+ * equivalent to rmsNorm(dropout(x, mask) + residual, gamma, beta, eps).
+ * @see addLayerNorm(), AddNormalizationOp
+ */
+Expr addRmsNorm(Expr x, Expr residual, Expr gamma, Expr beta = nullptr, Expr mask = nullptr, float eps = 1e-9);
+
 /**
  * Highway transformation.
  * Computes the highway tranform on @p y and @p x as gated by @p t:
@@ -4,6 +4,7 @@
 
 #include "common/hash.h"
 #include "functional/functional.h"
+#include "graph/auto_tuner.h"
 #include "graph/node.h"
 #include "tensors/tensor_operators.h"
 
@@ -44,7 +45,13 @@ public:
   }
 
   void forward() override {
+    if(recorder_)
+      recorder_->start(recorderHash_);
+
     (*forward_)(this, children_);
+
+    if(recorder_)
+      recorder_->stop(recorderHash_, recorderStop_);
   }
 
   void backward() override {
@@ -1602,6 +1609,79 @@ private:
   float eps_;
 };
 
+// Fused residual connection, dropout and layer or RMS norm along last axis: norm(x * mask + residual).
+// Children are {x, residual, gamma, [beta], [mask]}. The sum is not kept, backward recomputes it.
+struct AddNormalizationOp : public NaryNodeOp {
+public:
+  AddNormalizationOp(const std::vector<Expr>& nodes, bool hasBeta, bool hasMask, bool rms, float eps = 1e-9)
+      : NaryNodeOp(nodes, nodes[0]->shape()), hasBeta_(hasBeta), hasMask_(hasMask), rms_(rms), eps_(eps) {
+    ABORT_IF(nodes[1]->shape() != nodes[0]->shape(),
+             "Residual of shape {} does not match input of shape {}", nodes[1]->shape(), nodes[0]->shape());
+    ABORT_IF(hasMask_ && nodes.back()->shape() != nodes[0]->shape(),
+             "Dropout mask of shape {} does not match input of shape {}", nodes.back()->shape(), nodes[0]->shape());
+  }
+
+  NodeOps forwardOps() override {
+    return {NodeOp(
+        AddNormalization(graph()->allocator(),
+                         val_,
+                         child(0)->val(),
+                         child(1)->val(),
+                         hasMask_ ? children_.back()->val() : nullptr,
+                         child(2)->val(),
+                         hasBeta_ ? child(3)->val() : nullptr,
+                         eps_,
+                         rms_))};
+  }
+
+  NodeOps backwardOps() override {
+    return {NodeOp(
+      AddNormalizationGrad(
+        graph()->allocator(),
+        child(0)->grad(),
+        child(1)->grad(),
+        child(2)->grad(),
+        hasBeta_ ? child(3)->grad() : nullptr,
+        adj_,
+        val_,
+        child(0)->val(),
+        child(1)->val(),
+        hasMask_ ? children_.back()->val() : nullptr,
+        child(2)->val(),
+        hasBeta_ ? child(3)->val() : nullptr,
+        eps_,
+        rms_))};
+  }
+
+  const std::string type() override { return rms_ ? "add_rms_normalization" : "add_layer_normalization"; }
+
+  virtual size_t hash() override {
+    size_t seed = NaryNodeOp::hash();
+    util::hash_combine(seed, hasBeta_);
+    util::hash_combine(seed, hasMask_);
+    util::hash_combine(seed, rms_);
+    util::hash_combine(seed, eps_);
+    return seed;
+  }
+
+  virtual bool equal(Expr node) override {
+    if(!NaryNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<AddNormalizationOp>(node);
+    if(!cnode)
+      return false;
+    if(hasBeta_ != cnode->hasBeta_ || hasMask_ != cnode->hasMask_ || rms_ != cnode->rms_ || eps_ != cnode->eps_)
+      return false;
+    return true;
+  }
+
+private:
+  bool hasBeta_;
+  bool hasMask_;
+  bool rms_;
+  float eps_;
+};
+
 
 struct HighwayNodeOp : public NaryNodeOp {
   HighwayNodeOp(const std::vector<Expr>& nodes) : NaryNodeOp(nodes) {}
@@ -220,4 +220,19 @@ static inline Expr rmsNorm(Expr x, std::string prefix, std::string suffix = std:
   return marian::rmsNorm(x, scale, nullptr, 1e-6f);
 }
 
+// layerNorm(dropout(x, mask) + residual) with the same parameters as layerNorm() above, fused into a single op
+static inline Expr addLayerNorm(Expr x, Expr residual, Expr mask, std::string prefix, std::string suffix = std::string()) {
+  int dimModel = x->shape()[-1];
+  auto scale = x->graph()->param(prefix + "_ln_scale" + suffix, {1, dimModel}, inits::ones());
+  auto bias = x->graph()->param(prefix + "_ln_bias" + suffix, {1, dimModel}, inits::zeros());
+  return marian::addLayerNorm(x, residual, scale, bias, mask, 1e-6f);
+}
+
+// rmsNorm(dropout(x, mask) + residual) with the same parameters as rmsNorm() above, fused into a single op
+static inline Expr addRmsNorm(Expr x, Expr residual, Expr mask, std::string prefix, std::string suffix = std::string()) {
+  int dimModel = x->shape()[-1];
+  auto scale = x->graph()->param(prefix + "_rms_scale" + suffix, {1, dimModel}, inits::ones());
+  return marian::addRmsNorm(x, residual, scale, nullptr, mask, 1e-6f);
+}
+
 }  // namespace marian
@@ -1,14 +1,27 @@
 #include "layers/lsh.h"
 #include "tensors/tensor_operators.h"
 #include "common/utils.h"
+#include "common/hash.h"
+#include "tensors/cpu/backend.h"
 
 #include "3rd_party/faiss/utils/hamming.h"
-#include "3rd_party/faiss/Index.h"
 
 #if BLAS_FOUND
 #include "3rd_party/faiss/VectorTransform.h"
 #endif
 
+#if defined(__AVX2__) || defined(__AVX512VPOPCNTDQ__)
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
 
 namespace marian {
 namespace lsh {
@@ -109,53 +122,223 @@ Expr rotator(Expr weights, int nBits) {
   return lambda({weights}, {dim, nBits}, Type::float32, rotator, rotatorHash);
 }
 
-Expr searchEncoded(Expr encodedQuery, Expr encodedWeights, int k, int firstNRows) {
+static inline int popcount64(uint64_t x) {
+#ifdef _MSC_VER
+  return (int)__popcnt64(x);
+#else
+  return __builtin_popcountll(x);
+#endif
+}
+
+// Hamming distance between two codes of 'words' 64-bit words
+static inline int hamming(const uint64_t* a, const uint64_t* b, int words) {
+  int i = 0;
+  int dist = 0;
+#if defined(__AVX512VPOPCNTDQ__)
+  if(words >= 8) {
+    __m512i acc = _mm512_setzero_si512();
+    for(; i + 8 <= words; i += 8) {
+      __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+      acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+    }
+    dist += (int)_mm512_reduce_add_epi64(acc);
+  }
+#elif defined(__AVX2__)
+  if(words >= 4) {
+    // per-nibble lookup table popcount, summed into 64-bit lanes with sad
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    for(; i + 4 <= words; i += 4) {
+      __m256i x  = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                    _mm256_loadu_si256((const __m256i*)(b + i)));
+      __m256i lo = _mm256_and_si256(x, lowMask);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), lowMask);
+      __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    dist += (int)(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+                + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+  }
+#endif
+  for(; i < words; ++i)
+    dist += popcount64(a[i] ^ b[i]);
+  return dist;
+}
+
+Index::Index(const uint8_t* codes, int rows, int bytesPerVector)
+  : rows_(rows),
+    bytesPerVector_(bytesPerVector),
+    wordsPerVector_((bytesPerVector + 7) / 8),
+    codes_((size_t)rows * wordsPerVector_, 0) {
+  for(int r = 0; r < rows_; ++r)
+    std::memcpy(codes_.data() + (size_t)r * wordsPerVector_, codes + (size_t)r * bytesPerVector_, bytesPerVector_);
+
+  // aim for about 8 rows per bucket, bucket keys are at most 16 bits and never longer than the codes
+  bucketBits_ = 1;
+  while(bucketBits_ < 16 && bucketBits_ < 8 * bytesPerVector_ && (rows_ >> (bucketBits_ + 3)) > 0)
+    bucketBits_++;
+
+  // counting sort of rows by bucket key
+  size_t numBuckets = (size_t)1 << bucketBits_;
+  bucketOffsets_.resize(numBuckets + 1, 0);
+  for(int r = 0; r < rows_; ++r)
+    bucketOffsets_[bucketKey(codes_.data() + (size_t)r * wordsPerVector_) + 1]++;
+  for(size_t b = 0; b < numBuckets; ++b)
+    bucketOffsets_[b + 1] += bucketOffsets_[b];
+  bucketRows_.resize(rows_);
+  std::vector<uint32_t> fill(bucketOffsets_.begin(), bucketOffsets_.end() - 1);
+  for(int r = 0; r < rows_; ++r)
+    bucketRows_[fill[bucketKey(codes_.data() + (size_t)r * wordsPerVector_)]++] = (uint32_t)r;
+
+  // probe order: all key masks sorted by number of flipped bits
+  probeMasks_.resize(numBuckets);
+  for(size_t m = 0; m < numBuckets; ++m)
+    probeMasks_[m] = (uint32_t)m;
+  std::stable_sort(probeMasks_.begin(), probeMasks_.end(), [](uint32_t a, uint32_t b) {
+    return popcount64(a) < popcount64(b);
+  });
+}
+
+uint32_t Index::bucketKey(const uint64_t* code) const {
+  return (uint32_t)(code[0] & (((uint64_t)1 << bucketBits_) - 1));
+}
+
+void Index::search(const uint8_t* queryBytes, int k, int probes, int firstNRows, uint32_t* ids) const {
+  int limit = firstNRows > 0 ? std::min(firstNRows, rows_) : rows_;
+  ABORT_IF(k > limit, "Cannot return {} nearest neighbors from {} rows", k, limit);
+
+  std::vector<uint64_t> query(wordsPerVector_, 0);
+  std::memcpy(query.data(), queryBytes, bytesPerVector_);
+
+  // max-heap of the k best (distance, row) pairs seen so far
+  std::vector<std::pair<int, uint32_t>> heap;
+  heap.reserve(k + 1);
+  auto consider = [&](uint32_t row) {
+    int dist = hamming(query.data(), codes_.data() + (size_t)row * wordsPerVector_, wordsPerVector_);
+    if((int)heap.size() < k) {
+      heap.emplace_back(dist, row);
+      std::push_heap(heap.begin(), heap.end());
+    } else if(dist < heap.front().first) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = {dist, row};
+      std::push_heap(heap.begin(), heap.end());
+    }
+  };
+
+  if(probes > 0) {
+    uint32_t key = bucketKey(query.data());
+    size_t probed = 0;
+    for(auto mask : probeMasks_) {
+      if(probed >= (size_t)probes && (int)heap.size() >= k)
+        break;
+      uint32_t bucket = key ^ mask;
+      for(uint32_t j = bucketOffsets_[bucket]; j < bucketOffsets_[bucket + 1]; ++j)
+        if(bucketRows_[j] < (uint32_t)limit)
+          consider(bucketRows_[j]);
+      probed++;
+    }
+  } else {
+    for(int row = 0; row < limit; ++row)
+      consider((uint32_t)row);
+  }
+
+  // sort by increasing index value, required later for binary search during reverse look-up
+  for(int i = 0; i < k; ++i)
+    ids[i] = heap[i].second;
+  std::sort(ids, ids + k);
+}
+
+Ptr<const Index> Index::get(const uint8_t* codes, int rows, int bytesPerVector) {
+  static std::mutex mutex;
+  // indices by content hash; the graphs hold the indices, so entries expire once no graph uses them anymore
+  static std::unordered_map<size_t, std::weak_ptr<const Index>> byContent;
+
+  size_t bytes = (size_t)rows * bytesPerVector;
+  size_t hash = util::hashMem<uint8_t, size_t>(codes, bytes);
+
+  auto matches = [&](const Ptr<const Index>& index) {
+    if(index->rows_ != rows || index->bytesPerVector_ != bytesPerVector)
+      return false;
+    for(int row = 0; row < rows; ++row)
+      if(std::memcmp(index->codes_.data() + (size_t)row * index->wordsPerVector_,
+                     codes + (size_t)row * bytesPerVector,
+                     bytesPerVector) != 0)
+        return false;
+    return true;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto it = byContent.begin(); it != byContent.end();) {
+    if(it->second.expired())
+      it = byContent.erase(it);
+    else
+      ++it;
+  }
+
+  auto it = byContent.find(hash);
+  if(it != byContent.end()) {
+    auto index = it->second.lock();
+    if(index && matches(index))
+      return index;
+  }
+
+  LOG(info, "[lsh] Building shared LSH index for {} codes of {} bits", rows, 8 * bytesPerVector);
+  auto index = New<const Index>(codes, rows, bytesPerVector);
+  byContent[hash] = index; // a hash collision replaces the entry, the other index stays valid for its graphs
+  return index;
+}
+
+Ptr<const Index> Index::get(Expr codes) {
+  auto backend = std::dynamic_pointer_cast<cpu::Backend>(codes->graph()->getBackend());
+  ABORT_IF(!backend, "LSH search requires a CPU backend");
+  auto& graphIndices = backend->getLshIndices();
+  if(!graphIndices)
+    graphIndices = New<GraphIndices>();
+
+  for(const auto& entry : graphIndices->indices)
+    if(entry.first == codes)
+      return entry.second;
+
+  int bytesPerVector = codes->shape()[-1];
+  int rows = codes->shape().elements() / bytesPerVector;
+  auto index = get(codes->val()->data<uint8_t>(), rows, bytesPerVector);
+  graphIndices->indices.push_back({codes, index});
+  return index;
+}
+
+Expr searchEncoded(Expr encodedQuery, Expr encodedWeights, int k, int firstNRows, int probes) {
   ABORT_IF(encodedQuery->shape()[-1] != encodedWeights->shape()[-1],
            "Query and index bit vectors need to be of same size ({} != {})", encodedQuery->shape()[-1], encodedWeights->shape()[-1]);
 
   int currBeamSize = encodedQuery->shape()[0];
   int batchSize    = encodedQuery->shape()[2];
-  int numHypos = currBeamSize * batchSize;
 
   auto search = [=](Expr out, const std::vector<Expr>& inputs) {
     Expr encodedQuery   = inputs[0];
     Expr encodedWeights = inputs[1];
 
     int bytesPerVector = encodedWeights->shape()[-1];
-    int wRows = encodedWeights->shape().elements() / bytesPerVector;
-    
-    // we use this with Factored Segmenter to skip the factor embeddings at the end
-    if(firstNRows != 0)
-      wRows = firstNRows;
-
     int qRows = encodedQuery->shape().elements() / bytesPerVector;
 
-    uint8_t* qCodes = encodedQuery->val()->data<uint8_t>();
-    uint8_t* wCodes = encodedWeights->val()->data<uint8_t>();
-
-    // use actual faiss code for performing the hamming search. 
-    std::vector<int> distances(qRows * k);
-    std::vector<faiss::Index::idx_t> ids(qRows * k);
-    faiss::int_maxheap_array_t res = {(size_t)qRows, (size_t)k, ids.data(), distances.data()};
-    faiss::hammings_knn_hc(&res, qCodes, wCodes, (size_t)wRows, (size_t)bytesPerVector, 0);
+    // one immutable index per process for identical codes, held by the graph
+    auto index = Index::get(encodedWeights);
 
-    // Copy int64_t indices to Marian index type and sort by increasing index value per hypothesis.
-    // The sorting is required as we later do a binary search on those values for reverse look-up.
+    const uint8_t* qCodes = encodedQuery->val()->data<uint8_t>();
     uint32_t* outData = out->val()->data<uint32_t>();
-    for (size_t hypoIdx = 0; hypoIdx < numHypos; ++hypoIdx) {
-      size_t startIdx = k * hypoIdx;
-      size_t endIdx = startIdx + k;
-      for(size_t i = startIdx; i < endIdx; ++i)
-        outData[i] = (uint32_t)ids[i];
-      std::sort(outData + startIdx, outData + endIdx);
-    }
+
+    // we use firstNRows with Factored Segmenter to skip the factor embeddings at the end
+    #pragma omp parallel for
+    for(int hypoIdx = 0; hypoIdx < qRows; ++hypoIdx)
+      index->search(qCodes + (size_t)hypoIdx * bytesPerVector, k, probes, firstNRows, outData + (size_t)hypoIdx * k);
   };
 
   Shape kShape({currBeamSize, batchSize, k});
   return lambda({encodedQuery, encodedWeights}, kShape, Type::uint32, search);
 }
 
-Expr search(Expr query, Expr weights, int k, int nBits, int firstNRows) {
+Expr search(Expr query, Expr weights, int k, int nBits, int firstNRows, int probes) {
   int dim = weights->shape()[-1];
   
   Expr rotMat = nullptr;
@@ -177,7 +360,7 @@ Expr search(Expr query, Expr weights, int k, int nBits, int firstNRows) {
     encodedWeights = encode(weights, rotMat);
   }
   
-  return searchEncoded(encode(query, rotMat), encodedWeights, k, firstNRows);
+  return searchEncoded(encode(query, rotMat), encodedWeights, k, firstNRows, probes);
 }
 
 class RandomRotation : public inits::NodeInitializer {
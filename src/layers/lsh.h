@@ -27,12 +27,63 @@ namespace lsh {
   // compute the rotation matrix (maps weights->shape()[-1] to nbits floats)
   Expr rotator(Expr weights, int nbits);
 
+  /**
+   * Immutable search index over the encoded rows of the output weights. Codes are stored padded to whole
+   * 64-bit words and Hamming distances are computed with (AVX-512/AVX2 if available) popcounts. Additionally
+   * rows are grouped into buckets by the leading bits of their codes, which allows multi-probe search: only the
+   * buckets closest to the query bucket are scanned instead of the whole vocabulary.
+   *
+   * Indices are shared by all graphs of a process via Index::get(), so with N CPU threads there is still
+   * only one copy of the index in memory. Each graph holds the indices it uses, an index is released once
+   * no graph uses it anymore.
+   */
+  class Index {
+  private:
+    int rows_;
+    int bytesPerVector_;
+    int wordsPerVector_;
+    std::vector<uint64_t> codes_;          // [rows_ x wordsPerVector_]
+
+    int bucketBits_;                       // number of leading code bits used as bucket key
+    std::vector<uint32_t> bucketOffsets_;  // [2^bucketBits_ + 1] start of each bucket in bucketRows_
+    std::vector<uint32_t> bucketRows_;     // row ids ordered by bucket
+    std::vector<uint32_t> probeMasks_;     // bucket key masks in order of increasing Hamming distance
+
+    uint32_t bucketKey(const uint64_t* code) const;
+
+  public:
+    Index(const uint8_t* codes, int rows, int bytesPerVector);
+
+    int rows() const { return rows_; }
+    int bytesPerVector() const { return bytesPerVector_; }
+    int bucketBits() const { return bucketBits_; }
+
+    // Writes the k rows closest to the query code into ids, sorted by row index. Only the first firstNRows
+    // rows are considered if firstNRows > 0. With probes > 0 only that many buckets closest to the
+    // query are scanned (more if they hold fewer than k rows), otherwise all rows are scanned.
+    void search(const uint8_t* query, int k, int probes, int firstNRows, uint32_t* ids) const;
+
+    // Returns the shared index for the given code matrix, building it if no index for identical codes exists
+    static Ptr<const Index> get(const uint8_t* codes, int rows, int bytesPerVector);
+
+    // Same for the codes computed by a node, held by the graph of the node. Codes are only hashed the first
+    // time a node is seen by its graph, so the node must be a parameter or memoized.
+    static Ptr<const Index> get(Expr codes);
+  };
+
+  // Indices used by one graph together with their code nodes, held by the CPU backend of the graph so that
+  // they are released with it. Holding the nodes keeps their addresses from being reused by other nodes.
+  struct GraphIndices {
+    std::vector<std::pair<Expr, Ptr<const Index>>> indices;
+  };
+
   // perform the LSH search on fully encoded input and weights, return k results (indices) per input row
+  // probes > 0 enables multi-probe bucket search, see Index::search()
   // @TODO: add a top-k like operator that also returns the bitwise computed distances
-  Expr searchEncoded(Expr encodedQuery, Expr encodedWeights, int k, int firstNRows = 0);
+  Expr searchEncoded(Expr encodedQuery, Expr encodedWeights, int k, int firstNRows = 0, int probes = 0);
 
   // same as above, but performs encoding on the fly
-  Expr search(Expr query, Expr weights, int k, int nbits, int firstNRows = 0);
+  Expr search(Expr query, Expr weights, int k, int nbits, int firstNRows = 0, int probes = 0);
   
   // These are helper functions for encoding the LSH into the binary Marian model, used by marian-conv
   void addDummyParameters(Ptr<ExpressionGraph> graph, std::string weightsName, int nBits);
@@ -116,6 +116,8 @@ Logits Output::applyAsLogits(Expr input) /*override final*/ {
           factorB = slice(b_, -1, Slice((int)range.first, (int)range.second));
       }
       /*const*/ int lemmaDimEmb = options_->get<int>("lemma-dim-emb", 0);
+      ABORT_IF((lemmaDimEmb == -2 || lemmaDimEmb == -3) && g == 0 && isIntgemm(factorWt->value_type()),
+               "Lemma conditioning with gate is not implemented for --shortlist-gemm-type {}", factorWt->value_type());
       if((lemmaDimEmb == -2 || lemmaDimEmb == -3)
          && g > 0) {  // -2/-3 means a gated transformer-like structure (-3 = hard-max)
         LOG_ONCE(info, "[embedding] using lemma conditioning with gate");
@@ -180,7 +182,11 @@ Logits Output::applyAsLogits(Expr input) /*override final*/ {
       // @TODO: b_ should be a vector, not a matrix; but shotlists use cols() in, which requires a
       // matrix
       Expr factorLogits;
-      if(g == 0 && shortlist_) {
+      if(g == 0 && shortlist_ && isIntgemm(factorWt->value_type())) {
+        // already [D x U] in intgemm format, see --shortlist-gemm-type
+        factorLogits = affineOrDot(input1, factorWt, factorB, false, /*transB=*/false);
+      }
+      else if(g == 0 && shortlist_) {
         Expr tmp = transpose(input1, {0, 2, 1, 3});
         factorLogits = affineShortlist(
             tmp,
@@ -299,11 +305,14 @@ Logits Output::applyAsLogits(Expr input) /*override final*/ {
     }
     return Logits(std::move(allLogits), factoredVocab_);
   } else if(shortlist_) {
+    auto shortWt = shortlist_->getCachedShortWt();
+    // an intgemm shortlist is already [D x U], see --shortlist-gemm-type
+    bool transB = !isIntgemm(shortWt->value_type()) && !isLegacyUntransposedW;
     return Logits(affineOrDot(input,
-                              shortlist_->getCachedShortWt(),
+                              shortWt,
                               shortlist_->getCachedShortb(),
                               false,
-                              /*transB=*/isLegacyUntransposedW ? false : true));
+                              transB));
   } else {
     return Logits(
         affineOrDot(input, Wt_, b_, false, /*transB=*/isLegacyUntransposedW ? false : true));
@@ -0,0 +1,88 @@
+#include "decode_queue.h"
+
+#include "common/logging.h"
+
+#include <iterator>
+
+namespace marian {
+namespace quicksand {
+
+DecodeQueue::DecodeQueue(size_t miniBatch, size_t miniBatchWords)
+    : miniBatch_(miniBatch), miniBatchWords_(miniBatchWords) {
+  ABORT_IF(miniBatch_ == 0, "The decode engine needs a positive mini-batch size");
+}
+
+void DecodeQueue::push(const WordIndices& sentence, QSCallback callback) {
+  ABORT_IF(sentence.empty(), "Cannot decode an empty sentence, it should at least contain EOS");
+  size_t arrival = arrivals_++;
+  requests_[arrival] = Request{sentence, callback};
+  byLength_.insert(std::make_pair(sentence.size(), arrival));
+}
+
+std::future<QSNBest> DecodeQueue::push(const WordIndices& sentence) {
+  auto promise = std::make_shared<std::promise<QSNBest>>();
+  auto future = promise->get_future();
+  push(sentence, [promise](QSNBest nbest, std::exception_ptr error) {
+    if(error)
+      promise->set_exception(error);
+    else
+      promise->set_value(std::move(nbest));
+  });
+  return future;
+}
+
+std::vector<DecodeQueue::Request> DecodeQueue::nextBatch() {
+  size_t anchorLength = requests_.begin()->second.sentence.size();
+  auto lo = byLength_.find(std::make_pair(anchorLength, requests_.begin()->first));
+  auto hi = std::next(lo);
+  size_t maxLength = anchorLength;
+  std::vector<size_t> chosen(1, lo->second);
+  while(chosen.size() < miniBatch_) {
+    bool left = lo != byLength_.begin();
+    bool right = hi != byLength_.end();
+    if(!left && !right)
+      break;
+    if(left && (!right || anchorLength - std::prev(lo)->first <= hi->first - anchorLength)) {
+      if(miniBatchWords_ > 0 && maxLength * (chosen.size() + 1) > miniBatchWords_)
+        break;
+      chosen.push_back((--lo)->second);
+    } else {
+      if(miniBatchWords_ > 0 && hi->first * (chosen.size() + 1) > miniBatchWords_)
+        break;
+      maxLength = hi->first;
+      chosen.push_back((hi++)->second);
+    }
+  }
+  byLength_.erase(lo, hi);
+
+  std::vector<Request> batch;
+  for(auto arrival : chosen) {
+    auto it = requests_.find(arrival);
+    batch.push_back(std::move(it->second));
+    requests_.erase(it);
+  }
+  return batch;
+}
+
+void DecodeQueue::decode(std::vector<Request>& batch,
+                         const std::function<QSNBestBatch(const QSBatch&, size_t)>& decode) {
+  QSBatch qsBatch;
+  size_t maxLength = 0;
+  for(auto& request : batch) {
+    maxLength = std::max(maxLength, request.sentence.size());
+    qsBatch.push_back(std::move(request.sentence));
+  }
+
+  QSNBestBatch nbests;
+  std::exception_ptr error;
+  try {
+    nbests = decode(qsBatch, maxLength);
+  } catch(...) {
+    error = std::current_exception();
+  }
+  for(size_t i = 0; i < batch.size(); ++i)
+    batch[i].callback(error ? QSNBest() : std::move(nbests[i]), error);
+}
+
+}  // namespace quicksand
+}  // namespace marian
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "quicksand.h"
+
+#include <map>
+
+namespace marian {
+namespace quicksand {
+
+// Pending sentences of the decode engine, see IDecodeEngine, and the choice of the next batch. Not
+// thread-safe, the engine holds its lock while it uses the queue.
+class DecodeQueue {
+public:
+  struct Request {
+    WordIndices sentence;
+    QSCallback callback;
+  };
+
+  // miniBatch: most sentences per batch, miniBatchWords: if not 0, most source words per batch including padding
+  DecodeQueue(size_t miniBatch, size_t miniBatchWords);
+
+  bool empty() const { return requests_.empty(); }
+  size_t size() const { return requests_.size(); }
+
+  void push(const WordIndices& sentence, QSCallback callback);
+  std::future<QSNBest> push(const WordIndices& sentence);
+
+  // Removes the sentence waiting longest and the pending sentences closest in length from the queue.
+  // A sentence longer than mini-batch-words forms a batch of its own.
+  std::vector<Request> nextBatch();
+
+  // Decodes a batch with decode(sentences, maxLength) and passes each n-best list to the callback of
+  // its sentence. If decoding throws, all callbacks of the batch receive the exception.
+  static void decode(std::vector<Request>& batch,
+                     const std::function<QSNBestBatch(const QSBatch&, size_t)>& decode);
+
+private:
+  size_t miniBatch_;
+  size_t miniBatchWords_;
+
+  std::map<size_t, Request> requests_;           // pending sentences by arrival
+  std::set<std::pair<size_t, size_t>> byLength_; // (length, arrival) of the pending sentences
+  size_t arrivals_{0};
+};
+
+}  // namespace quicksand
+}  // namespace marian
@@ -1,4 +1,5 @@
 #include "quicksand.h"
+#include "decode_queue.h"
 #include "marian.h"
 
 #if MKL_FOUND
@@ -17,6 +18,13 @@
 #include "fbgemm/Utils.h"
 #endif
 
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+
 namespace marian {
 
 namespace quicksand {
@@ -54,16 +62,18 @@ public:
 class BeamSearchDecoder : public IBeamSearchDecoder {
 private:
   Ptr<ExpressionGraph> graph_;
-  Ptr<cpu::WrappedDevice> device_;
+  Ptr<cpu::WrappedDevice> device_; // null if the graph has a workspace of its own
 
   std::vector<Ptr<Scorer>> scorers_;
 
   std::vector<Ptr<Vocab>> vocabs_;
 
 public:
+  // workspaceMB: if not 0, the graph allocates its own workspace instead of the one set with setWorkspace()
   BeamSearchDecoder(Ptr<Options> options,
                     const std::vector<const void*>& ptrs,
-                    const std::vector<Ptr<IVocabWrapper>>& vocabs)
+                    const std::vector<Ptr<IVocabWrapper>>& vocabs,
+                    size_t workspaceMB = 0)
       : IBeamSearchDecoder(options, ptrs) {
 
     // copy the vocabs
@@ -74,8 +84,13 @@ public:
     graph_ = New<ExpressionGraph>(/*inference=*/true);
 
     DeviceId deviceId{0, DeviceType::cpu};
-    device_ = New<cpu::WrappedDevice>(deviceId);
-    graph_->setDevice(deviceId, device_);
+    if(workspaceMB > 0) {
+      graph_->setDevice(deviceId);
+      graph_->reserveWorkspaceMB(workspaceMB);
+    } else {
+      device_ = New<cpu::WrappedDevice>(deviceId);
+      graph_->setDevice(deviceId, device_);
+    }
 
 #if MKL_FOUND
     mkl_set_num_threads(options->get<int>("mkl-threads", 1));
@@ -116,7 +131,10 @@ public:
     }
   }
 
-  void setWorkspace(uint8_t* data, size_t size) override { device_->set(data, size); }
+  void setWorkspace(uint8_t* data, size_t size) override {
+    ABORT_IF(!device_, "This decoder has a workspace of its own");
+    device_->set(data, size);
+  }
 
   QSNBestBatch decode(const QSBatch& qsBatch,
                       size_t maxLength,
@@ -199,6 +217,103 @@ Ptr<IBeamSearchDecoder> newDecoder(Ptr<Options> options,
   return New<BeamSearchDecoder>(options, ptrs, vocabs/*, eos*/);
 }
 
+class DecodeEngine : public IDecodeEngine {
+private:
+  std::vector<std::vector<char>> models_; // binary models read for the workers, see constructor
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable pending_;
+  DecodeQueue queue_;
+  bool stop_{false};
+
+  void work(Ptr<BeamSearchDecoder> decoder) {
+    const std::unordered_set<WordIndex> noShortlist; // see IDecodeEngine
+    for(;;) {
+      std::vector<DecodeQueue::Request> batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if(queue_.empty()) // stopped and drained
+          return;
+        batch = queue_.nextBatch();
+      }
+      DecodeQueue::decode(batch, [&](const QSBatch& qsBatch, size_t maxLength) {
+        return decoder->decode(qsBatch, maxLength, noShortlist);
+      });
+    }
+  }
+
+public:
+  DecodeEngine(Ptr<Options> options,
+               std::vector<const void*> ptrs,
+               const std::vector<Ptr<IVocabWrapper>>& vocabs,
+               size_t workers)
+      : queue_(options->get<size_t>("mini-batch", 32), options->get<size_t>("mini-batch-words", 0)) {
+    ABORT_IF(workers == 0, "The decode engine needs at least one worker");
+
+    // the parameters of mapped models are shared by the graphs of all workers
+    auto models = options->get<std::vector<std::string>>("model");
+    ptrs.resize(models.size(), nullptr);
+    for(size_t i = 0; i < models.size(); ++i) {
+      if(ptrs[i] != nullptr || !io::isBin(models[i]))
+        continue;
+      std::ifstream file(models[i], std::ios::binary | std::ios::ate);
+      ABORT_IF(!file, "Cannot open model file {}", models[i]);
+      size_t size = (size_t)file.tellg();
+      models_.emplace_back(size + 256); // items are aligned to 256 bytes relative to the start of the model
+      char* data = models_.back().data();
+      data += (256 - (uintptr_t)data % 256) % 256;
+      file.seekg(0);
+      ABORT_IF(!file.read(data, size), "Cannot read model file {}", models[i]);
+      ptrs[i] = data;
+    }
+
+    size_t workspaceMB = options->get<size_t>("workspace", 512);
+    std::vector<Ptr<BeamSearchDecoder>> decoders;
+    for(size_t i = 0; i < workers; ++i)
+      decoders.push_back(New<BeamSearchDecoder>(options, ptrs, vocabs, workspaceMB));
+    for(auto decoder : decoders)
+      workers_.emplace_back([this, decoder] { work(decoder); });
+  }
+
+  ~DecodeEngine() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    pending_.notify_all();
+    for(auto& worker : workers_)
+      worker.join();
+  }
+
+  void submit(const WordIndices& sentence, QSCallback callback) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push(sentence, callback);
+    }
+    pending_.notify_one();
+  }
+
+  std::future<QSNBest> submit(const WordIndices& sentence) override {
+    std::future<QSNBest> future;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      future = queue_.push(sentence);
+    }
+    pending_.notify_one();
+    return future;
+  }
+};
+
+Ptr<IDecodeEngine> newDecodeEngine(Ptr<Options> options,
+                                   const std::vector<const void*>& ptrs,
+                                   const std::vector<Ptr<IVocabWrapper>>& vocabs,
+                                   size_t workers) {
+  marian::setThrowExceptionOnAbort(true); // same as newDecoder(), errors of a batch go to its callbacks
+  return New<DecodeEngine>(options, ptrs, vocabs, workers);
+}
+
 std::vector<Ptr<IVocabWrapper>> loadVocabs(const std::vector<std::string>& vocabPaths) {
   std::vector<Ptr<IVocabWrapper>> res(vocabPaths.size());
   for (size_t i = 0; i < vocabPaths.size(); i++) {
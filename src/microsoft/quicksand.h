@@ -1,4 +1,7 @@
 #pragma once
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -69,6 +72,36 @@ Ptr<IBeamSearchDecoder> newDecoder(Ptr<Options> options,
                                    const std::vector<Ptr<IVocabWrapper>>& vocabs,
                                    WordIndex eos/*dummy --@TODO: remove*/);
 
+// Receives the n-best list of a sentence, or the exception that aborted its batch and an empty list
+typedef std::function<void(QSNBest, std::exception_ptr)> QSCallback;
+
+// Decodes sentences submitted one at a time from any thread on a pool of worker threads, each with
+// a graph and workspace of its own. Pending sentences are decoded in batches of similar length: a
+// free worker takes the sentence waiting longest and the pending sentences closest to it in length.
+// Sentences are decoded without a shortlist, as the sentences of a batch would have to share one; use
+// newDecoder() to decode with a shortlist.
+class IDecodeEngine {
+public:
+  virtual ~IDecodeEngine() {} // decodes the pending sentences before it returns
+
+  // sentence: word indices as in a QSBatch entry; the future holds the n-best list
+  virtual std::future<QSNBest> submit(const WordIndices& sentence) = 0;
+
+  // callback is called from a worker thread once the sentence is decoded and must not throw
+  virtual void submit(const WordIndices& sentence, QSCallback callback) = 0;
+};
+
+// Options as for newDecoder(), and additionally:
+//   mini-batch: most sentences per batch (default 32)
+//   mini-batch-words: if not 0, most source words per batch including padding (default 0)
+//   workspace: workspace of each worker in MB (default 512)
+// Binary models that the caller has not mapped (nullptr in ptrs) are read once and mapped for all
+// workers, .npz models are loaded by each worker.
+Ptr<IDecodeEngine> newDecodeEngine(Ptr<Options> options,
+                                   const std::vector<const void*>& ptrs,
+                                   const std::vector<Ptr<IVocabWrapper>>& vocabs,
+                                   size_t workers);
+
 // load src and tgt vocabs
 std::vector<Ptr<IVocabWrapper>> loadVocabs(const std::vector<std::string>& vocabPaths);
 
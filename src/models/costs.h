@@ -368,6 +368,20 @@ public:
     return cost_->apply(nextState);
   }
 
+  virtual Ptr<DecoderState> stepMany(Ptr<ExpressionGraph> graph,
+                                     Ptr<DecoderState> state,
+                                     const std::vector<IndexType>& hypIndices,
+                                     const Words& words,
+                                     int beamSize) override {
+    return cost_->apply(encdec_->stepMany(graph, state, hypIndices, words, beamSize));
+  }
+
+  virtual Ptr<DecoderState> restoreState(Ptr<ExpressionGraph> graph,
+                                         Ptr<data::CorpusBatch> batch,
+                                         const DecoderStateSnapshot& snapshot) override {
+    return encdec_->restoreState(graph, batch, snapshot);
+  }
+
   virtual Logits build(Ptr<ExpressionGraph> /*graph*/,
                        Ptr<data::CorpusBatch> /*batch*/,
                        bool /*clearGraph*/ = true) override {
@@ -72,6 +72,20 @@ public:
     state->setTargetHistoryEmbeddings(selectedEmbs);
   }
 
+  // Embeds several consecutive target words of a single sentence, so that the next step
+  // advances the decoder by all of them at once
+  // words: [beamSize, positions] flattened, all hypotheses of a single sentence
+  virtual void embeddingsFromSequence(Ptr<ExpressionGraph> graph,
+                                      Ptr<DecoderState> state,
+                                      const Words& words,
+                                      int beamSize) {
+    graph_ = graph;
+    int dimEmb = opt<int>("dim-emb");
+    int positions = (int)words.size() / beamSize;
+    auto embeddings = getEmbeddingLayer()->apply(words, {beamSize, positions, 1, dimEmb});
+    state->setTargetHistoryEmbeddings(embeddings);
+  }
+
   virtual const std::vector<Expr> getAlignments(int /*i*/ = 0) { return {}; }; // [tgt index][beam depth, max src length, batch size, 1]
 
   virtual Ptr<data::Shortlist> getShortlist() { return shortlist_; }
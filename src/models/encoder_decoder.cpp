@@ -177,18 +177,45 @@ void EncoderDecoder::clear(Ptr<ExpressionGraph> graph) {
 Ptr<DecoderState> EncoderDecoder::startState(Ptr<ExpressionGraph> graph,
                                              Ptr<data::CorpusBatch> batch) {
   std::vector<Ptr<EncoderState>> encoderStates;
-  for(auto& encoder : encoders_)
-    encoderStates.push_back(encoder->build(graph, batch));
 
-  // initialize shortlist here
-  if(shortlistGenerator_) {
-    auto shortlist = shortlistGenerator_->generate(batch);
-    decoders_[0]->setShortlist(shortlist);
+  // With --n-best-shared-encoder every distinct source of the batch is encoded once and its
+  // context is broadcast to all hypotheses that share it along the batch dimension (-2)
+  std::vector<IndexType> sourceIndices;
+  auto sources = opt<bool>("n-best-shared-encoder", false) ? batch->uniqueSources(sourceIndices) : nullptr;
+  if(sources && sources->size() < batch->size()) {
+    for(auto& encoder : encoders_) {
+      auto state = encoder->build(graph, sources);
+      encoderStates.push_back(New<EncoderState>(index_select(state->getContext(), -2, sourceIndices),
+                                                index_select(state->getMask(), -2, sourceIndices),
+                                                batch));
+    }
+  } else {
+    for(auto& encoder : encoders_)
+      encoderStates.push_back(encoder->build(graph, batch));
   }
 
+  initShortlist(batch);
   return decoders_[0]->startState(graph, batch, encoderStates);
 }
 
+Ptr<DecoderState> EncoderDecoder::restoreState(Ptr<ExpressionGraph> graph,
+                                               Ptr<data::CorpusBatch> batch,
+                                               const DecoderStateSnapshot& snapshot) {
+  initShortlist(batch);
+  return snapshot.restore(graph, batch);
+}
+
+void EncoderDecoder::initShortlist(Ptr<data::CorpusBatch> batch) {
+  if(!shortlistGenerator_)
+    return;
+  auto shortlist = shortlistGenerator_->generate(batch);
+  // the previous shortlist's gathered output matrices stay memoized only if the new shortlist is identical
+  auto previous = decoders_[0]->getShortlist();
+  if(previous && previous->getIndicesHash() != shortlist->getIndicesHash())
+    previous->forget();
+  decoders_[0]->setShortlist(shortlist);
+}
+
 Ptr<DecoderState> EncoderDecoder::step(Ptr<ExpressionGraph> graph,
                                        Ptr<DecoderState> state,
                                        const std::vector<IndexType>& hypIndices,   // [beamIndex * activeBatchSize + batchIndex]
@@ -205,6 +232,21 @@ Ptr<DecoderState> EncoderDecoder::step(Ptr<ExpressionGraph> graph,
   return nextState;
 }
 
+Ptr<DecoderState> EncoderDecoder::stepMany(Ptr<ExpressionGraph> graph,
+                                           Ptr<DecoderState> state,
+                                           const std::vector<IndexType>& hypIndices, // [beamIndex]
+                                           const Words& words,                       // [beamIndex, position] flattened
+                                           int beamSize) {
+  // AAN and RNN layers keep a running summary of the history that cannot be extended by several words
+  ABORT_IF(opt<std::string>("type").find("transformer") == std::string::npos
+           || opt<std::string>("transformer-decoder-autoreg", "self-attention") != "self-attention",
+           "Multi-word decoder steps require a transformer model with a self-attention decoder");
+
+  state = hypIndices.empty() ? state : state->select(hypIndices, /*batchIndices=*/{0}, beamSize);
+  decoders_[0]->embeddingsFromSequence(graph, state, words, beamSize);
+  return decoders_[0]->step(graph, state);
+}
+
 Ptr<DecoderState> EncoderDecoder::stepAll(Ptr<ExpressionGraph> graph,
                                           Ptr<data::CorpusBatch> batch,
                                           bool clearGraph) {
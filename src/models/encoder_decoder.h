@@ -48,6 +48,23 @@ public:
                                  int beamSize)
       = 0;
 
+  // Advances the decoder state of a single sentence by several words per hypothesis in one step. Used
+  // to verify several draft words at once in speculative decoding, the log probs cover every position,
+  // [beamSize, positions, 1, dimVocab]. hypIndices reorders the state first as in step().
+  virtual Ptr<DecoderState> stepMany(Ptr<ExpressionGraph> graph,
+                                     Ptr<DecoderState> state,
+                                     const std::vector<IndexType>& hypIndices, // [beamIndex]
+                                     const Words& words,                       // [beamIndex, position] flattened
+                                     int beamSize)
+      = 0;
+
+  // Start state of the given batch from a snapshot of an earlier state of the same source sentences
+  // instead of running the encoder again, also initializes the shortlist
+  virtual Ptr<DecoderState> restoreState(Ptr<ExpressionGraph> graph,
+                                         Ptr<data::CorpusBatch> batch,
+                                         const DecoderStateSnapshot& snapshot)
+      = 0;
+
   virtual Ptr<Options> getOptions() = 0;
 
   virtual void setShortlistGenerator(
@@ -76,6 +93,9 @@ protected:
 
   virtual void createDecoderConfig(const std::string& name);
 
+  // generates the shortlist of the batch for the decoder
+  void initShortlist(Ptr<data::CorpusBatch> batch);
+
 public:
   typedef data::Corpus dataset_type;
 
@@ -152,6 +172,16 @@ public:
                                  const std::vector<IndexType>& batchIndices,
                                  int beamSize) override;
 
+  virtual Ptr<DecoderState> stepMany(Ptr<ExpressionGraph> graph,
+                                     Ptr<DecoderState> state,
+                                     const std::vector<IndexType>& hypIndices,
+                                     const Words& words,
+                                     int beamSize) override;
+
+  virtual Ptr<DecoderState> restoreState(Ptr<ExpressionGraph> graph,
+                                         Ptr<data::CorpusBatch> batch,
+                                         const DecoderStateSnapshot& snapshot) override;
+
   virtual Ptr<DecoderState> stepAll(Ptr<ExpressionGraph> graph,
                                     Ptr<data::CorpusBatch> batch,
                                     bool clearGraph = true);
@@ -12,5 +12,9 @@ struct ModelTask {
 struct ModelServiceTask {
   virtual ~ModelServiceTask() {}
   virtual std::string run(const std::string&) = 0;
+
+  // Translates a single source line whose translation has to start with the given target prefix,
+  // keeping the decoder states after the prefix in the session with the given ID
+  virtual std::string run(const std::string& input, const std::string& prefix, const std::string& sessionId) = 0;
 };
 }  // namespace marian
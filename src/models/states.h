@@ -37,6 +37,23 @@ public:
   }
 };
 
+class DecoderState;
+
+// Values of a decoder state copied to host memory, so that decoding can continue from them after
+// the graph has been cleared, see DecoderState::snapshot() and restore(). Log probs are not kept,
+// the restored state has to be stepped before they are used.
+struct DecoderStateSnapshot {
+  std::vector<io::Item> contexts;     // context of each encoder
+  std::vector<io::Item> masks;        // source mask of each encoder
+  std::vector<io::Item> outputs;      // output of each decoder layer
+  std::vector<io::Item> cells;        // cell of each decoder layer, empty name if there is none
+  size_t position{0};
+  Ptr<const DecoderState> prototype;  // state of the same kind without any expressions
+
+  // state with the saved values as constants of the given graph
+  Ptr<DecoderState> restore(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch) const;
+};
+
 class DecoderState {
 protected:
   rnn::States states_;  // states of individual decoder layers
@@ -107,6 +124,42 @@ public:
 
   Ptr<data::CorpusBatch> getBatch() const { return batch_; }
 
+  // Keep only the first `length` target positions of the decoder history, e.g. to drop rejected
+  // draft words in speculative decoding. Only supported by transformer self-attention decoders.
+  virtual Ptr<DecoderState> truncate(size_t /*length*/) const {
+    ABORT("Truncating the target history is not supported by this decoder");
+  }
+
+  // State of the same kind with the given layer and encoder states, see DecoderStateSnapshot
+  virtual Ptr<DecoderState> recreate(const rnn::States& states,
+                                     const std::vector<Ptr<EncoderState>>& encStates,
+                                     Ptr<data::CorpusBatch> batch) const {
+    return New<DecoderState>(states, Logits(), encStates, batch);
+  }
+
+  // Copies the values of the encoder and layer states to the host, requires a forward pass first
+  Ptr<DecoderStateSnapshot> snapshot() const {
+    auto saved = New<DecoderStateSnapshot>();
+    auto save = [](Expr e, const std::string& name, std::vector<io::Item>& items) {
+      items.emplace_back();
+      if(e) {
+        e->val()->get(items.back(), name);
+        items.back().bytes.resize(items.back().size()); // drop the padding of the allocation
+      }
+    };
+    for(auto& es : encStates_) {
+      save(es->getContext(), "context", saved->contexts);
+      save(es->getMask(), "mask", saved->masks);
+    }
+    for(const auto& state : states_) {
+      save(state.output, "output", saved->outputs);
+      save(state.cell, "cell", saved->cells);
+    }
+    saved->position = position_;
+    saved->prototype = recreate(rnn::States(), {}, nullptr);
+    return saved;
+  }
+
   // Set current target token position in state when decoding
   size_t getPosition() const { return position_; }
 
@@ -116,6 +169,22 @@ public:
   virtual void blacklist(Expr /*totalCosts*/, Ptr<data::CorpusBatch> /*batch*/) {}
 };
 
+inline Ptr<DecoderState> DecoderStateSnapshot::restore(Ptr<ExpressionGraph> graph,
+                                                      Ptr<data::CorpusBatch> batch) const {
+  auto load = [&](const io::Item& item) -> Expr {
+    return item.name.empty() ? nullptr : graph->constant(item.shape, inits::fromItem(item), item.type);
+  };
+  std::vector<Ptr<EncoderState>> encStates;
+  for(size_t i = 0; i < contexts.size(); ++i)
+    encStates.push_back(New<EncoderState>(load(contexts[i]), load(masks[i]), batch));
+  rnn::States states;
+  for(size_t i = 0; i < outputs.size(); ++i)
+    states.push_back({load(outputs[i]), load(cells[i])});
+  auto state = prototype->recreate(states, encStates, batch);
+  state->setPosition(position);
+  return state;
+}
+
 /**
  * Classifier output based on DecoderState
  * @TODO: should be unified with DecoderState or not be used at all as Classifier do not really have
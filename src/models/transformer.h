@@ -122,13 +122,15 @@ public:
     return addPositionalEmbeddings(input, start, trainPosEmbeddings);
   }
 
-  Expr triangleMask(int length) const {
+  // causal mask for length queries that follow offset already seen positions: [1, length, offset + length]
+  Expr triangleMask(int length, int offset = 0) const {
     // fill triangle mask
-    std::vector<float> vMask(length * length, 0);
+    int keys = offset + length;
+    std::vector<float> vMask(length * keys, 0);
     for(int i = 0; i < length; ++i)
-      for(int j = 0; j <= i; ++j)
-        vMask[i * length + j] = 1.f;
-    return graph_->constant({1, length, length}, inits::fromVector(vMask));
+      for(int j = 0; j <= offset + i; ++j)
+        vMask[i * keys + j] = 1.f;
+    return graph_->constant({1, length, keys}, inits::fromVector(vMask));
   }
 
   // convert multiplicative 1/0 mask to additive 0/-inf log mask, and transpose to match result of bdot() op in Attention()
@@ -185,6 +187,16 @@ public:
   }
 
   Expr postProcess(std::string prefix, std::string ops, Expr input, Expr prevInput, float dropProb = 0.0f) const {
+    // the common "dan", "dar", "an" and "ar" sequences are executed as a single fused op
+    std::string fused = ops.size() > 0 && ops[0] == 'd' ? ops.substr(1) : ops;
+    if((fused == "an" || fused == "ar") && input->shape() == prevInput->shape()) {
+      Expr mask = (ops[0] == 'd' && dropProb > 0.f) ? graph_->dropoutMask(dropProb, input->shape()) : nullptr;
+      if(fused == "an")
+        return addLayerNorm(input, prevInput, mask, prefix);
+      else
+        return addRmsNorm(input, prevInput, mask, prefix);
+    }
+
     auto output = input;
     for(auto op : ops) {
       // dropout
@@ -634,6 +646,22 @@ public:
     selectedState->setPosition(getPosition());
     return selectedState;
   }
+
+  virtual Ptr<DecoderState> recreate(const rnn::States& states,
+                                     const std::vector<Ptr<EncoderState>>& encStates,
+                                     Ptr<data::CorpusBatch> batch) const override {
+    return New<TransformerState>(states, Logits(), encStates, batch);
+  }
+
+  // The layer states hold the inputs of all previous positions for self-attention, batch-major
+  virtual Ptr<DecoderState> truncate(size_t length) const override {
+    rnn::States truncatedStates;
+    for(const auto& state : states_)
+      truncatedStates.push_back({slice(state.output, /*axis=*/-2, Slice(0, (int)length)), state.cell});
+    auto truncatedState = New<TransformerState>(truncatedStates, logProbs_, encStates_, batch_);
+    truncatedState->setPosition(length);
+    return truncatedState;
+  }
 };
 
 class DecoderTransformer : public Transformer<DecoderBase> {
@@ -736,7 +764,8 @@ public:
 
     int dimTrgWords = query->shape()[-2];
     int dimBatch    = query->shape()[-3];
-    auto selfMask = triangleMask(dimTrgWords);  // [ (1,) 1, max length, max length]
+    // several words at once after decoding has started (speculative decoding) also see all previous positions
+    auto selfMask = triangleMask(dimTrgWords, dimTrgWords > 1 ? startPos : 0);  // [ (1,) 1, max length, max length]
     if(decoderMask) {
       decoderMask = atleast_nd(decoderMask, 4);             // [ 1, max length, batch size, 1 ]
       decoderMask = reshape(transposeTimeBatch(decoderMask),// [ 1, batch size, max length, 1 ]
@@ -890,7 +919,7 @@ public:
       nextState = New<TransformerState>(
         decoderStates, logits, state->getEncoderStates(), state->getBatch());
     }
-    nextState->setPosition(state->getPosition() + 1);
+    nextState->setPosition(state->getPosition() + dimTrgWords);
     return nextState;
   }
 
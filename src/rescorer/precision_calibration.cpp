@@ -0,0 +1,184 @@
+#include "rescorer/precision_calibration.h"
+
+#include "common/config_parser.h"
+#include "common/io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace marian {
+
+PrecisionCalibration::PrecisionCalibration(const std::string& model,
+                                           const std::vector<std::string>& sets,
+                                           const std::vector<std::string>& vocabs,
+                                           const std::vector<std::string>& candidates,
+                                           float budget)
+    : budget_(budget) {
+  ABORT_IF(sets.size() != 2, "Calibration requires a source and a target file, not {} files", sets.size());
+  ABORT_IF(vocabs.size() != 2, "Calibration requires the source and target vocabularies, see --vocabs");
+  for(const auto& candidate : candidates) {
+    Type type = typeFromString(candidate);
+    ABORT_IF(!isIntgemm(type) && type != Type::packed16,
+             "Unsupported calibration candidate {}, expected a variant of intgemm8 or intgemm16, or packed16", type);
+    candidates_.push_back(type);
+  }
+
+  // same options as for marian-scorer with this model on one CPU thread
+  options_ = New<Options>(ConfigParser(cli::mode::scoring).getConfig());
+  try {
+    YAML::Node modelYaml;
+    io::getYamlFromModel(modelYaml, "special:model.yml", model);
+    options_->merge(modelYaml, /*overwrite=*/true);
+  } catch(std::runtime_error&) {
+    LOG(warn, "No model settings found in model file");
+  }
+  options_->set("model", model, "train-sets", sets, "vocabs", vocabs, "cpu-threads", 1, "maxi-batch", 1,
+                "inference", true, "shuffle", "none", "cost-type", "ce-sum");
+
+  graph_ = New<ExpressionGraphPackable>();
+  graph_->setDevice(CPU0);
+  graph_->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+
+  scorer_ = New<Rescorer>(options_);
+  scorer_->load(graph_, model);
+  graph_->forward();
+  for(auto& p : graph_->params()->getMap()) {
+    io::Item item;
+    p.second->val()->get(item, p.first);
+    items_.emplace_back(std::move(item));
+  }
+
+  auto corpus = New<data::Corpus>(options_);
+  auto batchGenerator = New<BatchGenerator<CorpusBase>>(corpus, options_);
+  batchGenerator->prepare();
+  for(auto batch : *batchGenerator)
+    batches_.push_back(batch);
+  ABORT_IF(batches_.empty(), "Calibration set {} {} is empty", sets[0], sets[1]);
+}
+
+float PrecisionCalibration::cost(Ptr<ExpressionGraph> graph) {
+  double loss = 0, words = 0;
+  for(auto batch : batches_) {
+    auto rationalLoss = scorer_->build(graph, batch);
+    graph->forward();
+    loss  += rationalLoss->loss<float>();
+    words += rationalLoss->count<float>();
+  }
+  return (float)(loss / words);
+}
+
+float PrecisionCalibration::cost(const std::map<std::string, Type>& plan) {
+  // each planned matrix is packed by a graph of its own, exactly as marian-conv packs it
+  std::vector<io::Item> items = items_;
+  for(auto& item : items) {
+    auto planned = plan.find(item.name);
+    if(planned == plan.end() || planned->second == Type::float32)
+      continue;
+    auto packer = New<ExpressionGraphPackable>();
+    packer->setDevice(CPU0);
+    std::vector<io::Item> matrix = {item};
+    packer->load(matrix);
+    packer->forward();
+    packer->setPrecisionPlan({{item.name, planned->second}});
+    item = packer->pack()[0];
+  }
+
+  // a fresh graph, as parameters cannot change their type
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice(CPU0);
+  graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+  graph->load(items);
+  return cost(graph);
+}
+
+std::map<std::string, Type> PrecisionCalibration::plan() {
+  float base = cost(graph_);
+  LOG(info, "[calibration] Cost per word on {} batches: {:.5f}", batches_.size(), base);
+
+  // cost increase of each matrix and candidate, with all other matrices in float32
+  std::map<std::string, std::vector<float>> increases;
+  for(const auto& item : items_) {
+    const std::string& name = item.name;
+    bool packable = false;
+    for(auto type : candidates_)
+      packable |= ExpressionGraphPackable::isPackable(name, type);
+    if(!packable)
+      continue;
+
+    auto& increase = increases[name];
+    for(auto type : candidates_) {
+      if(!ExpressionGraphPackable::isPackable(name, type)) {
+        increase.push_back(std::numeric_limits<float>::infinity());
+        continue;
+      }
+      increase.push_back(cost({{name, type}}) - base);
+      LOG(info, "[calibration] {} as {}: cost increase {:.5f}", name, type, increase.back());
+    }
+  }
+
+  auto plan = select(increases, candidates_, budget_, [&](const std::map<std::string, Type>& p) {
+    return cost(p) - base;
+  });
+
+  std::map<Type, size_t> counts;
+  for(const auto& entry : plan)
+    counts[entry.second]++;
+  for(const auto& count : counts)
+    LOG(info, "[calibration] {} matrices as {}", count.second, count.first);
+
+  return plan;
+}
+
+std::map<std::string, Type> PrecisionCalibration::select(
+    const std::map<std::string, std::vector<float>>& increases,
+    const std::vector<Type>& candidates,
+    float budget,
+    const std::function<float(const std::map<std::string, Type>&)>& measure) {
+  std::map<std::string, Type> plan;
+  for(const auto& entry : increases)
+    plan[entry.first] = Type::float32;
+
+  // the fastest candidate goes first to the least sensitive matrices, the budget left is given to the next candidate
+  float spent = 0.f;
+  for(size_t c = 0; c < candidates.size(); ++c) {
+    std::vector<std::pair<float, std::string>> order;
+    for(const auto& entry : increases)
+      if(plan[entry.first] == Type::float32 && std::isfinite(entry.second[c]))
+        order.emplace_back(std::max(0.f, entry.second[c]), entry.first);
+    std::sort(order.begin(), order.end());
+    for(const auto& candidate : order) {
+      if(spent + candidate.first > budget)
+        break;
+      spent += candidate.first;
+      plan[candidate.second] = candidates[c];
+    }
+  }
+
+  // the increases of several packed matrices do not add up exactly, so the plan is measured with all of them
+  // packed and the most expensive matrices are reverted to float32 until it meets the budget
+  float measured = measure(plan);
+  LOG(info, "[calibration] Estimated cost increase {:.5f}, measured {:.5f}, budget {:.5f}", spent, measured, budget);
+  while(measured > budget) {
+    std::string worst;
+    float worstIncrease = -std::numeric_limits<float>::infinity();
+    for(const auto& entry : plan) {
+      if(entry.second == Type::float32)
+        continue;
+      size_t c = std::find(candidates.begin(), candidates.end(), entry.second) - candidates.begin();
+      if(increases.at(entry.first)[c] > worstIncrease) {
+        worstIncrease = increases.at(entry.first)[c];
+        worst = entry.first;
+      }
+    }
+    if(worst.empty())
+      break;
+    plan[worst] = Type::float32;
+    measured = measure(plan);
+    LOG(info, "[calibration] {} reverted to float32, measured cost increase {:.5f}", worst, measured);
+  }
+
+  return plan;
+}
+
+}  // namespace marian
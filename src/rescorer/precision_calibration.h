@@ -0,0 +1,61 @@
+#pragma once
+
+#include "marian.h"
+
+#include "rescorer/rescorer.h"
+#include "tensors/cpu/expression_graph_packable.h"
+
+#include <functional>
+#include <map>
+
+namespace marian {
+
+/**
+ * Chooses the GEMM type of each weight matrix for marian-conv from the quality on a calibration set.
+ *
+ * The calibration set is scored like with marian-scorer. Each packable matrix is then stored in each
+ * candidate type in turn, exactly as marian-conv stores it, and the increase of the cost per target word
+ * is measured with the GEMM kernels of that type, so activations are quantized as in the decoder. Assuming
+ * the increases add up, candidates are assigned greedily, fastest type first and matrices with the smallest
+ * increase first, as long as the total increase stays within the budget. All other matrices remain
+ * float32. The cost of the final plan is measured again with all planned matrices packed.
+ */
+class PrecisionCalibration {
+private:
+  Ptr<Options> options_;
+  Ptr<ExpressionGraphPackable> graph_;
+  Ptr<Rescorer> scorer_;
+  std::vector<io::Item> items_; // parameters of the model in float32
+  std::vector<Ptr<data::CorpusBatch>> batches_;
+
+  std::vector<Type> candidates_; // fastest first
+  float budget_;
+
+  // average cost per target word on the calibration set with the parameters of the graph
+  float cost(Ptr<ExpressionGraph> graph);
+
+  // same with the matrices in the plan stored in their GEMM types, all other parameters in float32
+  float cost(const std::map<std::string, Type>& plan);
+
+public:
+  // model: model file, sets: source and target of the calibration set, vocabs: vocabularies of both sides,
+  // candidates: GEMM types to choose from, fastest first, budget: largest allowed increase of the cost per word
+  PrecisionCalibration(const std::string& model,
+                       const std::vector<std::string>& sets,
+                       const std::vector<std::string>& vocabs,
+                       const std::vector<std::string>& candidates,
+                       float budget);
+
+  // GEMM type of each packable matrix, float32 for matrices that are too sensitive
+  std::map<std::string, Type> plan();
+
+  // Assigns the candidates greedily from the cost increase of each matrix and candidate (infinite if the
+  // matrix cannot be stored in it), then reverts the matrices with the largest increase to float32 as long
+  // as the increase measured for the whole plan exceeds the budget.
+  static std::map<std::string, Type> select(const std::map<std::string, std::vector<float>>& increases,
+                                            const std::vector<Type>& candidates,
+                                            float budget,
+                                            const std::function<float(const std::map<std::string, Type>&)>& measure);
+};
+
+}  // namespace marian
@@ -59,6 +59,13 @@ public:
     options_->set("shuffle", "none");
     options_->set("cost-type", "ce-rescore"); // indicates that to keep separate per-batch-item scoresForSummary
 
+    if(options_->get<bool>("n-best") && options_->get<bool>("n-best-shared-encoder", false)) {
+      // hypotheses of the same source are consecutive in an n-best list, so reading in file order
+      // puts them into the same mini-batch where they share one encoder pass
+      LOG(info, "Encoding each n-best source once, setting --maxi-batch-sort none");
+      options_->set("maxi-batch-sort", "none");
+    }
+
     if(options_->get<bool>("n-best"))
       corpus_ = New<CorpusNBest>(options_);
     else
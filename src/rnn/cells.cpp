@@ -68,6 +68,163 @@ Expr gruOps(const std::vector<Expr>& nodes, bool final) {
 
 /******************************************************************************/
 
+namespace {
+
+// [rows x cols] view of the rows starting at the given row of a contiguous tensor, nullptr for nullptr
+Tensor rowsView(Tensor t, int row, int rows, int cols) {
+  if(!t)
+    return nullptr;
+  size_t bytes = sizeOf(t->type());
+  auto mem = MemoryPiece::New(t->memory()->data() + bytes * row * cols, bytes * rows * cols);
+  return TensorBase::New(mem, Shape({rows, cols}), t->type(), t->getBackend());
+}
+
+Tensor gradOrNull(Expr node) { return node->trainable() ? node->grad() : nullptr; }
+
+}  // namespace
+
+/**
+ * Base for the recurrence of a cell over all time steps (axis -3) in a single node. The input
+ * projections of all steps are computed beforehand in one GEMM (see Cell::applyInput), the node then
+ * issues the recurrent product state * U and the fused cell kernel step by step. The backward pass
+ * recomputes the recurrent products instead of keeping them for all steps.
+ */
+struct RNNSequenceNodeOp : public NaryNodeOp {
+  bool reverse_;
+  int dimTime_, dimBatch_, dimState_;
+
+  RNNSequenceNodeOp(const std::vector<Expr>& nodes, Shape shape, bool reverse)
+      : NaryNodeOp(nodes, shape), reverse_(reverse),
+        dimTime_(shape[-3]), dimBatch_(shape[-2]), dimState_(shape[-1]) {}
+
+  // time step processed in the s-th iteration
+  int step(int s) const { return reverse_ ? dimTime_ - s - 1 : s; }
+
+  // step t of a tensor with all steps, [dimBatch x cols]
+  Tensor at(Tensor t, int step, int cols) const { return rowsView(t, step * dimBatch_, dimBatch_, cols); }
+
+  // temporary [dimBatch x cols] tensor from the graph allocator
+  Tensor temporary(int cols) {
+    Shape shape({dimBatch_, cols});
+    auto mem = graph()->allocator()->alloc(requiredBytes(shape, value_type()));
+    return TensorBase::New(mem, shape, value_type(), val_->getBackend());
+  }
+
+  void release(Tensor t) { graph()->allocator()->free(t->memory()); }
+
+  // do not check if node is trainable
+  virtual void runBackward(const NodeOps& ops) override {
+    for(auto&& op : ops)
+      op();
+  }
+
+  const std::string color() override { return "yellow"; }
+
+  virtual size_t hash() override {
+    size_t seed = NaryNodeOp::hash();
+    util::hash_combine(seed, reverse_);
+    return seed;
+  }
+
+  virtual bool equal(Expr node) override {
+    if(!NaryNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<RNNSequenceNodeOp>(node);
+    return cnode && reverse_ == cnode->reverse_;
+  }
+};
+
+// children: initial state, xW of all steps, U, b[, mask of all steps], see gruOps for a single step
+struct GRUSequenceNodeOp : public RNNSequenceNodeOp {
+  bool final_;
+
+  GRUSequenceNodeOp(const std::vector<Expr>& nodes, bool final, bool reverse)
+      : RNNSequenceNodeOp(nodes, newShape(nodes), reverse), final_(final) {}
+
+  static Shape newShape(const std::vector<Expr>& nodes) {
+    Shape shape = nodes[1]->shape();
+    shape.set(-1, nodes[2]->shape()[-1] / 3);
+    return shape;
+  }
+
+  NodeOps forwardOps() override { return {NodeOp(recurrenceForward())}; }
+
+  NodeOps backwardOps() override { return {NodeOp(recurrenceBackward())}; }
+
+  void recurrenceForward() {
+    int D = dimState_;
+    Tensor U = child(2)->val(), b = child(3)->val();
+    Tensor mask = children_.size() > 4 ? child(4)->val() : nullptr;
+
+    Tensor sU = temporary(3 * D);
+    for(int s = 0; s < dimTime_; ++s) {
+      int t = step(s);
+      Tensor prev = s == 0 ? at(child(0)->val(), 0, D) : at(val_, step(s - 1), D);
+      Prod(sU, prev, U, false, false, 0.f, 1.f);
+
+      std::vector<Tensor> inputs = {prev, at(child(1)->val(), t, 3 * D), sU, b};
+      if(mask)
+        inputs.push_back(at(mask, t, 1));
+      GRUFastForward(at(val_, t, D), inputs, final_);
+    }
+    release(sU);
+  }
+
+  void recurrenceBackward() {
+    int D = dimState_;
+    Tensor U = child(2)->val(), b = child(3)->val();
+    Tensor mask = children_.size() > 4 ? child(4)->val() : nullptr;
+    Tensor dState0 = gradOrNull(child(0)), dxW = gradOrNull(child(1));
+    Tensor dU = gradOrNull(child(2)), db = gradOrNull(child(3));
+
+    Tensor sU = temporary(3 * D), dsU = temporary(3 * D);
+    for(int s = dimTime_ - 1; s >= 0; --s) {
+      int t = step(s);
+      Tensor prev  = s == 0 ? at(child(0)->val(), 0, D) : at(val_, step(s - 1), D);
+      // the adjoint of the previous step collects the gradient of this step, as in the unrolled graph
+      Tensor dPrev = s == 0 ? at(dState0, 0, D) : at(adj_, step(s - 1), D);
+      Prod(sU, prev, U, false, false, 0.f, 1.f);
+      dsU->set(0.f);
+
+      std::vector<Tensor> inputs = {prev, at(child(1)->val(), t, 3 * D), sU, b};
+      std::vector<Tensor> outputs = {dPrev, at(dxW, t, 3 * D), dsU, db};
+      if(mask) {
+        inputs.push_back(at(mask, t, 1));
+        outputs.push_back(nullptr);
+      }
+      GRUFastBackward(graph()->allocator(), outputs, inputs, at(adj_, t, D), final_);
+
+      if(dPrev)
+        Prod(dPrev, dsU, U, false, true, 1.f, 1.f);
+      if(dU)
+        Prod(dU, prev, dsU, true, false, 1.f, 1.f);
+    }
+    release(sU);
+    release(dsU);
+  }
+
+  const std::string type() override { return "GRU-sequence-ops"; }
+
+  virtual size_t hash() override {
+    size_t seed = RNNSequenceNodeOp::hash();
+    util::hash_combine(seed, final_);
+    return seed;
+  }
+
+  virtual bool equal(Expr node) override {
+    if(!RNNSequenceNodeOp::equal(node))
+      return false;
+    auto cnode = std::dynamic_pointer_cast<GRUSequenceNodeOp>(node);
+    return cnode && final_ == cnode->final_;
+  }
+};
+
+Expr gruSequenceOps(const std::vector<Expr>& nodes, bool final, bool reverse) {
+  return Expression<GRUSequenceNodeOp>(nodes, final, reverse);
+}
+
+/******************************************************************************/
+
 struct LSTMCellNodeOp : public NaryNodeOp {
   LSTMCellNodeOp(const std::vector<Expr>& nodes) : NaryNodeOp(nodes) {}
 
@@ -147,5 +304,145 @@ Expr lstmOpsC(const std::vector<Expr>& nodes) {
 Expr lstmOpsO(const std::vector<Expr>& nodes) {
   return Expression<LSTMOutputNodeOp>(nodes);
 }
+
+/******************************************************************************/
+
+// children: initial output, initial cell, xW of all steps, U, b[, mask of all steps], see lstmOpsC and lstmOpsO
+// for a single step. The value holds the outputs of all steps followed by the cells of all steps, [2, steps...].
+struct LSTMSequenceNodeOp : public RNNSequenceNodeOp {
+  LSTMSequenceNodeOp(const std::vector<Expr>& nodes, bool reverse)
+      : RNNSequenceNodeOp(nodes, newShape(nodes), reverse) {}
+
+  static Shape newShape(const std::vector<Expr>& nodes) {
+    Shape steps = nodes[2]->shape();
+    steps.set(-1, nodes[3]->shape()[-1] / 4);
+    Shape shape;
+    shape.resize(steps.size() + 1);
+    shape.set(0, 2);
+    for(int i = 0; i < (int)steps.size(); ++i)
+      shape.set(i + 1, steps[i]);
+    return shape;
+  }
+
+  // output and cell of step t
+  Tensor outputAt(Tensor t, int step) const { return at(t, step, dimState_); }
+  Tensor cellAt(Tensor t, int step) const { return t ? at(t, dimTime_ + step, dimState_) : nullptr; }
+
+  NodeOps forwardOps() override { return {NodeOp(recurrenceForward())}; }
+
+  NodeOps backwardOps() override { return {NodeOp(recurrenceBackward())}; }
+
+  void recurrenceForward() {
+    int D = dimState_;
+    Tensor U = child(3)->val(), b = child(4)->val();
+    Tensor mask = children_.size() > 5 ? child(5)->val() : nullptr;
+
+    Tensor sU = temporary(4 * D);
+    for(int s = 0; s < dimTime_; ++s) {
+      int t = step(s);
+      Tensor prevOutput = s == 0 ? at(child(0)->val(), 0, D) : outputAt(val_, step(s - 1));
+      Tensor prevCell   = s == 0 ? at(child(1)->val(), 0, D) : cellAt(val_, step(s - 1));
+      Tensor xW = at(child(2)->val(), t, 4 * D);
+      Prod(sU, prevOutput, U, false, false, 0.f, 1.f);
+
+      std::vector<Tensor> inputs = {prevCell, xW, sU, b};
+      if(mask)
+        inputs.push_back(at(mask, t, 1));
+      LSTMCellForward(cellAt(val_, t), inputs);
+      LSTMOutputForward(outputAt(val_, t), {cellAt(val_, t), xW, sU, b});
+    }
+    release(sU);
+  }
+
+  void recurrenceBackward() {
+    int D = dimState_;
+    Tensor U = child(3)->val(), b = child(4)->val();
+    Tensor mask = children_.size() > 5 ? child(5)->val() : nullptr;
+    Tensor dOutput0 = gradOrNull(child(0)), dCell0 = gradOrNull(child(1)), dxW = gradOrNull(child(2));
+    Tensor dU = gradOrNull(child(3)), db = gradOrNull(child(4));
+
+    Tensor sU = temporary(4 * D), dsU = temporary(4 * D);
+    for(int s = dimTime_ - 1; s >= 0; --s) {
+      int t = step(s);
+      Tensor prevOutput  = s == 0 ? at(child(0)->val(), 0, D) : outputAt(val_, step(s - 1));
+      Tensor prevCell    = s == 0 ? at(child(1)->val(), 0, D) : cellAt(val_, step(s - 1));
+      Tensor dPrevOutput = s == 0 ? at(dOutput0, 0, D) : outputAt(adj_, step(s - 1));
+      Tensor dPrevCell   = s == 0 ? at(dCell0, 0, D) : cellAt(adj_, step(s - 1));
+      Tensor xW = at(child(2)->val(), t, 4 * D);
+      Prod(sU, prevOutput, U, false, false, 0.f, 1.f);
+      dsU->set(0.f);
+
+      // the output adds to the adjoint of the cell of this step, which then flows into the previous cell
+      LSTMOutputBackward({cellAt(adj_, t), at(dxW, t, 4 * D), dsU, db},
+                         {cellAt(val_, t), xW, sU, b},
+                         outputAt(adj_, t));
+
+      std::vector<Tensor> inputs = {prevCell, xW, sU, b};
+      std::vector<Tensor> outputs = {dPrevCell, at(dxW, t, 4 * D), dsU, db};
+      if(mask) {
+        inputs.push_back(at(mask, t, 1));
+        outputs.push_back(nullptr);
+      }
+      LSTMCellBackward(outputs, inputs, cellAt(adj_, t));
+
+      if(dPrevOutput)
+        Prod(dPrevOutput, dsU, U, false, true, 1.f, 1.f);
+      if(dU)
+        Prod(dU, prevOutput, dsU, true, false, 1.f, 1.f);
+    }
+    release(sU);
+    release(dsU);
+  }
+
+  const std::string type() override { return "LSTM-sequence-ops"; }
+};
+
+Expr lstmSequenceOps(const std::vector<Expr>& nodes, bool reverse) {
+  return Expression<LSTMSequenceNodeOp>(nodes, reverse);
+}
+
+Expr stackedPart(Expr both, int part) {
+  Shape shape;
+  shape.resize(both->shape().size() - 1);
+  for(int i = 0; i < (int)shape.size(); ++i)
+    shape.set(i, both->shape()[i + 1]);
+  return reshape(slice(both, 0, part), shape);
+}
+
+/******************************************************************************/
+
+// children: previous cell state, x, f, bf[, mask], see SSRU. The value holds the output followed by the cell state.
+struct SSRUStepNodeOp : public NaryNodeOp {
+  SSRUStepNodeOp(const std::vector<Expr>& nodes) : NaryNodeOp(nodes, newShape(nodes)) {}
+
+  static Shape newShape(const std::vector<Expr>& nodes) {
+    Shape shape;
+    shape.resize(nodes[1]->shape().size() + 1);
+    shape.set(0, 2);
+    for(int i = 1; i < (int)shape.size(); ++i)
+      shape.set(i, nodes[1]->shape()[i - 1]);
+    return shape;
+  }
+
+  NodeOps forwardOps() override {
+    std::vector<Tensor> inputs;
+    for(size_t i = 0; i < children_.size(); ++i)
+      inputs.push_back(child(i)->val());
+
+    return {NodeOp(cpu::SSRUStepForward(val_, inputs))};
+  }
+
+  NodeOps backwardOps() override {
+    ABORT("The fused SSRU step is only used for inference");
+  }
+
+  const std::string type() override { return "SSRU-step-ops"; }
+
+  const std::string color() override { return "yellow"; }
+};
+
+Expr ssruStepOps(const std::vector<Expr>& nodes) {
+  return Expression<SSRUStepNodeOp>(nodes);
+}
 }  // namespace rnn
 }  // namespace marian
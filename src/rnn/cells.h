@@ -196,6 +196,17 @@ public:
 /******************************************************************************/
 
 Expr gruOps(const std::vector<Expr>& nodes, bool final = false);
+// all time steps of gruOps in one node, nodes: initial state, xW of all steps, U, b[, mask of all steps]
+Expr gruSequenceOps(const std::vector<Expr>& nodes, bool final, bool reverse);
+
+// Whether the recurrence can run as one node, i.e. the previous state enters the step only through
+// state * U and the step covers full time slices of xW. The initial state has one row per batch entry.
+static inline bool sequenceSupported(Expr xW, Expr state) {
+  int dimTime = xW->shape()[-3], dimBatch = xW->shape()[-2];
+  return xW->shape().elements() == dimTime * dimBatch * xW->shape()[-1]
+         && state && state->shape().elements() % dimBatch == 0
+         && state->shape().elements() / dimBatch == state->shape()[-1];
+}
 
 class GRU : public Cell {
 protected:
@@ -214,6 +225,9 @@ protected:
 
   Expr fakeInput_;
 
+  Expr sequence_;     // outputs of all steps of the last applySequence()
+  Expr sequenceCell_;
+
 public:
   GRU(Ptr<ExpressionGraph> graph, Ptr<Options> options) : Cell(options) {
     int dimInput = opt<int>("dimInput");
@@ -314,6 +328,22 @@ public:
 
     return {output, state.cell};  // no cell state, hence copy
   }
+
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse) override {
+    if(layerNorm_ || dropMaskS_ || xWs.empty() || !sequenceSupported(xWs.front(), state.output))
+      return nullptr;
+    sequence_ = mask ? gruSequenceOps({state.output, xWs.front(), U_, b_, mask}, final_, reverse)
+                     : gruSequenceOps({state.output, xWs.front(), U_, b_}, final_, reverse);
+    sequenceCell_ = state.cell;
+    return sequence_;
+  }
+
+  virtual State sequenceState(int step) override {
+    return {slice(sequence_, -3, step), sequenceCell_};  // no cell state, hence copy
+  }
 };
 
 /**
@@ -356,6 +386,10 @@ protected:
   // Fake input with zeros replaces W and Wx in transition cells
   Expr fakeInput_;
 
+  // Outputs of all steps of the last applySequence()
+  Expr sequence_;
+  Expr sequenceCell_;
+
 public:
   GRUNematus(Ptr<ExpressionGraph> graph, Ptr<Options> options) : Cell(options) {
     int dimInput = opt<int>("dimInput");
@@ -534,12 +568,36 @@ public:
 
     return {output, state.cell};  // no cell state, hence copy
   }
+
+  // without layer normalization the cell is the same as GRU, see there
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse) override {
+    if(layerNorm_ || dropMaskS_ || transition_ || xWs.empty()
+       || !sequenceSupported(xWs.front(), state.output))
+      return nullptr;
+    sequence_ = mask ? gruSequenceOps({state.output, xWs.front(), UUx_, bbx_, mask}, final_, reverse)
+                     : gruSequenceOps({state.output, xWs.front(), UUx_, bbx_}, final_, reverse);
+    sequenceCell_ = state.cell;
+    return sequence_;
+  }
+
+  virtual State sequenceState(int step) override {
+    return {slice(sequence_, -3, step), sequenceCell_};  // no cell state, hence copy
+  }
 };
 
 /******************************************************************************/
 
 Expr lstmOpsC(const std::vector<Expr>& nodes);
 Expr lstmOpsO(const std::vector<Expr>& nodes);
+// all time steps of lstmOpsC and lstmOpsO in one node, nodes: initial output, initial cell, xW of all steps,
+// U, b[, mask of all steps]. The node holds the outputs of all steps followed by their cells, [2, steps...].
+Expr lstmSequenceOps(const std::vector<Expr>& nodes, bool reverse);
+// part 0 or 1 of a node that holds two tensors of the same shape along a leading axis of size 2,
+// e.g. the outputs and cells of lstmSequenceOps
+Expr stackedPart(Expr both, int part);
 
 class FastLSTM : public Cell {
 protected:
@@ -557,6 +615,9 @@ protected:
 
   Expr fakeInput_;
 
+  Expr sequence_;        // outputs and cells of all steps of the last applySequence(), see lstmSequenceOps
+  Expr sequenceOutputs_;
+
 public:
   FastLSTM(Ptr<ExpressionGraph> graph, Ptr<Options> options) : Cell(options) {
     int dimInput = opt<int>("dimInput");
@@ -646,6 +707,23 @@ public:
 
     return {nextRecState, nextCellState};
   }
+
+  virtual Expr applySequence(std::vector<Expr> xWs,
+                             State state,
+                             Expr mask,
+                             bool reverse) override {
+    if(layerNorm_ || dropMaskS_ || xWs.empty() || !sequenceSupported(xWs.front(), state.output)
+       || !state.cell || state.cell->shape().elements() != state.output->shape().elements())
+      return nullptr;
+    sequence_ = mask ? lstmSequenceOps({state.output, state.cell, xWs.front(), U_, b_, mask}, reverse)
+                     : lstmSequenceOps({state.output, state.cell, xWs.front(), U_, b_}, reverse);
+    sequenceOutputs_ = stackedPart(sequence_, 0);
+    return sequenceOutputs_;
+  }
+
+  virtual State sequenceState(int step) override {
+    return {slice(sequenceOutputs_, -3, step), slice(stackedPart(sequence_, 1), -3, step)};
+  }
 };
 
 using LSTM = FastLSTM;
@@ -713,6 +791,9 @@ public:
 
     return CellType::applyState(xWs, State({mstate, state.cell}), mask);
   }
+
+  // the multiplicative state depends on the input of each step
+  virtual Expr applySequence(std::vector<Expr>, State, Expr, bool) override { return nullptr; }
 };
 
 using MLSTM = Multiplicative<LSTM>;
@@ -979,6 +1060,11 @@ public:
   }
 };
 
+// CPU inference step of SSRU in one pass: forget gate bias, sigmoid, state update and ReLU output.
+// nodes: previous cell state, x, f, bf[, mask], all with one row per hypothesis. Returns the output
+// followed by the cell state, see stackedPart.
+Expr ssruStepOps(const std::vector<Expr>& nodes);
+
 class SSRU : public Cell {
 private:
   Expr W_;
@@ -990,6 +1076,8 @@ private:
   float layerNorm_;
   Expr gamma_, gammaf_;
 
+  bool fused_; // use ssruStepOps, the bias of the forget gate is then added by the kernel
+
 public:
   SSRU(Ptr<ExpressionGraph> graph, Ptr<Options> options) : Cell(options) {
     int dimInput = options_->get<int>("dimInput");
@@ -1019,6 +1107,9 @@ public:
         gamma_ = graph->param(prefix + "_gamma", {1, dimState}, inits::ones());
       gammaf_ = graph->param(prefix + "_gammaf", {1, dimState}, inits::ones());
     }
+
+    fused_ = graph->isInference() && graph->getDeviceId().type == DeviceType::cpu
+             && graph->getDefaultElementType() == Type::float32 && !layerNorm_;
   }
 
   State apply(std::vector<Expr> inputs, State state, Expr mask = nullptr) {
@@ -1040,6 +1131,9 @@ public:
     if(layerNorm_) {
       x = layerNorm(dot(inputDropped, W_), gamma_);
       f = layerNorm(dot(inputDropped, Wf_), gammaf_, bf_);
+    } else if(fused_) {
+      x = dot(inputDropped, W_);
+      f = dot(inputDropped, Wf_);
     } else {
       x = dot(inputDropped, W_);
       f = affine(inputDropped, Wf_, bf_);
@@ -1055,6 +1149,16 @@ public:
     auto x = xWs[0];
     auto f = xWs[1];
 
+    if(fused_) {
+      // the kernel does not broadcast, e.g. a start state shared by all hypotheses
+      int rows = x->shape().elements() / x->shape()[-1];
+      if(cellState->shape() == x->shape() && (!mask || mask->shape().elements() == rows)) {
+        auto both = mask ? ssruStepOps({cellState, x, f, bf_, mask}) : ssruStepOps({cellState, x, f, bf_});
+        return {stackedPart(both, 0), stackedPart(both, 1)};
+      }
+      f = f + bf_;
+    }
+
     auto nextCellState = highway(cellState, x, f);  // rename to "gate"?
     auto nextState = relu(nextCellState);
 
@@ -52,6 +52,7 @@ private:
   Ptr<Cell> cell_;
   dir direction_;
   States last_;
+  int lastSequenceStep_{-1}; // last step if the cell ran as one node, last_ is then created on demand
 
   States apply(const Expr input,
                const States initialState,
@@ -66,6 +67,14 @@ private:
 
     auto timeSteps = input->shape()[-3];
 
+    // all time steps in one node if the cell supports it, see lastCellStates()
+    lastSequenceStep_ = -1;
+    auto sequence = cell_->applySequence(xWs, state, mask, direction_ == dir::backward);
+    if(sequence) {
+      lastSequenceStep_ = direction_ == dir::backward ? 0 : timeSteps - 1;
+      return States({State({sequence, nullptr})});
+    }
+
     States outputs;
     for(int i = 0; i < timeSteps; ++i) {
       int j = i;
@@ -128,7 +137,11 @@ public:
     return apply(input, States({state}), mask).outputs();
   }
 
-  States lastCellStates() override { return last_; }
+  States lastCellStates() override {
+    if(last_.size() == 0 && lastSequenceStep_ >= 0)
+      last_.push_back(cell_->sequenceState(lastSequenceStep_));
+    return last_;
+  }
 
   void push_back(Ptr<Cell> cell) override { cell_ = cell; }
 
@@ -167,6 +167,19 @@ public:
   virtual std::vector<Expr> applyInput(std::vector<Expr> inputs) = 0;
   virtual State applyState(std::vector<Expr>, State, Expr = nullptr) = 0;
 
+  // Applies the cell to all time steps (axis -3) of the mapped inputs in a single node, in reverse order
+  // if requested. Returns the outputs of all steps, or nullptr if there is no sequence-level kernel for
+  // this cell and configuration.
+  virtual Expr applySequence(std::vector<Expr> /*xWs*/, State /*state*/, Expr /*mask*/, bool /*reverse*/) {
+    return nullptr;
+  }
+
+  // State after the given time step of the last applySequence(). Created on demand, since nodes that are
+  // never used would become additional top nodes of the graph.
+  virtual State sequenceState(int /*step*/) {
+    ABORT("Cell has no sequence-level kernel");
+  }
+
   virtual void clear() override {}
 };
 
@@ -256,6 +269,17 @@ public:
       s->clear();
   }
 
+  // a stack of a single cell runs as that cell
+  virtual Expr applySequence(std::vector<Expr> xWs, State state, Expr mask, bool reverse) override {
+    if(stackables_.size() != 1 || !stackables_[0]->is<Cell>())
+      return nullptr;
+    return stackables_[0]->as<Cell>()->applySequence(xWs, state, mask, reverse);
+  }
+
+  virtual State sequenceState(int step) override {
+    return stackables_[0]->as<Cell>()->sequenceState(step);
+  }
+
   virtual std::vector<Expr> getLazyInputs(Ptr<rnn::RNN> parent) override {
     ABORT_IF(!stackables_[0]->is<Cell>(),
              "First stackable should be of type Cell");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/definitions.h"
+#include "common/types.h"
 #include "tensors/rand.h"
 
 namespace marian {
@@ -38,6 +39,23 @@ public:
   // for GPU, there's no gemm type. so, it does nothing.
   virtual void setGemmType(std::string gemmType) = 0;
   virtual GemmType getGemmType() = 0;
+  // for CPU, file in which the decisions of --gemm-type auto are kept across runs, empty for none.
+  // for GPU, there's no gemm type. so, it does nothing.
+  virtual void setGemmTuningFile(const std::string& file) = 0;
+  virtual std::string getGemmTuningFile() = 0;
+  // for CPU, selects the GEMM type for activation-by-activation batched products (bdot), e.g. in attention.
+  // for GPU, there's no gemm type. so, it does nothing.
+  virtual void setBatchedGemmType(std::string gemmType) = 0;
+  virtual Type getBatchedGemmType() = 0;
+  // for CPU, selects the GEMM type for the output layer with a lexical shortlist.
+  // for GPU, there's no gemm type. so, it does nothing.
+  virtual void setShortlistGemmType(std::string gemmType) = 0;
+  virtual Type getShortlistGemmType() = 0;
+  // for CPU, uses the block-sparse copies of weight matrices stored by marian-conv --block-sparse
+  // if their fraction of non-zero blocks is below maxDensity, 0 disables them.
+  // for GPU, there's no block-sparse kernel. so, it does nothing.
+  virtual void setBlockSparseMaxDensity(float maxDensity) = 0;
+  virtual float getBlockSparseMaxDensity() = 0;
   // for CPU, sets quantization range of weight matrices for the inference.
   // for GPU, there's no quantization. so, it does nothing.
   virtual void setQuantizeRange(float range) = 0;
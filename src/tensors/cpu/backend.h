@@ -7,13 +7,28 @@
 #include "tensors/backend.h"
 
 namespace marian {
+
+namespace lsh {
+struct GraphIndices;
+}
+
 namespace cpu {
 
+namespace blocksparse {
+struct ParamIndex;
+}
+
 class Backend : public marian::Backend {
 protected:
   bool optimized_{false};
   GemmType gemmType_{GemmType::Float32};
+  std::string gemmTuningFile_;
+  Type batchedGemmType_{Type::float32};
+  Type shortlistGemmType_{Type::float32};
   float quantizeRange_{0.f};
+  float blockSparseMaxDensity_{0.f};
+  Ptr<blocksparse::ParamIndex> blockSparseIndex_;
+  Ptr<lsh::GraphIndices> lshIndices_;
 
 public:
   Backend(DeviceId deviceId, size_t seed) : marian::Backend(deviceId, seed) {}
@@ -34,6 +49,34 @@ public:
     else ABORT("Unknown GEMM type - '{}'", gemmType);
   }
   GemmType getGemmType() override { return gemmType_; }
+  // for CPU only, sets the file that keeps the decisions of --gemm-type auto across runs.
+  void setGemmTuningFile(const std::string& file) override { gemmTuningFile_ = file; }
+  std::string getGemmTuningFile() override { return gemmTuningFile_; }
+  // for CPU only, selects the GEMM type for batched products of two activations (bdot) during inference.
+  // intgemm8 and intgemm16 quantize both operands on the fly, float32 keeps the (MKL) fp32 path.
+  void setBatchedGemmType(std::string gemmType) override {
+    if      (gemmType == "float32")   batchedGemmType_ = Type::float32;
+    else if (gemmType == "intgemm8")  batchedGemmType_ = Type::intgemm8;
+    else if (gemmType == "intgemm16") batchedGemmType_ = Type::intgemm16;
+    else ABORT("Unknown batched GEMM type - '{}'", gemmType);
+  }
+  Type getBatchedGemmType() override { return batchedGemmType_; }
+  // for CPU only, selects the GEMM type for the output layer with a lexical shortlist during inference.
+  // intgemm8 and intgemm16 quantize the output embeddings once and select the shortlisted columns from them.
+  void setShortlistGemmType(std::string gemmType) override {
+    if      (gemmType == "float32")   shortlistGemmType_ = Type::float32;
+    else if (gemmType == "intgemm8")  shortlistGemmType_ = Type::intgemm8;
+    else if (gemmType == "intgemm16") shortlistGemmType_ = Type::intgemm16;
+    else ABORT("Unknown shortlist GEMM type - '{}'", gemmType);
+  }
+  Type getShortlistGemmType() override { return shortlistGemmType_; }
+  // for CPU only, affine and dot use the block-sparse copies of weight matrices with a density below maxDensity.
+  void setBlockSparseMaxDensity(float maxDensity) override { blockSparseMaxDensity_ = maxDensity; }
+  float getBlockSparseMaxDensity() override { return blockSparseMaxDensity_; }
+  // for CPU only, block-sparse companions of the parameters of the graph, see cpu::blocksparse::find().
+  Ptr<blocksparse::ParamIndex>& getBlockSparseIndex() { return blockSparseIndex_; }
+  // for CPU only, LSH indices used by the graph, see lsh::Index::get().
+  Ptr<lsh::GraphIndices>& getLshIndices() { return lshIndices_; }
   // for CPU, sets quantization range of weight matrices for the inference.
   // for GPU, there's no quantization. so, it does nothing.
   void setQuantizeRange(float range) override { quantizeRange_ = range; }
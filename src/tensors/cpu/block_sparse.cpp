@@ -0,0 +1,274 @@
+#include "tensors/cpu/block_sparse.h"
+#include "graph/expression_operators.h"
+#include "tensors/cpu/backend.h"
+#include "tensors/tensor_operators.h"
+
+namespace marian {
+namespace cpu {
+namespace blocksparse {
+
+static inline bool isZeroBlock(const float* data, int cols, int blockRows, int blockCols) {
+  for(int r = 0; r < blockRows; ++r)
+    for(int c = 0; c < blockCols; ++c)
+      if(data[r * cols + c] != 0.f)
+        return false;
+  return true;
+}
+
+// Eight independent partial sums, so that the compiler vectorizes the loop without reassociating float additions
+static inline float dot(const float* a, const float* b, int n) {
+  float sums[8] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+  int i = 0;
+  for(; i + 8 <= n; i += 8)
+    for(int j = 0; j < 8; ++j)
+      sums[j] += a[i + j] * b[i + j];
+  float sum = 0.f;
+  for(int j = 0; j < 8; ++j)
+    sum += sums[j];
+  for(; i < n; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+float blockDensity(const float* data, int rows, int cols, int blockRows, int blockCols) {
+  int rowBlocks = rows / blockRows;
+  int colBlocks = cols / blockCols;
+  size_t nonZero = 0;
+  for(int rb = 0; rb < rowBlocks; ++rb)
+    for(int cb = 0; cb < colBlocks; ++cb)
+      if(!isZeroBlock(data + rb * blockRows * cols + cb * blockCols, cols, blockRows, blockCols))
+        nonZero++;
+  return (float)nonZero / (float)(rowBlocks * colBlocks);
+}
+
+void toBlockSparse(const float* data, int rows, int cols, int blockRows, int blockCols,
+                   std::vector<float>& values,
+                   std::vector<uint32_t>& indices,
+                   std::vector<uint32_t>& offsets) {
+  ABORT_IF(rows % blockRows != 0 || cols % blockCols != 0,
+           "Matrix of shape {}x{} cannot be divided into blocks of {}x{}", rows, cols, blockRows, blockCols);
+
+  int rowBlocks = rows / blockRows;
+  int colBlocks = cols / blockCols;
+
+  values.clear();
+  indices.clear();
+  offsets.clear();
+
+  offsets.push_back(0);
+  for(int rb = 0; rb < rowBlocks; ++rb) {
+    for(int cb = 0; cb < colBlocks; ++cb) {
+      const float* block = data + rb * blockRows * cols + cb * blockCols;
+      if(isZeroBlock(block, cols, blockRows, blockCols))
+        continue;
+      for(int r = 0; r < blockRows; ++r)
+        values.insert(values.end(), block + r * cols, block + r * cols + blockCols);
+      indices.push_back((uint32_t)cb);
+    }
+    offsets.push_back((uint32_t)indices.size());
+  }
+}
+
+template <typename T>
+static io::Item itemFromVector(const std::string& name, const Shape& shape, Type type, const std::vector<T>& v) {
+  io::Item item;
+  item.name  = name;
+  item.shape = shape;
+  item.type  = type;
+  item.bytes.resize(v.size() * sizeof(T));
+  std::copy((const char*)v.data(), (const char*)v.data() + item.bytes.size(), item.bytes.data());
+  return item;
+}
+
+bool toBlockSparseItems(const io::Item& dense, int blockRows, int blockCols, float maxDensity, std::vector<io::Item>& items) {
+  ABORT_IF(dense.type != Type::float32, "Block-sparse conversion requires float32 matrices, not {}", dense.type);
+
+  int cols = dense.shape[-1];
+  int rows = (int)dense.shape.elements() / cols;
+  if(rows % blockRows != 0 || cols % blockCols != 0)
+    return false;
+
+  const float* data = (const float*)dense.data();
+  float density = blockDensity(data, rows, cols, blockRows, blockCols);
+  if(density >= maxDensity)
+    return false;
+
+  std::vector<float> values;
+  std::vector<uint32_t> indices, offsets;
+  toBlockSparse(data, rows, cols, blockRows, blockCols, values, indices, offsets);
+
+  // keep at least one (unused) block, so that parameters never have zero elements
+  int numBlocks = (int)indices.size();
+  if(numBlocks == 0) {
+    values.resize(blockRows * blockCols, 0.f);
+    indices.push_back(0);
+    numBlocks = 1;
+  }
+
+  LOG(info, "Storing {} as block-sparse matrix with {}x{} blocks and density {:.2f}", dense.name, blockRows, blockCols, density);
+
+  items.emplace_back(itemFromVector(dense.name + valuesSuffix,  {numBlocks, blockRows * blockCols}, Type::float32, values));
+  items.emplace_back(itemFromVector(dense.name + indicesSuffix, {numBlocks}, Type::uint32, indices));
+  items.emplace_back(itemFromVector(dense.name + offsetsSuffix, {(int)offsets.size()}, Type::uint32, offsets));
+  items.emplace_back(itemFromVector(dense.name + densitySuffix, {1}, Type::float32, std::vector<float>({density})));
+  return true;
+}
+
+void Affine(marian::Tensor C,
+            const marian::Tensor& A,
+            const marian::Tensor& values,
+            const marian::Tensor& indices,
+            const marian::Tensor& offsets,
+            const marian::Tensor& bias,
+            float scale) {
+  const int N = C->shape()[-1];
+  const int M = (int)C->shape().elements() / N;
+  const int K = A->shape()[-1];
+
+  const int rowBlocks = offsets->shape().elements() - 1;
+  const int blockRows = K / rowBlocks;
+  const int blockCols = values->shape()[-1] / blockRows;
+
+  const float* a = A->data();
+  const float* v = values->data();
+  const uint32_t* idx = indices->data<uint32_t>();
+  const uint32_t* off = offsets->data<uint32_t>();
+  float* c = C->data();
+
+  std::fill(c, c + M * N, 0.f);
+
+  // Column-vector blocks (the default 16x1) add one output value per row of A, which is the dot product of
+  // the block with a contiguous piece of that row, vectorized over the rows of the block.
+  if(blockCols == 1) {
+    for(int rb = 0; rb < rowBlocks; ++rb) {
+      for(uint32_t j = off[rb]; j < off[rb + 1]; ++j) {
+        const float* block = v + (size_t)j * blockRows;
+        for(int m = 0; m < M; ++m)
+          c[(size_t)m * N + idx[j]] += dot(a + (size_t)m * K + rb * blockRows, block, blockRows);
+      }
+    }
+  }
+
+  // Otherwise every stored block is loaded once and applied to all rows of A; the innermost loop runs over
+  // contiguous output columns of a block and is left to the compiler to vectorize.
+  for(int rb = 0; rb < rowBlocks && blockCols > 1; ++rb) {
+    for(uint32_t j = off[rb]; j < off[rb + 1]; ++j) {
+      const float* block = v + (size_t)j * blockRows * blockCols;
+      const int col0 = idx[j] * blockCols;
+      for(int m = 0; m < M; ++m) {
+        const float* aRow = a + (size_t)m * K + rb * blockRows;
+        float* cRow = c + (size_t)m * N + col0;
+        for(int r = 0; r < blockRows; ++r) {
+          const float aVal = aRow[r];
+          if(aVal == 0.f)
+            continue;
+          const float* bRow = block + r * blockCols;
+          for(int cc = 0; cc < blockCols; ++cc)
+            cRow[cc] += aVal * bRow[cc];
+        }
+      }
+    }
+  }
+
+  if(scale != 1.f)
+    for(int i = 0; i < M * N; ++i)
+      c[i] *= scale;
+
+  if(bias) {
+    const float* b = bias->data();
+    for(int m = 0; m < M; ++m)
+      for(int n = 0; n < N; ++n)
+        c[m * N + n] += b[n];
+  }
+}
+
+bool find(Expr b, Expr& values, Expr& indices, Expr& offsets, Expr& density) {
+  if(b->type() != "param")
+    return false;
+
+  auto graph = b->graph();
+  auto backend = std::dynamic_pointer_cast<cpu::Backend>(graph->getBackend());
+  ABORT_IF(!backend, "Block-sparse products require a CPU backend");
+  auto& index = backend->getBlockSparseIndex();
+  if(!index)
+    index = New<ParamIndex>();
+
+  auto it = index->companions.find(b->name());
+  if(it == index->companions.end()) {
+    // graph->get() prepends the current namespace, so strip it from the full parameter name
+    std::string name = b->name();
+    auto pos = name.rfind("::");
+    if(pos != std::string::npos)
+      name = name.substr(pos + 2);
+
+    std::vector<Expr> companions;
+    if(auto bsrValues = graph->get(name + valuesSuffix)) {
+      companions = {bsrValues, graph->get(name + indicesSuffix), graph->get(name + offsetsSuffix), graph->get(name + densitySuffix)};
+      ABORT_IF(!companions[1] || !companions[2] || !companions[3],
+               "Incomplete block-sparse representation for parameter {}", b->name());
+    }
+    it = index->companions.emplace(b->name(), companions).first;
+  }
+
+  if(it->second.empty())
+    return false;
+  values  = it->second[0];
+  indices = it->second[1];
+  offsets = it->second[2];
+  density = it->second[3];
+  return true;
+}
+
+Expr affine(Expr a, Expr b, Expr values, Expr indices, Expr offsets, Expr density, Expr bias, bool transA, float scale, float maxDensity) {
+  if(transA)
+    a = transpose(a);
+
+  const Shape& bShape = b->shape();
+  int K = bShape[-2];
+  ABORT_IF(a->shape()[-1] != K,
+           "Block-sparse product requires inner dimensions to match in {} * {}", a->shape(), bShape);
+  ABORT_IF(K % (offsets->shape().elements() - 1) != 0,
+           "Block-sparse matrix with {} block-rows does not match inner dimension {}", offsets->shape().elements() - 1, K);
+
+  Shape outShape = a->shape();
+  outShape.set(-1, bShape[-1]);
+
+  auto affineNodeOp = [scale, maxDensity](Expr out, const std::vector<Expr>& children) {
+    marian::Tensor bias;
+    if(children.size() > 6)
+      bias = children[6]->val();
+
+    if(children[5]->val()->data()[0] < maxDensity) {
+      Affine(out->val(),
+             children[0]->val(),
+             children[2]->val(),
+             children[3]->val(),
+             children[4]->val(),
+             bias,
+             scale);
+      return;
+    }
+
+    // too dense for the block-sparse kernel to pay off
+    cpu::Prod(out->val(), children[0]->val(), children[1]->val(), false, false, 0.f, scale);
+    if(bias) {
+      const int N = out->shape()[-1];
+      const int M = (int)out->shape().elements() / N;
+      float* c = out->val()->data();
+      const float* bv = bias->data();
+      for(int m = 0; m < M; ++m)
+        for(int n = 0; n < N; ++n)
+          c[m * N + n] += bv[n];
+    }
+  };
+
+  std::vector<Expr> children = {a, b, values, indices, offsets, density};
+  if(bias)
+    children.push_back(bias);
+
+  return lambda(children, outShape, Type::float32, affineNodeOp); // inference-only Lambda node
+}
+
+}  // namespace blocksparse
+}  // namespace cpu
+}  // namespace marian
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "graph/expression_graph.h"
+#include "common/io_item.h"
+
+#include <unordered_map>
+
+namespace marian {
+namespace cpu {
+namespace blocksparse {
+
+/*
+ * Block-sparse (BSR) storage for pruned weight matrices B of shape [K x N] used as A x B in affine/dot.
+ * B is cut into blocks of blockRows x blockCols elements; only blocks with at least one non-zero value are stored.
+ * The representation lives next to the dense parameter "name" as three additional parameters:
+ *   name_bsr_values  : float32 [numBlocks x blockRows * blockCols], each block in row-major order
+ *   name_bsr_indices : uint32  [numBlocks], block-column index of each stored block
+ *   name_bsr_offsets : uint32  [K / blockRows + 1], start of each block-row in values/indices (CSR-style)
+ *   name_bsr_density : float32 [1], fraction of non-zero blocks of the dense matrix
+ * Block sizes are implied by the shapes. These are created by marian-conv --block-sparse. At inference time
+ * each matrix is multiplied with the block-sparse kernel if its density is below --block-sparse-max-density,
+ * see Backend::setBlockSparseMaxDensity(), and with the dense matrix otherwise.
+ */
+static const std::string valuesSuffix  = "_bsr_values";
+static const std::string indicesSuffix = "_bsr_indices";
+static const std::string offsetsSuffix = "_bsr_offsets";
+static const std::string densitySuffix = "_bsr_density";
+
+// Fraction of blocks of a row-major [rows x cols] matrix that contain at least one non-zero value.
+float blockDensity(const float* data, int rows, int cols, int blockRows, int blockCols);
+
+// Convert a row-major [rows x cols] matrix into BSR format. Requires rows % blockRows == 0 and cols % blockCols == 0.
+void toBlockSparse(const float* data, int rows, int cols, int blockRows, int blockCols,
+                   std::vector<float>& values,
+                   std::vector<uint32_t>& indices,
+                   std::vector<uint32_t>& offsets);
+
+// Create the four BSR io::Items for the dense float32 item if its block density is below maxDensity.
+// Returns false (and adds nothing) if the matrix is not divisible into blocks or too dense.
+bool toBlockSparseItems(const io::Item& dense, int blockRows, int blockCols, float maxDensity, std::vector<io::Item>& items);
+
+// C = scale * A x B (+ bias) for a row-major A [M x K] and B in BSR format. Bias may be nullptr.
+void Affine(marian::Tensor C,
+            const marian::Tensor& A,
+            const marian::Tensor& values,
+            const marian::Tensor& indices,
+            const marian::Tensor& offsets,
+            const marian::Tensor& bias,
+            float scale);
+
+// BSR parameters of the dense parameters of a graph, kept by its backend so that each parameter is looked up once.
+struct ParamIndex {
+  std::unordered_map<std::string, std::vector<Expr>> companions; // by full name: {values, indices, offsets, density} or empty
+};
+
+// Look up the BSR parameters that belong to the dense parameter b, returns false if there are none.
+bool find(Expr b, Expr& values, Expr& indices, Expr& offsets, Expr& density);
+
+// Inference-only affine/dot with B given both dense and block-sparse. The stored density is only known once the
+// parameters are initialized, so the node multiplies with the block-sparse kernel if it is below maxDensity and
+// with the dense B otherwise. Bias may be nullptr.
+Expr affine(Expr a, Expr b, Expr values, Expr indices, Expr offsets, Expr density, Expr bias, bool transA, float scale, float maxDensity);
+
+}  // namespace blocksparse
+}  // namespace cpu
+}  // namespace marian
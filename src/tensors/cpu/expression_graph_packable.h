@@ -3,6 +3,10 @@
 #include "graph/expression_graph.h"
 #include "fbgemm/packed_gemm.h"
 #include "tensors/cpu/integer_common.h"
+#include "tensors/cpu/block_sparse.h"
+
+#include <map>
+#include <sstream>
 
 namespace marian {
   namespace cpu {
@@ -20,14 +24,54 @@ namespace marian {
 // So, we make a subclass of ExpressionGraph and put those immature codes in this class.
 // We will improve this in the near future. 
 class ExpressionGraphPackable : public ExpressionGraph {
+private:
+  // block-sparse conversion of pruned weights, disabled if blockRows_ == 0
+  int blockRows_{0};
+  int blockCols_{0};
+  float maxBlockDensity_{0.f};
+
+  // per-matrix GEMM types that override the type given to pack(), see setPrecisionPlan()
+  std::map<std::string, Type> precisionPlan_;
+
 public:
   ExpressionGraphPackable()
     : ExpressionGraph( /* inference =  */ true) {} // Packable expression graph only supports inference
 
   virtual ~ExpressionGraphPackable() {}
 
+  // Store weight matrices whose fraction of non-zero blocks is below maxDensity additionally in block-sparse format.
+  // Such matrices are kept as float32 and are multiplied with the block-sparse kernel at inference time.
+  void setBlockSparse(int blockRows, int blockCols, float maxDensity) {
+    blockRows_ = blockRows;
+    blockCols_ = blockCols;
+    maxBlockDensity_ = maxDensity;
+  }
+
+  // Store the matrices named in the plan in the given GEMM type (float32 to keep them unpacked) instead
+  // of the type given to pack(). Each matrix carries its type in the model, so a mixed-precision model
+  // is decoded without further options.
+  void setPrecisionPlan(const std::map<std::string, Type>& plan) {
+    for(const auto& entry : plan)
+      ABORT_IF(entry.second != Type::float32 && !isPackable(entry.first, entry.second),
+               "Parameter {} cannot be stored as {}", entry.first, entry.second);
+    precisionPlan_ = plan;
+  }
+
+  // True if pack() can store the parameter with the given name in the given GEMM type.
+  // @TODO Hardcoded to find packable weights
+  // int8 - all the weights used for affine op and dot op
+  // fp16 - all the weights used for affine op
+  static bool isPackable(const std::string& pName, Type gemmElementType) {
+    if(gemmElementType == Type::packed8avx2 || gemmElementType == Type::packed8avx512 || isIntgemm(gemmElementType))
+      return pName.find("_W") == pName.length() - 3 || pName.find("_W") == pName.length() - 2;
+    else if(gemmElementType == Type::packed16)
+      return pName.find("_W") == pName.length() - 3;
+    else
+      return false;
+  }
+
   // Convert model weights into packed format and save to IO items.
-  std::vector<io::Item> pack(Type gemmElementType = Type::float32, Type saveElementType = Type::float32) {
+  std::vector<io::Item> pack(Type defaultGemmElementType = Type::float32, Type saveElementType = Type::float32) {
     std::vector<io::Item> ioItems;
 
     // handle packable parameters first (a float32 parameter is packable)
@@ -45,12 +89,25 @@ public:
 
       Tensor val = p.second->val();
 
+      auto planned = precisionPlan_.find(pName);
+      Type gemmElementType = planned != precisionPlan_.end() ? planned->second : defaultGemmElementType;
+
+      // save pruned weights as float32 together with their block-sparse representation
+      if(blockRows_ > 0 && (pName.find("_W") == pName.length() - 3 || pName.find("_W") == pName.length() - 2)) {
+        io::Item item;
+        val->get(item, pName);
+        std::vector<io::Item> sparseItems;
+        if(cpu::blocksparse::toBlockSparseItems(item, blockRows_, blockCols_, maxBlockDensity_, sparseItems)) {
+          ioItems.emplace_back(std::move(item));
+          for(auto& sparseItem : sparseItems)
+            ioItems.emplace_back(std::move(sparseItem));
+          continue;
+        }
+      }
+
       // save as packed format
-      // @TODO Hardcoded to find packable weights
-      // int8 - all the weights used for affine op and dot op
-      // fp16 - all the weights used for affine op
       if ((gemmElementType == Type::packed8avx2 || gemmElementType == Type::packed8avx512)
-        && (pName.find("_W") == pName.length() - 3 || pName.find("_W") == pName.length() - 2)) {
+        && isPackable(pName, gemmElementType)) {
 #if USE_FBGEMM
         using namespace marian::cpu::variant;
         // packing information - size
@@ -96,7 +153,7 @@ public:
         ABORT("Packed type {} only supported when compiled with -DUSE_FBGEMM=on", gemmElementType);
 #endif
       // fp16 quantization option
-      } else if (gemmElementType == Type::packed16 && pName.find("_W") == pName.length() - 3) {
+      } else if (gemmElementType == Type::packed16 && isPackable(pName, gemmElementType)) {
 #if USE_FBGEMM
         using namespace marian::cpu::variant;
 
@@ -150,8 +207,7 @@ public:
 #else
         ABORT("Packed type {} only supported when compiled with -DUSE_FBGEMM=on", gemmElementType);
 #endif
-      } else if (isIntgemm(gemmElementType) &&
-      (pName.find("_W") == pName.length() - 3 || pName.find("_W") == pName.length() - 2 /* || pName.find("Wemb") != std::string::npos*/)) {
+      } else if (isIntgemm(gemmElementType) && isPackable(pName, gemmElementType) /* || pName.find("Wemb") != std::string::npos*/) {
 #if COMPILE_CPU
         using cpu::integer::cols;
         using cpu::integer::rows;
@@ -289,6 +345,12 @@ public:
     auto ioItems = pack(gemmElementType, saveElementType);
     if (!meta.empty())
       io::addMetaToItems(meta, "special:model.yml", ioItems);
+    if (!precisionPlan_.empty()) { // for inspection only, the types of the matrices are what the decoder uses
+      std::stringstream plan;
+      for(const auto& entry : precisionPlan_)
+        plan << entry.first << ": " << entry.second << "\n";
+      io::addMetaToItems(plan.str(), "special:precision-plan.yml", ioItems);
+    }
     io::saveItems(name, ioItems);
   }
 };
@@ -127,6 +127,346 @@ static inline Expr affineOrDot(Expr a, Expr bQuant, Expr bias, bool transA, bool
   }
 }
 
+#if COMPILE_CPU
+/*
+ * Quantization multiplier for an activation that is quantized on the fly. Unlike parameters, we cannot
+ * assume a fixed range, so for 16-bit we clamp the default multiplier of 1024 to the observed range.
+ */
+template<Type vtype>
+static inline float computeQuantMultOnTheFly(const float* begin, const float* end) {
+  float maxAbs = intgemm::MaxAbsolute(begin, end);
+  if(maxAbs == 0.f) // all zeros, any multiplier will do
+    return 1.f;
+  if(sizeOf(vtype) == 1)
+    return 127.0f / maxAbs;
+  else
+    return std::min(1024.0f, 32767.0f / maxAbs);
+}
+
+/*
+ * Batched matrix product C = scale * op(A) x op(B) with broadcasting over the batch dimensions, same semantics as
+ * cpu::ProdBatched, but both operands are quantized on the fly per batch entry and multiplied with intgemm.
+ * Intgemm requires the inner dimension to be a multiple of the register width and the number of columns of B
+ * to be a multiple of 8, so operands are copied into zero-padded buffers from the graph allocator.
+ */
+template<Type vtype>
+void ProdBatchedTyped(marian::Tensor C,
+                      Ptr<Allocator> allocator,
+                      const marian::Tensor A,
+                      const marian::Tensor B,
+                      bool transA,
+                      bool transB,
+                      float scale) {
+  typedef typename intgemm_<vtype>::type Integer;
+
+  auto aShape = A->shape();
+  auto bShape = B->shape();
+
+  // make sure both shape have the same number of dimensions via broadcasting
+  size_t maxLength = std::max(aShape.size(), bShape.size());
+  if(aShape.size() != bShape.size()) {
+    Shape ones(std::vector<int>(maxLength, 1));
+    aShape = Shape::broadcast({aShape, ones});
+    bShape = Shape::broadcast({bShape, ones});
+  }
+
+  // Create meta-shapes without last 2 dimensions
+  Shape aShapeMeta, bShapeMeta, cShapeMeta;
+  aShapeMeta.resize(maxLength - 2);
+  bShapeMeta.resize(maxLength - 2);
+  for(size_t i = 0; i < maxLength - 2; ++i) {
+    aShapeMeta.set(i, aShape[i]);
+    bShapeMeta.set(i, bShape[i]);
+  }
+  cShapeMeta = Shape::broadcast({aShapeMeta, bShapeMeta});
+
+  int m = aShape[-2];
+  int k = aShape[-1];
+  if(transA)
+    std::swap(m, k);
+
+  int n = bShape[-1];
+  if(transB)
+    n = bShape[-2];
+
+  int strideA = m * k;
+  int strideB = n * k;
+  int strideC = n * m;
+
+  // intgemm constraints: width is a multiple of 64 (8-bit) or 32 (16-bit), B columns a multiple of 8
+  const int widthMult = sizeOf(vtype) == 1 ? 64 : 32;
+  int kPad = ((k + widthMult - 1) / widthMult) * widthMult;
+  int nPad = ((n + 7) / 8) * 8;
+
+  MemoryPiece::PtrType memAFloat = allocator->alloc<float>(m * kPad);
+  MemoryPiece::PtrType memBFloat = allocator->alloc<float>(kPad * nPad);
+  MemoryPiece::PtrType memAQuant = allocator->alloc<Integer>(m * kPad);
+  MemoryPiece::PtrType memBQuant = allocator->alloc<Integer>(kPad * nPad);
+  MemoryPiece::PtrType memC; // only needed if output columns were padded
+  if(nPad != n)
+    memC = allocator->alloc<float>(m * nPad);
+
+  float* aFloat   = memAFloat->data<float>();
+  float* bFloat   = memBFloat->data<float>();
+  Integer* aQuant = memAQuant->data<Integer>();
+  Integer* bQuant = memBQuant->data<Integer>();
+
+  // padding stays zero for all batch entries, only the valid region is overwritten below
+  std::fill(aFloat, aFloat + m * kPad, 0.f);
+  std::fill(bFloat, bFloat + kPad * nPad, 0.f);
+
+  functional::Shape aShapeMetaF = aShapeMeta;
+  functional::Shape bShapeMetaF = bShapeMeta;
+  functional::Shape cShapeMetaF = cShapeMeta;
+
+  int batchC = cShapeMeta.elements();
+  int lastAIndex = -1, lastBIndex = -1;
+  float aQuantMult = 1.f, bQuantMult = 1.f;
+
+  functional::Array<int, functional::Shape::size()> dims;
+  for(int i = 0; i < batchC; ++i) {
+    cShapeMetaF.dims(i, dims);
+    int aIndex = aShapeMetaF.bindex(dims);
+    int bIndex = bShapeMetaF.bindex(dims);
+
+    // broadcasted operands are quantized only once
+    if(aIndex != lastAIndex) {
+      const float* a = A->data() + aIndex * strideA;
+      for(int r = 0; r < m; ++r)
+        for(int c = 0; c < k; ++c)
+          aFloat[r * kPad + c] = transA ? a[c * m + r] : a[r * k + c];
+      aQuantMult = computeQuantMultOnTheFly<vtype>(aFloat, aFloat + m * kPad);
+      intgemm_<vtype>::width::PrepareA(aFloat, aQuant, aQuantMult, m, kPad);
+      lastAIndex = aIndex;
+    }
+
+    if(bIndex != lastBIndex) {
+      const float* b = B->data() + bIndex * strideB;
+      for(int r = 0; r < k; ++r)
+        for(int c = 0; c < n; ++c)
+          bFloat[r * nPad + c] = transB ? b[c * k + r] : b[r * n + c];
+      bQuantMult = computeQuantMultOnTheFly<vtype>(bFloat, bFloat + kPad * nPad);
+      intgemm_<vtype>::width::PrepareB(bFloat, bQuant, bQuantMult, kPad, nPad);
+      lastBIndex = bIndex;
+    }
+
+    float unquantMult = scale / (aQuantMult * bQuantMult);
+    float* c = C->data() + i * strideC;
+    float* cPad = memC ? memC->data<float>() : c;
+    intgemm_<vtype>::width::Multiply(aQuant, bQuant, m, kPad, nPad,
+                                     intgemm::callbacks::UnquantizeAndWrite(unquantMult, cPad));
+    if(memC) // drop padded columns
+      for(int r = 0; r < m; ++r)
+        std::copy(cPad + r * nPad, cPad + r * nPad + n, c + r * n);
+  }
+
+  allocator->free(memAFloat);
+  allocator->free(memBFloat);
+  allocator->free(memAQuant);
+  allocator->free(memBQuant);
+  if(memC)
+    allocator->free(memC);
+}
+#endif
+
+/*
+ * This computes the batched product op(A) x op(B) of two float activations (see bdot) in intgemm, quantizing both
+ * operands on the fly. This is used for attention during inference, where neither operand is a parameter.
+ * The template argument can be Type::intgemm8 or Type::intgemm16 and all hardware-specific variants.
+ */
+template<Type vtype>
+static inline Expr bdotTyped(Expr a, Expr b, bool transA, bool transB, float scale) {
+#if COMPILE_CPU
+  ABORT_IF(!isFloat(a->value_type()) || !isFloat(b->value_type()),
+           "Intgemm batched product expects float32 inputs not {} and {}", a->value_type(), b->value_type());
+
+  // same output shape as for the float32 version
+  auto shapeA = a->shape();
+  if(transA) {
+    shapeA.set(-2, a->shape()[-1]);
+    shapeA.set(-1, a->shape()[-2]);
+  }
+
+  auto shapeB = b->shape();
+  if(transB) {
+    shapeB.set(-2, b->shape()[-1]);
+    shapeB.set(-1, b->shape()[-2]);
+  }
+
+  ABORT_IF(shapeA[-1] != shapeB[-2],
+           "Batched matrix product requires inner dimensions to match in {}{} * {}{}",
+           std::string(shapeA), transA, std::string(shapeB), transB);
+
+  auto shapeBatchA = shapeA;
+  shapeBatchA.set(-1, 1);
+  shapeBatchA.set(-2, 1);
+
+  auto shapeBatchB = shapeB;
+  shapeBatchB.set(-1, 1);
+  shapeBatchB.set(-2, 1);
+
+  auto outShape = Shape::broadcast({shapeBatchA, shapeBatchB});
+  outShape.set(-2, shapeA[-2]);
+  outShape.set(-1, shapeB[-1]);
+
+  auto bdotNodeOp = [=](Expr out, const std::vector<Expr>& children) {
+    ProdBatchedTyped<vtype>(out->val(),
+                            out->graph()->allocator(),
+                            children[0]->val(),
+                            children[1]->val(),
+                            transA,
+                            transB,
+                            scale);
+  };
+
+  return lambda({a, b}, outShape, Type::float32, bdotNodeOp); // inference-only Lambda node
+#else
+  a, b, transA, transB, scale;
+  ABORT("You need to enable CPU compilation to use this feature. Use cmake .. -DCOMPILE_CPU=ON");
+#endif
+}
+
+// Dispatch hardware-specific batched matrix multiplies for on-the-fly quantized activations
+static inline Expr bdot(Type vtype, Expr a, Expr b, bool transA, bool transB, float scale) {
+  switch(getIntgemmType(vtype)) {
+    case Type::intgemm8ssse3 :
+      return cpu::integer::bdotTyped<Type::intgemm8ssse3>(a, b, transA, transB, scale);
+    case Type::intgemm8avx2 :
+      return cpu::integer::bdotTyped<Type::intgemm8avx2>(a, b, transA, transB, scale);
+    case Type::intgemm8avx512 :
+      return cpu::integer::bdotTyped<Type::intgemm8avx512>(a, b, transA, transB, scale);
+    case Type::intgemm8avx512vnni :
+      return cpu::integer::bdotTyped<Type::intgemm8avx512vnni>(a, b, transA, transB, scale);
+    case Type::intgemm16sse2 :
+      return cpu::integer::bdotTyped<Type::intgemm16sse2>(a, b, transA, transB, scale);
+    case Type::intgemm16avx2 :
+      return cpu::integer::bdotTyped<Type::intgemm16avx2>(a, b, transA, transB, scale);
+    case Type::intgemm16avx512 :
+      return cpu::integer::bdotTyped<Type::intgemm16avx512>(a, b, transA, transB, scale);
+    default:
+      ABORT("Unsupported type {} for Intgemm batched product", vtype);
+  }
+}
+
+/*
+ * Quantizes a float parameter into the intgemm format of the B operand. With transB the parameter holds B transposed,
+ * like the output embeddings [vocab x dim], and the result is B [dim x vocab] with the quantization multiplier at
+ * the end. The node is memoized for parameters, so the matrix is prepared once and kept by the graph.
+ */
+template<Type vtype>
+static inline Expr prepareBTyped(Expr b, bool transB) {
+#if COMPILE_CPU
+  ABORT_IF(!isFloat(b->value_type()), "Intgemm expects type of B to be float32 not {}", b->value_type());
+  int k = transB ? b->shape()[-1] : b->shape()[-2];
+  int n = transB ? b->shape()[-2] : b->shape()[-1];
+
+  auto prepareNodeOp = [=](Expr out, const std::vector<Expr>& children) {
+    Expr in = children[0];
+    auto quantMult = computeQuantMult<vtype>(in->val());
+    typedef typename intgemm_<vtype>::type Integer;
+    if(transB)
+      intgemm_<vtype>::width::PrepareBTransposed(in->val()->data(), out->val()->data<Integer>(), quantMult, k, n);
+    else
+      intgemm_<vtype>::width::PrepareB(in->val()->data(), out->val()->data<Integer>(), quantMult, k, n);
+    getQuantMult<vtype>(out->val()) = quantMult;
+  };
+
+  size_t hash = util::hash<std::string>()("prepareB");
+  util::hash_combine(hash, (size_t)vtype);
+  util::hash_combine(hash, transB);
+  return lambda({b}, {k, n}, vtype, prepareNodeOp, hash);
+#else
+  b, transB;
+  ABORT("You need to enable CPU compilation to use this feature. Use cmake .. -DCOMPILE_CPU=ON");
+#endif
+}
+
+/*
+ * Parameter B (transposed with transB) prepared for affineOrDot above in the hardware-specific variant of vtype
+ * (intgemm8 or intgemm16), see prepareBTyped.
+ */
+static inline Expr prepareB(Type vtype, Expr b, bool transB) {
+  switch(getIntgemmType(vtype)) {
+    case Type::intgemm8ssse3 :
+      return prepareBTyped<Type::intgemm8ssse3>(b, transB);
+    case Type::intgemm8avx2 :
+      return prepareBTyped<Type::intgemm8avx2>(b, transB);
+    case Type::intgemm8avx512 :
+      return prepareBTyped<Type::intgemm8avx512>(b, transB);
+    case Type::intgemm8avx512vnni :
+      return prepareBTyped<Type::intgemm8avx512vnni>(b, transB);
+    case Type::intgemm16sse2 :
+      return prepareBTyped<Type::intgemm16sse2>(b, transB);
+    case Type::intgemm16avx2 :
+      return prepareBTyped<Type::intgemm16avx2>(b, transB);
+    case Type::intgemm16avx512 :
+      return prepareBTyped<Type::intgemm16avx512>(b, transB);
+    default:
+      ABORT("Unsupported type {} for Intgemm preparation", vtype);
+  }
+}
+
+/*
+ * Selects the columns of a prepared B [k x n] given by indices, e.g. the shortlisted output embeddings, without
+ * quantizing again. The result [k x indices] shares the quantization multiplier of B. Intgemm requires the number
+ * of selected columns to be a multiple of 8.
+ */
+template<Type vtype>
+static inline Expr selectColumnsBTyped(Expr bQuant, Expr indices) {
+#if COMPILE_CPU
+  ABORT_IF(indices->value_type() != Type::uint32, "Column indices must be of type uint32 not {}", indices->value_type());
+  int k = bQuant->shape()[-2];
+  int n = indices->shape().elements();
+  ABORT_IF(n % 8 != 0, "Intgemm can only select a multiple of 8 columns, not {}", n);
+
+  auto selectNodeOp = [](Expr out, const std::vector<Expr>& children) {
+    Expr bQuant  = children[0];
+    Expr indices = children[1];
+    typedef typename intgemm_<vtype>::type Integer;
+    const uint32_t* begin = indices->val()->data<uint32_t>();
+    intgemm_<vtype>::width::SelectColumnsB(bQuant->val()->data<Integer>(),
+                                           out->val()->data<Integer>(),
+                                           rows(bQuant->val()),
+                                           begin,
+                                           begin + indices->shape().elements());
+    getQuantMult<vtype>(out->val()) = getQuantMult<vtype>(bQuant->val());
+  };
+
+  size_t hash = util::hash<std::string>()("selectColumnsB");
+  util::hash_combine(hash, (size_t)vtype);
+  return lambda({bQuant, indices}, {k, n}, vtype, selectNodeOp, hash);
+#else
+  bQuant, indices;
+  ABORT("You need to enable CPU compilation to use this feature. Use cmake .. -DCOMPILE_CPU=ON");
+#endif
+}
+
+/*
+ * Columns of the parameter B (transposed with transB) given by indices, quantized into the hardware-specific
+ * variant of vtype (intgemm8 or intgemm16) for affineOrDot above. B is quantized as a whole, so all subsets share
+ * one quantization multiplier and the products match those with the complete matrix.
+ */
+static inline Expr selectColumnsB(Type vtype, Expr b, bool transB, Expr indices) {
+  switch(getIntgemmType(vtype)) {
+    case Type::intgemm8ssse3 :
+      return selectColumnsBTyped<Type::intgemm8ssse3>(prepareBTyped<Type::intgemm8ssse3>(b, transB), indices);
+    case Type::intgemm8avx2 :
+      return selectColumnsBTyped<Type::intgemm8avx2>(prepareBTyped<Type::intgemm8avx2>(b, transB), indices);
+    case Type::intgemm8avx512 :
+      return selectColumnsBTyped<Type::intgemm8avx512>(prepareBTyped<Type::intgemm8avx512>(b, transB), indices);
+    case Type::intgemm8avx512vnni :
+      return selectColumnsBTyped<Type::intgemm8avx512vnni>(prepareBTyped<Type::intgemm8avx512vnni>(b, transB), indices);
+    case Type::intgemm16sse2 :
+      return selectColumnsBTyped<Type::intgemm16sse2>(prepareBTyped<Type::intgemm16sse2>(b, transB), indices);
+    case Type::intgemm16avx2 :
+      return selectColumnsBTyped<Type::intgemm16avx2>(prepareBTyped<Type::intgemm16avx2>(b, transB), indices);
+    case Type::intgemm16avx512 :
+      return selectColumnsBTyped<Type::intgemm16avx512>(prepareBTyped<Type::intgemm16avx512>(b, transB), indices);
+    default:
+      ABORT("Unsupported type {} for Intgemm column selection", vtype);
+  }
+}
+
 }  // namespace integer
 }  // namespace cpu
 }  // namespace marian
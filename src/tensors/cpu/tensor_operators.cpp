@@ -895,6 +895,38 @@ void GRUFastBackward(Ptr<Allocator> /*allocator*/,
   }
 }
 
+void SSRUStepForward(Tensor out_, std::vector<Tensor> inputs) {
+  int cols = out_->shape().back();
+  int rows = out_->shape().elements() / cols / 2;
+
+  float* outState = out_->data();
+  float* outCell = outState + rows * cols;
+
+  const float* cell = inputs[0]->data();
+  const float* x = inputs[1]->data();
+  const float* f = inputs[2]->data();
+  const float* bf = inputs[3]->data();
+  const float* mask = inputs.size() > 4 ? inputs[4]->data() : nullptr;
+
+#pragma omp parallel for
+  for(int j = 0; j < rows; ++j) {
+    float m = !mask || mask[j];
+    float* rowOutState = outState + j * cols;
+    float* rowOutCell = outCell + j * cols;
+    const float* rowCell = cell + j * cols;
+    const float* rowX = x + j * cols;
+    const float* rowF = f + j * cols;
+
+#pragma omp simd
+    for(int i = 0; i < cols; ++i) {
+      float g = functional::Ops<float>::sigmoid(rowF[i] + bf[i]);
+      float c = g * rowCell[i] + (1.f - g) * rowX[i];
+      rowOutCell[i] = m * c;
+      rowOutState[i] = m * std::max(c, 0.f);
+    }
+  }
+}
+
 void CrossEntropyPick(Tensor out, Tensor in, Tensor labelIndices, float labelSmoothingAlpha = 0.f) {
   matchOrAbort<IndexType>(labelIndices->type());
 
@@ -1411,6 +1443,181 @@ void RMSNormalizationGrad(Tensor gradX_,
 }
 MARIAN_FFAST_MATH_END
 
+MARIAN_FFAST_MATH_BEGIN
+template <bool rms, bool hasMask>
+void AddNormalizationImpl(float* out,
+                          const float* x,
+                          const float* residual,
+                          const float* mask,
+                          const float* gamma,
+                          const float* beta,
+                          int gammaStride,
+                          int betaStride,
+                          float eps,
+                          int rows,
+                          int cols) {
+  #pragma omp parallel for
+  for(int j = 0; j < rows; ++j) {
+    float* so = out + j * cols;
+    const float* xRow = x + j * cols;
+    const float* rRow = residual + j * cols;
+    const float* mRow = hasMask ? mask + j * cols : nullptr;
+
+    // the sum is written once to the output row and normalized in place from there
+    float sum = 0.f;
+    #pragma omp simd reduction(+ : sum)
+    for(int i = 0; i < cols; ++i) {
+      float s = (hasMask ? xRow[i] * mRow[i] : xRow[i]) + rRow[i];
+      so[i] = s;
+      sum += s;
+    }
+
+    float mean = rms ? 0.f : sum / cols;
+    float sqSum = 0.f;
+    #pragma omp simd reduction(+ : sqSum)
+    for(int i = 0; i < cols; ++i) {
+      float ex = so[i] - mean;
+      sqSum += ex * ex;
+    }
+
+    float sigma = std::sqrt(sqSum / cols + eps);
+
+    #pragma omp simd
+    for(int i = 0; i < cols; ++i) {
+      float t = gamma[gammaStride * i] * ((so[i] - mean) / sigma);
+      if(beta)
+        t += beta[betaStride * i];
+      so[i] = t;
+    }
+  }
+}
+MARIAN_FFAST_MATH_END
+
+void AddNormalization(Tensor out,
+                      Tensor x,
+                      Tensor residual,
+                      Tensor mask,
+                      Tensor gamma,
+                      Tensor beta,
+                      float eps,
+                      bool rms) {
+  const int gammaStride = gamma->shape().back() > 1;  // broadcasting for gamma and beta
+  const int betaStride = beta && beta->shape().back() > 1;
+  const float* betaData = beta ? beta->data() : nullptr;
+
+  int rows = x->shape().elements() / x->shape().back();
+  int cols = x->shape().back();
+
+  if(rms) {
+    if(mask)
+      AddNormalizationImpl<true, true>(out->data(), x->data(), residual->data(), mask->data(), gamma->data(), betaData, gammaStride, betaStride, eps, rows, cols);
+    else
+      AddNormalizationImpl<true, false>(out->data(), x->data(), residual->data(), nullptr, gamma->data(), betaData, gammaStride, betaStride, eps, rows, cols);
+  } else {
+    if(mask)
+      AddNormalizationImpl<false, true>(out->data(), x->data(), residual->data(), mask->data(), gamma->data(), betaData, gammaStride, betaStride, eps, rows, cols);
+    else
+      AddNormalizationImpl<false, false>(out->data(), x->data(), residual->data(), nullptr, gamma->data(), betaData, gammaStride, betaStride, eps, rows, cols);
+  }
+}
+
+MARIAN_FFAST_MATH_BEGIN
+void AddNormalizationGrad(Tensor gradX_,
+                          Tensor gradResidual_,
+                          Tensor gradGamma_,
+                          Tensor gradBeta_,
+                          Tensor adj_,
+                          Tensor x_,
+                          Tensor residual_,
+                          Tensor mask_,
+                          Tensor gamma_,
+                          float eps,
+                          bool rms) {
+  float* gradX = gradX_ ? gradX_->data() : nullptr;
+  float* gradResidual = gradResidual_ ? gradResidual_->data() : nullptr;
+  float* gradGamma = gradGamma_->data();
+  const float* adj = adj_->data();
+  const float* x = x_->data();
+  const float* residual = residual_->data();
+  const float* mask = mask_ ? mask_->data() : nullptr;
+  const float* gamma = gamma_->data();
+  const int gammaStride = gamma_->shape().back() > 1;  // broadcasting for gamma and beta. 0 means it's a scalar
+
+  size_t rows = x_->shape().elements() / x_->shape()[-1];
+  size_t cols = x_->shape()[-1];
+
+  // omp array reductions need a valid target, so accumulate beta gradients into a scratch buffer if there is no beta
+  std::vector<float> scratchGradBeta;
+  float* gradBeta = nullptr;
+  int betaStride = 0;
+  if(gradBeta_) {
+    gradBeta = gradBeta_->data();
+    betaStride = gradBeta_->shape().back() > 1;
+  } else {
+    scratchGradBeta.resize(cols, 0.f);
+    gradBeta = scratchGradBeta.data();
+    betaStride = 1;
+  }
+
+  #pragma omp parallel
+  {
+    // the sum of input and residual is not stored in the forward step, recompute it per row
+    std::vector<float> sRow(cols);
+
+    #pragma omp for reduction(+ : gradGamma[:cols], gradBeta[:cols])
+    for(size_t j = 0; j < rows; ++j) {
+      const float* xRow = x + j * cols;
+      const float* rRow = residual + j * cols;
+      const float* mRow = mask ? mask + j * cols : nullptr;
+      const float* adjRow = adj + j * cols;
+
+      float sum = 0.f;
+      for(size_t i = 0; i < cols; ++i) {
+        sRow[i] = (mRow ? xRow[i] * mRow[i] : xRow[i]) + rRow[i];
+        sum += sRow[i];
+      }
+
+      float mean = rms ? 0.f : sum / cols;
+      float sum_sqr = 0.f;
+      #pragma omp simd reduction(+ : sum_sqr)
+      for(size_t i = 0; i < cols; ++i) {
+        float ex = sRow[i] - mean;
+        sum_sqr += ex * ex;
+      }
+      float sigma = std::sqrt(sum_sqr / cols + eps);
+
+      float sum_adj = 0.f;
+      float sum_adj_x = 0.f;
+      #pragma omp simd reduction(+ : sum_adj, sum_adj_x)
+      for(size_t i = 0; i < cols; ++i) {
+        float x_hat = (sRow[i] - mean) / sigma;
+        sum_adj   += adjRow[i];
+        sum_adj_x += adjRow[i] * x_hat;
+      }
+
+      // same gradient as LayerNormalizationGrad and RMSNormalizationGrad, the mean term vanishes for RMS
+      float* gradXRow = gradX ? gradX + j * cols : nullptr;
+      float* gradRRow = gradResidual ? gradResidual + j * cols : nullptr;
+      for(size_t i = 0; i < cols; ++i) {
+        float x_hat = (sRow[i] - mean) / sigma;
+        float grad_s = cols * adjRow[i];
+        if(!rms)
+          grad_s -= sum_adj;
+        grad_s -= sum_adj_x * x_hat;
+        grad_s *= gamma[gammaStride * i] / (cols * sigma);
+
+        if(gradXRow)
+          gradXRow[i] += mRow ? grad_s * mRow[i] : grad_s;
+        if(gradRRow)
+          gradRRow[i] += grad_s;
+        gradGamma[gammaStride * i] += adjRow[i] * x_hat;
+        gradBeta[betaStride * i]   += adjRow[i];
+      }
+    }
+  }
+}
+MARIAN_FFAST_MATH_END
+
 void Shift(Tensor out_,
            Tensor in_,
            marian::Shape shift,
@@ -83,6 +83,43 @@ public:
     LOG_ONCE(info, "getGemmType() not supported for GPU");
     return GemmType::Float32;
   }
+  void setGemmTuningFile(const std::string& file) override {
+    LOG_ONCE(info, "setGemmTuningFile() not supported for GPU_{}", file);
+  }
+  std::string getGemmTuningFile() override {
+    LOG_ONCE(info, "getGemmTuningFile() not supported for GPU");
+    return "";
+  }
+
+  // for CPU, selects the GEMM type for batched products (bdot) during inference.
+  // for GPU, there's no gemm type. so, it does nothing.
+  void setBatchedGemmType(std::string gemmType) override {
+    LOG_ONCE(info, "setBatchedGemmType() not supported for GPU_{}", gemmType);
+  }
+  Type getBatchedGemmType() override {
+    LOG_ONCE(info, "getBatchedGemmType() not supported for GPU");
+    return Type::float32;
+  }
+
+  // for CPU, selects the GEMM type for the shortlisted output layer during inference.
+  // for GPU, there's no gemm type. so, it does nothing.
+  void setShortlistGemmType(std::string gemmType) override {
+    LOG_ONCE(info, "setShortlistGemmType() not supported for GPU_{}", gemmType);
+  }
+  Type getShortlistGemmType() override {
+    LOG_ONCE(info, "getShortlistGemmType() not supported for GPU");
+    return Type::float32;
+  }
+
+  // for CPU, uses the block-sparse copies of weight matrices.
+  // for GPU, there's no block-sparse kernel. so, it does nothing.
+  void setBlockSparseMaxDensity(float maxDensity) override {
+    LOG_ONCE(info, "setBlockSparseMaxDensity() not supported for GPU_{}", maxDensity);
+  }
+  float getBlockSparseMaxDensity() override {
+    LOG_ONCE(info, "getBlockSparseMaxDensity() not supported for GPU");
+    return 0.f;
+  }
 
   // for CPU, sets quantization range of weight matrices for the inference.
   // for GPU, there's no quantization. so, it does nothing.
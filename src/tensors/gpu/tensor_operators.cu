@@ -2570,6 +2570,85 @@ void RMSNormalizationGrad(Ptr<Allocator> allocator,
 }
 
 
+// Fused residual-add + normalization. Instead of separate kernels this composes the element-wise sum with the
+// existing normalization kernels, the sum only lives in temporary memory and is recomputed for the backward step.
+static MemoryPiece::PtrType addNormalizationSum(Ptr<Allocator> allocator,
+                                                Tensor& sum,
+                                                Tensor x,
+                                                Tensor residual,
+                                                Tensor mask) {
+  using namespace functional;
+  auto sumMemory = allocator->alloc(x->shape().elements() * sizeOf(x->type()));
+  sum = TensorBase::New(sumMemory, x->shape(), x->type(), x->getBackend());
+  if(mask)
+    gpu::Element(_1 = _2 * _3 + _4, sum, x, mask, residual);
+  else
+    gpu::Element(_1 = _2 + _3, sum, x, residual);
+  return sumMemory;
+}
+
+void AddNormalization(Ptr<Allocator> allocator,
+                      Tensor out,
+                      Tensor x,
+                      Tensor residual,
+                      Tensor mask,
+                      Tensor gamma,
+                      Tensor beta,
+                      float eps,
+                      bool rms) {
+  cudaSetDevice(out->getDeviceId().no);
+
+  Tensor sum;
+  auto sumMemory = addNormalizationSum(allocator, sum, x, residual, mask);
+  if(rms)
+    gpu::RMSNormalization(out, sum, gamma, beta, eps);
+  else
+    gpu::LayerNormalization(out, sum, gamma, beta, eps);
+  allocator->free(sumMemory);
+}
+
+void AddNormalizationGrad(Ptr<Allocator> allocator,
+                          Tensor gradX,
+                          Tensor gradResidual,
+                          Tensor gradGamma,
+                          Tensor gradBeta,
+                          Tensor adj,
+                          Tensor y,
+                          Tensor x,
+                          Tensor residual,
+                          Tensor mask,
+                          Tensor gamma,
+                          Tensor beta,
+                          float eps,
+                          bool rms) {
+  using namespace functional;
+  cudaSetDevice(adj->getDeviceId().no);
+
+  Tensor sum;
+  auto sumMemory = addNormalizationSum(allocator, sum, x, residual, mask);
+
+  auto gradSumMemory = allocator->alloc(adj->shape().elements() * sizeOf(adj->type()));
+  Tensor gradSum = TensorBase::New(gradSumMemory, adj->shape(), adj->type(), adj->getBackend());
+  gradSum->set(0.f);
+
+  if(rms)
+    gpu::RMSNormalizationGrad(allocator, gradSum, gradGamma, gradBeta, adj, y, sum, gamma, beta, eps);
+  else
+    gpu::LayerNormalizationGrad(allocator, gradSum, gradGamma, gradBeta, adj, y, sum, gamma, beta, eps);
+
+  if(gradX) {
+    if(mask)
+      gpu::Add(_1 * _2, 1.f, gradX, gradSum, mask);
+    else
+      gpu::Add(_1, 1.f, gradX, gradSum);
+  }
+  if(gradResidual)
+    gpu::Add(_1, 1.f, gradResidual, gradSum);
+
+  allocator->free(gradSumMemory);
+  allocator->free(sumMemory);
+}
+
 template <bool add, typename T>
 __global__ void gShift(T* out,
                        const T* in,
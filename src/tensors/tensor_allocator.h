@@ -80,7 +80,7 @@ public:
     }
   }
 
-  void free(const Tensor& t) { allocator_->free(t->memory()); }
+  bool free(const Tensor& t) { return allocator_->free(t->memory()); }
 
   Tensor asTensor(Type type = Type::float32) {
     auto mem = allocator_->memory();
@@ -268,6 +268,100 @@ static inline void RMSNormalizationGrad(
     cpu::RMSNormalizationGrad(gradX, gradGamma, gradBeta, adj, y, x, gamma, beta, eps);
 }
 
+// Fused out = norm(x * mask + residual) with layer normalization or, if rms is set, RMS normalization.
+// mask (dropout) and beta may be nullptr. The GPU version needs the allocator for a temporary sum.
+#ifdef CUDA_FOUND
+namespace gpu {
+void AddNormalization(Ptr<Allocator> allocator,
+                      Tensor out,
+                      Tensor x,
+                      Tensor residual,
+                      Tensor mask,
+                      Tensor gamma,
+                      Tensor beta,
+                      float eps,
+                      bool rms);
+
+void AddNormalizationGrad(Ptr<Allocator> allocator,
+                          Tensor gradX,
+                          Tensor gradResidual,
+                          Tensor gradGamma,
+                          Tensor gradBeta,
+                          Tensor adj,
+                          Tensor y,
+                          Tensor x,
+                          Tensor residual,
+                          Tensor mask,
+                          Tensor gamma,
+                          Tensor beta,
+                          float eps,
+                          bool rms);
+}
+#endif
+
+namespace cpu {
+void AddNormalization(Tensor out,
+                      Tensor x,
+                      Tensor residual,
+                      Tensor mask,
+                      Tensor gamma,
+                      Tensor beta,
+                      float eps,
+                      bool rms);
+
+void AddNormalizationGrad(Tensor gradX,
+                          Tensor gradResidual,
+                          Tensor gradGamma,
+                          Tensor gradBeta,
+                          Tensor adj,
+                          Tensor x,
+                          Tensor residual,
+                          Tensor mask,
+                          Tensor gamma,
+                          float eps,
+                          bool rms);
+}
+
+static inline void AddNormalization(Ptr<Allocator> allocator,
+                                    Tensor out,
+                                    Tensor x,
+                                    Tensor residual,
+                                    Tensor mask,
+                                    Tensor gamma,
+                                    Tensor beta,
+                                    float eps,
+                                    bool rms) {
+#ifdef CUDA_FOUND
+  if(out->getBackend()->getDeviceId().type == DeviceType::gpu)
+    gpu::AddNormalization(allocator, out, x, residual, mask, gamma, beta, eps, rms);
+  else
+#endif
+    cpu::AddNormalization(out, x, residual, mask, gamma, beta, eps, rms);
+}
+
+// Accumulates gradients for x, residual, gamma and beta. Any of gradX, gradResidual and gradBeta may be nullptr.
+static inline void AddNormalizationGrad(Ptr<Allocator> allocator,
+                                        Tensor gradX,
+                                        Tensor gradResidual,
+                                        Tensor gradGamma,
+                                        Tensor gradBeta,
+                                        Tensor adj,
+                                        Tensor y,
+                                        Tensor x,
+                                        Tensor residual,
+                                        Tensor mask,
+                                        Tensor gamma,
+                                        Tensor beta,
+                                        float eps,
+                                        bool rms) {
+#ifdef CUDA_FOUND
+  if(adj->getBackend()->getDeviceId().type == DeviceType::gpu)
+    gpu::AddNormalizationGrad(allocator, gradX, gradResidual, gradGamma, gradBeta, adj, y, x, residual, mask, gamma, beta, eps, rms);
+  else
+#endif
+    cpu::AddNormalizationGrad(gradX, gradResidual, gradGamma, gradBeta, adj, x, residual, mask, gamma, eps, rms);
+}
+
 DISPATCH4(HighwayForward, marian::Tensor, const marian::Tensor, const marian::Tensor, const marian::Tensor)
 DISPATCH7(HighwayBackward, marian::Tensor, marian::Tensor, marian::Tensor, const marian::Tensor, const marian::Tensor, const marian::Tensor, const marian::Tensor)
 
@@ -369,6 +463,12 @@ static inline void GRUFastBackward(Ptr<Allocator> allocator,
     cpu::GRUFastBackward(allocator, outputs, inputs, adj, final);
 }
 
+namespace cpu {
+// One inference step of an SSRU cell for all rows: out holds the output followed by the cell state.
+// inputs: previous cell state, x = input * W, f = input * Wf, bf[, mask], see rnn::SSRU
+void SSRUStepForward(marian::Tensor out, std::vector<marian::Tensor> inputs);
+}
+
 // clang-format off
 DISPATCH4(Att, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor)
 DISPATCH7(AttBack, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor, marian::Tensor)
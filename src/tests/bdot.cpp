@@ -0,0 +1,62 @@
+#include <iostream>
+
+#include "marian.h"
+#include "common/timer.h"
+
+// Benchmarks the float32 batched product against on-the-fly quantized intgemm8/intgemm16
+// for attention-like shapes and reports speed and the maximum relative deviation.
+// Usage: ./test_bdot [source length] [number of heads] [beam * batch]
+
+using namespace marian;
+
+int main(int argc, char** argv) {
+  int srcLength = argc > 1 ? std::atoi(argv[1]) : 256;
+  int heads     = argc > 2 ? std::atoi(argv[2]) : 8;
+  int batch     = argc > 3 ? std::atoi(argv[3]) : 16;
+  int dimHead   = 64;
+  int iterations = 100;
+
+  Config::seed = 1234;
+
+  std::vector<float> reference, values;
+  for(auto batchedGemmType : {"float32", "intgemm8", "intgemm16"}) {
+    auto graph = New<ExpressionGraph>(/*inference=*/true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->getBackend()->setBatchedGemmType(batchedGemmType);
+    graph->reserveWorkspaceMB(1024);
+
+    timer::Timer timer;
+    for(int i = 0; i < iterations; ++i) {
+      graph->clear();
+
+      // one decoder step of encoder-decoder attention: [batch, heads, 1, dimHead] x [batch, heads, srcLength, dimHead]^T
+      auto q = graph->constant({batch, heads, 1, dimHead}, inits::normal());
+      auto k = graph->constant({batch, heads, srcLength, dimHead}, inits::normal());
+      auto v = graph->constant({batch, heads, srcLength, dimHead}, inits::normal());
+
+      auto weights = softmax(bdot(q, k, false, true, 1.f / std::sqrt((float)dimHead)));
+      auto output  = bdot(weights, v);
+
+      graph->forward();
+
+      if(i == 0)
+        output->val()->get(values);
+    }
+    timer.stop();
+
+    std::cout << batchedGemmType << ": " << timer.elapsed<std::chrono::milliseconds>() / iterations << "ms per step";
+    if(reference.empty()) {
+      reference = values;
+    } else {
+      float maxRef = 0.f, maxDiff = 0.f;
+      for(size_t i = 0; i < reference.size(); ++i) {
+        maxRef  = std::max(maxRef, std::abs(reference[i]));
+        maxDiff = std::max(maxDiff, std::abs(reference[i] - values[i]));
+      }
+      std::cout << ", max relative deviation from float32: " << maxDiff / maxRef;
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <random>
+
+#include "marian.h"
+#include "common/timer.h"
+#include "tensors/cpu/block_sparse.h"
+
+// Benchmarks the block-sparse affine against the dense float32 affine for the two matrices of a Transformer FFN
+// pruned to the given fraction of zero blocks, and reports the speed-up and the maximum deviation.
+// Usage: ./test_block_sparse [sparsity] [rows of A, i.e. batch * beam] [model dimension] [FFN dimension]
+
+using namespace marian;
+
+int main(int argc, char** argv) {
+  float sparsity = argc > 1 ? std::atof(argv[1]) : 0.8f;
+  int rows       = argc > 2 ? std::atoi(argv[2]) : 64;
+  int dimModel   = argc > 3 ? std::atoi(argv[3]) : 512;
+  int dimFfn     = argc > 4 ? std::atoi(argv[4]) : 2048;
+  int iterations = 100;
+
+  Config::seed = 1234;
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  std::normal_distribution<float> normal(0.f, 0.1f);
+
+  for(auto blockShape : std::vector<std::pair<int, int>>({{16, 1}, {4, 4}})) {
+    int blockRows = blockShape.first, blockCols = blockShape.second;
+
+    // prune whole blocks at random
+    auto pruned = [&](int K, int N) {
+      std::vector<float> w(K * N, 0.f);
+      for(int rb = 0; rb < K / blockRows; ++rb)
+        for(int cb = 0; cb < N / blockCols; ++cb)
+          if(uniform(rng) >= sparsity)
+            for(int r = 0; r < blockRows; ++r)
+              for(int c = 0; c < blockCols; ++c)
+                w[(rb * blockRows + r) * N + cb * blockCols + c] = normal(rng);
+      return w;
+    };
+    std::vector<float> w1 = pruned(dimModel, dimFfn), w2 = pruned(dimFfn, dimModel);
+
+    std::vector<float> reference, values;
+    for(float maxDensity : {0.f, 1.f}) {
+      auto graph = New<ExpressionGraph>(/*inference=*/true);
+      graph->setDevice({0, DeviceType::cpu});
+      graph->getBackend()->setBlockSparseMaxDensity(maxDensity);
+      graph->reserveWorkspaceMB(512);
+
+      auto addParam = [&](const std::string& name, int K, int N, const std::vector<float>& w) {
+        std::vector<float> bsrValues;
+        std::vector<IndexType> bsrIndices, bsrOffsets;
+        cpu::blocksparse::toBlockSparse(w.data(), K, N, blockRows, blockCols, bsrValues, bsrIndices, bsrOffsets);
+        int numBlocks = (int)bsrIndices.size();
+        graph->param(name + cpu::blocksparse::valuesSuffix, {numBlocks, blockRows * blockCols}, inits::fromVector(bsrValues));
+        graph->param(name + cpu::blocksparse::indicesSuffix, {numBlocks}, inits::fromVector(bsrIndices), Type::uint32);
+        graph->param(name + cpu::blocksparse::offsetsSuffix, {(int)bsrOffsets.size()}, inits::fromVector(bsrOffsets), Type::uint32);
+        graph->param(name + cpu::blocksparse::densitySuffix, {1},
+                     inits::fromValue(cpu::blocksparse::blockDensity(w.data(), K, N, blockRows, blockCols)));
+        return graph->param(name, {K, N}, inits::fromVector(w));
+      };
+      auto W1 = addParam("ffn_W1", dimModel, dimFfn, w1);
+      auto W2 = addParam("ffn_W2", dimFfn, dimModel, w2);
+      auto b1 = graph->param("ffn_b1", {1, dimFfn}, inits::normal());
+      auto b2 = graph->param("ffn_b2", {1, dimModel}, inits::normal());
+
+      timer::Timer timer;
+      for(int i = 0; i < iterations; ++i) {
+        graph->clear();
+        auto x = graph->constant({rows, dimModel}, inits::normal());
+        auto y = affine(relu(affine(x, W1, b1)), W2, b2);
+        graph->forward();
+        if(i == 0)
+          y->val()->get(values);
+      }
+      timer.stop();
+
+      double ms = timer.elapsed<std::chrono::microseconds>() / 1000.0 / iterations;
+      std::cout << blockRows << "x" << blockCols << " blocks, " << (maxDensity > 0.f ? "block-sparse" : "dense")
+                << ": " << ms << "ms per FFN";
+      if(reference.empty()) {
+        reference = values;
+      } else {
+        float maxRef = 0.f, maxDiff = 0.f;
+        for(size_t j = 0; j < reference.size(); ++j) {
+          maxRef  = std::max(maxRef, std::abs(reference[j]));
+          maxDiff = std::max(maxDiff, std::abs(reference[j] - values[j]));
+        }
+        std::cout << ", max relative deviation from dense: " << maxDiff / maxRef;
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+
+#include "marian.h"
+#include "common/timer.h"
+#include "layers/lsh.h"
+
+// Benchmarks the LSH output-layer index: exhaustive Hamming search against multi-probe bucket search.
+// Reports the time per query and the recall of the multi-probe results with respect to the exhaustive search.
+// Usage: ./test_lsh [vocabulary size] [dimension] [number of bits] [k]
+
+using namespace marian;
+
+int main(int argc, char** argv) {
+  int vocabSize = argc > 1 ? std::atoi(argv[1]) : 32000;
+  int dim       = argc > 2 ? std::atoi(argv[2]) : 512;
+  int nBits     = argc > 3 ? std::atoi(argv[3]) : 1024;
+  int k         = argc > 4 ? std::atoi(argv[4]) : 100;
+  int numQueries = 1000;
+
+  Config::seed = 1234;
+
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(512);
+
+  auto weights = graph->param("W", {vocabSize, dim}, inits::normal());
+  auto queries = graph->constant({numQueries, dim}, inits::normal());
+  auto rotation = dim != nBits ? lsh::rotator(weights, nBits) : nullptr;
+
+  auto weightCodes = lsh::encode(weights, rotation);
+  auto queryCodes  = lsh::encode(queries, rotation);
+  graph->forward();
+
+  std::vector<uint8_t> wCodes, qCodes;
+  weightCodes->val()->get(wCodes);
+  queryCodes->val()->get(qCodes);
+
+  int bytes = lsh::bytesPerVector(nBits);
+  auto index = lsh::Index::get(wCodes.data(), vocabSize, bytes);
+  std::cout << "Index with " << index->rows() << " rows of " << nBits << " bits, "
+            << (1 << index->bucketBits()) << " buckets" << std::endl;
+
+  std::vector<uint32_t> reference(numQueries * k), ids(numQueries * k);
+  for(int probes : {0, 16, 64, 256, 1024}) {
+    auto& out = probes == 0 ? reference : ids;
+
+    timer::Timer timer;
+    for(int q = 0; q < numQueries; ++q)
+      index->search(qCodes.data() + (size_t)q * bytes, k, probes, 0, out.data() + (size_t)q * k);
+    timer.stop();
+
+    std::cout << "probes " << probes << ": "
+              << timer.elapsed<std::chrono::microseconds>() / numQueries << "us per query";
+    if(probes > 0) {
+      // both lists are sorted by index, count the overlap
+      size_t found = 0;
+      for(int q = 0; q < numQueries; ++q) {
+        std::vector<uint32_t> common;
+        std::set_intersection(reference.begin() + q * k, reference.begin() + (q + 1) * k,
+                              ids.begin() + q * k, ids.begin() + (q + 1) * k,
+                              std::back_inserter(common));
+        found += common.size();
+      }
+      std::cout << ", recall@" << k << ": " << (double)found / (numQueries * k);
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
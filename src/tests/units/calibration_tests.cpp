@@ -0,0 +1,60 @@
+#include "catch.hpp"
+#include "rescorer/precision_calibration.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace marian;
+
+TEST_CASE("Precision calibration keeps the cost increase within the budget", "[calibration]") {
+  float inf = std::numeric_limits<float>::infinity();
+  std::vector<Type> candidates = {Type::intgemm8, Type::intgemm16}; // fastest first
+
+  // cost increase of each matrix in each candidate type, infinite if the matrix cannot be stored in it
+  std::map<std::string, std::vector<float>> increases = {{"A_W", {0.01f, 0.005f}},
+                                                         {"B_W", {0.02f, 0.01f}},
+                                                         {"C_W", {0.5f, 0.1f}},
+                                                         {"D_W", {inf, 0.001f}},
+                                                         {"E_W", {-0.01f, 0.f}}};
+
+  // the sum of the increases of the planned matrices, scaled to simulate increases that do not add up
+  std::vector<std::map<std::string, Type>> measured;
+  auto additive = [&](float scale) {
+    return [&measured, &increases, &candidates, scale](const std::map<std::string, Type>& plan) {
+      measured.push_back(plan);
+      float sum = 0.f;
+      for(const auto& entry : plan) {
+        size_t c = std::find(candidates.begin(), candidates.end(), entry.second) - candidates.begin();
+        if(c < candidates.size())
+          sum += std::max(0.f, increases[entry.first][c]);
+      }
+      return scale * sum;
+    };
+  };
+
+  SECTION("the fastest candidate goes to the least sensitive matrices first") {
+    auto plan = PrecisionCalibration::select(increases, candidates, 0.04f, additive(1.f));
+    CHECK(plan == std::map<std::string, Type>({{"A_W", Type::intgemm8},
+                                               {"B_W", Type::intgemm8},
+                                               {"C_W", Type::float32},
+                                               {"D_W", Type::intgemm16},
+                                               {"E_W", Type::intgemm8}}));
+    CHECK(measured.size() == 1); // within the budget as estimated
+  }
+
+  SECTION("the most expensive matrices are reverted until the measured increase meets the budget") {
+    auto plan = PrecisionCalibration::select(increases, candidates, 0.04f, additive(2.f));
+    CHECK(plan == std::map<std::string, Type>({{"A_W", Type::intgemm8},
+                                               {"B_W", Type::float32},
+                                               {"C_W", Type::float32},
+                                               {"D_W", Type::intgemm16},
+                                               {"E_W", Type::intgemm8}}));
+    CHECK(measured.size() == 2);
+  }
+
+  SECTION("a zero budget only packs matrices that do not get worse") {
+    auto plan = PrecisionCalibration::select(increases, candidates, 0.f, additive(1.f));
+    for(const auto& entry : plan)
+      CHECK(entry.second == (entry.first == "E_W" ? Type::intgemm8 : Type::float32));
+  }
+}
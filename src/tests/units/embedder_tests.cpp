@@ -0,0 +1,145 @@
+#include "catch.hpp"
+#include "common/file_stream.h"
+#include "common/utils.h"
+#include "embedder/miner.h"
+#include "embedder/vector_collector.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+using namespace marian;
+
+TEST_CASE("Margin scores prefer candidates that are not close to everything", "[embedder]") {
+  auto unit = [](float degrees) {
+    float radians = degrees * 3.14159265f / 180.f;
+    return std::vector<float>({std::cos(radians), std::sin(radians)});
+  };
+  auto cosine = [](float degrees) { return std::cos(degrees * 3.14159265f / 180.f); };
+
+  // target 0 is the nearest neighbour of source 0, but also close to source 1; target 1 is a little
+  // further from source 0 and far from everything else
+  mining::EmbeddingMatrix src, trg;
+  src.Write(0, unit(0.f));
+  src.Write(1, unit(90.f));
+  trg.Write(1, unit(-30.f)); // rows may arrive in any order
+  trg.Write(0, unit(10.f));
+
+  float srcAvg  = (cosine(10.f) + cosine(30.f)) / 2;
+  float trg0Avg = (cosine(10.f) + cosine(80.f)) / 2;
+  float trg1Avg = (cosine(30.f) + cosine(120.f)) / 2;
+
+  // mines with k = 2 and returns the candidates of source 0 as (target, score) in the written order
+  auto mine = [&](const std::string& margin) {
+    io::TemporaryFile temp("/tmp/", /*earlyUnlink=*/false);
+    auto options = New<Options>("mine-k", (size_t)2,
+                                "mine-margin", margin,
+                                "mine-index", std::string("exact"),
+                                "cpu-threads", (size_t)1,
+                                "output", temp.getFileName());
+    mining::Miner(options).mine(src, trg);
+
+    std::vector<std::pair<size_t, float>> candidates;
+    io::InputFileStream in(temp.getFileName());
+    std::string line;
+    while(io::getline(in, line)) {
+      auto fields = utils::split(line, "\t");
+      REQUIRE(fields.size() == 3);
+      if(fields[0] == "0")
+        candidates.emplace_back(std::stoul(fields[1]), std::stof(fields[2]));
+    }
+    return candidates;
+  };
+
+  SECTION("absolute keeps the order of cosine similarities") {
+    auto candidates = mine("absolute");
+    REQUIRE(candidates.size() == 2);
+    CHECK(candidates[0].first == 0);
+    CHECK(candidates[0].second == Approx(cosine(10.f)).epsilon(1e-4));
+    CHECK(candidates[1].first == 1);
+    CHECK(candidates[1].second == Approx(cosine(30.f)).epsilon(1e-4));
+  }
+
+  SECTION("ratio divides by the average similarity of both neighbourhoods") {
+    auto candidates = mine("ratio");
+    REQUIRE(candidates.size() == 2);
+    CHECK(candidates[0].first == 1);
+    CHECK(candidates[0].second == Approx(cosine(30.f) / ((srcAvg + trg1Avg) / 2)).epsilon(1e-4));
+    CHECK(candidates[1].first == 0);
+    CHECK(candidates[1].second == Approx(cosine(10.f) / ((srcAvg + trg0Avg) / 2)).epsilon(1e-4));
+  }
+
+  SECTION("distance subtracts the average similarity of both neighbourhoods") {
+    auto candidates = mine("distance");
+    REQUIRE(candidates.size() == 2);
+    CHECK(candidates[0].first == 1);
+    CHECK(candidates[0].second == Approx(cosine(30.f) - (srcAvg + trg1Avg) / 2).epsilon(1e-4));
+    CHECK(candidates[1].first == 0);
+    CHECK(candidates[1].second == Approx(cosine(10.f) - (srcAvg + trg0Avg) / 2).epsilon(1e-4));
+  }
+}
+
+TEST_CASE("Embeddings are written as .npy matrix in any order", "[embedder]") {
+  io::TemporaryFile input("/tmp/", false), output("/tmp/", false);
+  std::ofstream(input.getFileName()) << "a\nb\nc\n";
+
+  std::vector<std::vector<float>> rows = {{1.f, 2.f, 3.f, 4.f}, {0.5f, -1.f, 0.25f, 8.f}, {-2.f, 0.f, 1.5f, 3.f}};
+
+  // writes the given rows in the given order and returns the header and the data of the file
+  auto write = [&](const std::string& type, const std::vector<long>& ids) {
+    auto options = New<Options>("output", output.getFileName(),
+                                "npy", type,
+                                "train-sets", std::vector<std::string>({input.getFileName()}));
+    auto collector = VectorCollector::Create(options);
+    REQUIRE(std::dynamic_pointer_cast<NpyVectorCollector>(collector));
+    for(auto id : ids)
+      collector->Write(id, rows[id]);
+    collector.reset(); // unmaps the file
+
+    std::ifstream in(output.getFileName(), std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(file.size() > 10);
+    size_t headerSize = 10 + (unsigned char)file[8] + ((unsigned char)file[9] << 8);
+    REQUIRE(file.size() >= headerSize);
+    return std::make_pair(file.substr(0, headerSize), file.substr(headerSize));
+  };
+
+  auto checkHeader = [](const std::string& header, const std::string& descr) {
+    CHECK(header.substr(0, 6) == std::string(1, (char)0x93) + "NUMPY");
+    CHECK(header[6] == 1); // version 1.0
+    CHECK(header[7] == 0);
+    CHECK(header.size() % 64 == 0); // the data is aligned
+    CHECK(header.back() == '\n');
+    CHECK(header.find("'descr': '" + descr + "'") != std::string::npos);
+    CHECK(header.find("'fortran_order': False") != std::string::npos);
+    CHECK(header.find("'shape': (3, 4)") != std::string::npos);
+  };
+
+  SECTION("float32") {
+    auto file = write("float32", {2, 0, 1});
+    checkHeader(file.first, "<f4");
+    REQUIRE(file.second.size() == 3 * 4 * sizeof(float));
+    std::vector<float> values(12);
+    std::memcpy(values.data(), file.second.data(), file.second.size());
+    for(size_t i = 0; i < 3; ++i)
+      CHECK(std::vector<float>(values.begin() + 4 * i, values.begin() + 4 * (i + 1)) == rows[i]);
+  }
+
+  SECTION("float16") {
+    auto file = write("float16", {1, 2, 0});
+    checkHeader(file.first, "<f2");
+    REQUIRE(file.second.size() == 3 * 4 * sizeof(float16));
+    auto values = reinterpret_cast<const float16*>(file.second.data());
+    for(size_t i = 0; i < 3; ++i)
+      for(size_t j = 0; j < 4; ++j)
+        CHECK((float)values[4 * i + j] == rows[i][j]); // all values are exact in float16
+  }
+
+  SECTION("rows that are not written stay zero") {
+    auto file = write("float32", {2, 0});
+    std::vector<float> values(12);
+    std::memcpy(values.data(), file.second.data(), file.second.size());
+    CHECK(std::vector<float>(values.begin() + 4, values.begin() + 8) == std::vector<float>(4, 0.f));
+    CHECK(std::vector<float>(values.begin() + 8, values.end()) == rows[2]);
+  }
+}
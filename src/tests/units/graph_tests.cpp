@@ -1,6 +1,11 @@
 #include "catch.hpp"
 #include "graph/expression_graph.h"
 #include "graph/expression_operators.h"
+#include "graph/auto_tuner.h"
+#include "common/file_stream.h"
+#include "common/hash.h"
+#include "data/shortlist.h"
+#include "layers/lsh.h"
 
 #ifdef CUDA_FOUND
 #include "tensors/gpu/backend.h"
@@ -121,3 +126,265 @@ TEST_CASE("Expression graph can be initialized with constant values (cpu)",
     REQUIRE(values == v);
   }
 }
+
+TEST_CASE("Shortlist bitsets and reuse of gathered output matrices (cpu)", "[graph]") {
+  SECTION("bitset union is sorted and padded") {
+    data::ShortlistBitset bitset(200);
+    std::vector<WordIndex> list1 = {130, 5, 64};
+    std::vector<WordIndex> list2 = {64, 199, 0};
+    bitset.set(list1.begin(), list1.end());
+    bitset.set(list2.begin(), list2.end());
+
+    CHECK(bitset.count() == 5);
+    CHECK(bitset.test(199));
+    CHECK(!bitset.test(63));
+    CHECK(bitset.toIndices() == std::vector<WordIndex>({0, 5, 64, 130, 199}));
+
+    bitset.padToMultiple(8, 10);
+    CHECK(bitset.toIndices() == std::vector<WordIndex>({0, 5, 10, 11, 12, 64, 130, 199}));
+  }
+
+  SECTION("ranges and unions are set word by word") {
+    data::ShortlistBitset bitset(200);
+    bitset.set(70);
+    bitset.setRange(60, 130);
+    CHECK(bitset.count() == 70);
+    CHECK(!bitset.test(59));
+    CHECK(bitset.test(60));
+    CHECK(bitset.test(127));
+    CHECK(bitset.test(129));
+    CHECK(!bitset.test(130));
+
+    bitset.setRange(190, 1000); // clipped to the vocabulary
+    CHECK(bitset.count() == 80);
+
+    data::ShortlistBitset other(150);
+    std::vector<WordIndex> list = {3, 64, 149};
+    other.set(list.begin(), list.end());
+    bitset |= other;
+    CHECK(bitset.count() == 82);
+    CHECK(bitset.test(3));
+    CHECK(bitset.test(149));
+  }
+
+  SECTION("identical shortlists share memoized tensors") {
+    auto graph = New<ExpressionGraph>(/*inference=*/true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(4);
+
+    std::vector<float> vW(16 * 4);
+    for(size_t i = 0; i < vW.size(); ++i)
+      vW[i] = (float)i;
+
+    auto W = graph->param("Wt", {16, 4}, inits::fromVector(vW));
+    auto input = graph->constant({1, 4}, inits::ones());
+
+    auto shortlist1 = New<data::Shortlist>(std::vector<WordIndex>({1, 3, 5, 7, 9, 11, 13, 15}));
+    shortlist1->filter(input, W, false, nullptr, nullptr);
+    graph->forward();
+
+    std::vector<float> values;
+    shortlist1->getCachedShortWt()->val()->get(values);
+    CHECK(values.size() == 8 * 4);
+    CHECK(values[4] == vW[3 * 4]);
+
+    graph->clear();
+    input = graph->constant({1, 4}, inits::ones());
+    auto shortlist2 = New<data::Shortlist>(std::vector<WordIndex>({1, 3, 5, 7, 9, 11, 13, 15}));
+    CHECK(shortlist1->getIndicesHash() == shortlist2->getIndicesHash());
+    shortlist2->filter(input, W, false, nullptr, nullptr);
+    CHECK(shortlist2->getCachedShortWt() == shortlist1->getCachedShortWt());
+
+    graph->clear();
+    shortlist2->forget();
+    input = graph->constant({1, 4}, inits::ones());
+    auto shortlist3 = New<data::Shortlist>(std::vector<WordIndex>({0, 2, 4, 6, 8, 10, 12, 14}));
+    shortlist3->filter(input, W, false, nullptr, nullptr);
+    graph->forward();
+
+    CHECK(shortlist3->getCachedShortWt() != shortlist1->getCachedShortWt());
+    shortlist3->getCachedShortWt()->val()->get(values);
+    CHECK(values[4] == vW[2 * 4]);
+  }
+}
+
+TEST_CASE("LSH index search (cpu)", "[graph]") {
+  int rows = 300, bytes = 16, k = 10;
+
+  std::mt19937 rng(1234);
+  std::vector<uint8_t> codes(rows * bytes), query(bytes);
+  for(auto& c : codes)
+    c = (uint8_t)rng();
+  for(auto& c : query)
+    c = (uint8_t)rng();
+
+  auto distance = [&](uint32_t row) {
+    int dist = 0;
+    for(int i = 0; i < bytes; ++i)
+      for(uint8_t x = codes[row * bytes + i] ^ query[i]; x; x &= x - 1)
+        dist++;
+    return dist;
+  };
+
+  // k-th smallest distance by brute force
+  std::vector<int> distances;
+  for(int r = 0; r < rows; ++r)
+    distances.push_back(distance(r));
+  std::vector<int> sorted = distances;
+  std::sort(sorted.begin(), sorted.end());
+  int kthDistance = sorted[k - 1];
+
+  auto index = lsh::Index::get(codes.data(), rows, bytes);
+  CHECK(index == lsh::Index::get(codes.data(), rows, bytes)); // shared
+
+  SECTION("exhaustive search returns the k nearest rows sorted by index") {
+    std::vector<uint32_t> ids(k);
+    index->search(query.data(), k, /*probes=*/0, /*firstNRows=*/0, ids.data());
+    CHECK(std::is_sorted(ids.begin(), ids.end()));
+    for(auto id : ids)
+      CHECK(distances[id] <= kthDistance);
+  }
+
+  SECTION("probing all buckets equals exhaustive search") {
+    std::vector<uint32_t> ids(k);
+    index->search(query.data(), k, /*probes=*/1 << index->bucketBits(), /*firstNRows=*/0, ids.data());
+    for(auto id : ids)
+      CHECK(distances[id] <= kthDistance);
+  }
+
+  SECTION("multi-probe search only returns valid rows") {
+    std::vector<uint32_t> ids(k);
+    index->search(query.data(), k, /*probes=*/2, /*firstNRows=*/rows / 2, ids.data());
+    for(auto id : ids)
+      CHECK(id < (uint32_t)rows / 2);
+  }
+
+  SECTION("indices are only shared for identical codes and released when unused") {
+    std::vector<uint8_t> changed = codes;
+    changed[(rows / 2) * bytes] ^= 1; // neither first nor last row
+    auto other = lsh::Index::get(changed.data(), rows, bytes);
+    CHECK(other != index);
+
+    std::weak_ptr<const lsh::Index> released = index;
+    index.reset();
+    CHECK(released.expired());
+    CHECK(lsh::Index::get(codes.data(), rows, bytes)->rows() == rows);
+  }
+}
+
+TEST_CASE("Tuning decisions of --gemm-type auto (cpu)", "[graph]") {
+  auto readDecisions = [](const std::string& file) {
+    std::vector<std::pair<size_t, size_t>> decisions;
+    std::ifstream in(file);
+    size_t operation, algorithm;
+    while(in >> operation >> algorithm)
+      decisions.push_back({operation, algorithm});
+    return decisions;
+  };
+
+  SECTION("decisions are saved to and reloaded from the tuning file") {
+    io::TemporaryFile temp("/tmp/", false);
+    std::string file = temp.getFileName();
+    std::ofstream(file) << "11 12" << std::endl;
+
+    size_t algorithm = 0;
+    {
+      AutoTunerDatabase database(file);
+      CHECK(database.find(11, algorithm));
+      CHECK(algorithm == 12);
+      CHECK_FALSE(database.find(13, algorithm));
+      database.add(13, 14);
+      database.add(11, 99); // decided already, neither changed nor saved
+      CHECK(database.find(11, algorithm));
+      CHECK(algorithm == 12);
+    }
+    CHECK(readDecisions(file) == std::vector<std::pair<size_t, size_t>>({{11, 12}, {13, 14}}));
+
+    AutoTunerDatabase reloaded(file);
+    CHECK(reloaded.find(11, algorithm));
+    CHECK(algorithm == 12);
+    CHECK(reloaded.find(13, algorithm));
+    CHECK(algorithm == 14);
+  }
+
+  SECTION("a recorded decision is used without exploring") {
+    auto database = AutoTunerDatabase::get("");
+    database->add(21, 2);
+
+    AutoTuner<int> tuner;
+    tuner.setDatabase(database);
+    tuner.clear(21);
+    tuner.insert({1, []() { return 1; }});
+    tuner.insert({2, []() { return 2; }});
+    CHECK(tuner.run() == 2);
+    CHECK(tuner.run() == 2);
+  }
+
+  SECTION("tuned products pick the recorded variant") {
+    int m = 4, k = 64, n = 16;
+    std::vector<float> vA(m * k), vW(k * n);
+    for(size_t i = 0; i < vA.size(); ++i)
+      vA[i] = (float)((i * 7) % 13) / 13.f - 0.5f;
+    for(size_t i = 0; i < vW.size(); ++i)
+      vW[i] = (float)((i * 5) % 11) / 11.f - 0.5f;
+
+    std::vector<float> expected(m * n, 0.f);
+    for(int i = 0; i < m; ++i)
+      for(int j = 0; j < n; ++j)
+        for(int l = 0; l < k; ++l)
+          expected[i * n + j] += vA[i * k + l] * vW[l * n + j];
+
+    auto tunedGraph = [](const std::string& file) {
+      auto graph = New<ExpressionGraph>(/*inference=*/true);
+      graph->setDevice({0, DeviceType::cpu});
+      graph->getBackend()->setGemmType("auto");
+      graph->getBackend()->setGemmTuningFile(file);
+      graph->reserveWorkspaceMB(4);
+      return graph;
+    };
+    auto product = [&](Ptr<ExpressionGraph> graph) {
+      graph->clear();
+      auto A = graph->constant({m, k}, inits::fromVector(vA));
+      auto W = graph->param("W", {k, n}, inits::fromVector(vW));
+      return dot(A, W);
+    };
+
+    // explore until the tuner has decided and saved the decision for this shape
+    io::TemporaryFile explored("/tmp/", false);
+    auto graph = tunedGraph(explored.getFileName());
+    for(int i = 0; i < 4 * 50 + 1 && readDecisions(explored.getFileName()).empty(); ++i) {
+      product(graph);
+      graph->forward();
+    }
+    auto decisions = readDecisions(explored.getFileName());
+    REQUIRE(decisions.size() == 1);
+    size_t operation = decisions[0].first;
+
+    // the variant hashes combine the operation hash with the variant id, see tunedAffineOrDot()
+    auto forced = [&](size_t variant) {
+      io::TemporaryFile temp("/tmp/", false);
+      size_t algorithm = operation;
+      util::hash_combine(algorithm, variant);
+      std::ofstream(temp.getFileName()) << operation << " " << algorithm << std::endl;
+
+      auto forcedGraph = tunedGraph(temp.getFileName());
+      auto y = product(forcedGraph);
+      forcedGraph->forward();
+      std::vector<float> values;
+      y->val()->get(values);
+      return std::make_pair(y->type(), values);
+    };
+
+    auto float32 = forced(1);
+    CHECK(float32.first == "dot");
+    for(size_t i = 0; i < expected.size(); ++i)
+      CHECK(float32.second[i] == Approx(expected[i]).epsilon(1e-4).margin(1e-5));
+
+#if COMPILE_CPU
+    auto intgemm8 = forced(4);
+    CHECK(intgemm8.first == "lambda");
+    for(size_t i = 0; i < expected.size(); ++i)
+      CHECK(intgemm8.second[i] == Approx(expected[i]).margin(0.1));
+#endif
+  }
+}
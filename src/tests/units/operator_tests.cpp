@@ -5,6 +5,9 @@
 #include "catch.hpp"
 #include "graph/expression_graph.h"
 #include "graph/expression_operators.h"
+#include "data/shortlist.h"
+#include "tensors/cpu/block_sparse.h"
+#include "tensors/cpu/intgemm_interface.h"
 
 #ifdef CUDA_FOUND
 #include "tensors/gpu/backend.h"
@@ -343,6 +346,88 @@ void tests(DeviceType device, Type floatType = Type::float32) {
   
   }
 
+  SECTION("fused residual and normalization") {
+    graph->clear();
+    values.clear();
+
+    std::vector<T> init = {
+      2.88794374, 4.67853451, 3.96257305, 3.28433037,
+      0.37778997, 0.67662024, 4.24959183, 1.23910618,
+      0.68929380, 2.00369596, 4.38251686, 1.75624943,
+      4.96126175, 3.01947117, 4.72057724, 2.23017120
+    };
+    std::vector<T> vMask = {
+      2, 0, 2, 2,
+      0, 2, 2, 0,
+      2, 2, 0, 2,
+      2, 0, 0, 2
+    };
+    std::vector<T> vRes = {
+      -0.5, 1.2, 0.3, -2.1,
+      0.8, -0.4, 1.7, 0.2,
+      -1.3, 0.6, -0.9, 1.1,
+      0.4, 2.3, -0.7, -1.6
+    };
+
+    auto mask = graph->constant({2, 2, 4}, inits::fromVector(vMask));
+
+    auto x1 = graph->param("x1", {2, 2, 4}, inits::fromVector(init));
+    auto x2 = graph->param("x2", {2, 2, 4}, inits::fromVector(init));
+    auto r1 = graph->param("r1", {2, 2, 4}, inits::fromVector(vRes));
+    auto r2 = graph->param("r2", {2, 2, 4}, inits::fromVector(vRes));
+    auto gamma1 = graph->param("gamma1", {1, 4}, inits::ones());
+    auto gamma2 = graph->param("gamma2", {1, 4}, inits::ones());
+    auto beta1 = graph->param("beta1", {1, 4}, inits::zeros());
+    auto beta2 = graph->param("beta2", {1, 4}, inits::zeros());
+
+    auto ln  = addLayerNorm(x1, r1, gamma1, beta1, mask, 1e-5f);
+    auto ln2 = layerNorm(x2 * mask + r2, gamma2, beta2, 1e-5f);
+
+    auto rms  = addRmsNorm(x1, r1, gamma1, nullptr, nullptr, 1e-5f);
+    auto rms2 = gamma2 * ((x2 + r2) / sqrt(mean((x2 + r2) * (x2 + r2), /*axis=*/-1) + 1e-5f));
+
+    auto top = sum(flatten(ln + ln2 + rms + rms2));
+
+    graph->forward();
+    graph->backward();
+
+    CHECK(ln->shape() == Shape({2, 2, 4}));
+
+    std::vector<T> values2;
+
+    // compare fused and unfused forward computation
+    ln->val()->get(values);
+    ln2->val()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+
+    rms->val()->get(values);
+    rms2->val()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+
+    // compare gradients of inputs, residuals and parameters
+    x1->grad()->get(values);
+    x2->grad()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+
+    r1->grad()->get(values);
+    r2->grad()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+
+    gamma1->grad()->get(values);
+    gamma2->grad()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+
+    beta1->grad()->get(values);
+    beta2->grad()->get(values2);
+    CHECK( std::equal(values.begin(), values.end(),
+                      values2.begin(), floatApprox) );
+  }
+
   SECTION("reductions") {
     graph->clear();
     values.clear();
@@ -1118,6 +1203,241 @@ TEST_CASE("Expression graph supports basic math operations (cpu)", "[operator]")
 }
 #endif
 
+#ifdef BLAS_FOUND
+TEST_CASE("Block-sparse affine matches dense affine (cpu)", "[operator]") {
+  auto floatApprox = [](float x, float y) -> bool { return x == Approx(y).margin(0.001f); };
+
+  Config::seed = 1234;
+  int K = 32, N = 16;
+  for(auto blockShape : std::vector<std::pair<int, int>>({{4, 4}, {1, 16}, {2, 1}, {16, 1}})) {
+    // parameters keep their shapes, so each block shape gets a graph of its own
+    auto graph = New<ExpressionGraph>();
+    graph->setInference(true);
+    graph->setDevice({0, DeviceType::cpu});
+    graph->reserveWorkspaceMB(16);
+    graph->getBackend()->setBlockSparseMaxDensity(0.75f);
+
+    int blockRows = blockShape.first, blockCols = blockShape.second;
+
+    // prune every second block in a checkerboard pattern
+    std::vector<float> vW(K * N);
+    for(int r = 0; r < K; ++r)
+      for(int c = 0; c < N; ++c)
+        vW[r * N + c] = ((r / blockRows + c / blockCols) % 2 == 0) ? 0.1f * (r - c) : 0.f;
+
+    std::vector<float> vX(3 * K), vB(N);
+    for(size_t i = 0; i < vX.size(); ++i) vX[i] = 0.01f * i - 0.1f;
+    for(size_t i = 0; i < vB.size(); ++i) vB[i] = 0.5f - 0.05f * i;
+
+    std::vector<float> values;
+    std::vector<IndexType> indices, offsets;
+    cpu::blocksparse::toBlockSparse(vW.data(), K, N, blockRows, blockCols, values, indices, offsets);
+    float density = cpu::blocksparse::blockDensity(vW.data(), K, N, blockRows, blockCols);
+    CHECK(density <= 0.5f);
+    CHECK(offsets.size() == K / blockRows + 1);
+
+    int numBlocks = (int)indices.size();
+    auto x  = graph->param("x", {3, K}, inits::fromVector(vX));
+    auto b  = graph->param("b", {1, N}, inits::fromVector(vB));
+    auto W  = graph->param("W", {K, N}, inits::fromVector(vW));
+    auto Wd = graph->param("Wd", {K, N}, inits::fromVector(vW)); // same matrix, no block-sparse representation
+    graph->param("W" + cpu::blocksparse::valuesSuffix, {numBlocks, blockRows * blockCols}, inits::fromVector(values));
+    graph->param("W" + cpu::blocksparse::indicesSuffix, {numBlocks}, inits::fromVector(indices), Type::uint32);
+    graph->param("W" + cpu::blocksparse::offsetsSuffix, {(int)offsets.size()}, inits::fromVector(offsets), Type::uint32);
+    graph->param("W" + cpu::blocksparse::densitySuffix, {1}, inits::fromValue(density));
+
+    // a matrix above the density limit is multiplied densely, its dense copy is zero to tell the kernels apart
+    auto Wz = graph->param("Wz", {K, N}, inits::zeros());
+    graph->param("Wz" + cpu::blocksparse::valuesSuffix, {numBlocks, blockRows * blockCols}, inits::fromVector(values));
+    graph->param("Wz" + cpu::blocksparse::indicesSuffix, {numBlocks}, inits::fromVector(indices), Type::uint32);
+    graph->param("Wz" + cpu::blocksparse::offsetsSuffix, {(int)offsets.size()}, inits::fromVector(offsets), Type::uint32);
+    graph->param("Wz" + cpu::blocksparse::densitySuffix, {1}, inits::fromValue(0.8f));
+
+    auto sparse = affine(x, W, b, false, false, 2.f);
+    auto dense  = affine(x, Wd, b, false, false, 2.f);
+    auto sparseDot = dot(x, W);
+    auto denseDot  = dot(x, Wd);
+    auto tooDense  = dot(x, Wz);
+
+    CHECK(sparse->type() == "lambda");
+    CHECK(dense->type() != "lambda");
+
+    graph->forward();
+
+    std::vector<float> vSparse, vDense;
+    sparse->val()->get(vSparse);
+    dense->val()->get(vDense);
+    CHECK(std::equal(vSparse.begin(), vSparse.end(), vDense.begin(), floatApprox));
+
+    sparseDot->val()->get(vSparse);
+    denseDot->val()->get(vDense);
+    CHECK(std::equal(vSparse.begin(), vSparse.end(), vDense.begin(), floatApprox));
+
+    tooDense->val()->get(vDense);
+    CHECK(std::all_of(vDense.begin(), vDense.end(), [](float v) { return v == 0.f; }));
+
+    // the block-sparse copies are not used at all with a limit of 0
+    graph->getBackend()->setBlockSparseMaxDensity(0.f);
+    CHECK(affine(x, W, b)->type() != "lambda");
+  }
+}
+#endif
+
+#if defined(BLAS_FOUND) && COMPILE_CPU
+// maximum absolute difference relative to the largest absolute reference value
+static float relativeError(const std::vector<float>& ref, const std::vector<float>& test) {
+  float maxRef = 0.f, maxDiff = 0.f;
+  for(size_t i = 0; i < ref.size(); ++i) {
+    maxRef  = std::max(maxRef, std::abs(ref[i]));
+    maxDiff = std::max(maxDiff, std::abs(ref[i] - test[i]));
+  }
+  return maxDiff / maxRef;
+}
+
+TEST_CASE("Intgemm batched products match float32 within quantization tolerance (cpu)", "[operator]") {
+  Config::seed = 1234;
+  auto graph = New<ExpressionGraph>();
+  graph->setInference(true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(16);
+
+  std::vector<float> values, values2;
+
+  for(auto batchedGemmType : {"intgemm8", "intgemm16"}) {
+    graph->clear();
+
+    // inner dimension and columns are deliberately not multiples of the intgemm tile sizes
+    auto A  = graph->param("A",  {2, 3, 5, 70}, inits::normal());
+    auto B  = graph->param("B",  {2, 1, 70, 13}, inits::normal());
+    auto Bt = graph->param("Bt", {2, 3, 13, 70}, inits::normal());
+
+    graph->getBackend()->setBatchedGemmType("float32");
+    auto C   = bdot(A, B,  /*transA=*/false, /*transB=*/false);
+    auto Ct  = bdot(A, Bt, /*transA=*/false, /*transB=*/true, /*scale=*/0.125f);
+
+    graph->getBackend()->setBatchedGemmType(batchedGemmType);
+    auto Cq  = bdot(A, B,  /*transA=*/false, /*transB=*/false);
+    auto Ctq = bdot(A, Bt, /*transA=*/false, /*transB=*/true, /*scale=*/0.125f);
+    graph->getBackend()->setBatchedGemmType("float32");
+
+    graph->forward();
+
+    float tolerance = std::string(batchedGemmType) == "intgemm8" ? 0.05f : 0.01f;
+
+    CHECK(Cq->shape() == C->shape());
+    C->val()->get(values);
+    Cq->val()->get(values2);
+    CHECK(relativeError(values, values2) < tolerance);
+
+    CHECK(Ctq->shape() == Ct->shape());
+    Ct->val()->get(values);
+    Ctq->val()->get(values2);
+    CHECK(relativeError(values, values2) < tolerance);
+  }
+}
+
+TEST_CASE("Intgemm shortlisted output layer matches float32 within quantization tolerance (cpu)", "[operator]") {
+  Config::seed = 1234;
+  auto graph = New<ExpressionGraph>();
+  graph->setInference(true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(16);
+
+  // shortlist of 16 out of 96 words, embedding size 128
+  std::vector<IndexType> shortlist;
+  for(IndexType i = 0; i < 16; ++i)
+    shortlist.push_back(i * 6 + i % 3);
+
+  std::vector<float> values, values2;
+
+  for(auto gemmType : {Type::intgemm8, Type::intgemm16}) {
+    graph->clear();
+
+    auto x  = graph->param("x",  {3, 1, 4, 128}, inits::normal());
+    auto Wt = graph->param("Wt", {96, 128}, inits::normal());
+    auto b  = graph->param("b",  {1, 96}, inits::normal());
+    auto indices = graph->constant({16}, inits::fromVector(shortlist), Type::uint32);
+
+    auto shortb = index_select(b, -1, indices);
+    auto y  = affine(x, index_select(Wt, 0, indices), shortb, /*transA=*/false, /*transB=*/true);
+
+    auto shortWt = cpu::integer::selectColumnsB(gemmType, Wt, /*transB=*/true, indices);
+    auto yq = affine(x, shortWt, shortb, /*transA=*/false, /*transB=*/false);
+
+    graph->forward();
+
+    CHECK(isIntgemm(shortWt->value_type()));
+    CHECK(shortWt->shape() == Shape({128, 16}));
+    CHECK(yq->shape() == y->shape());
+    y->val()->get(values);
+    yq->val()->get(values2);
+    CHECK(relativeError(values, values2) < (gemmType == Type::intgemm8 ? 0.05f : 0.01f));
+  }
+}
+
+TEST_CASE("Intgemm shortlists give the logits of float32 shortlists within quantization tolerance (cpu)", "[operator]") {
+  Config::seed = 1234;
+  auto graph = New<ExpressionGraph>();
+  graph->setInference(true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(16);
+
+  std::vector<WordIndex> indices;
+  for(WordIndex i = 0; i < 16; ++i)
+    indices.push_back(i * 6 + i % 3);
+
+  // the shortlisted output layer as in mlp::Output::applyAsLogits() with the given --shortlist-gemm-type
+  auto logits = [&](Expr x, Expr Wt, Expr b, const std::string& shortlistGemmType) {
+    graph->getBackend()->setShortlistGemmType(shortlistGemmType);
+    auto shortlist = New<data::Shortlist>(indices);
+    shortlist->filter(x, Wt, /*isLegacyUntransposedW=*/false, b, /*lemmaEt=*/nullptr);
+    graph->getBackend()->setShortlistGemmType("float32");
+
+    auto shortWt = shortlist->getCachedShortWt();
+    bool transB = !isIntgemm(shortWt->value_type());
+    return std::make_pair(shortWt, affine(x, shortWt, shortlist->getCachedShortb(), false, transB));
+  };
+
+  std::vector<float> values, values2;
+
+  for(auto gemmType : {"intgemm8", "intgemm16"}) {
+    graph->clear();
+
+    auto x  = graph->param("x",  {3, 1, 4, 128}, inits::normal());
+    auto Wt = graph->param("Wt", {96, 128}, inits::normal());
+    auto b  = graph->param("b",  {1, 96}, inits::normal());
+
+    auto y  = logits(x, Wt, b, "float32");
+    auto yq = logits(x, Wt, b, gemmType);
+    graph->forward();
+
+    CHECK(!isIntgemm(y.first->value_type()));
+    CHECK(isIntgemm(yq.first->value_type()));
+    CHECK(yq.second->shape() == y.second->shape());
+    CHECK(y.second->shape()[-1] == 16);
+    y.second->val()->get(values);
+    yq.second->val()->get(values2);
+    CHECK(relativeError(values, values2) < (std::string(gemmType) == "intgemm8" ? 0.05f : 0.01f));
+  }
+
+  SECTION("embedding sizes intgemm cannot handle stay float32") {
+    graph->clear();
+    auto x  = graph->param("x100",  {3, 1, 4, 100}, inits::normal());
+    auto Wt = graph->param("Wt100", {96, 100}, inits::normal());
+    auto b  = graph->param("b100",  {1, 96}, inits::normal());
+
+    auto y  = logits(x, Wt, b, "float32");
+    auto yq = logits(x, Wt, b, "intgemm8");
+    graph->forward();
+
+    CHECK(!isIntgemm(yq.first->value_type()));
+    y.second->val()->get(values);
+    yq.second->val()->get(values2);
+    CHECK(values == values2);
+  }
+}
+#endif
+
 #ifdef BLAS_FOUND
 #ifdef CUDA_FOUND
 
@@ -0,0 +1,88 @@
+#include "catch.hpp"
+#include "microsoft/decode_queue.h"
+
+#include <stdexcept>
+
+using namespace marian::quicksand;
+
+// sentences of the given lengths, each filled with its arrival number to identify it in a batch
+static void pushAll(DecodeQueue& queue, const std::vector<size_t>& lengths) {
+  for(size_t i = 0; i < lengths.size(); ++i)
+    queue.push(WordIndices(lengths[i], (WordIndex)i), [](QSNBest, std::exception_ptr) {});
+}
+
+static std::vector<WordIndex> arrivals(const std::vector<DecodeQueue::Request>& batch) {
+  std::vector<WordIndex> ids;
+  for(const auto& request : batch)
+    ids.push_back(request.sentence[0]);
+  return ids;
+}
+
+TEST_CASE("Decode engine batches", "[quicksand]") {
+  SECTION("the sentence waiting longest and those closest in length") {
+    DecodeQueue queue(/*miniBatch=*/3, /*miniBatchWords=*/0);
+    pushAll(queue, {5, 1, 6, 4, 9, 5});
+
+    // equal length first, then the shorter sentence on a tie
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({0, 5, 3}));
+    CHECK(queue.size() == 3);
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({1, 2, 4}));
+    CHECK(queue.empty());
+  }
+
+  SECTION("mini-batch-words limits the padded size of a batch") {
+    DecodeQueue queue(/*miniBatch=*/10, /*miniBatchWords=*/12);
+    pushAll(queue, {4, 4, 5, 3, 8, 20});
+
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({0, 1, 3})); // 3 * 4 words
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({2}));       // 2 * 8 words would not fit
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({4}));
+    CHECK(arrivals(queue.nextBatch()) == std::vector<WordIndex>({5}));       // too long on its own
+    CHECK(queue.empty());
+  }
+
+  SECTION("n-best lists reach the futures of their sentences") {
+    DecodeQueue queue(/*miniBatch=*/4, /*miniBatchWords=*/0);
+    std::vector<std::future<QSNBest>> futures;
+    for(size_t length : {3, 2, 3})
+      futures.push_back(queue.push(WordIndices(length, (WordIndex)futures.size())));
+
+    auto batch = queue.nextBatch();
+    REQUIRE(batch.size() == 3);
+    DecodeQueue::decode(batch, [](const QSBatch& qsBatch, size_t maxLength) {
+      CHECK(maxLength == 3);
+      QSNBestBatch nbests;
+      for(const auto& sentence : qsBatch) // echoes the source
+        nbests.push_back(QSNBest({QSSentenceWithProb(sentence, AlignmentSets(), -1.f)}));
+      return nbests;
+    });
+    for(size_t i = 0; i < futures.size(); ++i) {
+      auto nbest = futures[i].get();
+      REQUIRE(nbest.size() == 1);
+      CHECK(std::get<0>(nbest[0]) == WordIndices(i == 1 ? 2 : 3, (WordIndex)i));
+    }
+  }
+
+  SECTION("a failing batch reaches all its futures and callbacks") {
+    DecodeQueue queue(/*miniBatch=*/4, /*miniBatchWords=*/0);
+    std::vector<std::future<QSNBest>> futures;
+    futures.push_back(queue.push(WordIndices(3, 0)));
+    futures.push_back(queue.push(WordIndices(2, 1)));
+    std::exception_ptr received;
+    bool empty = false;
+    queue.push(WordIndices(4, 2), [&](QSNBest nbest, std::exception_ptr error) {
+      received = error;
+      empty = nbest.empty();
+    });
+
+    auto batch = queue.nextBatch();
+    REQUIRE(batch.size() == 3);
+    DecodeQueue::decode(batch, [](const QSBatch&, size_t) -> QSNBestBatch {
+      throw std::runtime_error("decoding failed");
+    });
+    for(auto& future : futures)
+      CHECK_THROWS_AS(future.get(), std::runtime_error);
+    CHECK(received);
+    CHECK(empty);
+  }
+}
@@ -325,6 +325,115 @@ void tests(DeviceType type, Type floatType = Type::float32) {
     //CHECK( std::equal(values.begin(), values.end(),
     //                  vContextSum3.begin(), floatApprox) );
   }
+
+  SECTION("Sequence-level cell kernels match the unrolled cells") {
+    int dimTime = 8, dimBatch = 4, dimEmb = 16, dimState = 24;
+
+    for(std::string cellType : {"gru", "gru-nematus", "lstm"}) {
+      for(bool reverse : {false, true}) {
+        Config::seed = 1234;
+
+        auto graph = New<ExpressionGraph>();
+        graph->setDefaultElementType(floatType);
+        graph->setDevice({0, type});
+        graph->reserveWorkspaceMB(16);
+
+        // outputs and gradients of the embeddings and the recurrent matrix, parameters are shared by both runs
+        auto run = [&](bool sequence, std::vector<T>& output, std::vector<T>& gradEmb, std::vector<T>& gradU) {
+          graph->clear();
+          auto cell = rnn::cell()                //
+              ("type", cellType)                 //
+              ("prefix", "seq")                  //
+              ("dimInput", dimEmb)               //
+              ("dimState", dimState)             //
+              .construct(graph);
+          auto emb   = graph->param("Embeddings", {128, dimEmb}, inits::glorotUniform());
+          auto input = reshape(rows(emb, vWords), {dimTime, dimBatch, dimEmb});
+          auto mask  = graph->constant({dimTime, dimBatch, 1}, inits::fromVector(vMask));
+          auto start = graph->zeros({1, dimBatch, dimState});
+
+          auto xWs = cell->applyInput({input});
+          Expr outputs = sequence ? cell->applySequence(xWs, rnn::State({start, start}), mask, reverse) : nullptr;
+          if(!sequence) {
+            rnn::State state({start, start});
+            std::vector<Expr> steps(dimTime);
+            for(int i = 0; i < dimTime; ++i) {
+              int j = reverse ? dimTime - i - 1 : i;
+              state = cell->applyState({slice(xWs[0], -3, j)}, state, slice(mask, -3, j));
+              steps[j] = state.output;
+            }
+            outputs = concatenate(steps, /*axis =*/ -3);
+          }
+          REQUIRE(outputs);
+          CHECK(outputs->shape() == Shape({dimTime, dimBatch, dimState}));
+
+          sum(flatten(outputs * outputs)); // the cost is the only top node
+          graph->forward();
+          graph->backward();
+
+          outputs->val()->get(output);
+          emb->grad()->get(gradEmb);
+          graph->get("seq_U")->grad()->get(gradU);
+        };
+
+        std::vector<T> output, gradEmb, gradU, seqOutput, seqGradEmb, seqGradU;
+        run(/*sequence=*/false, output, gradEmb, gradU);
+        run(/*sequence=*/true, seqOutput, seqGradEmb, seqGradU);
+
+        CHECK( std::equal(output.begin(), output.end(), seqOutput.begin(), floatApprox) );
+        CHECK( std::equal(gradEmb.begin(), gradEmb.end(), seqGradEmb.begin(), floatApprox) );
+        CHECK( std::equal(gradU.begin(), gradU.end(), seqGradU.begin(), floatApprox) );
+      }
+    }
+  }
+
+  SECTION("SSRU inference steps match the training graph") {
+    int dimTime = 8, dimBatch = 4, dimEmb = 16;
+
+    // the cell of an inference graph on the CPU uses the fused step kernel
+    auto run = [&](bool inference, std::vector<T>& output, std::vector<T>& cells) {
+      Config::seed = 1234;
+      auto graph = New<ExpressionGraph>(inference);
+      graph->setDefaultElementType(floatType);
+      graph->setDevice({0, type});
+      graph->reserveWorkspaceMB(16);
+
+      auto cell = rnn::cell()                  //
+          ("type", "ssru")                     //
+          ("prefix", "ssru")                   //
+          ("dimInput", dimEmb)                 //
+          ("dimState", dimEmb)                 //
+          .construct(graph);
+
+      auto emb   = graph->param("Embeddings", {128, dimEmb}, inits::glorotUniform());
+      auto input = reshape(rows(emb, vWords), {dimTime, dimBatch, dimEmb});
+      auto mask  = graph->constant({dimTime, dimBatch, 1}, inits::fromVector(vMask));
+      auto start = graph->zeros({1, dimBatch, dimEmb});
+
+      auto xWs = cell->applyInput({input});
+      rnn::State state({start, start});
+      std::vector<Expr> steps, stepCells;
+      for(int j = 0; j < dimTime; ++j) {
+        state = cell->applyState({slice(xWs[0], -3, j), slice(xWs[1], -3, j)}, state, slice(mask, -3, j));
+        steps.push_back(state.output);
+        stepCells.push_back(state.cell);
+      }
+      auto outputs = concatenate(steps, /*axis =*/ -3);
+      auto allCells = concatenate(stepCells, /*axis =*/ -3);
+      graph->forward();
+
+      outputs->val()->get(output);
+      allCells->val()->get(cells);
+    };
+
+    std::vector<T> output, cells, fusedOutput, fusedCells;
+    run(/*inference=*/false, output, cells);
+    run(/*inference=*/true, fusedOutput, fusedCells);
+
+    CHECK(output.size() == (size_t)dimTime * dimBatch * dimEmb);
+    CHECK( std::equal(output.begin(), output.end(), fusedOutput.begin(), floatApprox) );
+    CHECK( std::equal(cells.begin(), cells.end(), fusedCells.begin(), floatApprox) );
+  }
 }
 
 #ifdef CUDA_FOUND
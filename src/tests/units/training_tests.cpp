@@ -0,0 +1,72 @@
+#include "catch.hpp"
+#include "marian.h"
+#include "training/scheduler.h"
+#include "training/validator.h"
+
+using namespace marian;
+
+namespace {
+
+// Validates the single parameter "w" of the first graph, lower is better
+class ParameterValidator : public ValidatorBase {
+public:
+  std::vector<float> values; // in the order of validation
+
+  ParameterValidator() : ValidatorBase(/*lowerIsBetter=*/true) {}
+
+  float validate(const std::vector<Ptr<ExpressionGraph>>& graphs, Ptr<const TrainingState> /*state*/) override {
+    std::vector<float> w;
+    graphs[0]->get("w")->val()->get(w);
+    values.push_back(w[0]);
+    if(w[0] < lastBest_) {
+      lastBest_ = w[0];
+      stalled_ = 0;
+    } else {
+      stalled_++;
+    }
+    return w[0];
+  }
+
+  std::string type() override { return "parameter"; }
+};
+
+}  // namespace
+
+TEST_CASE("Asynchronous validation runs on parameter snapshots (cpu)", "[training]") {
+  auto options = New<Options>("valid-async", (size_t)1,
+                              "valid-async-cpu-threads", (size_t)1,
+                              "valid-freq", std::string("1u"),
+                              "workspace", (size_t)4,
+                              "early-stopping-on", std::string("first"),
+                              "learn-rate", 0.1f,
+                              "lr-warmup", std::string("0"),
+                              "lr-warmup-start-rate", 0.f,
+                              "lr-decay-inv-sqrt", std::vector<std::string>({"0"}));
+
+  auto graph = New<ExpressionGraph>();
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+  auto w = graph->param("w", {1, 1}, inits::fromValue(1.f));
+  graph->forward();
+
+  auto state = New<TrainingState>(0.1f);
+  Scheduler scheduler(options, state);
+  auto validator = New<ParameterValidator>();
+  scheduler.addValidator(validator);
+
+  // the first validation sees the parameters at the time it was started
+  state->batches = 1;
+  scheduler.validate({graph});
+  w->val()->set(std::vector<float>({5.f}));
+
+  // the final validation waits for all results and folds them into the training state in order
+  state->validated = false;
+  state->rememberPreviousProgress();
+  state->batches = 2;
+  scheduler.validate({graph}, /*isFinal=*/true);
+
+  CHECK(validator->values == std::vector<float>({1.f, 5.f}));
+  CHECK(state->validators["parameter"]["last-best"].as<float>() == 1.f);
+  CHECK(state->validators["parameter"]["stalled"].as<size_t>() == 1);
+  CHECK(scheduler.stalled() == 1);
+}
@@ -0,0 +1,787 @@
+#include "catch.hpp"
+#include "marian.h"
+#include "common/config_parser.h"
+#include "data/segmenter.h"
+#include "models/model_factory.h"
+#include "models/states.h"
+#include "translator/beam_search.h"
+#include "translator/decode_scheduler.h"
+#include "translator/decoding_stats.h"
+#include "translator/greedy_search.h"
+#include "translator/hypothesis_pool.h"
+#include "translator/output_collector.h"
+#include "translator/prefix_session.h"
+#include "translator/speculative_search.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+using namespace marian;
+
+TEST_CASE("Prefix sessions", "[translator]") {
+  auto w = [](WordIndex i) { return Word::fromWordIndex(i); };
+
+  SECTION("saved states continue the same line with a longer prefix") {
+    PrefixSession session;
+    session.source = "a b c";
+    session.consumed = {w(5)};
+    session.steps = 2;
+
+    CHECK(session.continues("a b c", {w(5), w(6)}));
+    CHECK(session.continues("a b c", {w(5), w(6), w(7)}));
+    CHECK(!session.continues("a b c", {w(5)}));        // fewer words than decoder steps
+    CHECK(!session.continues("a b c", {w(4), w(6)}));  // different confirmed word
+    CHECK(!session.continues("a b", {w(5), w(6)}));    // different source
+
+    PrefixSession encoderOnly;
+    encoderOnly.source = "a b c";
+    CHECK(encoderOnly.continues("a b c", {}));
+    CHECK(encoderOnly.continues("a b c", {w(1)}));
+  }
+
+  SECTION("the least recently used session is evicted") {
+    PrefixSessionCache cache(2);
+    auto a = New<PrefixSession>();
+    auto b = New<PrefixSession>();
+    auto c = New<PrefixSession>();
+
+    CHECK(!cache.get("a"));
+    cache.put("a", a);
+    cache.put("b", b);
+    CHECK(cache.get("a") == a); // a is now more recent than b
+    cache.put("c", c);
+
+    CHECK(!cache.get("b"));
+    CHECK(cache.get("a") == a);
+    CHECK(cache.get("c") == c);
+
+    // storing a session again replaces the old one without evicting others
+    auto a2 = New<PrefixSession>();
+    cache.put("a", a2);
+    CHECK(cache.get("a") == a2);
+    CHECK(cache.get("c") == c);
+  }
+}
+
+TEST_CASE("Decoder state snapshots are restored (cpu)", "[translator]") {
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+
+  std::vector<float> vContext = {1, 2, 3, 4, 5, 6};
+  std::vector<float> vMask    = {1, 0};
+  std::vector<float> vOutput  = {-1, -2, -3, -4};
+
+  auto context = graph->constant({1, 2, 1, 3}, inits::fromVector(vContext));
+  auto mask    = graph->constant({1, 2, 1, 1}, inits::fromVector(vMask));
+  auto output  = graph->constant({1, 1, 1, 4}, inits::fromVector(vOutput));
+
+  rnn::States states;
+  states.push_back({output, nullptr});
+  auto state = New<DecoderState>(states, Logits(), std::vector<Ptr<EncoderState>>({New<EncoderState>(context, mask, nullptr)}), nullptr);
+  state->setPosition(3);
+  graph->forward();
+
+  auto snapshot = state->snapshot();
+  graph->clear();
+
+  auto restored = snapshot->restore(graph, nullptr);
+  graph->forward();
+
+  CHECK(restored->getPosition() == 3);
+  REQUIRE(restored->getEncoderStates().size() == 1);
+  REQUIRE(restored->getStates().size() == 1);
+  CHECK(!restored->getStates()[0].cell);
+
+  std::vector<float> values;
+  restored->getEncoderStates()[0]->getContext()->val()->get(values);
+  CHECK(values == vContext);
+  CHECK(restored->getEncoderStates()[0]->getContext()->shape() == context->shape());
+  restored->getEncoderStates()[0]->getMask()->val()->get(values);
+  CHECK(values == vMask);
+  restored->getStates()[0].output->val()->get(values);
+  CHECK(values == vOutput);
+}
+
+TEST_CASE("Long inputs are split and joined again", "[translator]") {
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake(); // tokens are separated by spaces
+
+  std::vector<std::string> rules = {"[.!?]+[\"')\\]]*\\s+", "[;:]\\s+", ",\\s+", "\\s+"};
+  auto options = New<Options>("split-long-inputs", (size_t)4, "split-rules", rules);
+
+  auto check = [](const data::Segmenter::Segment& segment, size_t lineId, size_t index, size_t segments) {
+    CHECK(segment.lineId == lineId);
+    CHECK(segment.index == index);
+    CHECK(segment.segments == segments);
+  };
+
+  SECTION("lines are cut by the rules in order, merged up to the limit and trimmed") {
+    data::Segmenter segmenter(options, vocab);
+    CHECK(segmenter.split("a b c d") == std::vector<std::string>({"a b c d"}));
+
+    // the first rule cuts after the full stop, the second after the semicolon, the last between words
+    auto segments = segmenter.split("a b c. d e f; g h i j k");
+    CHECK(segments == std::vector<std::string>({"a b c.", "d e f; g", "h i j k"}));
+
+    // without a matching rule a piece stays too long
+    data::Segmenter fullStops(options->with("split-rules", std::vector<std::string>({"[.!?]+\\s+"})), vocab);
+    CHECK(fullStops.split("a b c d e f") == std::vector<std::string>({"a b c d e f"}));
+    CHECK(fullStops.split("a b. c d e f") == std::vector<std::string>({"a b.", "c d e f"}));
+  }
+
+  SECTION("segments are mapped back to lines over gaps and split lines") {
+    data::Segmenter segmenter(options, vocab);
+    CHECK(segmenter.add(0, 1) == 0);
+    CHECK(segmenter.add(1, 3) == 1);
+    CHECK(segmenter.add(2, 1) == 4);
+    CHECK(segmenter.add(5, 1) == 5); // lines 3 and 4 were skipped
+    CHECK(segmenter.add(6, 2) == 6);
+    CHECK(segmenter.add(7, 1) == 8);
+
+    check(segmenter.locate(0), 0, 0, 1);
+    check(segmenter.locate(1), 1, 0, 3);
+    check(segmenter.locate(3), 1, 2, 3);
+    check(segmenter.locate(4), 2, 0, 1);
+    check(segmenter.locate(5), 5, 0, 1);
+    check(segmenter.locate(7), 6, 1, 2);
+    check(segmenter.locate(8), 7, 0, 1);
+  }
+
+  SECTION("translations of segments are joined in any order") {
+    data::Segmenter segmenter(options, vocab);
+    segmenter.add(0, 1);
+    segmenter.add(1, 3);
+    segmenter.add(2, 2);
+
+    size_t lineId;
+    std::string line;
+    CHECK(!segmenter.join(3, "z", lineId, line));
+    CHECK(!segmenter.join(1, "x", lineId, line));
+
+    REQUIRE(segmenter.join(0, "w", lineId, line));
+    CHECK(lineId == 0);
+    CHECK(line == "w");
+
+    REQUIRE(segmenter.join(2, "y", lineId, line));
+    CHECK(lineId == 1);
+    CHECK(line == "x y z");
+
+    // empty translations do not add spaces
+    CHECK(!segmenter.join(5, "", lineId, line));
+    REQUIRE(segmenter.join(4, "v", lineId, line));
+    CHECK(lineId == 2);
+    CHECK(line == "v");
+  }
+}
+
+TEST_CASE("N-best hypotheses of a source share its encoder pass", "[translator]") {
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+
+  // one stream of sentences as word indices, shorter sentences are masked at the end
+  auto stream = [&](const std::vector<std::vector<WordIndex>>& sentences, size_t width) {
+    auto sb = New<data::SubBatch>(sentences.size(), width, vocab);
+    std::fill(sb->mask().begin(), sb->mask().end(), 0.f);
+    for(size_t b = 0; b < sentences.size(); ++b) {
+      for(size_t s = 0; s < sentences[b].size(); ++s) {
+        sb->data()[sb->locate(b, s)] = Word::fromWordIndex(sentences[b][s]);
+        sb->mask()[sb->locate(b, s)] = 1.f;
+      }
+    }
+    return sb;
+  };
+
+  // hypotheses 0, 1 and 3 translate the same source, the padding of hypothesis 2 does not matter
+  auto source = stream({{5, 6, 0}, {5, 6, 0}, {7, 0}, {5, 6, 0}}, 3);
+  auto target = stream({{8, 0}, {9, 0}, {8, 0}, {10, 11, 0}}, 3);
+  source->data()[source->locate(2, 2)] = Word::fromWordIndex(6);
+  auto batch = New<data::CorpusBatch>(std::vector<Ptr<data::SubBatch>>({source, target}));
+  batch->setSentenceIds({3, 3, 4, 3});
+
+  std::vector<IndexType> sourceIndices;
+  auto unique = batch->uniqueSources(sourceIndices);
+
+  CHECK(sourceIndices == std::vector<IndexType>({0, 0, 1, 0}));
+  REQUIRE(unique->size() == 2);
+  CHECK(unique->getSentenceIds() == std::vector<size_t>({3, 4}));
+
+  auto first = unique->front();
+  CHECK(first->data()[first->locate(0, 1)] == Word::fromWordIndex(6));
+  CHECK(first->data()[first->locate(1, 0)] == Word::fromWordIndex(7));
+  CHECK(first->mask()[first->locate(1, 2)] == 0.f);
+}
+
+TEST_CASE("Decode scheduler splits expensive batches and queues them first", "[translator]") {
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+  std::vector<Ptr<Vocab>> vocabs = {vocab, vocab};
+  auto options = New<Options>("beam-size", (size_t)4, "max-length-factor", 3.f, "maxi-batch", 4);
+
+  // one batch of long sentences and three batches of short ones
+  std::vector<Ptr<data::CorpusBatch>> window;
+  size_t id = 0;
+  for(size_t length : {5, 40, 5, 5}) {
+    size_t rows = length == 40 ? 8 : 2;
+    auto batch = data::CorpusBatch::fakeBatch({length, length}, vocabs, rows, nullptr);
+    std::vector<size_t> ids;
+    for(size_t i = 0; i < rows; ++i)
+      ids.push_back(id++);
+    batch->setSentenceIds(ids);
+    window.push_back(batch);
+  }
+
+  SECTION("a single worker decodes the window as it is") {
+    DecodeScheduler scheduler(options, 1);
+    CHECK(scheduler.schedule(window) == window);
+  }
+
+  SECTION("several workers get the expensive pieces first") {
+    DecodeScheduler scheduler(options, 4);
+    CHECK(scheduler.window() == 8);
+    CHECK(scheduler.cost(window[1]) > 4 * scheduler.cost(window[0]));
+
+    auto scheduled = scheduler.schedule(window);
+    REQUIRE(scheduled.size() > window.size());
+
+    // the long batch was split into pieces that still cost more than the short batches
+    CHECK(scheduled.front()->size() < window[1]->size());
+    CHECK(scheduled.front()->getSentenceIds().front() >= 2);
+    CHECK(scheduled.back() == window[3]);
+    for(size_t i = 1; i < scheduled.size(); ++i)
+      CHECK(scheduler.cost(scheduled[i - 1]) >= scheduler.cost(scheduled[i]));
+
+    // every sentence is decoded exactly once
+    std::vector<size_t> ids;
+    for(auto batch : scheduled)
+      ids.insert(ids.end(), batch->getSentenceIds().begin(), batch->getSentenceIds().end());
+    std::sort(ids.begin(), ids.end());
+    std::vector<size_t> expected(id);
+    std::iota(expected.begin(), expected.end(), 0);
+    CHECK(ids == expected);
+  }
+}
+
+// Search algorithms are compared on small transformers with random parameters. Scorers that share a name
+// share their parameters in the graph.
+static Ptr<Options> tinyTransformerOptions(int decDepth) {
+  auto options = New<Options>(ConfigParser(cli::mode::translation).getConfig());
+  options->set("type", "transformer",
+               "dim-vocabs", std::vector<int>({32, 32}),
+               "vocabs", std::vector<std::string>({"", ""}),
+               "dim-emb", 16,
+               "transformer-heads", 2,
+               "transformer-dim-ffn", 32,
+               "enc-depth", 1,
+               "dec-depth", decDepth,
+               "inference", true,
+               "max-length-factor", 2.f);
+  return options;
+}
+
+static Ptr<Scorer> tinyScorer(Ptr<Options> options, const std::string& name, float weight = 1.f) {
+  auto model = models::createModelFromOptions(options, models::usage::translation);
+  return New<ScorerWrapper>(model, name, weight, std::string());
+}
+
+static Ptr<ExpressionGraph> tinyGraph() {
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(32);
+  return graph;
+}
+
+// source sentences without the final EOS, which is added here
+static Ptr<data::CorpusBatch> sourceBatch(const std::vector<std::vector<WordIndex>>& sentences, Ptr<Vocab> vocab) {
+  size_t width = 0;
+  for(const auto& sentence : sentences)
+    width = std::max(width, sentence.size() + 1);
+
+  auto subBatch = New<data::SubBatch>(sentences.size(), width, vocab);
+  for(size_t i = 0; i < sentences.size(); ++i) {
+    for(size_t j = 0; j < width; ++j) {
+      auto index = subBatch->locate(i, j);
+      subBatch->data()[index] = j < sentences[i].size() ? Word::fromWordIndex(sentences[i][j]) : vocab->getEosId();
+      subBatch->mask()[index] = j <= sentences[i].size() ? 1.f : 0.f;
+    }
+  }
+
+  auto batch = New<data::CorpusBatch>(std::vector<Ptr<data::SubBatch>>({subBatch}));
+  std::vector<size_t> ids(sentences.size());
+  std::iota(ids.begin(), ids.end(), 0);
+  batch->setSentenceIds(ids);
+  return batch;
+}
+
+// the words of the n best translations of each sentence
+static std::vector<std::vector<Words>> translations(const Histories& histories, size_t n = 1) {
+  std::vector<std::vector<Words>> words;
+  for(auto history : histories) {
+    words.emplace_back();
+    for(const auto& result : history->nBest(n))
+      words.back().push_back(std::get<0>(result));
+  }
+  return words;
+}
+
+TEST_CASE("Greedy search gives the output of beam search with beam size 1", "[translator]") {
+  Config::seed = 1234;
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+  auto graph = tinyGraph();
+
+  auto options = tinyTransformerOptions(/*decDepth=*/2);
+  options->set("beam-size", 1);
+  REQUIRE(GreedySearch::supported(options, vocab));
+
+  // searchBeams() bypasses the greedy fast path of BeamSearch::search()
+  auto compare = [&](const std::vector<Ptr<Scorer>>& scorers, Ptr<data::CorpusBatch> batch) {
+    auto greedy = GreedySearch(options, scorers, vocab).search(graph, batch);
+    auto beam = BeamSearch(options, scorers, vocab).searchBeams(graph, batch, nullptr, "", nullptr);
+    REQUIRE(greedy.size() == beam.size());
+    for(size_t i = 0; i < greedy.size(); ++i) {
+      CHECK(greedy[i]->getLineNum() == beam[i]->getLineNum());
+      auto greedyTop = greedy[i]->top(), beamTop = beam[i]->top();
+      CHECK(std::get<0>(greedyTop) == std::get<0>(beamTop));
+      CHECK(std::get<1>(greedyTop)->getPathScore() == Approx(std::get<1>(beamTop)->getPathScore()).epsilon(1e-4));
+    }
+    return translations(greedy);
+  };
+
+  SECTION("a single model") {
+    compare({tinyScorer(options, "F0")}, sourceBatch({{5, 9, 3, 7, 11, 6}, {12, 4}, {8, 20, 31, 2}}, vocab));
+  }
+
+  SECTION("an ensemble") {
+    compare({tinyScorer(options, "F0", 0.7f), tinyScorer(tinyTransformerOptions(/*decDepth=*/1), "F1", 0.3f)},
+            sourceBatch({{5, 9, 3, 7, 11, 6}, {12, 4}, {8, 20, 31, 2}}, vocab));
+  }
+
+  SECTION("an empty input only gives EOS") {
+    auto words = compare({tinyScorer(options, "F0")}, sourceBatch({{5, 9, 3}, {}, {12, 4}}, vocab));
+    CHECK(words[1][0] == Words({vocab->getEosId()}));
+  }
+
+  SECTION("translations are cut at the maximum length") {
+    // the batch is 7 words wide, so the search stops after 4 target words at the latest
+    options->set("max-length-factor", 0.5f);
+    auto words = compare({tinyScorer(options, "F0")}, sourceBatch({{5, 9, 3, 7, 11, 6}, {12, 4}}, vocab));
+    for(const auto& sentence : words)
+      CHECK(sentence[0].size() <= 4);
+  }
+}
+
+TEST_CASE("Speculative decoding", "[translator]") {
+  Config::seed = 1234;
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+  auto graph = tinyGraph();
+  auto batch = sourceBatch({{5, 9, 3, 7, 11, 6}, {12, 4}, {8, 20, 31, 2}}, vocab);
+
+  auto options = tinyTransformerOptions(/*decDepth=*/2);
+  options->set("beam-size", 1, "speculative-k", 3);
+
+  SECTION("a different draft model gives the output of greedy decoding") {
+    auto main = tinyScorer(options, "F0");
+    auto draft = tinyScorer(tinyTransformerOptions(/*decDepth=*/1), "draft");
+    auto expected = translations(GreedySearch(options, {main}, vocab).search(graph, batch));
+    CHECK(translations(SpeculativeSearch(options, {main, draft}, vocab).search(graph, batch)) == expected);
+  }
+
+  SECTION("a draft model that always agrees gives the output of greedy decoding") {
+    // both scorers use the parameters named "draft", so all drafts are accepted
+    auto main = tinyScorer(options, "draft");
+    auto draft = tinyScorer(options, "draft");
+    auto expected = translations(GreedySearch(options, {main}, vocab).search(graph, batch));
+    CHECK(translations(SpeculativeSearch(options, {main, draft}, vocab).search(graph, batch)) == expected);
+  }
+
+  SECTION("with a beam the n-best lists are those of beam search") {
+    options->set("beam-size", 3);
+
+    auto main = tinyScorer(options, "F0");
+    auto draft = tinyScorer(tinyTransformerOptions(/*decDepth=*/1), "draft");
+    auto expected = translations(BeamSearch(options, {main}, vocab).search(graph, batch), 3);
+    CHECK(translations(SpeculativeSearch(options, {main, draft}, vocab).search(graph, batch), 3) == expected);
+
+    auto agreeingMain = tinyScorer(options, "draft");
+    auto agreeingDraft = tinyScorer(options, "draft");
+    expected = translations(BeamSearch(options, {agreeingMain}, vocab).search(graph, batch), 3);
+    CHECK(translations(SpeculativeSearch(options, {agreeingMain, agreeingDraft}, vocab).search(graph, batch), 3) == expected);
+  }
+}
+
+TEST_CASE("Parallel ensembles", "[translator]") {
+  Config::seed = 1234;
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+  auto batch = sourceBatch({{5, 9, 3, 7}, {12, 4, 30}}, vocab);
+
+  auto options = tinyTransformerOptions(/*decDepth=*/2);
+  options->set("beam-size", 3, "n-best", true);
+
+  // the sequential ensemble runs in the search graph, which initializes the parameters
+  auto graph = tinyGraph();
+  std::vector<Ptr<Scorer>> sequential = {tinyScorer(options, "F0", 0.7f), tinyScorer(options, "F1", 0.3f)};
+  auto expected = BeamSearch(options, sequential, vocab).search(graph, batch);
+
+  // the same members on graphs of their own
+  std::vector<Ptr<Scorer>> parallel = {tinyScorer(options, "F0", 0.7f), tinyScorer(options, "F1", 0.3f)};
+  for(auto scorer : parallel) {
+    scorer->setGraph(tinyGraph());
+    scorer->getGraph()->copyParams(graph);
+  }
+  auto searchGraph = tinyGraph();
+  BeamSearch parallelSearch(options, parallel, vocab);
+
+  auto bitwiseEqual = [](const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+  };
+
+  SECTION("the expanded path scores of a step are bitwise identical") {
+    const std::vector<IndexType> batchIndices = {0, 1};
+
+    Expr sequentialScores = graph->constant({1, 1, 1, 1}, inits::fromValue(0));
+    for(auto scorer : sequential) {
+      scorer->clear(graph);
+      auto state = scorer->step(graph, scorer->startState(graph, batch), {}, {}, batchIndices, 1);
+      sequentialScores = sequentialScores + scorer->getWeight() * state->getLogProbs().getLogits();
+    }
+    sequentialScores = swapAxes(sequentialScores, 0, 2);
+    graph->forward();
+
+    std::vector<Ptr<ScorerState>> states;
+    for(auto scorer : parallel) {
+      scorer->clear(scorer->getGraph());
+      states.push_back(scorer->startState(scorer->getGraph(), batch));
+    }
+    searchGraph->clear();
+    auto prevPathScores = searchGraph->constant({1, 1, 1, 1}, inits::fromValue(0));
+    auto parallelScores = parallelSearch.stepEnsembleInParallel(searchGraph, states, {}, {}, batchIndices, 1,
+                                                                prevPathScores, /*first=*/true);
+    searchGraph->forward();
+
+    REQUIRE(parallelScores->shape() == sequentialScores->shape());
+    std::vector<float> sequentialValues, parallelValues;
+    sequentialScores->val()->get(sequentialValues);
+    parallelScores->val()->get(parallelValues);
+    CHECK(bitwiseEqual(parallelValues, sequentialValues));
+  }
+
+  SECTION("the n-best lists are bitwise identical") {
+    auto histories = parallelSearch.search(searchGraph, batch);
+    REQUIRE(histories.size() == expected.size());
+    for(size_t i = 0; i < histories.size(); ++i) {
+      auto nBest = histories[i]->nBest(3);
+      auto expectedNBest = expected[i]->nBest(3);
+      REQUIRE(nBest.size() == expectedNBest.size());
+      for(size_t j = 0; j < nBest.size(); ++j) {
+        CHECK(std::get<0>(nBest[j]) == std::get<0>(expectedNBest[j]));
+        auto hyp = std::get<1>(nBest[j]), expectedHyp = std::get<1>(expectedNBest[j]);
+        CHECK(bitwiseEqual({hyp->getPathScore()}, {expectedHyp->getPathScore()}));
+        CHECK(bitwiseEqual(std::vector<float>(hyp->getScoreBreakdown().begin(), hyp->getScoreBreakdown().end()),
+                           std::vector<float>(expectedHyp->getScoreBreakdown().begin(), expectedHyp->getScoreBreakdown().end())));
+      }
+    }
+  }
+}
+
+TEST_CASE("Hypothesis pools", "[translator]") {
+  auto eos = Word::fromWordIndex(0);
+  auto w = [](WordIndex i) { return Word::fromWordIndex(i); };
+
+  IPtr<HypothesisPool> pool; // a reference of the test, to see when the pool would be freed
+  Histories histories;
+  {
+    HypothesisPool::Scope scope;
+    pool = HypothesisPool::current();
+    REQUIRE(pool);
+
+    {
+      HypothesisPool::Scope inner; // e.g. GreedySearch called by BeamSearch
+      CHECK(HypothesisPool::current() != pool.get());
+    }
+    CHECK(HypothesisPool::current() == pool.get());
+
+    auto history = New<History>(0, 0.f, 0.f);
+    auto hyp = Hypothesis::New();
+    history->add(Beam(1, hyp), eos);
+    for(WordIndex i = 1; i <= 3; ++i) {
+      hyp = Hypothesis::New(hyp, i < 3 ? w(i + 4) : eos, 0, hyp->getPathScore() - 1.f);
+      hyp->setScoreBreakdown(std::vector<float>(2, hyp->getPathScore()));
+      history->add(Beam(1, hyp), eos, i == 3);
+    }
+    histories.push_back(history);
+  }
+  CHECK(HypothesisPool::current() == nullptr);
+
+  // the hypotheses outlive the scope and keep the pool alive
+  CHECK(references(pool.get()) > 1);
+  auto result = histories[0]->top();
+  CHECK(std::get<0>(result) == Words({w(5), w(6), eos}));
+  CHECK(std::get<1>(result)->getScoreBreakdown()[1] == -3.f);
+
+  // once the last hypothesis is released only the test's reference is left
+  histories.clear();
+  CHECK(references(pool.get()) == 1);
+
+  // outside of a scope hypotheses are allocated on the heap
+  auto hyp = Hypothesis::New(Hypothesis::New(), w(5), 0, -1.f);
+  CHECK(hyp->getWord() == w(5));
+}
+
+// exposes the size of the ring
+class RingOutputCollector : public OutputCollector {
+public:
+  using OutputCollector::OutputCollector;
+  static const long ringSize = RING_SIZE;
+};
+
+TEST_CASE("Output collector", "[translator]") {
+  const long numLines = 3 * RingOutputCollector::ringSize + 100;
+  io::TemporaryFile temp("/tmp/", /*earlyUnlink=*/false);
+  const std::string fileName = temp.getFileName();
+
+  auto linesOf = [](const std::string& fileName) {
+    std::ifstream file(fileName);
+    std::vector<std::string> lines;
+    for(std::string line; std::getline(file, line);)
+      lines.push_back(line);
+    return lines;
+  };
+  auto expectedLines = [numLines](const std::string& prefix) {
+    std::vector<std::string> lines;
+    for(long id = 0; id < numLines; ++id)
+      lines.push_back(prefix + std::to_string(id));
+    return lines;
+  };
+
+  // all line numbers but 0 in random order, shared by four writing threads
+  std::vector<long> ids(numLines - 1);
+  std::iota(ids.begin(), ids.end(), 1);
+  std::shuffle(ids.begin(), ids.end(), std::mt19937(1234));
+  const size_t numThreads = 4;
+
+  SECTION("lines far ahead of the output are written once the first line arrives") {
+    {
+      RingOutputCollector collector(fileName);
+      collector.setPrintingStrategy(New<QuietPrinting>());
+      auto write = [&](long id) { collector.Write(id, "best " + std::to_string(id), "", /*nbest=*/false); };
+
+      // nothing can be written before line 0, most lines are more than the ring size ahead
+      std::vector<std::thread> threads;
+      for(size_t t = 0; t < numThreads; ++t)
+        threads.emplace_back([&, t]() {
+          for(size_t i = t; i < ids.size(); i += numThreads)
+            write(ids[i]);
+        });
+      for(auto& thread : threads)
+        thread.join();
+      CHECK(linesOf(fileName).empty());
+
+      write(0);
+    }
+    CHECK(linesOf(fileName) == expectedLines("best "));
+  }
+
+  SECTION("lines arriving concurrently in any order are written in order") {
+    ids.insert(ids.begin() + ids.size() / 3, 0);
+    {
+      RingOutputCollector collector(fileName);
+      collector.setPrintingStrategy(New<QuietPrinting>());
+
+      std::vector<std::thread> threads;
+      for(size_t t = 0; t < numThreads; ++t)
+        threads.emplace_back([&, t]() {
+          for(size_t i = t; i < ids.size(); i += numThreads)
+            collector.Write(ids[i], "best " + std::to_string(ids[i]), "nbest " + std::to_string(ids[i]), /*nbest=*/true);
+        });
+      for(auto& thread : threads)
+        thread.join();
+    }
+    CHECK(linesOf(fileName) == expectedLines("nbest "));
+  }
+}
+
+TEST_CASE("Prefix decoding with sessions", "[translator]") {
+  Config::seed = 1234;
+  auto w = [](WordIndex i) { return Word::fromWordIndex(i); };
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+  auto graph = tinyGraph();
+  auto batch = sourceBatch({{5, 9, 3, 7, 11}}, vocab);
+
+  auto options = tinyTransformerOptions(/*decDepth=*/2);
+  options->set("beam-size", 3, "n-best", true);
+  BeamSearch search(options, {tinyScorer(options, "F0")}, vocab);
+
+  const Words shortPrefix = {w(6), w(8)};
+  const Words longPrefix = {w(6), w(8), w(10), w(4)};
+
+  // the n-best translations decoded from scratch
+  Ptr<const PrefixSession> fresh;
+  auto expected = search.search(graph, batch, longPrefix, "a b c d e", fresh);
+  REQUIRE(fresh);
+  CHECK(fresh->steps == longPrefix.size());
+
+  auto checkSame = [&](const Histories& histories) {
+    CHECK(translations(histories, 3) == translations(expected, 3));
+    auto nBest = histories[0]->nBest(3), expectedNBest = expected[0]->nBest(3);
+    REQUIRE(nBest.size() == expectedNBest.size());
+    for(size_t i = 0; i < nBest.size(); ++i)
+      CHECK(std::get<1>(nBest[i])->getPathScore() == Approx(std::get<1>(expectedNBest[i])->getPathScore()).epsilon(1e-5));
+  };
+
+  SECTION("continuing a session after a shorter prefix") {
+    Ptr<const PrefixSession> session;
+    search.search(graph, batch, shortPrefix, "a b c d e", session);
+    REQUIRE(session);
+    CHECK(session->steps == shortPrefix.size());
+
+    auto previous = session;
+    auto histories = search.search(graph, batch, longPrefix, "a b c d e", session);
+    CHECK(session != previous);
+    CHECK(session->steps == longPrefix.size());
+    checkSame(histories);
+  }
+
+  SECTION("continuing a session after the same prefix") {
+    auto session = fresh;
+    checkSame(search.search(graph, batch, longPrefix, "a b c d e", session));
+  }
+
+  SECTION("a session of another source line is not continued") {
+    Ptr<const PrefixSession> session;
+    search.search(graph, sourceBatch({{12, 4}}, vocab), shortPrefix, "f g", session);
+    REQUIRE(!session->continues("a b c d e", longPrefix));
+    checkSame(search.search(graph, batch, longPrefix, "a b c d e", session));
+    CHECK(session->source == "a b c d e");
+  }
+}
+
+TEST_CASE("Beam pruning", "[translator]") {
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+
+  // two parents and their continuations, the second beam has a different best path score
+  auto root = Hypothesis::New();
+  auto parent0 = Hypothesis::New(root, Word::fromWordIndex(2), 0, -1.f);
+  auto parent1 = Hypothesis::New(root, Word::fromWordIndex(3), 1, -1.5f);
+  Beam beam = {Hypothesis::New(parent0, Word::fromWordIndex(4), 0, -2.0f),
+               Hypothesis::New(parent0, Word::fromWordIndex(5), 0, -2.1f),
+               Hypothesis::New(parent1, Word::fromWordIndex(4), 1, -2.5f),
+               Hypothesis::New(parent0, Word::fromWordIndex(6), 0, -2.2f),
+               Hypothesis::New(parent1, Word::fromWordIndex(5), 1, -4.0f)};
+  Beam other = {Hypothesis::New(parent0, Word::fromWordIndex(4), 0, -6.0f),
+                Hypothesis::New(parent1, Word::fromWordIndex(5), 1, -6.1f)};
+
+  // the positions of the kept hypotheses in each of the beams {beam, empty beam, other}
+  auto prune = [&](float relative, float absolute, size_t maxCandidates) {
+    auto options = tinyTransformerOptions(1);
+    options->set("beam-size", 5,
+                 "beam-prune-relative", relative,
+                 "beam-prune-absolute", absolute,
+                 "beam-max-candidates", maxCandidates);
+    BeamSearch search(options, {}, vocab);
+
+    Beams beams = {beam, Beam(), other};
+    auto pruned = search.pruneBeams(beams);
+    REQUIRE(pruned.size() == beams.size());
+    std::vector<std::vector<size_t>> kept;
+    for(size_t b = 0; b < beams.size(); ++b) {
+      kept.emplace_back();
+      for(const auto& hyp : pruned[b]) {
+        auto it = std::find(beams[b].begin(), beams[b].end(), hyp);
+        REQUIRE(it != beams[b].end());
+        kept.back().push_back(it - beams[b].begin());
+      }
+    }
+    return kept;
+  };
+  typedef std::vector<std::vector<size_t>> Kept;
+
+  SECTION("without pruning all hypotheses are kept") {
+    CHECK(prune(0.f, 0.f, 0) == Kept({{0, 1, 2, 3, 4}, {}, {0, 1}}));
+  }
+
+  SECTION("relative threshold") {
+    // probability ratio 0.5 to the best hypothesis of the same beam, i.e. a margin of log(2)
+    CHECK(prune(0.5f, 0.f, 0) == Kept({{0, 1, 2, 3}, {}, {0, 1}}));
+  }
+
+  SECTION("absolute threshold") {
+    CHECK(prune(0.f, 0.15f, 0) == Kept({{0, 1}, {}, {0, 1}}));
+    CHECK(prune(0.f, 0.05f, 0) == Kept({{0}, {}, {0}}));
+  }
+
+  SECTION("the tighter threshold wins") {
+    CHECK(prune(0.5f, 0.15f, 0) == Kept({{0, 1}, {}, {0, 1}}));
+    CHECK(prune(0.1f, 0.3f, 0) == Kept({{0, 1, 3}, {}, {0, 1}}));
+  }
+
+  SECTION("pruning may keep only the best hypothesis") {
+    // a ratio of 1 keeps only hypotheses as good as the best one
+    CHECK(prune(1.f, 0.f, 0) == Kept({{0}, {}, {0}}));
+  }
+
+  SECTION("maximum number of continuations per hypothesis") {
+    // the best continuations of each parent are kept in their original order
+    CHECK(prune(0.f, 0.f, 1) == Kept({{0, 2}, {}, {0, 1}}));
+    CHECK(prune(0.f, 0.f, 2) == Kept({{0, 1, 2, 4}, {}, {0, 1}}));
+  }
+
+  SECTION("thresholds and the maximum number of continuations combined") {
+    CHECK(prune(0.f, 1.f, 1) == Kept({{0, 2}, {}, {0, 1}}));
+  }
+}
+
+TEST_CASE("Batch sizes for --mini-batch-fit in decoding", "[translator]") {
+  Config::seed = 1234;
+  auto vocab = New<Vocab>(New<Options>(), 0);
+  vocab->createFake();
+
+  auto graph = New<ExpressionGraph>(/*inference=*/true);
+  graph->setDevice({0, DeviceType::cpu});
+  graph->reserveWorkspaceMB(4);
+  size_t workspace = graph->getTensorAllocator()->size();
+
+  SECTION("a graph that does not fit leaves the workspace as it is") {
+    graph->constant({1024, 2048}, inits::zeros()); // 8MB
+    CHECK_FALSE(graph->forwardFits());
+    CHECK(graph->getTensorAllocator()->size() == workspace);
+
+    graph->clear();
+    graph->constant({16, 16}, inits::zeros());
+    CHECK(graph->forwardFits());
+    CHECK(graph->getTensorAllocator()->size() == workspace);
+  }
+
+  SECTION("batch sizes do not grow with the length") {
+    auto options = tinyTransformerOptions(/*decDepth=*/2);
+    options->set("beam-size", 2, "mini-batch-fit-step", 5, "max-length", 20, "max-length-factor", 1.5f);
+    auto stats = collectDecodingStats(options, graph, {tinyScorer(options, "F0")}, {vocab}, vocab);
+    CHECK(graph->getTensorAllocator()->size() == workspace);
+
+    auto it = stats->begin();
+    size_t previous = SIZE_MAX;
+    for(size_t length = 5; length <= 20; length += 5) {
+      size_t batchSize = stats->findBatchSize({length}, it);
+      CHECK(batchSize >= 1);
+      CHECK(batchSize <= previous);
+      previous = batchSize;
+    }
+    it = stats->begin();
+    CHECK(stats->findBatchSize({5}, it) > 1);
+
+    // longer sentences than probed are translated one at a time
+    it = stats->begin();
+    CHECK(stats->findBatchSize({21}, it) == 1);
+    it = stats->lower_bound({SIZE_MAX});
+    CHECK(it->first == std::vector<size_t>({SIZE_MAX}));
+    CHECK(it->second == 1);
+  }
+}
@@ -7,6 +7,9 @@
 #include "training/communicator.h"
 #include "layers/loss.h"
 
+#include <deque>
+#include <future>
+
 namespace marian {
 
 class Scheduler : public TrainingObserver {
@@ -24,6 +27,22 @@ private:
   timer::Timer timer_;
   timer::Timer heartBeatTimer_;
 
+  // Asynchronous validation (--valid-async): validators run one after another on a single
+  // background thread over snapshot graphs, so results arrive in the order validations were started.
+  struct ValidationResult {
+    float value;
+    size_t stalled;
+    float lastBest;
+  };
+  struct PendingValidation {
+    size_t batches;     // update at which the snapshot was taken
+    std::string epoch;  // formatted logical epoch at which the snapshot was taken
+    std::future<std::vector<ValidationResult>> results;
+  };
+  std::deque<PendingValidation> pendingValidations_;
+  std::vector<size_t> stalledSeen_; // stalled counts from the last folded results, the validators themselves may be busy
+  UPtr<ThreadPool> validationThread_; // declared after all members the background task uses, hence joined first
+
   // The variable helps to keep track of the end of the current epoch
   // (regardless if it's the 1st or nth epoch and if it's a new or continued training),
   // which indicates the end of the training data stream from STDIN
@@ -254,6 +273,7 @@ public:
 
   void started() { LOG(info, "Training started"); }
   void finished() {
+    foldValidations(0); // wait for outstanding background validations
     if (saveAndExitRequested())
       LOG(info, "Training interrupted (via signal).");
     else
@@ -296,6 +316,12 @@ public:
        || (!state_->enteredNewPeriodOf(options_->get<std::string>("valid-freq")) && !isFinal)) // not now
       return;
 
+    if(options_->get<size_t>("valid-async", 0) > 0) {
+      validateAsync(graphs, isFinal);
+      state_->validated = true;
+      return;
+    }
+
     size_t stalledPrev = stalled();
     for(auto validator : validators_) {
       if(!validator)
@@ -346,6 +372,125 @@ public:
     state_->validated = true;
   }
 
+  // Takes a snapshot of the current parameters of graphs[0] (the smoothed ones if the graph group
+  // swapped them in) and validates it in the background. Blocks only if --valid-async validations
+  // are already outstanding, or until all of them have finished for the final validation.
+  void validateAsync(const std::vector<Ptr<ExpressionGraph>>& graphs, bool isFinal) {
+    ABORT_IF(mpi_ && mpi_->numMPIProcesses() > 1, "Asynchronous validation is not supported with MPI");
+
+    if(!validationThread_) {
+      for(auto validator : validators_)
+        stalledSeen_.push_back(validator ? validator->stalled() : 0);
+      validationThread_.reset(new ThreadPool(1));
+    }
+
+    foldValidations(options_->get<size_t>("valid-async") - 1); // make room for this one
+
+    auto items = New<std::vector<io::Item>>();
+    graphs[0]->save(*items);
+    auto state = New<TrainingState>(*state_); // the validators only read progress counters, e.g. for file names
+
+    auto task = [this, items, state]() {
+      auto snapshot = createValidationGraphs(*items);
+      std::vector<ValidationResult> results;
+      for(auto validator : validators_) {
+        ValidationResult result = {0.f, 0, 0.f};
+        if(validator) {
+          result.value    = validator->validate(snapshot, state);
+          result.stalled  = validator->stalled();
+          result.lastBest = validator->lastBest();
+        }
+        results.push_back(result);
+      }
+      return results;
+    };
+
+    LOG(info, "Validating snapshot after {} updates in the background", state_->batches);
+    PendingValidation pending;
+    pending.batches = state_->batches;
+    pending.epoch   = formatLogicalEpoch();
+    pending.results = validationThread_->enqueue(task);
+    pendingValidations_.push_back(std::move(pending));
+
+    if(isFinal)
+      foldValidations(0);
+  }
+
+  // Inference graphs for asynchronous validation on --valid-async-devices or CPU threads
+  std::vector<Ptr<ExpressionGraph>> createValidationGraphs(std::vector<io::Item>& items) {
+    std::vector<DeviceId> devices;
+    for(auto id : options_->get<std::vector<size_t>>("valid-async-devices", {}))
+      devices.push_back({id, DeviceType::gpu});
+    if(devices.empty())
+      for(size_t i = 0; i < options_->get<size_t>("valid-async-cpu-threads", 1); ++i)
+        devices.push_back({i, DeviceType::cpu});
+
+    std::vector<Ptr<ExpressionGraph>> graphs;
+    for(auto device : devices) {
+      auto graph = New<ExpressionGraph>(/*inference=*/true);
+      graph->setDevice(device);
+      graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      graph->load(items, /*markReloaded=*/false);
+      graphs.push_back(graph);
+    }
+    return graphs;
+  }
+
+  // Folds the results of finished background validations into the training state in the order they
+  // were started. Blocks while more than maxPending validations are outstanding.
+  void foldValidations(size_t maxPending) {
+    if(pendingValidations_.empty())
+      return;
+
+    size_t stalledPrev = stalled();
+    while(!pendingValidations_.empty()) {
+      auto& pending = pendingValidations_.front();
+      if(pendingValidations_.size() <= maxPending
+         && pending.results.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        break;
+
+      auto results = pending.results.get();
+      for(size_t i = 0; i < validators_.size(); ++i) {
+        auto validator = validators_[i];
+        if(!validator)
+          continue;
+        const auto& result = results[i];
+        if(result.stalled > 0) {
+          LOG_VALID(info,
+                    "Ep. {} : Up. {} : {} : {} : stalled {} times (last best: {})",
+                    pending.epoch,
+                    pending.batches,
+                    validator->type(),
+                    result.value,
+                    result.stalled, result.lastBest);
+        } else {
+          LOG_VALID(info,
+                    "Ep. {} : Up. {} : {} : {} : new best",
+                    pending.epoch,
+                    pending.batches,
+                    validator->type(),
+                    result.value);
+        }
+        state_->validators[validator->type()]["last-best"] = result.lastBest;
+        state_->validators[validator->type()]["stalled"]   = result.stalled;
+        stalledSeen_[i] = result.stalled;
+      }
+      pendingValidations_.pop_front();
+    }
+
+    // notify training observers about stalled validation
+    size_t stalledNew = stalled();
+    if(stalledNew > stalledPrev)
+      state_->newStalled(stalledNew);
+  }
+
+  // Stalled count of the i-th validator; with asynchronous validation as of the last folded result
+  size_t stalledOf(size_t i) {
+    if(validationThread_)
+      return stalledSeen_[i];
+    return validators_[i] ? validators_[i]->stalled() : 0;
+  }
+
   // Returns the proper number of stalled validation w.r.t. early-stopping-on
   size_t stalled() {
     std::string stopOn = options_->get<std::string>("early-stopping-on");
@@ -359,26 +504,25 @@ public:
   // Returns the number of stalled validations for the first validator
   size_t stalled1st() {
     if(!validators_.empty())
-      if(validators_[0])
-        return validators_[0]->stalled();
+      return stalledOf(0);
     return 0;
   }
 
   // Returns the largest number of stalled validations across validators or 0 if there are no validators
   size_t stalledMax() {
     size_t max = 0;
-    for(auto validator : validators_)
-      if(validator && validator->stalled() > max)
-        max = validator->stalled();
+    for(size_t i = 0; i < validators_.size(); ++i)
+      if(validators_[i] && stalledOf(i) > max)
+        max = stalledOf(i);
     return max;
   }
 
   // Returns the lowest number of stalled validations across validators or 0 if there are no validators
   size_t stalledMin() {
     size_t min = std::numeric_limits<std::size_t>::max();
-    for(auto validator : validators_)
-      if(validator && validator->stalled() < min)
-        min = validator->stalled();
+    for(size_t i = 0; i < validators_.size(); ++i)
+      if(validators_[i] && stalledOf(i) < min)
+        min = stalledOf(i);
     return min == std::numeric_limits<std::size_t>::max() ? 0 : min;
   }
 
@@ -394,6 +538,8 @@ public:
               size_t batchSize,      // total number of sentences in batch
               size_t batchLabels,    // total number of target words in batch
               float gradientNorm) {  // gradientNorm of update
+    foldValidations(options_->get<size_t>("valid-async", 0)); // results of finished background validations, if any
+
     state_->rememberPreviousProgress();  // note: epoch increases happen at the wrong place, hence
                                          // -freq parameters do not support epoch units
     state_->validated = false;
@@ -3,8 +3,12 @@
 #include "data/factored_vocab.h"
 #include "translator/helpers.h"
 #include "translator/nth_element.h"
+#include "translator/speculative_search.h"
 #include "data/shortlist.h"
 #include "common/utils.h"
+#include "3rd_party/threadpool.h"
+
+#include <unordered_map>
 
 namespace marian {
 
@@ -41,6 +45,7 @@ Beams BeamSearch::toHyps(const std::vector<unsigned int>& nBestKeys, // [current
     }
   }
 
+  std::vector<float> breakDown, hypAlign; // buffers reused for all hyps
   for(size_t i = 0; i < nBestKeys.size(); ++i) { // [currentDimBatch, beamSize] flattened
     // Keys encode batchIdx, beamHypIdx, and word index in the entire beam.
     // They can be between 0 and (vocabSize * nBestBeamSize * batchSize)-1.
@@ -123,7 +128,8 @@ Beams BeamSearch::toHyps(const std::vector<unsigned int>& nBestKeys, // [current
 
     // Set score breakdown for n-best lists
     if(options_->get<bool>("n-best")) {
-      auto breakDown = beam[beamHypIdx]->getScoreBreakdown();
+      const auto& prevBreakDown = beam[beamHypIdx]->getScoreBreakdown();
+      breakDown.assign(prevBreakDown.begin(), prevBreakDown.end()); // reuses the buffer, the hyp's copy lives in the pool
       ABORT_IF(factoredVocab && factorGroup > 0 && !factoredVocab->canExpandFactoredWord(word, factorGroup),
                "A word without this factor snuck through to here??");
       breakDown.resize(states.size(), 0); // at start, this is empty, so this will set the initial score to 0
@@ -143,8 +149,10 @@ Beams BeamSearch::toHyps(const std::vector<unsigned int>& nBestKeys, // [current
     }
 
     // Set alignments
-    if(!align.empty())
-      hyp->setAlignment(getAlignmentsForHypothesis(align, batch, (int)beamHypIdx, (int)currentBatchIdx, (int)origBatchIdx, (int)currentDimBatch));
+    if(!align.empty()) {
+      getAlignmentsForHypothesis(align, batch, (int)beamHypIdx, (int)currentBatchIdx, (int)origBatchIdx, (int)currentDimBatch, hypAlign);
+      hyp->setAlignment(hypAlign);
+    }
     else // not first factor: just copy
       hyp->setAlignment(beam[beamHypIdx]->getAlignment());
 
@@ -178,13 +186,14 @@ Beams BeamSearch::toHyps(const std::vector<unsigned int>& nBestKeys, // [current
   return newBeams;
 }
 
-std::vector<float> BeamSearch::getAlignmentsForHypothesis( // -> P(s|t) for current t and given beam and batch dim
-    const std::vector<float> alignAll, // [beam depth, max src length, batch size, 1], flattened vector of all attention probablities
+void BeamSearch::getAlignmentsForHypothesis( // -> P(s|t) for current t and given beam and batch dim
+    const std::vector<float>& alignAll, // [beam depth, max src length, batch size, 1], flattened vector of all attention probablities
     Ptr<data::CorpusBatch> batch,
     int beamHypIdx,
     int currentBatchIdx,
     int origBatchIdx,
-    int currentDimBatch) const {
+    int currentDimBatch,
+    /*out*/ std::vector<float>& align) const {
   // Let's B be the beam size, N be the number of batched sentences,
   // and L the number of words in the longest sentence in the batch.
   // The alignment vector:
@@ -207,7 +216,7 @@ std::vector<float> BeamSearch::getAlignmentsForHypothesis( // -> P(s|t) for curr
   size_t batchWidth   = batch->width(); // max src length
 
   // loop over words of batch entry 'currentBatchIdx' and beam entry 'beamHypIdx'
-  std::vector<float> align;
+  align.clear();
   for(size_t srcPos = 0; srcPos < batchWidth; ++srcPos) { // loop over source positions
     // We are looking into the probabilites from an actual tensor, hence we need to use currentDimBatch and currentBatchIdx.
     size_t currentAttIdx = (batchWidth * beamHypIdx + srcPos) * currentDimBatch + currentBatchIdx; // = flatten [beam index, s, batch index, 0]
@@ -220,7 +229,245 @@ std::vector<float> BeamSearch::getAlignmentsForHypothesis( // -> P(s|t) for curr
     if(batch->front()->mask()[origMaskIdx] != 0)
       align.emplace_back(alignAll[currentAttIdx]);
   }
-  return align;
+}
+
+// Threshold pruning and a limit of candidates per parent hypothesis, see Freitag & Al-Onaizan (2017),
+// "Beam Search Strategies for Neural Machine Translation". toHyps() never creates more hypotheses
+// than the previous beam had, so a pruned beam stays narrower for the rest of the search, and once
+// all beams of a batch are narrower fewer rows are passed to Scorer::step() via hypIndices.
+Beams BeamSearch::pruneBeams(const Beams& beams) const {
+  if(pruneMargin_ == std::numeric_limits<float>::infinity() && maxCandidates_ == 0)
+    return beams;
+
+  Beams newBeams;
+  for(const auto& beam : beams) {
+    Beam newBeam;
+    if(!beam.empty()) {
+      // visit hyps from best to worst, so the best continuations of each parent are kept
+      std::vector<size_t> order(beam.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return beam[a]->getPathScore() > beam[b]->getPathScore();
+      });
+      float threshold = beam[order[0]]->getPathScore() - pruneMargin_;
+
+      std::vector<bool> keep(beam.size(), false);
+      std::unordered_map<const Hypothesis*, size_t> candidates; // number of kept continuations per parent
+      for(auto i : order) {
+        if(beam[i]->getPathScore() < threshold)
+          break;
+        if(maxCandidates_ > 0 && ++candidates[beam[i]->getPrevHyp().get()] > maxCandidates_)
+          continue;
+        keep[i] = true;
+      }
+      for(size_t i = 0; i < beam.size(); ++i) // keep original order within the beam
+        if(keep[i])
+          newBeam.push_back(beam[i]);
+    }
+    newBeams.push_back(newBeam);
+  }
+  return newBeams;
+}
+
+size_t BeamSearch::speculate(Ptr<ExpressionGraph> graph,
+                             /*in/out*/ Ptr<ScorerState>& state,
+                             /*in/out*/ Ptr<ScorerState>& draftState,
+                             /*in/out*/ Beam& beam,
+                             Ptr<History> history,
+                             const std::vector<WordIndex>& suppressed,
+                             size_t length,
+                             float maxLength) {
+  const auto trgEosId = trgVocab_->getEosId();
+  const int dimBeam = (int)beam.size();
+  const std::vector<IndexType> batchIndices = {0};
+
+  std::vector<IndexType> hypIndices; // as in searchBeams() for a single sentence
+  Words prevWords;
+  for(const auto& hyp : beam) {
+    hypIndices.push_back((IndexType)hyp->getPrevStateIndex());
+    prevWords.push_back(hyp->getWord());
+  }
+
+  // the draft model proposes the next words of all hypotheses, one position at a time
+  std::vector<Words> drafts(dimBeam); // [beamHypIdx][position]
+  auto draftNext = draftState;
+  auto draftShortlist = draft_->getShortlist();
+  std::vector<IndexType> indices;
+  for(size_t j = 0; j < draftWords_; ++j) {
+    Words input(dimBeam);
+    for(int i = 0; i < dimBeam; ++i)
+      input[i] = j == 0 ? prevWords[i] : drafts[i].back();
+    draftNext = draft_->step(graph, draftNext, j == 0 ? hypIndices : std::vector<IndexType>(), input, batchIndices, dimBeam);
+    auto best = get<1>(argmax(draftNext->getLogProbs().getLogits(), /*axis=*/-1)); // [dimBeam, 1, 1, 1]
+    graph->forwardNext();
+    best->val()->get(indices);
+    for(int i = 0; i < dimBeam; ++i)
+      drafts[i].push_back(Word::fromWordIndex(draftShortlist ? draftShortlist->reverseMap(0, 0, indices[i]) : indices[i]));
+  }
+
+  // the main model consumes the last word of each hypothesis and its drafts in a single step
+  Words verify; // [beamHypIdx, position] flattened
+  for(int i = 0; i < dimBeam; ++i) {
+    verify.push_back(prevWords[i]);
+    verify.insert(verify.end(), drafts[i].begin(), drafts[i].end());
+  }
+  auto scorer = scorers_[0];
+  auto next = scorer->stepMany(graph, state, hypIndices, verify, dimBeam);
+  auto logits = cast(next->getLogProbs().getLogits(), Type::float32); // [dimBeam, draftWords + 1, 1, dimVocab]
+  graph->forwardNext();
+  std::vector<float> logProbs;
+  logits->val()->get(logProbs);
+
+  const size_t positions = draftWords_ + 1;
+  const size_t dimVocab = logits->shape()[-1];
+  const float weight = scorer->getWeight();
+  const float lowest = std::numeric_limits<float>::lowest();
+  const bool nBest = options_->get<bool>("n-best");
+  auto shortlist = scorer->getShortlist();
+
+  std::vector<bool> isSuppressed(dimVocab, false); // the columns suppressWords() sets
+  for(auto i : suppressed)
+    if(i < dimVocab)
+      isSuppressed[i] = true;
+
+  // Repeat the selection of searchBeams() on the host for each position: the expanded path scores are
+  // computed with the same float operations, toHyps() keeps the best dimBeam of them in that order.
+  std::vector<size_t> rows(dimBeam); // state row each hypothesis of the beam continues
+  std::iota(rows.begin(), rows.end(), 0);
+  std::vector<std::pair<float, size_t>> candidates; // (expanded path score, beamHypIdx * dimVocab + wordIdx)
+  std::vector<float> breakDown;
+  size_t steps = 0;
+  for(; steps < draftWords_; ++steps) {
+    if(history->size() >= maxLength) // the last step is left to searchBeams()
+      break;
+
+    candidates.clear();
+    for(int beamHypIdx = 0; beamHypIdx < dimBeam; ++beamHypIdx) {
+      const float prevScore = beam[beamHypIdx]->getPathScore();
+      const float* rowLogProbs = logProbs.data() + (rows[beamHypIdx] * positions + steps) * dimVocab;
+      for(size_t wordIdx = 0; wordIdx < dimVocab; ++wordIdx) {
+        volatile float weighted = weight * rowLogProbs[wordIdx]; // rounded before the addition as in the graph
+        float score = isSuppressed[wordIdx] ? lowest : prevScore + weighted;
+        candidates.emplace_back(score, beamHypIdx * dimVocab + wordIdx);
+      }
+    }
+    size_t nBestSize = std::min(candidates.size(), (size_t)dimBeam + 1);
+    std::partial_sort(candidates.begin(), candidates.begin() + nBestSize, candidates.end(),
+                      [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+
+    // rounding differences between single- and multi-word steps must not be able to change the beam
+    if(nBestSize > (size_t)dimBeam
+       && candidates[dimBeam - 1].first - candidates[dimBeam].first < SpeculativeSearch::TIE_MARGIN)
+      break;
+    if(pruneMargin_ != std::numeric_limits<float>::infinity()
+       && candidates[dimBeam - 1].first - (candidates[0].first - pruneMargin_) < SpeculativeSearch::TIE_MARGIN)
+      break;
+
+    // every hypothesis has to be continued by its own draft word, there is one per hypothesis
+    Beam nextBeam;
+    std::vector<size_t> nextRows;
+    for(int i = 0; i < dimBeam; ++i) {
+      auto beamHypIdx = candidates[i].second / dimVocab;
+      auto wordIdx = (WordIndex)(candidates[i].second % dimVocab);
+      auto word = Word::fromWordIndex(shortlist ? shortlist->reverseMap((int)beamHypIdx, 0, wordIdx) : wordIdx);
+      auto row = rows[beamHypIdx];
+      if(word != drafts[row][steps] || word == trgEosId || candidates[i].first == lowest)
+        break;
+
+      auto hyp = Hypothesis::New(beam[beamHypIdx], word, row, candidates[i].first);
+      if(nBest) { // as in toHyps()
+        const auto& prevBreakDown = beam[beamHypIdx]->getScoreBreakdown();
+        breakDown.assign(prevBreakDown.begin(), prevBreakDown.end());
+        breakDown.resize(1, 0);
+        breakDown[0] += logProbs[(row * positions + steps) * dimVocab + wordIdx];
+        hyp->setScoreBreakdown(breakDown);
+      }
+      nextBeam.push_back(hyp);
+      nextRows.push_back(row);
+    }
+    if(nextBeam.size() < (size_t)dimBeam)
+      break;
+
+    history->add(nextBeam, trgEosId);
+    beam = nextBeam;
+    rows = nextRows;
+  }
+  if(steps == 0) // the states stay as they were, the multi-word step is discarded
+    return 0;
+
+  // keep the positions of the accepted words but the last, which the next step of searchBeams() consumes
+  state = scorer->truncate(next, length + steps);
+  draftState = steps < draftWords_ ? draft_->truncate(draftNext, length + steps) : draftNext;
+  return steps;
+}
+
+Expr BeamSearch::stepEnsembleInParallel(Ptr<ExpressionGraph> graph,
+                                        std::vector<Ptr<ScorerState>>& states,
+                                        const std::vector<IndexType>& hypIndices,
+                                        const Words& prevWords,
+                                        const std::vector<IndexType>& batchIndices,
+                                        int beamSize,
+                                        Expr prevPathScores,
+                                        bool first) {
+  // helper threads of this search thread, member 0 is stepped by the search thread itself
+  thread_local UPtr<ThreadPool> memberThreads;
+  if(!memberThreads)
+    memberThreads.reset(new ThreadPool(scorers_.size() - 1));
+  memberThreads->reserve(scorers_.size() - 1);
+
+  std::vector<Tensor> logits(scorers_.size());
+  auto stepMember = [&](size_t i) {
+    auto memberGraph = scorers_[i]->getGraph();
+    states[i] = scorers_[i]->step(memberGraph, states[i], hypIndices, prevWords, batchIndices, beamSize);
+    auto memberLogits = states[i]->getLogProbs().getLogits(); // [beamSize, 1, currentDimBatch, dimVocab]
+    if(first)
+      memberGraph->forward();
+    else
+      memberGraph->forwardNext();
+    logits[i] = memberLogits->val();
+  };
+
+  std::vector<std::future<void>> members;
+  for(size_t i = 1; i < scorers_.size(); ++i)
+    members.emplace_back(memberThreads->enqueue(stepMember, i));
+  stepMember(0);
+  for(auto& member : members)
+    member.get();
+
+  std::vector<float> weights;
+  for(auto scorer : scorers_)
+    weights.push_back(scorer->getWeight());
+
+  const auto& shape = logits[0]->shape();
+  int dimBeam = shape[-4], dimBatch = shape[-2], dimVocab = shape[-1];
+
+  // One pass over the logits of all members that replaces prevPathScores + w_0 * logits_0 + ... and
+  // swapAxes(., 0, 2) of the sequential ensemble. The additions are done in the same order, element
+  // by element, and each weighted logit is rounded to float before it is added as in the separate
+  // graph operations, so the results are bitwise identical.
+  auto combine = [logits, weights, dimBeam, dimBatch, dimVocab](Expr out, const std::vector<Expr>& inputs) {
+    const float* prev = inputs[0]->val()->data<float>();
+    bool broadcast = inputs[0]->shape().elements() == 1; // first step
+    float* scores = out->val()->data<float>();
+    for(int beamHypIdx = 0; beamHypIdx < dimBeam; ++beamHypIdx) {
+      for(int batchIdx = 0; batchIdx < dimBatch; ++batchIdx) {
+        float prevScore = broadcast ? prev[0] : prev[beamHypIdx * dimBatch + batchIdx];
+        float* row = scores + ((size_t)batchIdx * dimBeam + beamHypIdx) * dimVocab;     // [batch, 1, beam, vocab]
+        size_t offset = ((size_t)beamHypIdx * dimBatch + batchIdx) * dimVocab;         // [beam, 1, batch, vocab]
+        std::fill(row, row + dimVocab, prevScore);
+        for(size_t i = 0; i < logits.size(); ++i) {
+          const float* memberRow = logits[i]->data<float>() + offset;
+          const float weight = weights[i];
+          for(int wordIdx = 0; wordIdx < dimVocab; ++wordIdx) {
+            volatile float weighted = weight * memberRow[wordIdx]; // no contraction into an FMA
+            row[wordIdx] = row[wordIdx] + weighted;
+          }
+        }
+      }
+    }
+  };
+
+  return lambda({prevPathScores}, {dimBatch, 1, dimBeam, dimVocab}, Type::float32, combine);
 }
 
 // remove all beam entries that have reached EOS
@@ -246,9 +493,74 @@ Beams BeamSearch::purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexTyp
   return newBeams;
 }
 
+std::vector<Ptr<ScorerState>> BeamSearch::forcePrefix(Ptr<ExpressionGraph> graph,
+                                                      Ptr<data::CorpusBatch> batch,
+                                                      const Words& prefix,
+                                                      const std::string& source,
+                                                      /*in/out*/ Ptr<const PrefixSession>& session) {
+  std::vector<Ptr<ScorerState>> states;
+  auto next = New<PrefixSession>();
+  next->source = source;
+
+  if(session && session->continues(source, prefix) && session->states.size() == scorers_.size()) {
+    for(size_t i = 0; i < scorers_.size(); ++i)
+      states.push_back(scorers_[i]->restore(graph, batch, session->states[i]));
+    next->steps = session->steps;
+  } else {
+    for(auto scorer : scorers_)
+      states.push_back(scorer->startState(graph, batch));
+  }
+
+  // the first step consumes the sentence start, every further step one word of the prefix
+  const std::vector<IndexType> batchIndices = {0};
+  for(; next->steps < prefix.size(); next->steps++) {
+    Words words;
+    if(next->steps > 0)
+      words.push_back(prefix[next->steps - 1]);
+    for(size_t i = 0; i < scorers_.size(); ++i)
+      states[i] = scorers_[i]->step(graph, states[i], {}, words, batchIndices, /*beamSize=*/1);
+  }
+  next->consumed.assign(prefix.begin(), prefix.begin() + std::max(next->steps, (size_t)1) - 1);
+
+  graph->forward();
+  for(size_t i = 0; i < scorers_.size(); ++i)
+    next->states.push_back(scorers_[i]->snapshot(states[i]));
+  session = next;
+  return states;
+}
+
 //**********************************************************************
 // main decoding function
 Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch) {
+  HypothesisPool::Scope hypothesisPool; // all hypotheses of this batch are freed together with its histories
+
+  if(greedy_) // beam size 1 does not need any of the beam bookkeeping below
+    return greedy_->search(graph, batch);
+
+  return searchBeams(graph, batch, /*prefix=*/nullptr, /*source=*/"", /*session=*/nullptr);
+}
+
+Histories BeamSearch::search(Ptr<ExpressionGraph> graph,
+                             Ptr<data::CorpusBatch> batch,
+                             const Words& prefix,
+                             const std::string& source,
+                             /*in/out*/ Ptr<const PrefixSession>& session) {
+  HypothesisPool::Scope hypothesisPool;
+
+  ABORT_IF(batch->size() != 1, "Prefix decoding expects a single sentence, got {}", batch->size());
+  ABORT_IF(trgVocab_->tryAs<FactoredVocab>(), "Prefix decoding does not support factored vocabularies");
+  ABORT_IF(options_->hasAndNotEmpty("alignment"), "Prefix decoding does not support --alignment");
+  ABORT_IF(options_->get<bool>("right-left", false), "Prefix decoding does not support --right-left");
+  ABORT_IF(scorers_[0]->getGraph(), "Prefix decoding cannot be combined with --ensemble-parallel");
+
+  return searchBeams(graph, batch, &prefix, source, &session);
+}
+
+Histories BeamSearch::searchBeams(Ptr<ExpressionGraph> graph,
+                                  Ptr<data::CorpusBatch> batch,
+                                  const Words* prefix,
+                                  const std::string& source,
+                                  Ptr<const PrefixSession>* session) {
   auto factoredVocab = trgVocab_->tryAs<FactoredVocab>();
   size_t numFactorGroups = factoredVocab ? factoredVocab->getNumGroups() : 1;
   if (numFactorGroups == 1) // if no factors then we didn't need this object in the first place
@@ -261,8 +573,15 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
 
   auto getNBestList = createGetNBestListFn(beamSize_, origDimBatch, graph->getDeviceId());
 
+  // with --ensemble-parallel each member runs on its own graph, the search graph only combines their scores
+  bool parallelEnsemble = scorers_.size() > 1 && scorers_[0]->getGraph();
+  ABORT_IF(parallelEnsemble && numFactorGroups > 1, "--ensemble-parallel does not support factored vocabularies");
+  auto scorerGraph = [&](Ptr<Scorer> scorer) { return parallelEnsemble ? scorer->getGraph() : graph; };
+
+  if(parallelEnsemble)
+    graph->clear();
   for(auto scorer : scorers_) {
-    scorer->clear(graph);
+    scorer->clear(scorerGraph(scorer));
   }
 
   Histories histories(origDimBatch);
@@ -275,12 +594,32 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
 
   // start states
   std::vector<Ptr<ScorerState>> states;
-  for(auto scorer : scorers_) {
-    states.push_back(scorer->startState(graph, batch));
+  if(prefix) {
+    states = forcePrefix(graph, batch, *prefix, source, *session);
+  } else {
+    for(auto scorer : scorers_) {
+      states.push_back(scorer->startState(scorerGraph(scorer), batch));
+    }
+  }
+
+  // speculative decoding: the draft model is stepped with the beam, see speculate()
+  Ptr<ScorerState> draftState;
+  if(draft_) {
+    ABORT_IF(origDimBatch != 1 || prefix || factoredVocab || parallelEnsemble,
+             "Speculative decoding with a beam expects a single sentence without prefix, factors or parallel ensemble");
+    draft_->clear(graph);
+    draftState = draft_->startState(graph, batch);
   }
+  const float maxLength = options_->get<float>("max-length-factor") * batch->front()->batchWidth();
+
+  // the search continues from the last word of a forced prefix, preceded by the rest of it in the history
+  std::vector<Hypothesis::PtrType> prefixHyps(1, Hypothesis::New());
+  if(prefix)
+    for(auto word : *prefix)
+      prefixHyps.push_back(Hypothesis::New(prefixHyps.back(), word, 0, 0.f));
 
   // create one beam per batch entry with sentence-start hypothesis
-  Beams beams(origDimBatch, Beam(beamSize_, Hypothesis::New())); // array [origDimBatch] of array [maxBeamSize] of Hypothesis, keeps full size through search.
+  Beams beams(origDimBatch, Beam(beamSize_, prefixHyps.back())); // array [origDimBatch] of array [maxBeamSize] of Hypothesis, keeps full size through search.
                                                                  // batch purging is determined from an empty sub-beam.
   std::vector<IndexType> batchIdxMap(origDimBatch); // Record at which batch entry a beam is looking.
                                                     // By default that corresponds to position in array,
@@ -290,6 +629,8 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
   for(int origBatchIdx = 0; origBatchIdx < origDimBatch; ++origBatchIdx) {
     batchIdxMap[origBatchIdx] = origBatchIdx; // map to same position on initialization
     auto& beam = beams[origBatchIdx];
+    for(size_t i = 0; i + 1 < prefixHyps.size(); ++i)
+      histories[origBatchIdx]->add(Beam(1, prefixHyps[i]), trgEosId);
     histories[origBatchIdx]->add(beam, trgEosId); // add beams with start-hypotheses to traceback grid
 
     // Mark batch entries that consist only of source <EOS> i.e. these are empty lines. They will be forced to EOS and purged from batch
@@ -298,10 +639,11 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
   }
 
   Expr suppressedWordIndices;
+  std::vector<WordIndex> suppressed;
   bool suppressUnk     = !options_->get<bool>("allow-unk", false);
   bool suppressSpecial = !options_->get<bool>("allow-special", false);
   if (suppressUnk || suppressSpecial) { // do we need to suppress unk or special?
-    std::vector<WordIndex> suppressed = trgVocab_->suppressedIndices(suppressUnk, suppressSpecial);
+    suppressed = trgVocab_->suppressedIndices(suppressUnk, suppressSpecial);
 
     auto shortlist = scorers_[0]->getShortlist(); // first shortlist is generally ok, @TODO: make sure they are the same across scorers?
     if(shortlist) // check if suppressed words are allowed by the shortlist, if not, remove
@@ -343,6 +685,10 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
     if (maxBeamSize == 0)
       break;
 
+    // skip the steps that would only follow the draft model's words, the states have t positions
+    if(draftState && t > 0)
+      t += speculate(graph, states[0], draftState, beams[0], histories[0], suppressed, t, maxLength);
+
     for (size_t factorGroup = 0; factorGroup < numFactorGroups; factorGroup++) {
       // for factored vocabs, we do one factor at a time, but without updating the scorer for secondary factors
 
@@ -362,6 +708,10 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
         // at the beginning all batch entries are used
         batchIndices.resize(origDimBatch);
         std::iota(batchIndices.begin(), batchIndices.end(), 0);
+
+        // the states have consumed all but the last word of a forced prefix
+        if(prefix && !prefix->empty())
+          prevWords.push_back(prefix->back());
       } else {
         if(factorGroup == 0)                                                              // only factorGroup==0 can subselect neural state
           for(int currentBatchIdx = 0; currentBatchIdx < beams.size(); ++currentBatchIdx) // loop over batch entries (active sentences)
@@ -414,7 +764,7 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
       // compute expanded path scores with word prediction probs from all scorers
       auto expandedPathScores = prevPathScores; // will become [maxBeamSize, 1, currDimBatch, dimVocab]
       Expr logProbs;
-      for(size_t i = 0; i < scorers_.size(); ++i) {
+      for(size_t i = 0; i < scorers_.size() && !parallelEnsemble; ++i) {
         if (factorGroup == 0) {
           // compute output probabilities for current output time step
           //  - uses hypIndices[index in beam, 1, batch index, 1] to reorder scorer state to reflect the top-N in beams[][]
@@ -427,7 +777,7 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
           //  LOG(info, "prevWords[{},{}]={} -> {}", t/numFactorGroups, factorGroup,
           //      factoredVocab ? factoredVocab->word2string(prevWords[kk]) : (*batch->back()->vocab())[prevWords[kk]],
           //      prevScores[kk]);
-          states[i] = scorers_[i]->step(graph, states[i], hypIndices, prevWords, batchIndices, (int)maxBeamSize);
+          states[i] = scorers_[i]->step(graph, states[i], hypIndices, prevWords, batchIndices, t == 0 ? 1 : (int)maxBeamSize);
           if (numFactorGroups == 1) { // @TODO: this branch can go away
             logProbs = states[i]->getLogProbs().getLogits(); // [maxBeamSize, 1, currentDimBatch, dimVocab]
           } else {
@@ -450,12 +800,18 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
         // expand all hypotheses, [maxBeamSize, 1, currentDimBatch, 1] -> [maxBeamSize, 1, currentDimBatch, dimVocab]
         expandedPathScores = expandedPathScores + scorers_[i]->getWeight() * logProbs;
       }
+      if(draftState) // the draft model follows the same hypotheses
+        draftState = draft_->step(graph, draftState, hypIndices, prevWords, batchIndices, t == 0 ? 1 : (int)maxBeamSize);
 
       // make beams continuous
-      expandedPathScores = swapAxes(expandedPathScores, 0, 2); // -> [currentDimBatch, 1, maxBeamSize, dimVocab]
+      if(parallelEnsemble) // steps the members and adds up their scores, already swapped
+        expandedPathScores = stepEnsembleInParallel(graph, states, hypIndices, prevWords, batchIndices, (int)maxBeamSize,
+                                                    prevPathScores, /*first=*/t == 0); // -> [currentDimBatch, 1, maxBeamSize, dimVocab]
+      else
+        expandedPathScores = swapAxes(expandedPathScores, 0, 2); // -> [currentDimBatch, 1, maxBeamSize, dimVocab]
 
-      // perform NN computation
-      if(t == 0 && factorGroup == 0)
+      // perform NN computation, a forced prefix has already been computed
+      if(t == 0 && factorGroup == 0 && !prefix)
         graph->forward();
       else
         graph->forwardNext();
@@ -491,6 +847,9 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
                      batchIdxMap);      // used to create a reverse batch index map to recover original batch indices for this step
     } // END FOR factorGroup = 0 .. numFactorGroups-1
 
+    // drop hyps that fell too far behind, this narrows the beams for the following steps
+    beams = pruneBeams(beams);
+
     prevBatchIdxMap = batchIdxMap; // save current batchIdx map to be used in next step; we are then going to look one step back
 
     // remove all hyps that end in EOS
@@ -503,7 +862,7 @@ Histories BeamSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch>
     for(int batchIdx = 0; batchIdx < origDimBatch; ++batchIdx) {
       // if this batch entry has surviving hyps then add them to the traceback grid
       if(!beams[batchIdx].empty()) { // if the beam is not empty expand the history object associated with the beam
-        if (histories[batchIdx]->size() >= options_->get<float>("max-length-factor") * batch->front()->batchWidth())
+        if (histories[batchIdx]->size() >= maxLength)
           maxLengthReached = true;
         histories[batchIdx]->add(beams[batchIdx], trgEosId, purgedNewBeams[batchIdx].empty() || maxLengthReached);
       }
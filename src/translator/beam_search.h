@@ -3,6 +3,8 @@
 #include "marian.h"
 #include "translator/history.h"
 #include "translator/scorers.h"
+#include "translator/greedy_search.h"
+#include "translator/prefix_session.h"
 
 namespace marian {
 
@@ -13,6 +15,14 @@ private:
   size_t beamSize_;
   Ptr<const Vocab> trgVocab_;
 
+  float pruneMargin_;          // hypotheses more than this below the best path score of their beam are dropped
+  size_t maxCandidates_;       // maximum number of continuations of the same hypothesis per beam, 0 = no limit
+
+  Ptr<GreedySearch> greedy_;   // fast path for beam size 1, nullptr if not applicable
+
+  Ptr<Scorer> draft_;          // speculative decoding with a beam, see setDraft()
+  size_t draftWords_{0};
+
   const float INVALID_PATH_SCORE;
   const bool PURGE_BATCH = true; // @TODO: diagnostic, to-be-removed once confirmed there are no issues.
 
@@ -26,7 +36,22 @@ public:
   BeamSearch(Ptr<Options> options, const std::vector<Ptr<Scorer>>& scorers, const Ptr<const Vocab> trgVocab)
       : options_(options), scorers_(scorers), beamSize_(options_->get<size_t>("beam-size")), trgVocab_(trgVocab),
         INVALID_PATH_SCORE{chooseInvalidPathScore(options)}
-  {}
+  {
+    // relative (probability ratio) and absolute (log space) threshold, the tighter one wins
+    auto pruneRelative = options_->get<float>("beam-prune-relative", 0.f);
+    auto pruneAbsolute = options_->get<float>("beam-prune-absolute", 0.f);
+    ABORT_IF(pruneRelative < 0.f || pruneRelative > 1.f, "--beam-prune-relative must be between 0 and 1");
+    ABORT_IF(pruneAbsolute < 0.f, "--beam-prune-absolute must not be negative");
+    pruneMargin_ = std::numeric_limits<float>::infinity();
+    if(pruneRelative > 0.f)
+      pruneMargin_ = std::min(pruneMargin_, -std::log(pruneRelative));
+    if(pruneAbsolute > 0.f)
+      pruneMargin_ = std::min(pruneMargin_, pruneAbsolute);
+    maxCandidates_ = options_->get<size_t>("beam-max-candidates", 0);
+
+    if(GreedySearch::supported(options_, trgVocab_))
+      greedy_ = New<GreedySearch>(options_, scorers_, trgVocab_);
+  }
 
   // combine new expandedPathScores and previous beams into new set of beams
   Beams toHyps(const std::vector<unsigned int>& nBestKeys, // [currentDimBatch, beamSize] flattened -> ((batchIdx, beamHypIdx) flattened, word idx) flattened
@@ -40,19 +65,84 @@ public:
                const std::vector<bool>& dropBatchEntries, // [origDimBatch] - empty source batch entries are marked with true, should be cleared after first use.
                const std::vector<IndexType>& batchIdxMap) const;
 
-  std::vector<float> getAlignmentsForHypothesis( // -> P(s|t) for current t and given beam and batch dim
-      const std::vector<float> alignAll, // [beam depth, max src length, batch size, 1], flattened vector of all attention probablities
+  void getAlignmentsForHypothesis( // -> P(s|t) for current t and given beam and batch dim
+      const std::vector<float>& alignAll, // [beam depth, max src length, batch size, 1], flattened vector of all attention probablities
       Ptr<data::CorpusBatch> batch,
       int beamHypIdx,
       int currentBatchIdx,
       int origBatchIdx,
-      int currentDimBatch) const;
+      int currentDimBatch,
+      /*out*/ std::vector<float>& align) const; // reused buffer
+
+  // remove hypotheses that are too far behind the best one of their beam or exceed the number of
+  // continuations per parent hypothesis; beams never grow again, so the search continues narrower
+  Beams pruneBeams(const Beams& beams) const;
+
+  // --ensemble-parallel: steps all scorers concurrently on their own graphs and returns the expanded
+  // path scores [currentDimBatch, 1, beamSize, dimVocab] as a node of the search graph
+  Expr stepEnsembleInParallel(Ptr<ExpressionGraph> graph,
+                              std::vector<Ptr<ScorerState>>& states,
+                              const std::vector<IndexType>& hypIndices,
+                              const Words& prevWords,
+                              const std::vector<IndexType>& batchIndices,
+                              int beamSize,
+                              Expr prevPathScores,
+                              bool first);
+
+  // Speculative decoding of a single sentence, see setDraft(): the draft model proposes the next words of
+  // every hypothesis in the beam, the main model scores them in one multi-word step, and the beam is
+  // advanced along them for as long as the steps of searchBeams() would select exactly these words, with
+  // no EOS, pruning, or near tie that rounding could decide differently. Returns the number of steps
+  // taken; the states then hold `length` plus that many positions and the hypotheses' last words are
+  // left for the next step of searchBeams(), which also decides where the draft words were rejected.
+  size_t speculate(Ptr<ExpressionGraph> graph,
+                   /*in/out*/ Ptr<ScorerState>& state,
+                   /*in/out*/ Ptr<ScorerState>& draftState,
+                   /*in/out*/ Beam& beam,
+                   Ptr<History> history,
+                   const std::vector<WordIndex>& suppressed,
+                   size_t length, // number of positions in both states
+                   float maxLength);
 
   // remove all beam entries that have reached EOS
   Beams purgeBeams(const Beams& beams, /*in/out=*/std::vector<IndexType>& batchIdxMap);
 
+  // start states of all scorers with the decoder stepped through the sentence start and all but the
+  // last word of the prefix, continued from and saved to the session; runs a forward pass
+  std::vector<Ptr<ScorerState>> forcePrefix(Ptr<ExpressionGraph> graph,
+                                            Ptr<data::CorpusBatch> batch,
+                                            const Words& prefix,
+                                            const std::string& source,
+                                            /*in/out*/ Ptr<const PrefixSession>& session);
+
+  // beam search over all sentences of the batch, optionally continuing a forced prefix of a single sentence
+  Histories searchBeams(Ptr<ExpressionGraph> graph,
+                        Ptr<data::CorpusBatch> batch,
+                        const Words* prefix,
+                        const std::string& source,
+                        Ptr<const PrefixSession>* session);
+
+  // Speculative decoding with a beam (SpeculativeSearch for --beam-size > 1): searchBeams() keeps the given
+  // draft model in step with the beam and lets it propose draftWords words per hypothesis, see speculate().
+  // Requires a single main scorer and single-sentence batches.
+  void setDraft(Ptr<Scorer> draft, size_t draftWords) {
+    ABORT_IF(scorers_.size() != 1, "Speculative decoding does not support ensembles");
+    draft_ = draft;
+    draftWords_ = draftWords;
+  }
+
   // main decoding function
   Histories search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
+
+  // Decodes a single source sentence whose translation has to start with the given target prefix.
+  // Only the suffix is searched, the prefix words get a score of 0. The session holds the encoder
+  // and decoder states after an earlier, shorter prefix of the same source line; they are continued
+  // if they fit and the session is replaced by one with the states after this prefix.
+  Histories search(Ptr<ExpressionGraph> graph,
+                   Ptr<data::CorpusBatch> batch,
+                   const Words& prefix,
+                   const std::string& source,
+                   /*in/out*/ Ptr<const PrefixSession>& session);
 };
 
 }  // namespace marian
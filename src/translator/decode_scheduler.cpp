@@ -0,0 +1,73 @@
+#include "translator/decode_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace marian {
+
+namespace {
+
+// work of one decoder step for one hypothesis apart from attention, i.e. feed-forward and output
+// layers, in multiples of attending over one position; only the ratio to the attention cost matters
+const double STEP_COST = 64.0;
+
+}  // namespace
+
+DecodeScheduler::DecodeScheduler(Ptr<Options> options, size_t workers)
+    : workers_(std::max(workers, (size_t)1)),
+      beamSize_(options->get<size_t>("beam-size")),
+      maxLengthFactor_(options->get<float>("max-length-factor")) {
+  // one maxi-batch, but enough batches to keep all workers busy
+  window_ = std::max((size_t)std::max(options->get<int>("maxi-batch"), 1), 2 * workers_);
+}
+
+double DecodeScheduler::cost(Ptr<data::CorpusBatch> batch) const {
+  double rows  = (double)batch->size();
+  double width = (double)batch->front()->batchWidth();
+  double steps = width * std::min(1.f, maxLengthFactor_); // expected target length, at most the length limit
+
+  // the encoder attends once over the source, every decoder step runs all hypotheses of the batch
+  // through the layers and attends over the source and on average half of the target history
+  double encoder = rows * width * (STEP_COST + width);
+  double decoder = rows * beamSize_ * steps * (STEP_COST + width + steps / 2);
+  return encoder + decoder;
+}
+
+std::vector<Ptr<data::CorpusBatch>> DecodeScheduler::schedule(
+    const std::vector<Ptr<data::CorpusBatch>>& window) const {
+  if(workers_ == 1)
+    return window;
+
+  std::vector<std::pair<double, Ptr<data::CorpusBatch>>> costs;
+  double total = 0;
+  for(auto batch : window) {
+    costs.emplace_back(cost(batch), batch);
+    total += costs.back().first;
+  }
+
+  // a batch above half of a worker's share would keep its worker busy after the others are done
+  double limit = total / (2 * workers_);
+  std::vector<std::pair<double, Ptr<data::CorpusBatch>>> pieces;
+  for(const auto& entry : costs) {
+    size_t n = std::min(entry.second->size(), (size_t)std::ceil(entry.first / limit));
+    if(n <= 1) {
+      pieces.push_back(entry);
+      continue;
+    }
+    for(auto piece : entry.second->split(n, SIZE_MAX)) {
+      auto batch = std::static_pointer_cast<data::CorpusBatch>(piece);
+      pieces.emplace_back(cost(batch), batch);
+    }
+  }
+
+  std::stable_sort(pieces.begin(), pieces.end(),
+                   [](const std::pair<double, Ptr<data::CorpusBatch>>& a,
+                      const std::pair<double, Ptr<data::CorpusBatch>>& b) { return a.first > b.first; });
+
+  std::vector<Ptr<data::CorpusBatch>> scheduled;
+  for(const auto& entry : pieces)
+    scheduled.push_back(entry.second);
+  return scheduled;
+}
+
+}  // namespace marian
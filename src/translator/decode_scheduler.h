@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common/options.h"
+#include "data/corpus_base.h"
+
+#include <vector>
+
+namespace marian {
+
+/**
+ * Orders the batches of a maxi-batch for decoding on several worker threads, see --decode-schedule cost.
+ *
+ * The workers take batches from a shared queue, so the order of the queue decides how well their
+ * load is balanced. Each batch gets an estimated cost from its source length, the expected target
+ * length and the beam size. Batches that cost more than half of a worker's fair share of the
+ * maxi-batch are split into pieces of about that size, and all batches are queued most expensive
+ * first (longest processing time first), so that the cheap ones fill the gaps at the end. Sentence
+ * IDs are kept, the output collector restores the input order.
+ */
+class DecodeScheduler {
+private:
+  size_t workers_;
+  size_t beamSize_;
+  float maxLengthFactor_;
+  size_t window_;
+
+public:
+  DecodeScheduler(Ptr<Options> options, size_t workers);
+
+  // number of batches to collect before scheduling them
+  size_t window() const { return window_; }
+
+  // estimated decoding cost of the batch in multiples of attending over one position
+  double cost(Ptr<data::CorpusBatch> batch) const;
+
+  // the batches of the window, possibly split, in the order they should be decoded
+  std::vector<Ptr<data::CorpusBatch>> schedule(const std::vector<Ptr<data::CorpusBatch>>& window) const;
+};
+
+}  // namespace marian
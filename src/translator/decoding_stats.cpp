@@ -0,0 +1,136 @@
+#include "translator/decoding_stats.h"
+
+#include "common/timer.h"
+
+#include <numeric>
+
+namespace marian {
+
+namespace {
+
+// Runs the encoders and the given number of decoder steps of a search on the batch, every sentence
+// with the full beam; false as soon as a step does not fit into the workspace
+bool decodingFits(Ptr<ExpressionGraph> graph,
+                  const std::vector<Ptr<Scorer>>& scorers,
+                  Ptr<data::CorpusBatch> batch,
+                  int beamSize,
+                  size_t steps,
+                  Word word) {
+  for(auto scorer : scorers)
+    scorer->clear(graph);
+
+  std::vector<Ptr<ScorerState>> states;
+  for(auto scorer : scorers)
+    states.push_back(scorer->startState(graph, batch));
+
+  const int dimBatch = (int)batch->size();
+  std::vector<IndexType> batchIndices(dimBatch);
+  std::iota(batchIndices.begin(), batchIndices.end(), 0);
+
+  for(size_t t = 0; t < steps; ++t) {
+    // the first step starts all hypotheses of a sentence from its single start state
+    int dimBeam = t == 0 ? 1 : beamSize;
+    std::vector<IndexType> hypIndices;
+    Words words;
+    if(t > 0) {
+      for(int b = 0; b < dimBeam; ++b)
+        for(int i = 0; i < dimBatch; ++i)
+          hypIndices.push_back((IndexType)((t == 1 ? 0 : b) * dimBatch + i));
+      words.assign(hypIndices.size(), word);
+    }
+
+    Expr pathScores; // as in BeamSearch, without the n-best selection outside of the graph
+    for(size_t i = 0; i < scorers.size(); ++i) {
+      states[i] = scorers[i]->step(graph, states[i], hypIndices, words, batchIndices, dimBeam);
+      auto logProbs = scorers[i]->getWeight() * states[i]->getLogProbs().getLogits();
+      pathScores = pathScores ? pathScores + logProbs : logProbs;
+    }
+    pathScores = swapAxes(pathScores, 0, 2); // the layout n-best selection works on
+
+    if(!graph->forwardFits())
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+Ptr<data::BatchStats> collectDecodingStats(Ptr<Options> options,
+                                           Ptr<ExpressionGraph> graph,
+                                           const std::vector<Ptr<Scorer>>& scorers,
+                                           const std::vector<Ptr<Vocab>>& srcVocabs,
+                                           Ptr<const Vocab> trgVocab) {
+  ABORT_IF(scorers[0]->getGraph(), "--mini-batch-fit cannot be combined with --ensemble-parallel");
+  timer::Timer timer;
+
+  auto stats = New<data::BatchStats>();
+  size_t step = options->get<size_t>("mini-batch-fit-step");
+  size_t maxLength = options->get<size_t>("max-length");
+  maxLength = (size_t)(std::ceil(maxLength / (float)step) * step);
+  int beamSize = (int)options->get<size_t>("beam-size");
+  float maxLengthFactor = options->get<float>("max-length-factor");
+  Word word = trgVocab->getUnkId(); // any word, the decoder is not supposed to finish early
+
+  auto fits = [&](size_t length, size_t batchSize) {
+    std::vector<size_t> lengths(srcVocabs.size(), length);
+    auto batch = data::CorpusBatch::fakeBatch(lengths, srcVocabs, batchSize, /*options=*/nullptr);
+    size_t steps = (size_t)std::ceil(maxLengthFactor * length);
+    bool result = decodingFits(graph, scorers, batch, beamSize, steps, word);
+    LOG(debug, "[batching] length: {} - size: {} - fits: {}", length, batchSize, result);
+    return result;
+  };
+
+  // upper bound for the binary search at the shortest length, then shrinking with the length
+  size_t fitting = 0; // largest batch size known to fit at the shortest length
+  size_t maxBatch = 64;
+  while(fits(step, maxBatch)) {
+    fitting = maxBatch;
+    maxBatch *= 2;
+  }
+  maxBatch--;
+
+  // Lengths are probed in growing distances, about 25% apart, as every probe decodes up to
+  // --max-length-factor times the length. Lengths in between get the batch size of the next probed
+  // length, which is never too large as batch sizes only shrink with the length.
+  size_t probed = 0;
+  for(size_t length = step; probed < maxLength;) {
+    // binary search in [start, end]: the shortest length continues from the sizes probed above, at
+    // the following lengths the batch size of the previous length still fits in most cases
+    size_t start = 1;
+    size_t end = maxBatch;
+    if(length == step)
+      start = fitting + 1;
+    else if(fits(length, maxBatch))
+      start = maxBatch + 1;
+    else
+      end = maxBatch - 1;
+    while(end >= start) {
+      size_t current = (start + end) / 2;
+      if(fits(length, current))
+        start = current + 1;
+      else
+        end = current - 1;
+    }
+    size_t batchSize = start - 1;
+
+    if(batchSize == 0)
+      LOG(warn, "[batching] A single sentence of length {} does not fit into the workspace, consider increasing --workspace", length);
+    if(batchSize <= 1)
+      break; // longer sentences are translated one at a time anyway, see below
+
+    for(size_t l = probed + step; l <= length; l += step)
+      stats->add(std::vector<size_t>(srcVocabs.size(), l), batchSize);
+    probed = length;
+    maxBatch = batchSize;
+    length = std::min(maxLength, std::max(length + step, (size_t)(std::ceil(length * 1.25f / step) * step)));
+  }
+  // longer sentences than probed are translated one at a time
+  stats->add(std::vector<size_t>(srcVocabs.size(), SIZE_MAX), 1);
+
+  for(auto scorer : scorers)
+    scorer->clear(graph);
+  LOG(info, "[batching] Collected batch sizes for lengths up to {} in {:.2f}s", probed, timer.elapsed());
+  return stats;
+}
+
+}  // namespace marian
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "data/batch_stats.h"
+#include "translator/scorers.h"
+
+namespace marian {
+
+/**
+ * Inference counterpart of GraphGroup::collectStats() for --mini-batch-fit: finds the largest number
+ * of sentences per source length that can be translated within the workspace of the graph.
+ *
+ * Each probe encodes a fake batch and steps the decoders with the full beam for as many steps as the
+ * length limit of the search allows (--max-length-factor), so that the largest decoder states and
+ * output layers of a real search are covered. Lengths are multiples of --mini-batch-fit-step up to
+ * --max-length, probed about 25% apart, with the batch size of the previous length first and by binary
+ * search below it otherwise. Probing stops at the first length where only one sentence fits, longer
+ * sentences are translated one at a time.
+ */
+Ptr<data::BatchStats> collectDecodingStats(Ptr<Options> options,
+                                           Ptr<ExpressionGraph> graph,
+                                           const std::vector<Ptr<Scorer>>& scorers,
+                                           const std::vector<Ptr<Vocab>>& srcVocabs,
+                                           Ptr<const Vocab> trgVocab);
+
+}  // namespace marian
@@ -0,0 +1,144 @@
+#include "translator/greedy_search.h"
+
+#include "data/factored_vocab.h"
+#include "data/shortlist.h"
+
+namespace marian {
+
+bool GreedySearch::supported(Ptr<Options> options, const Ptr<const Vocab> trgVocab) {
+  return options->get<size_t>("beam-size") == 1
+         && !options->get<bool>("n-best", false)      // needs the score breakdown per scorer
+         && !options->hasAndNotEmpty("alignment")     // needs the attention of every step
+         && !trgVocab->tryAs<FactoredVocab>()         // factors are predicted one group at a time
+         && !options->get<bool>("ensemble-parallel", false); // members run on graphs of their own
+}
+
+Expr GreedySearch::suppressionMask(Ptr<ExpressionGraph> graph, int dimVocab) const {
+  bool suppressUnk     = !options_->get<bool>("allow-unk", false);
+  bool suppressSpecial = !options_->get<bool>("allow-special", false);
+  if(!suppressUnk && !suppressSpecial)
+    return nullptr;
+
+  std::vector<float> mask(dimVocab, 0.f);
+  bool any = false;
+  auto shortlist = scorers_[0]->getShortlist(); // same as in BeamSearch
+  for(auto i : trgVocab_->suppressedIndices(suppressUnk, suppressSpecial)) {
+    auto index = shortlist ? shortlist->tryForwardMap(i) : i;
+    if(index == data::Shortlist::npos || index >= (WordIndex)dimVocab)
+      continue;
+    mask[index] = NumericLimits<float>(Type::float32).lowest;
+    any = true;
+  }
+  return any ? graph->constant({dimVocab}, inits::fromVector(mask), Type::float32) : nullptr;
+}
+
+Histories GreedySearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch) {
+  HypothesisPool::Scope hypothesisPool; // all hypotheses of this batch are freed together with its histories
+
+  const int origDimBatch = (int)batch->size();
+  const auto trgEosId = trgVocab_->getEosId();
+  const auto srcEosId = batch->front()->vocab()->getEosId();
+  const float maxLength = options_->get<float>("max-length-factor") * batch->front()->batchWidth();
+
+  for(auto scorer : scorers_)
+    scorer->clear(graph);
+
+  std::vector<Ptr<ScorerState>> states;
+  for(auto scorer : scorers_)
+    states.push_back(scorer->startState(graph, batch));
+
+  std::vector<Words> words(origDimBatch);               // output words per sentence
+  std::vector<std::vector<float>> scores(origDimBatch); // their log probs per sentence
+
+  // rows of the current decoder states, each row is the original batch index of an unfinished sentence
+  std::vector<IndexType> active(origDimBatch);
+  std::iota(active.begin(), active.end(), 0);
+
+  std::vector<IndexType> batchIndices = active; // rows of the previous states to continue with
+  std::vector<IndexType> hypIndices;            // empty as long as no sentence has finished since the last step
+  Words prevWords;
+
+  Expr mask;
+  std::vector<IndexType> bestIndices;
+  std::vector<float> bestScores;
+  for(size_t t = 0; ; t++) {
+    Expr pathScores; // [1, 1, currentDimBatch, dimVocab]
+    for(size_t i = 0; i < scorers_.size(); ++i) {
+      states[i] = scorers_[i]->step(graph, states[i], hypIndices, prevWords, batchIndices, /*beamSize=*/1);
+      auto logProbs = scorers_[i]->getWeight() * states[i]->getLogProbs().getLogits();
+      pathScores = pathScores ? pathScores + logProbs : logProbs;
+    }
+
+    if(t == 0)
+      mask = suppressionMask(graph, pathScores->shape()[-1]);
+    if(mask)
+      pathScores = pathScores + cast(mask, pathScores->value_type());
+
+    auto best = argmax(pathScores, /*axis=*/-1);
+    auto bestScore = cast(get<0>(best), Type::float32);
+
+    if(t == 0)
+      graph->forward();
+    else
+      graph->forwardNext();
+
+    get<1>(best)->val()->get(bestIndices);
+    bestScore->val()->get(bestScores);
+
+    // same limit as in BeamSearch, where the history already contains the start hypothesis
+    bool maxLengthReached = t + 1 >= maxLength;
+
+    auto shortlist = scorers_[0]->getShortlist();
+    std::vector<IndexType> nextActive, nextBatchIndices;
+    Words nextWords;
+    for(IndexType row = 0; row < (IndexType)active.size(); ++row) {
+      auto origBatchIdx = active[row];
+      Word word; float score;
+      if(t == 0 && batch->front()->data()[origBatchIdx] == srcEosId) { // empty input, force EOS as in BeamSearch
+        word = trgEosId;
+        score = 0.f;
+      } else {
+        auto wordIdx = bestIndices[row];
+        word = Word::fromWordIndex(shortlist ? shortlist->reverseMap(0, (int)origBatchIdx, (int)wordIdx) : wordIdx);
+        score = bestScores[row];
+      }
+      words[origBatchIdx].push_back(word);
+      scores[origBatchIdx].push_back(score);
+
+      if(word != trgEosId && !maxLengthReached) {
+        nextActive.push_back(origBatchIdx);
+        nextBatchIndices.push_back(row);
+        nextWords.push_back(word);
+      }
+    }
+
+    if(nextActive.empty())
+      break;
+
+    // states only need to be subselected if sentences have finished
+    if(nextActive.size() < active.size())
+      hypIndices = nextBatchIndices;
+    else
+      hypIndices.clear();
+    batchIndices = nextBatchIndices;
+    prevWords = nextWords;
+    active = nextActive;
+  }
+
+  // build the hypotheses of each translation for History
+  Histories histories(origDimBatch);
+  for(int i = 0; i < origDimBatch; ++i) {
+    histories[i] = New<History>(batch->getSentenceIds()[i],
+                                options_->get<float>("normalize"),
+                                options_->get<float>("word-penalty"));
+    auto hyp = Hypothesis::New();
+    histories[i]->add(Beam(1, hyp), trgEosId);
+    for(size_t j = 0; j < words[i].size(); ++j) {
+      hyp = Hypothesis::New(hyp, words[i][j], 0, hyp->getPathScore() + scores[i][j]);
+      histories[i]->add(Beam(1, hyp), trgEosId, j + 1 == words[i].size());
+    }
+  }
+  return histories;
+}
+
+}  // namespace marian
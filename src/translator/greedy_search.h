@@ -0,0 +1,38 @@
+#pragma once
+
+#include "marian.h"
+#include "translator/history.h"
+#include "translator/scorers.h"
+
+namespace marian {
+
+/**
+ * Greedy decoding (beam size 1) without the beam machinery of BeamSearch: the best word of each
+ * sentence is found with an argmax over the (ensembled) logits on the device, and only the word
+ * indices and their scores are copied back. Words and scores are kept in flat per-sentence arrays,
+ * the hypotheses needed by History are created once at the end.
+ *
+ * Used by BeamSearch::search() if supported(), i.e. for beam size 1 without n-best lists,
+ * alignments or factored vocabularies.
+ */
+class GreedySearch {
+private:
+  Ptr<Options> options_;
+  std::vector<Ptr<Scorer>> scorers_;
+  Ptr<const Vocab> trgVocab_;
+
+  // additive mask (0 or lowest) of words that must not be produced, nullptr if there are none
+  Expr suppressionMask(Ptr<ExpressionGraph> graph, int dimVocab) const;
+
+public:
+  GreedySearch(Ptr<Options> options, const std::vector<Ptr<Scorer>>& scorers, const Ptr<const Vocab> trgVocab)
+      : options_(options), scorers_(scorers), trgVocab_(trgVocab) {}
+
+  // true if the options and vocabulary allow greedy decoding with this class
+  static bool supported(Ptr<Options> options, const Ptr<const Vocab> trgVocab);
+
+  // main decoding function
+  Histories search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
+};
+
+}  // namespace marian
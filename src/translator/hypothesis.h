@@ -3,6 +3,7 @@
 
 #include "common/definitions.h"
 #include "data/alignment.h"
+#include "translator/hypothesis_pool.h"
 
 namespace marian {
 
@@ -14,6 +15,7 @@ namespace marian {
 class Hypothesis {
 public:
   typedef IPtr<Hypothesis> PtrType;
+  typedef std::vector<float, PoolAllocator<float>> Floats; // backed by the pool of the search, if any
 
 private:
   // Constructors are private, use Hypothesis::New(...)
@@ -26,6 +28,29 @@ private:
              float pathScore)
       : prevHyp_(prevHyp), prevBeamHypIdx_(prevBeamHypIdx), word_(word), pathScore_(pathScore) {}
 
+  // Hypotheses are placed in the pool of the current HypothesisPool::Scope, if any, otherwise on
+  // the heap. The header in front of each object records the pool, which is kept alive until the
+  // hypothesis is deleted; pooled memory itself is only released with the pool.
+  static const size_t HEADER_SIZE = alignof(std::max_align_t);
+
+  static void* operator new(size_t size) {
+    auto pool = HypothesisPool::current();
+    char* p = (char*)(pool ? pool->allocate(HEADER_SIZE + size) : ::operator new(HEADER_SIZE + size));
+    *reinterpret_cast<HypothesisPool**>(p) = pool;
+    if(pool)
+      intrusivePtrAddRef(pool);
+    return p + HEADER_SIZE;
+  }
+
+  static void operator delete(void* ptr) {
+    char* p = (char*)ptr - HEADER_SIZE;
+    auto pool = *reinterpret_cast<HypothesisPool**>(p);
+    if(pool)
+      intrusivePtrRelease(pool);
+    else
+      ::operator delete(p);
+  }
+
 public:
  // Use this whenever creating a pointer to MemoryPiece
  template <class ...Args>
@@ -41,11 +66,13 @@ public:
 
   float getPathScore() const { return pathScore_; }
 
-  const std::vector<float>& getScoreBreakdown() { return scoreBreakdown_; }
-  void setScoreBreakdown(const std::vector<float>& scoreBreakdown) { scoreBreakdown_ = scoreBreakdown; }
+  const Floats& getScoreBreakdown() { return scoreBreakdown_; }
+  template <class Vector>
+  void setScoreBreakdown(const Vector& scoreBreakdown) { scoreBreakdown_.assign(scoreBreakdown.begin(), scoreBreakdown.end()); }
 
-  const std::vector<float>& getAlignment() { return alignment_; }
-  void setAlignment(const std::vector<float>& align) { alignment_ = align; };
+  const Floats& getAlignment() { return alignment_; }
+  template <class Vector>
+  void setAlignment(const Vector& align) { alignment_.assign(align.begin(), align.end()); };
 
   // trace back paths referenced from this hypothesis
   Words tracebackWords() {
@@ -76,7 +103,7 @@ public:
   SoftAlignment tracebackAlignment() {
     SoftAlignment align;
     for(auto hyp = this; hyp->getPrevHyp(); hyp = hyp->getPrevHyp().get()) {
-      align.push_back(hyp->getAlignment());
+      align.emplace_back(hyp->getAlignment().begin(), hyp->getAlignment().end());
     }
     std::reverse(align.begin(), align.end());
     return align;  // [t][s] -> P(s|t)
@@ -88,8 +115,8 @@ private:
   const Word word_;
   const float pathScore_;
 
-  std::vector<float> scoreBreakdown_; // [num scorers]
-  std::vector<float> alignment_;
+  Floats scoreBreakdown_; // [num scorers]
+  Floats alignment_;
 
   ENABLE_INTRUSIVE_PTR(Hypothesis)
 };
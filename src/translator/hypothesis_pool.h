@@ -0,0 +1,93 @@
+#pragma once
+
+#include "common/definitions.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace marian {
+
+// Arena for the hypotheses of one search: memory is handed out by bumping a pointer through large
+// blocks and is only returned all at once when the pool is destroyed. Each pooled Hypothesis holds
+// a reference to its pool, so the pool lives until the last hypothesis of a search, usually held
+// by the Histories, is released after printing.
+//
+// Not thread-safe, just like the reference counting of hypotheses; a pool belongs to the thread
+// running the search.
+class HypothesisPool {
+private:
+  static const size_t BLOCK_SIZE = 64 * 1024;
+  static const size_t ALIGNMENT  = alignof(std::max_align_t);
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* next_{nullptr};
+  size_t left_{0};
+
+  static HypothesisPool*& current_() {
+    static thread_local HypothesisPool* pool = nullptr;
+    return pool;
+  }
+
+  ENABLE_INTRUSIVE_PTR(HypothesisPool)
+
+public:
+  void* allocate(size_t bytes) {
+    bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    if(bytes > left_) {
+      size_t size = std::max(bytes, BLOCK_SIZE);
+      blocks_.emplace_back(new char[size]); // aligned for any fundamental type
+      next_ = blocks_.back().get();
+      left_ = size;
+    }
+    void* p = next_;
+    next_ += bytes;
+    left_ -= bytes;
+    return p;
+  }
+
+  // pool of the innermost Scope on this thread, nullptr outside of a search
+  static HypothesisPool* current() { return current_(); }
+
+  // Creates a pool that backs all hypotheses created on this thread during its lifetime
+  class Scope {
+  private:
+    IPtr<HypothesisPool> pool_;
+    HypothesisPool* prev_;
+
+  public:
+    Scope() : pool_(new HypothesisPool()), prev_(current_()) { current_() = pool_.get(); }
+    ~Scope() { current_() = prev_; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+};
+
+// Allocator for the vectors held by pooled hypotheses, falls back to the heap without a pool.
+// Deallocation of pooled memory is a no-op, it is released with the pool.
+template <typename T>
+class PoolAllocator {
+public:
+  typedef T value_type;
+
+  HypothesisPool* pool_;
+
+  PoolAllocator(HypothesisPool* pool = HypothesisPool::current()) : pool_(pool) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool_) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(pool_ ? pool_->allocate(n * sizeof(T)) : ::operator new(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t /*n*/) {
+    if(!pool_)
+      ::operator delete(p);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.pool_ == b.pool_; }
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) { return a.pool_ != b.pool_; }
+
+}  // namespace marian
@@ -7,11 +7,11 @@
 namespace marian {
 
 OutputCollector::OutputCollector()
-  : nextId_(0),
+  : ring_(new Slot[RING_SIZE]),
     printing_(new DefaultPrinting()) {}
 
 OutputCollector::OutputCollector(std::string outFile)
-  : nextId_(0),
+  : ring_(new Slot[RING_SIZE]),
     outStrm_(new std::ostream(std::cout.rdbuf())),
     printing_(new DefaultPrinting()) {
   if (outFile != "stdout")
@@ -22,60 +22,94 @@ void OutputCollector::Write(long sourceId,
                             const std::string& best1,
                             const std::string& bestn,
                             bool nbest) {
+  if(!segmenter_) {
+    store(sourceId, best1, bestn, nbest);
+  } else {
+    size_t lineId;
+    std::string line;
+    if(segmenter_->join((size_t)sourceId, best1, lineId, line))
+      store((long)lineId, line, bestn, nbest);
+  }
+}
+
+void OutputCollector::store(long sourceId,
+                            const std::string& best1,
+                            const std::string& bestn,
+                            bool nbest) {
+  // Slot sourceId % RING_SIZE is free once all lines before sourceId - RING_SIZE + 1 are written,
+  // since the writing thread releases a slot before advancing nextId_
+  if(sourceId - nextId_.load() < RING_SIZE) {
+    auto& slot = ring_[sourceId % RING_SIZE];
+    slot.best1.assign(best1);
+    if(nbest)
+      slot.bestn.assign(bestn);
+    slot.id.store(sourceId); // publish
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_[sourceId] = std::make_pair(best1, nbest ? bestn : std::string());
+    numOutputs_++;
+  }
+  flush(nbest);
+}
+
+bool OutputCollector::isReady(long id) {
+  if(ring_[id % RING_SIZE].id.load() == id)
+    return true;
+  if(numOutputs_.load() == 0)
+    return false;
   std::lock_guard<std::mutex> lock(mutex_);
-  if(sourceId == nextId_) {
-    if(printing_->shouldBePrinted(sourceId))
-      LOG(info, "Best translation {} : {}", sourceId, best1);
-
-    if(outStrm_) {
-      if(nbest)
-        *outStrm_ << bestn << std::endl;
-      else
-        *outStrm_ << best1 << std::endl;
-    }
+  return outputs_.count(id) > 0;
+}
+
+bool OutputCollector::takeOutput(long id, std::pair<std::string, std::string>& output) {
+  if(numOutputs_.load() == 0)
+    return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = outputs_.find(id);
+  if(it == outputs_.end())
+    return false;
+  output = std::move(it->second);
+  outputs_.erase(it);
+  numOutputs_--;
+  return true;
+}
+
+void OutputCollector::writeLine(long id, const std::string& best1, const std::string& bestn, bool nbest) {
+  if(printing_->shouldBePrinted(id))
+    LOG(info, "Best translation {} : {}", id, best1);
 
-    ++nextId_;
-
-    Outputs::const_iterator iter, iterNext;
-    iter = outputs_.begin();
-    while(iter != outputs_.end()) {
-      long currId = iter->first;
-
-      if(currId == nextId_) {
-        // 1st element in the map is the next
-        const auto& currOutput = iter->second;
-        if(printing_->shouldBePrinted(currId))
-          LOG(info, "Best translation {} : {}", currId, currOutput.first);
-
-        if(outStrm_) {
-          if(nbest)
-            *outStrm_ << currOutput.second << std::endl;
-          else
-            *outStrm_ << currOutput.first << std::endl;
-        }
-
-        ++nextId_;
-
-        // delete current record, move iter on 1
-        iterNext = iter;
-        ++iterNext;
-        outputs_.erase(iter);
-        iter = iterNext;
+  if(outStrm_) {
+    const auto& line = nbest ? bestn : best1;
+    outStrm_->write(line.data(), line.size());
+    outStrm_->put('\n');
+  }
+}
+
+void OutputCollector::flush(bool nbest) {
+  // Only one thread writes at a time. A thread that finds another one writing leaves its line to
+  // that thread, which checks for the next line again after it stopped writing, so no line is missed.
+  while(isReady(nextId_.load()) && !flushing_.exchange(true)) {
+    bool written = false;
+    std::pair<std::string, std::string> output;
+    for(long id = nextId_.load(); ; ++id) {
+      auto& slot = ring_[id % RING_SIZE];
+      if(slot.id.load() == id) {
+        writeLine(id, slot.best1, slot.bestn, nbest);
+        slot.id.store(-1);
+      } else if(takeOutput(id, output)) {
+        writeLine(id, output.first, output.second, nbest);
       } else {
-        // not the next. stop iterating
-        assert(nextId_ < currId);
         break;
       }
+      nextId_.store(id + 1);
+      written = true;
     }
 
-    // for 1-best, flush stdout so that we can consume this immediately from an
-    // external process
-    if(outStrm_ && !nbest)
+    // one flush for all lines, so that the output can be consumed immediately by an external process
+    if(outStrm_ && written)
       *outStrm_ << std::flush;
 
-  } else {
-    // save for later
-    outputs_[sourceId] = std::make_pair(best1, bestn);
+    flushing_.store(false);
   }
 }
 
@@ -84,10 +118,19 @@ StringCollector::StringCollector(bool quiet /*=false*/) : maxId_(-1), quiet_(qui
 void StringCollector::add(long sourceId,
                           const std::string& best1,
                           const std::string& bestn) {
+  std::string line;
+  if(segmenter_) {
+    size_t lineId;
+    if(!segmenter_->join((size_t)sourceId, best1, lineId, line))
+      return;
+    sourceId = (long)lineId;
+  }
+  const std::string& output = segmenter_ ? line : best1;
+
   std::lock_guard<std::mutex> lock(mutex_);
   if(!quiet_)
-    LOG(info, "Best translation {} : {}", sourceId, best1);
-  outputs_[sourceId] = std::make_pair(best1, bestn);
+    LOG(info, "Best translation {} : {}", sourceId, output);
+  outputs_[sourceId] = std::make_pair(output, bestn);
   if(maxId_ <= sourceId)
     maxId_ = sourceId;
 }
@@ -2,7 +2,9 @@
 
 #include "common/definitions.h"
 #include "common/file_stream.h"
+#include "data/segmenter.h"
 
+#include <atomic>
 #include <mutex>
 #include <iostream>
 #include <map>
@@ -44,16 +46,22 @@ private:
   long next_{10};
 };
 
+// Writes translations in the order of their line numbers while they arrive out of order from
+// several worker threads. Lines are handed over through a ring of slots indexed by line number,
+// without a lock: whichever thread completes the next line writes out all contiguous lines that
+// are ready and flushes the stream once. Lines too far ahead of the output for the ring are kept
+// in a map guarded by a mutex.
 class OutputCollector {
 public:
   OutputCollector();
   OutputCollector(std::string outFile);
 
   template <class T>
-  OutputCollector(T&& arg) : nextId_(0), outStrm_(new io::OutputFileStream(arg)) {}
+  OutputCollector(T&& arg) : ring_(new Slot[RING_SIZE]), outStrm_(new io::OutputFileStream(arg)) {}
 
   OutputCollector(const OutputCollector&) = delete;
 
+  // bestn is only used (and copied) if nbest is true
   void Write(long sourceId,
              const std::string& best1,
              const std::string& bestn,
@@ -63,13 +71,37 @@ public:
     printing_ = strategy;
   }
 
+  // Source IDs are then segment IDs, the translations of the segments of a line are written as one line
+  void setSegmenter(Ptr<data::Segmenter> segmenter) {
+    segmenter_ = segmenter;
+  }
+
 protected:
+  struct Slot {
+    std::atomic<long> id{-1}; // line number held by this slot, -1 if free
+    std::string best1;        // keep their capacity when the slot is reused
+    std::string bestn;
+  };
+  static const long RING_SIZE = 4096;
+  std::unique_ptr<Slot[]> ring_;
+
+  std::atomic<long> nextId_{0};       // next line to be written
+  std::atomic<bool> flushing_{false}; // set while a thread is writing lines
+
   typedef std::map<long, std::pair<std::string, std::string>> Outputs;
-  Outputs outputs_;
-  long nextId_;
+  Outputs outputs_;                   // lines that do not fit into the ring yet
+  std::atomic<size_t> numOutputs_{0};
+  std::mutex mutex_;                  // guards outputs_
+
   UPtr<std::ostream> outStrm_;
   Ptr<PrintingStrategy> printing_;
-  std::mutex mutex_;
+  Ptr<data::Segmenter> segmenter_;
+
+  void store(long id, const std::string& best1, const std::string& bestn, bool nbest);
+  bool isReady(long id);
+  bool takeOutput(long id, std::pair<std::string, std::string>& output);
+  void writeLine(long id, const std::string& best1, const std::string& bestn, bool nbest);
+  void flush(bool nbest);
 };
 
 class StringCollector {
@@ -80,6 +112,9 @@ public:
   void add(long sourceId, const std::string& best1, const std::string& bestn);
   std::vector<std::string> collect(bool nbest);
 
+  // see OutputCollector::setSegmenter()
+  void setSegmenter(Ptr<data::Segmenter> segmenter) { segmenter_ = segmenter; }
+
 protected:
   long maxId_;  // the largest index of the translated source sentences
   bool quiet_;  // if true do not log best translations
@@ -87,5 +122,6 @@ protected:
 
   typedef std::map<long, std::pair<std::string, std::string>> Outputs;
   Outputs outputs_;
+  Ptr<data::Segmenter> segmenter_;
 };
 }  // namespace marian
@@ -1,38 +1,102 @@
 #include "output_printer.h"
 
-#include <sstream>
-
 namespace marian {
 
-std::string OutputPrinter::getAlignment(const Hypothesis::PtrType& hyp) {
-  data::SoftAlignment align;
-  auto last = hyp;
-  // get soft alignments for each target word starting from the last one
-  while(last->getPrevHyp().get() != nullptr) {
-    align.push_back(last->getAlignment());
-    last = last->getPrevHyp();
+using utils::appendInt;
+using utils::appendFloat;
+
+void OutputPrinter::print(Ptr<const History> history, std::string& best1, std::string& bestn) {
+  best1.clear();
+  bestn.clear();
+
+  const auto& nbl = history->nBest(nbest_);
+
+  // prepare n-best list output
+  for(size_t i = 0; i < nbl.size(); ++i) {
+    const auto& result = nbl[i];
+    const auto& hypo = std::get<1>(result);
+    auto words = std::get<0>(result);
+
+    if(reverse_)
+      std::reverse(words.begin(), words.end());
+
+    appendInt(bestn, history->getLineNum());
+    bestn += " ||| ";
+    bestn += vocab_->decode(words);
+
+    if(!alignment_.empty()) {
+      bestn += " ||| ";
+      appendAlignment(bestn, hypo);
+    }
+
+    if(wordScores_) {
+      bestn += " ||| WordScores=";
+      appendWordScores(bestn, hypo);
+    }
+
+    bestn += " |||";
+    if(hypo->getScoreBreakdown().empty()) {
+      bestn += " F0=";
+      appendFloat(bestn, hypo->getPathScore());
+    } else {
+      for(size_t j = 0; j < hypo->getScoreBreakdown().size(); ++j) {
+        bestn += " F";
+        appendInt(bestn, j);
+        bestn += "= ";
+        appendFloat(bestn, hypo->getScoreBreakdown()[j]);
+      }
+    }
+
+    float realScore = std::get<2>(result);
+    bestn += " ||| ";
+    appendFloat(bestn, realScore);
+
+    if(i < nbl.size() - 1)
+      bestn += '\n';
   }
 
-  // reverse alignments
-  std::reverse(align.begin(), align.end());
+  auto result = history->top();
+  auto words = std::get<0>(result);
+
+  if(reverse_)
+    std::reverse(words.begin(), words.end());
+
+  best1 += vocab_->decode(words);
+  if(!alignment_.empty()) {
+    best1 += " ||| ";
+    appendAlignment(best1, std::get<1>(result));
+  }
+
+  if(wordScores_) {
+    best1 += " ||| WordScores=";
+    appendWordScores(best1, std::get<1>(result));
+  }
+}
+
+void OutputPrinter::appendAlignment(std::string& out, const Hypothesis::PtrType& hyp) {
+  data::SoftAlignment align = hyp->tracebackAlignment(); // [t][s] -> P(s|t)
 
   if(alignment_ == "soft") {
-    return data::SoftAlignToString(align);
-  } else if(alignment_ == "hard") {
-    return data::ConvertSoftAlignToHardAlign(align, 1.f).toString();
-  } else if(alignmentThreshold_ > 0.f) {
-    return data::ConvertSoftAlignToHardAlign(align, alignmentThreshold_).toString();
-  } else {
-    ABORT("Unrecognized word alignment type");
+    data::AppendSoftAlign(out, align);
+    return;
   }
+
+  float threshold;
+  if(alignment_ == "hard")
+    threshold = 1.f;
+  else if(alignmentThreshold_ > 0.f)
+    threshold = alignmentThreshold_;
+  else
+    ABORT("Unrecognized word alignment type");
+
+  data::ConvertSoftAlignToHardAlign(align, threshold).appendTo(out);
 }
 
-std::string OutputPrinter::getWordScores(const Hypothesis::PtrType& hyp) {
-  std::ostringstream scores;
-  scores.precision(5);
-  for(const auto& score : hyp->tracebackWordScores())
-    scores << " " << std::fixed << score;
-  return scores.str();
+void OutputPrinter::appendWordScores(std::string& out, const Hypothesis::PtrType& hyp) {
+  for(const auto& score : hyp->tracebackWordScores()) {
+    out += ' ';
+    appendFloat(out, score, /*fixed=*/true, /*precision=*/5);
+  }
 }
 
 }  // namespace marian
@@ -23,66 +23,17 @@ public:
         alignmentThreshold_(getAlignmentThreshold(alignment_)),
         wordScores_(options->get<bool>("word-scores")) {}
 
+  // Replaces the contents of best1 with the translation of history and of bestn with its n-best
+  // list, if requested. Numbers are formatted directly into the strings, so buffers that are
+  // reused across calls, e.g. one pair per worker thread, keep their capacity and are not reallocated.
+  void print(Ptr<const History> history, std::string& best1, std::string& bestn);
+
   template <class OStream>
   void print(Ptr<const History> history, OStream& best1, OStream& bestn) {
-    const auto& nbl = history->nBest(nbest_);
-
-    // prepare n-best list output
-    for(size_t i = 0; i < nbl.size(); ++i) {
-      const auto& result = nbl[i];
-      const auto& hypo = std::get<1>(result);
-      auto words = std::get<0>(result);
-
-      if(reverse_)
-        std::reverse(words.begin(), words.end());
-
-      std::string translation = vocab_->decode(words);
-      bestn << history->getLineNum() << " ||| " << translation;
-
-      if(!alignment_.empty())
-        bestn << " ||| " << getAlignment(hypo);
-
-      if(wordScores_)
-        bestn << " ||| WordScores=" << getWordScores(hypo);
-
-      bestn << " |||";
-      if(hypo->getScoreBreakdown().empty()) {
-        bestn << " F0=" << hypo->getPathScore();
-      } else {
-        for(size_t j = 0; j < hypo->getScoreBreakdown().size(); ++j) {
-          bestn << " F" << j << "= " << hypo->getScoreBreakdown()[j];
-        }
-      }
-
-      float realScore = std::get<2>(result);
-      bestn << " ||| " << realScore;
-
-      if(i < nbl.size() - 1)
-        bestn << std::endl;
-      else
-        bestn << std::flush;
-    }
-
-    auto result = history->top();
-    auto words = std::get<0>(result);
-
-    if(reverse_)
-      std::reverse(words.begin(), words.end());
-
-    std::string translation = vocab_->decode(words);
-
-    best1 << translation;
-    if(!alignment_.empty()) {
-      const auto& hypo = std::get<1>(result);
-      best1 << " ||| " << getAlignment(hypo);
-    }
-
-    if(wordScores_) {
-      const auto& hypo = std::get<1>(result);
-      best1 << " ||| WordScores=" << getWordScores(hypo);
-    }
-
-    best1 << std::flush;
+    std::string best1Str, bestnStr;
+    print(history, best1Str, bestnStr);
+    best1 << best1Str << std::flush;
+    bestn << bestnStr << std::flush;
   }
 
 private:
@@ -93,10 +44,10 @@ private:
   float alignmentThreshold_{0.f};  // Threshold for converting attention into hard word alignment
   bool wordScores_{false};         // Whether to print word-level scores or not
 
-  // Get word alignment pairs or soft alignment
-  std::string getAlignment(const Hypothesis::PtrType& hyp);
-  // Get word-level scores
-  std::string getWordScores(const Hypothesis::PtrType& hyp);
+  // Append word alignment pairs or soft alignment
+  void appendAlignment(std::string& out, const Hypothesis::PtrType& hyp);
+  // Append word-level scores
+  void appendWordScores(std::string& out, const Hypothesis::PtrType& hyp);
 
   float getAlignmentThreshold(const std::string& str) {
     try {
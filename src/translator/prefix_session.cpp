@@ -0,0 +1,27 @@
+#include "translator/prefix_session.h"
+
+namespace marian {
+
+Ptr<const PrefixSession> PrefixSessionCache::get(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(id);
+  if(it == index_.end())
+    return nullptr;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void PrefixSessionCache::put(const std::string& id, Ptr<const PrefixSession> session) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(id);
+  if(it != index_.end())
+    entries_.erase(it->second);
+  entries_.emplace_front(id, session);
+  index_[id] = entries_.begin();
+  while(entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+}  // namespace marian
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "marian.h"
+#include "models/states.h"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace marian {
+
+/**
+ * Decoding state of an interactive session that re-translates the same source sentence with a
+ * growing confirmed target prefix. Holds the states of all scorers after the decoder has consumed
+ * the sentence start and all but the last word of the prefix, see BeamSearch::search().
+ * Sessions are immutable once stored, every request that advances a session stores a new one.
+ */
+struct PrefixSession {
+  std::string source;                                // source line the states belong to
+  Words consumed;                                    // prefix words consumed by the saved decoder states
+  size_t steps{0};                                   // decoder steps in the saved states, 0 = encoder only
+  std::vector<Ptr<const DecoderStateSnapshot>> states; // one per scorer
+
+  // true if the saved states can be continued for the given source and confirmed prefix
+  bool continues(const std::string& line, const Words& prefix) const {
+    // decoding after a prefix of m words starts with m steps taken, the last word is fed by the search
+    return line == source && steps <= prefix.size()
+           && std::equal(consumed.begin(), consumed.end(), prefix.begin());
+  }
+};
+
+// Sessions by ID in memory, the least recently used session is dropped once there are too many
+class PrefixSessionCache {
+private:
+  typedef std::list<std::pair<std::string, Ptr<const PrefixSession>>> Entries;
+
+  size_t capacity_;
+  Entries entries_;                                                  // most recently used first
+  std::unordered_map<std::string, Entries::iterator> index_;
+  std::mutex mutex_;
+
+public:
+  PrefixSessionCache(size_t capacity) : capacity_(capacity) {}
+
+  // nullptr if there is no session with this ID
+  Ptr<const PrefixSession> get(const std::string& id);
+
+  void put(const std::string& id, Ptr<const PrefixSession> session);
+};
+
+}  // namespace marian
@@ -92,6 +92,26 @@ std::vector<Ptr<Scorer>> createScorers(Ptr<Options> options) {
   return scorers;
 }
 
+Ptr<Scorer> createDraftScorer(Ptr<Options> options) {
+  auto model = options->get<std::string>("speculative-draft", "");
+  if(model.empty())
+    return nullptr;
+
+  // load options specific for the draft model
+  auto modelOptions = New<Options>(options->clone());
+  try {
+    if(!options->get<bool>("ignore-model-config")) {
+      YAML::Node modelYaml;
+      io::getYamlFromModel(modelYaml, "special:model.yml", model);
+      modelOptions->merge(modelYaml, true);
+    }
+  } catch(std::runtime_error&) {
+    LOG(warn, "No model settings found in draft model file");
+  }
+
+  return scorerByType("draft", 1.f, model, modelOptions);
+}
+
 std::vector<Ptr<Scorer>> createScorers(Ptr<Options> options, const std::vector<const void*>& ptrs) {
   std::vector<Ptr<Scorer>> scorers;
 
@@ -21,6 +21,7 @@ class Scorer {
 protected:
   std::string name_;
   float weight_;
+  Ptr<ExpressionGraph> graph_; // own graph with --ensemble-parallel, otherwise the search graph is used
 
 public:
   Scorer(const std::string& name, float weight)
@@ -31,6 +32,9 @@ public:
   std::string getName() { return name_; }
   float getWeight() { return weight_; }
 
+  void setGraph(Ptr<ExpressionGraph> graph) { graph_ = graph; }
+  Ptr<ExpressionGraph> getGraph() { return graph_; }
+
   virtual void clear(Ptr<ExpressionGraph>) = 0;
   virtual Ptr<ScorerState> startState(Ptr<ExpressionGraph>,
                                       Ptr<data::CorpusBatch>)
@@ -45,6 +49,28 @@ public:
 
   virtual void init(Ptr<ExpressionGraph>) {}
 
+  // Speculative decoding (see SpeculativeSearch): advance the hypotheses of a single sentence by several
+  // words each in one step and drop positions from the end of a state again
+  virtual Ptr<ScorerState> stepMany(Ptr<ExpressionGraph>,
+                                    Ptr<ScorerState>,
+                                    const std::vector<IndexType>& /*hypIndices*/,
+                                    const Words& /*words [beamIndex, position] flattened*/,
+                                    int /*beamSize*/) {
+    ABORT("Scorer {} does not support multi-word steps", name_);
+  }
+  virtual Ptr<ScorerState> truncate(Ptr<ScorerState>, size_t /*length*/) {
+    ABORT("Scorer {} does not support truncating its state", name_);
+  }
+
+  // Prefix sessions (see PrefixSessionCache): copy a state to the host and continue from such a copy
+  // after the graph has been cleared
+  virtual Ptr<DecoderStateSnapshot> snapshot(Ptr<ScorerState>) {
+    ABORT("Scorer {} does not support saving its state", name_);
+  }
+  virtual Ptr<ScorerState> restore(Ptr<ExpressionGraph>, Ptr<data::CorpusBatch>, Ptr<const DecoderStateSnapshot>) {
+    ABORT("Scorer {} does not support restoring its state", name_);
+  }
+
   virtual void setShortlistGenerator(Ptr<const data::ShortlistGenerator> /*shortlistGenerator*/){};
   virtual Ptr<data::Shortlist> getShortlist() { return nullptr; };
 
@@ -126,6 +152,32 @@ public:
     return New<ScorerWrapperState>(newState);
   }
 
+  virtual Ptr<ScorerState> stepMany(Ptr<ExpressionGraph> graph,
+                                    Ptr<ScorerState> state,
+                                    const std::vector<IndexType>& hypIndices,
+                                    const Words& words,
+                                    int beamSize) override {
+    graph->switchParams(getName());
+    auto wrapperState = std::dynamic_pointer_cast<ScorerWrapperState>(state);
+    return New<ScorerWrapperState>(encdec_->stepMany(graph, wrapperState->getState(), hypIndices, words, beamSize));
+  }
+
+  virtual Ptr<ScorerState> truncate(Ptr<ScorerState> state, size_t length) override {
+    auto wrapperState = std::dynamic_pointer_cast<ScorerWrapperState>(state);
+    return New<ScorerWrapperState>(wrapperState->getState()->truncate(length));
+  }
+
+  virtual Ptr<DecoderStateSnapshot> snapshot(Ptr<ScorerState> state) override {
+    return std::dynamic_pointer_cast<ScorerWrapperState>(state)->getState()->snapshot();
+  }
+
+  virtual Ptr<ScorerState> restore(Ptr<ExpressionGraph> graph,
+                                   Ptr<data::CorpusBatch> batch,
+                                   Ptr<const DecoderStateSnapshot> snapshot) override {
+    graph->switchParams(getName());
+    return New<ScorerWrapperState>(encdec_->restoreState(graph, batch, *snapshot));
+  }
+
   virtual void setShortlistGenerator(
       Ptr<const data::ShortlistGenerator> shortlistGenerator) override {
     encdec_->setShortlistGenerator(shortlistGenerator);
@@ -149,6 +201,9 @@ Ptr<Scorer> scorerByType(const std::string& fname,
 
 std::vector<Ptr<Scorer>> createScorers(Ptr<Options> options);
 
+// The draft model given by --speculative-draft, or nullptr
+Ptr<Scorer> createDraftScorer(Ptr<Options> options);
+
 Ptr<Scorer> scorerByType(const std::string& fname,
                          float weight,
                          const void* ptr,
@@ -0,0 +1,245 @@
+#include "translator/speculative_search.h"
+#include "data/factored_vocab.h"
+#include "data/shortlist.h"
+
+namespace marian {
+
+constexpr float SpeculativeSearch::TIE_MARGIN;
+
+SpeculativeSearch::SpeculativeSearch(Ptr<Options> options,
+                                     const std::vector<Ptr<Scorer>>& scorers,
+                                     const Ptr<const Vocab> trgVocab)
+    : options_(options),
+      draftWords_(options->get<size_t>("speculative-k", 4)),
+      trgVocab_(trgVocab) {
+  ABORT_IF(scorers.size() != 2 || scorers.back()->getName() != "draft",
+           "Speculative decoding expects exactly one model followed by the draft model, ensembles are not supported");
+  main_  = scorers.front();
+  draft_ = scorers.back();
+  ABORT_IF(main_->getGraph(), "Speculative decoding cannot be combined with --ensemble-parallel");
+
+  ABORT_IF(draftWords_ == 0, "--speculative-k must be at least 1");
+  ABORT_IF(trgVocab_->tryAs<FactoredVocab>(), "Speculative decoding does not support factored vocabularies");
+  ABORT_IF(options_->hasAndNotEmpty("alignment"), "Speculative decoding does not support --alignment");
+  ABORT_IF(options_->hasAndNotEmpty("output-approx-knn"), "Speculative decoding does not support --output-approx-knn");
+  ABORT_IF(options_->get<bool>("output-sampling", false), "Speculative decoding does not support --output-sampling");
+
+  if(options_->get<size_t>("beam-size") > 1) {
+    beamSearch_ = New<BeamSearch>(options_, std::vector<Ptr<Scorer>>({main_}), trgVocab_);
+    beamSearch_->setDraft(draft_, draftWords_);
+  }
+}
+
+Expr SpeculativeSearch::suppressionMask(Ptr<ExpressionGraph> graph, Ptr<Scorer> scorer, int dimVocab) const {
+  bool suppressUnk     = !options_->get<bool>("allow-unk", false);
+  bool suppressSpecial = !options_->get<bool>("allow-special", false);
+  if(!suppressUnk && !suppressSpecial)
+    return nullptr;
+
+  std::vector<float> mask(dimVocab, 0.f);
+  bool any = false;
+  auto shortlist = scorer->getShortlist();
+  for(auto i : trgVocab_->suppressedIndices(suppressUnk, suppressSpecial)) {
+    // map into the shortlist, words that are not in the shortlist cannot be produced anyway
+    auto index = shortlist ? shortlist->tryForwardMap(i) : i;
+    if(index == data::Shortlist::npos || index >= (WordIndex)dimVocab)
+      continue;
+    mask[index] = NumericLimits<float>(Type::float32).lowest;
+    any = true;
+  }
+  return any ? graph->constant({dimVocab}, inits::fromVector(mask), Type::float32) : nullptr;
+}
+
+Expr2 SpeculativeSearch::bestWords(Expr logProbs, Expr mask) const {
+  if(mask)
+    logProbs = logProbs + cast(mask, logProbs->value_type());
+  auto best = topk(logProbs, /*k=*/2, /*axis=*/-1);
+  return std::make_tuple(cast(get<0>(best), Type::float32), get<1>(best));
+}
+
+void SpeculativeSearch::readBestWords(Ptr<Scorer> scorer,
+                                      Expr2 best,
+                                      /*out*/ Words& words,
+                                      /*out*/ std::vector<float>& scores,
+                                      /*out*/ std::vector<float>& gaps) const {
+  std::vector<IndexType> indices;
+  std::vector<float> values;
+  get<1>(best)->val()->get(indices); // [positions, 2] flattened, best first
+  get<0>(best)->val()->get(values);
+
+  // the shortlist is shared by all positions of the sentence, see the constructor
+  auto shortlist = scorer->getShortlist();
+  size_t positions = indices.size() / 2;
+  words.resize(positions);
+  scores.resize(positions);
+  gaps.resize(positions);
+  for(size_t i = 0; i < positions; ++i) {
+    words[i] = Word::fromWordIndex(shortlist ? shortlist->reverseMap(0, 0, indices[2 * i]) : indices[2 * i]);
+    scores[i] = values[2 * i];
+    gaps[i] = values[2 * i] - values[2 * i + 1];
+  }
+}
+
+Ptr<History> SpeculativeSearch::searchSentence(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch) {
+  const auto trgEosId = trgVocab_->getEosId();
+  const float maxLength = options_->get<float>("max-length-factor") * batch->front()->batchWidth();
+  const bool nBest = options_->get<bool>("n-best");
+
+  auto history = New<History>(batch->getSentenceIds()[0],
+                              options_->get<float>("normalize"),
+                              options_->get<float>("word-penalty"));
+
+  auto hyp = Hypothesis::New();
+  history->add(Beam(1, hyp), trgEosId);
+
+  // appends the next word of the main model to the translation, returns true if the translation is complete
+  auto commit = [&](Word word, float logProb) {
+    bool last = word == trgEosId || history->size() >= maxLength; // same length limit as in BeamSearch
+    hyp = Hypothesis::New(hyp, word, 0, hyp->getPathScore() + logProb);
+    if(nBest)
+      hyp->setScoreBreakdown(std::vector<float>(1, hyp->getPathScore()));
+    history->add(Beam(1, hyp), trgEosId, last);
+    return last;
+  };
+
+  main_->clear(graph);
+  draft_->clear(graph);
+
+  auto mainState  = main_->startState(graph, batch);
+  auto draftState = draft_->startState(graph, batch);
+
+  // first word: both models consume the sentence start, only the main model's prediction is used
+  const std::vector<IndexType> batchIndices = {0};
+  mainState  = main_->step(graph, mainState, {}, {}, batchIndices, 1);
+  draftState = draft_->step(graph, draftState, {}, {}, batchIndices, 1);
+
+  auto mainLogProbs = mainState->getLogProbs().getLogits();
+  auto mainMask = suppressionMask(graph, main_, mainLogProbs->shape()[-1]);
+  auto best = bestWords(mainLogProbs, mainMask);
+  graph->forward();
+
+  Words words;
+  std::vector<float> scores, gaps;
+  readBestWords(main_, best, words, scores, gaps);
+
+  // an empty source sentence is forced to EOS as in BeamSearch
+  if(batch->front()->data()[0] == batch->front()->vocab()->getEosId()) {
+    commit(trgEosId, scores[0]);
+    return history;
+  }
+  if(commit(words[0], scores[0]))
+    return history;
+
+  size_t mainLength = 1, draftLength = 1; // number of positions in the decoder states
+  Words mainPending  = {words[0]};        // accepted words the main model has not consumed yet
+  Words draftPending = {words[0]};        // accepted words the draft model has not consumed yet
+
+  Expr draftMask;
+  bool draftMaskDone = false;
+
+  for(;;) {
+    // the draft model proposes up to k words, one at a time
+    Words drafts;
+    for(size_t j = 0; j < draftWords_; ++j) {
+      Words input = j == 0 ? draftPending : Words(1, drafts.back());
+      draftState = input.size() == 1 ? draft_->step(graph, draftState, {}, input, batchIndices, 1)
+                                     : draft_->stepMany(graph, draftState, {}, input, 1);
+      draftLength += input.size();
+
+      auto draftLogProbs = draftState->getLogProbs().getLogits();
+      if(!draftMaskDone) {
+        draftMask = suppressionMask(graph, draft_, draftLogProbs->shape()[-1]);
+        draftMaskDone = true;
+      }
+      auto draftBest = bestWords(draftLogProbs, draftMask);
+      graph->forwardNext();
+
+      readBestWords(draft_, draftBest, words, scores, gaps);
+      drafts.push_back(words.back());
+      if(drafts.back() == trgEosId || history->size() + drafts.size() > maxLength)
+        break; // nothing after this word would be kept
+    }
+
+    // the main model consumes its pending word and all drafts in a single step
+    Words verify = mainPending;
+    verify.insert(verify.end(), drafts.begin(), drafts.end());
+    mainState = main_->stepMany(graph, mainState, {}, verify, 1);
+    mainLength += verify.size();
+
+    best = bestWords(mainState->getLogProbs().getLogits(), mainMask);
+    graph->forwardNext();
+    readBestWords(main_, best, words, scores, gaps); // words[j] is the main model's choice after drafts[0..j)
+
+    // keep the main model's words as long as the drafts they follow agree with them, up to a near tie
+    size_t accepted = 0;
+    bool done = false, tie = false;
+    for(size_t j = 0; ; ++j) {
+      if(gaps[j] < TIE_MARGIN) {
+        tie = true;
+        break;
+      }
+      done = commit(words[j], scores[j]);
+      if(done || j == drafts.size() || words[j] != drafts[j])
+        break;
+      accepted++;
+    }
+    if(done)
+      break;
+
+    // drop the positions of rejected drafts from the main state
+    size_t rejected = drafts.size() - accepted;
+    Word next = words[accepted];
+    if(tie) {
+      // also drop the position of the near tie and decide it with a single-word step
+      mainLength -= rejected + 1;
+      mainState = main_->truncate(mainState, mainLength);
+      mainState = main_->step(graph, mainState, {}, Words(1, verify[accepted]), batchIndices, 1);
+      mainLength++;
+
+      best = bestWords(mainState->getLogProbs().getLogits(), mainMask);
+      graph->forwardNext();
+      readBestWords(main_, best, words, scores, gaps);
+      next = words[0];
+      if(commit(next, scores[0]))
+        break;
+    } else if(rejected > 0) {
+      mainLength -= rejected;
+      mainState = main_->truncate(mainState, mainLength);
+    }
+    mainPending = {next};
+
+    if(accepted == drafts.size()) {
+      // the last draft has not been consumed by the draft model yet
+      draftPending = {drafts.back(), next};
+    } else {
+      size_t stale = drafts.size() - 1 - accepted;
+      if(stale > 0) {
+        draftLength -= stale;
+        draftState = draft_->truncate(draftState, draftLength);
+      }
+      draftPending = {next};
+    }
+  }
+
+  return history;
+}
+
+Histories SpeculativeSearch::search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch) {
+  HypothesisPool::Scope hypothesisPool; // all hypotheses of this batch are freed together with its histories
+  auto searchOne = [&](Ptr<data::CorpusBatch> sentence) -> Ptr<History> {
+    if(beamSearch_)
+      return beamSearch_->searchBeams(graph, sentence, /*prefix=*/nullptr, /*source=*/"", /*session=*/nullptr).front();
+    return searchSentence(graph, sentence);
+  };
+
+  Histories histories;
+  if(batch->size() == 1) {
+    histories.push_back(searchOne(batch));
+    return histories;
+  }
+  for(auto sentence : batch->split(batch->size(), SIZE_MAX))
+    histories.push_back(searchOne(std::static_pointer_cast<data::CorpusBatch>(sentence)));
+  return histories;
+}
+
+}  // namespace marian
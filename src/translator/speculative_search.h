@@ -0,0 +1,80 @@
+#pragma once
+
+#include "marian.h"
+#include "translator/beam_search.h"
+#include "translator/history.h"
+#include "translator/prefix_session.h"
+#include "translator/scorers.h"
+
+namespace marian {
+
+/**
+ * Speculative (draft-and-verify) greedy and small-beam decoding with a small draft model, see
+ * --speculative-draft.
+ *
+ * Greedy (beam size 1): the draft model proposes up to k words one step at a time, the main model
+ * then scores all of them in a single multi-word step. The longest prefix of draft words that agrees
+ * with the main model's own best words is kept, followed by the main model's next word, and the states
+ * of both models are truncated to the accepted history.
+ *
+ * A multi-word step computes the same products as single-word steps, but as one matrix product over
+ * all positions, for which the GEMM library may choose a different summation order, so log probs can
+ * differ in the last bits. A word is therefore only taken from the multi-word step if it leads the
+ * second best word by at least TIE_MARGIN; otherwise the main model's state is truncated before that
+ * position and the word is chosen by a single-word step, as in plain greedy decoding. The output is
+ * the same word sequence as that of GreedySearch with the main model.
+ *
+ * Beam sizes above 1 use BeamSearch with the draft model, see BeamSearch::setDraft(): the draft model
+ * proposes k words for every hypothesis and the beam is advanced along them for as long as BeamSearch
+ * would select exactly these words with the same margin, the other steps are regular beam search steps.
+ *
+ * Expects the scorers of a single model followed by the draft scorer created by createDraftScorer().
+ * Sentences of a batch are decoded one after another, which suits latency-bound translation of
+ * single sentences. Both models need transformer self-attention decoders. The LSH shortlist
+ * (--output-approx-knn) selects different words at each position and is not supported, other
+ * shortlists are the same for all positions of a sentence.
+ */
+class SpeculativeSearch {
+public:
+  // Log prob gap between the best and the next word (or hypothesis) below which the choice is left to a
+  // single-word step. Rounding differences between single- and multi-word steps are far smaller.
+  static constexpr float TIE_MARGIN = 1e-3f;
+
+private:
+  Ptr<Options> options_;
+  Ptr<Scorer> main_;
+  Ptr<Scorer> draft_;
+  size_t draftWords_;
+  Ptr<const Vocab> trgVocab_;
+  Ptr<BeamSearch> beamSearch_; // for beam sizes above 1
+
+  // Additive mask (0 or lowest) over the output vocabulary or shortlist of the scorer for words that
+  // must not be produced, as in BeamSearch; nullptr if nothing is suppressed
+  Expr suppressionMask(Ptr<ExpressionGraph> graph, Ptr<Scorer> scorer, int dimVocab) const;
+
+  // (log probs, indices) of the two best words at each position of logProbs [1, positions, 1, dimVocab]
+  Expr2 bestWords(Expr logProbs, Expr mask) const;
+
+  // After the forward pass: best words, mapped back from the shortlist, their log probs, and how far
+  // they lead the second best words
+  void readBestWords(Ptr<Scorer> scorer,
+                     Expr2 best,
+                     /*out*/ Words& words,
+                     /*out*/ std::vector<float>& scores,
+                     /*out*/ std::vector<float>& gaps) const;
+
+  Ptr<History> searchSentence(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
+
+public:
+  SpeculativeSearch(Ptr<Options> options, const std::vector<Ptr<Scorer>>& scorers, const Ptr<const Vocab> trgVocab);
+
+  // main decoding function
+  Histories search(Ptr<ExpressionGraph> graph, Ptr<data::CorpusBatch> batch);
+
+  // prefix decoding as in BeamSearch, not supported
+  Histories search(Ptr<ExpressionGraph>, Ptr<data::CorpusBatch>, const Words&, const std::string&, Ptr<const PrefixSession>&) {
+    ABORT("Speculative decoding does not support prefix decoding");
+  }
+};
+
+}  // namespace marian
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 
 #include "data/batch_generator.h"
@@ -15,6 +16,9 @@
 #include "translator/history.h"
 #include "translator/output_collector.h"
 #include "translator/output_printer.h"
+#include "translator/decode_scheduler.h"
+#include "translator/decoding_stats.h"
+#include "translator/prefix_session.h"
 
 #include "models/model_task.h"
 #include "translator/scorers.h"
@@ -29,6 +33,53 @@
 
 namespace marian {
 
+// Expression graph for translation on the given device
+static inline Ptr<ExpressionGraph> createTranslationGraph(Ptr<Options> options, DeviceId device) {
+  auto graph = New<ExpressionGraph>(true);
+  auto prec = options->get<std::vector<std::string>>("precision", {"float32"});
+  graph->setDefaultElementType(typeFromString(prec[0])); // only use first type, used for parameter type in graph
+  graph->setDevice(device);
+  if (device.type == DeviceType::cpu) {
+    graph->getBackend()->setOptimized(options->get<bool>("optimize"));
+    graph->getBackend()->setGemmType(options->get<std::string>("gemm-type"));
+    graph->getBackend()->setGemmTuningFile(options->get<std::string>("gemm-tuning-file", ""));
+    graph->getBackend()->setQuantizeRange(options->get<float>("quantize-range"));
+    graph->getBackend()->setBatchedGemmType(options->get<std::string>("batched-gemm-type"));
+    graph->getBackend()->setShortlistGemmType(options->get<std::string>("shortlist-gemm-type", "float32"));
+    graph->getBackend()->setBlockSparseMaxDensity(options->get<float>("block-sparse-max-density", 0.f));
+  }
+  graph->reserveWorkspaceMB(options->get<size_t>("workspace"));
+  return graph;
+}
+
+// Loads the scorers into the search graph, or with --ensemble-parallel each ensemble member into a
+// graph of its own on the same device, which BeamSearch then steps concurrently. Every member graph
+// reserves a full --workspace in addition to the search graph, so memory grows with the ensemble size.
+static inline void initScorers(Ptr<Options> options,
+                               DeviceId device,
+                               Ptr<ExpressionGraph> graph,
+                               const std::vector<Ptr<Scorer>>& scorers,
+                               Ptr<const data::ShortlistGenerator> shortlistGenerator) {
+  bool parallelEnsemble = options->get<bool>("ensemble-parallel", false) && scorers.size() > 1;
+  if(parallelEnsemble) {
+    ABORT_IF(device.type != DeviceType::cpu, "--ensemble-parallel is only supported on CPU");
+    ABORT_IF(options->get<std::vector<std::string>>("precision", {"float32"})[0] != "float32",
+             "--ensemble-parallel requires --precision float32");
+  }
+
+  for(auto scorer : scorers) {
+    if(parallelEnsemble) {
+      scorer->setGraph(createTranslationGraph(options, device));
+      scorer->init(scorer->getGraph());
+      scorer->getGraph()->forward();
+    } else {
+      scorer->init(graph);
+    }
+    if(shortlistGenerator)
+      scorer->setShortlistGenerator(shortlistGenerator);
+  }
+}
+
 template <class Search>
 class Translate : public ModelTask {
 private:
@@ -39,6 +90,7 @@ private:
   Ptr<data::Corpus> corpus_;
   Ptr<Vocab> trgVocab_;
   Ptr<const data::ShortlistGenerator> shortlistGenerator_;
+  Ptr<data::BatchStats> stats_; // batch sizes per source length with --mini-batch-fit
 
   size_t numDevices_;
 
@@ -63,9 +115,9 @@ public:
     auto srcVocab = corpus_->getVocabs()[0];
 
     std::vector<int> lshOpts = options_->get<std::vector<int>>("output-approx-knn");
-    ABORT_IF(lshOpts.size() != 0 && lshOpts.size() != 2, "--output-approx-knn takes 2 parameters");
+    ABORT_IF(lshOpts.size() != 0 && lshOpts.size() != 2 && lshOpts.size() != 3, "--output-approx-knn takes 2 or 3 parameters");
 
-    if (lshOpts.size() == 2 || options_->hasAndNotEmpty("shortlist")) {
+    if (lshOpts.size() >= 2 || options_->hasAndNotEmpty("shortlist")) {
       shortlistGenerator_ = data::createShortlistGenerator(options_, srcVocab, trgVocab_, lshOpts, 0, 1, vocabs.front() == vocabs.back());
     }
 
@@ -89,16 +141,7 @@ public:
     size_t id = 0;
     for(auto device : devices) {
       auto task = [&](DeviceId device, size_t id) {
-        auto graph = New<ExpressionGraph>(true);
-        auto prec = options_->get<std::vector<std::string>>("precision", {"float32"});
-        graph->setDefaultElementType(typeFromString(prec[0]));
-        graph->setDevice(device);
-        if (device.type == DeviceType::cpu) {
-          graph->getBackend()->setOptimized(options_->get<bool>("optimize"));
-          graph->getBackend()->setGemmType(options_->get<std::string>("gemm-type"));
-          graph->getBackend()->setQuantizeRange(options_->get<float>("quantize-range"));
-        }
-        graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+        auto graph = createTranslationGraph(options_, device);
         graphs_[id] = graph;
 
 #if MMAP
@@ -106,11 +149,9 @@ public:
 #else
         auto scorers = createScorers(options_);
 #endif
-        for(auto scorer : scorers) {
-          scorer->init(graph);
-          if(shortlistGenerator_)
-            scorer->setShortlistGenerator(shortlistGenerator_);
-        }
+        if(auto draft = createDraftScorer(options_)) // last scorer, used by SpeculativeSearch
+          scorers.push_back(draft);
+        initScorers(options_, device, graph, scorers, shortlistGenerator_);
 
         scorers_[id] = scorers;
         graph->forward();
@@ -118,6 +159,11 @@ public:
 
       threadPool.enqueue(task, device, id++);
     }
+    threadPool.join_all();
+
+    // all graphs have the same workspace size, the first one is probed
+    if(options_->get<bool>("mini-batch-fit", false))
+      stats_ = collectDecodingStats(options_, graphs_[0], scorers_[0], corpus_->getVocabs(), trgVocab_);
 
     if(options_->get<bool>("output-sampling", false)) {
       if(options_->get<size_t>("beam-size") > 1)
@@ -132,15 +178,15 @@ public:
   }
 
   void run() override {
-    data::BatchGenerator<data::Corpus> bg(corpus_, options_);
+    data::BatchGenerator<data::Corpus> bg(corpus_, options_, stats_);
 
     ThreadPool threadPool(numDevices_, numDevices_);
 
-    size_t batchId = 0;
     auto collector = New<OutputCollector>(options_->get<std::string>("output"));
     auto printer = New<OutputPrinter>(options_, trgVocab_);
     if(options_->get<bool>("quiet-translation"))
       collector->setPrintingStrategy(New<QuietPrinting>());
+    collector->setSegmenter(corpus_->getSegmenter());
 
     // mutex for syncing counter and timer updates
     std::mutex syncCounts;
@@ -173,59 +219,75 @@ public:
 
     bool doNbest = options_->get<bool>("n-best");
 
-    bg.prepare();
-    for(auto batch : bg) {
-      auto task = [=, &syncCounts,
-                      &totBatches, &totLines, &totSourceTokens, &totTimer, 
-                      &curBatches, &curLines, &curSourceTokens, &curTimer](size_t id) {
-        thread_local Ptr<ExpressionGraph> graph;
-        thread_local std::vector<Ptr<Scorer>> scorers;
-
-        if(!graph) {
-          graph = graphs_[id % numDevices_];
-          scorers = scorers_[id % numDevices_];
-        }
+    // each worker thread keeps the graph it picked first, whichever batch it starts with
+    std::atomic<size_t> workers{0};
 
-        auto search = New<Search>(options_, scorers, trgVocab_);
-        auto histories = search->search(graph, batch);
-
-        for(auto history : histories) {
-          std::stringstream best1;
-          std::stringstream bestn;
-          printer->print(history, best1, bestn);
-          collector->Write((long)history->getLineNum(),
-                           best1.str(),
-                           bestn.str(),
-                           doNbest);
-        }
+    auto task = [=, &syncCounts, &workers,
+                    &totBatches, &totLines, &totSourceTokens, &totTimer, 
+                    &curBatches, &curLines, &curSourceTokens, &curTimer](Ptr<data::CorpusBatch> batch) {
+      thread_local Ptr<ExpressionGraph> graph;
+      thread_local std::vector<Ptr<Scorer>> scorers;
 
-        // if we asked for speed information display this
-        if(statFreq.n > 0) { 
-          std::lock_guard<std::mutex> lock(syncCounts);
-          totBatches++; 
-          totLines        += batch->size();
-          totSourceTokens += batch->front()->batchWords();
-        
-          curBatches++;
-          curLines        += batch->size();
-          curSourceTokens += batch->front()->batchWords();
-
-          if(totBatches % statFreq.n == 0) {
-            double totTime = totTimer->elapsed();
-            double curTime = curTimer->elapsed();
-
-            LOG(info, 
-                "Processed {} batches, {} lines, {} source tokens in {:.2f}s - Speed (since last): {:.2f} batches/s - {:.2f} lines/s - {:.2f} tokens/s", 
-                totBatches, totLines, totSourceTokens, totTime, curBatches / curTime, curLines / curTime, curSourceTokens / curTime);
-            
-            // reset stats between updates
-            curBatches = curLines = curSourceTokens = 0;
-            curTimer.reset(new timer::Timer());
-          }
+      if(!graph) {
+        size_t id = workers++;
+        graph = graphs_[id % numDevices_];
+        scorers = scorers_[id % numDevices_];
+      }
+
+      auto search = New<Search>(options_, scorers, trgVocab_);
+      auto histories = search->search(graph, batch);
+
+      thread_local std::string best1, bestn; // output buffers of this worker, reused for all lines
+      for(auto history : histories) {
+        printer->print(history, best1, bestn);
+        collector->Write((long)history->getLineNum(), best1, bestn, doNbest);
+      }
+
+      // if we asked for speed information display this
+      if(statFreq.n > 0) { 
+        std::lock_guard<std::mutex> lock(syncCounts);
+        totBatches++; 
+        totLines        += batch->size();
+        totSourceTokens += batch->front()->batchWords();
+      
+        curBatches++;
+        curLines        += batch->size();
+        curSourceTokens += batch->front()->batchWords();
+
+        if(totBatches % statFreq.n == 0) {
+          double totTime = totTimer->elapsed();
+          double curTime = curTimer->elapsed();
+
+          LOG(info, 
+              "Processed {} batches, {} lines, {} source tokens in {:.2f}s - Speed (since last): {:.2f} batches/s - {:.2f} lines/s - {:.2f} tokens/s", 
+              totBatches, totLines, totSourceTokens, totTime, curBatches / curTime, curLines / curTime, curSourceTokens / curTime);
+          
+          // reset stats between updates
+          curBatches = curLines = curSourceTokens = 0;
+          curTimer.reset(new timer::Timer());
         }
-      };
+      }
+    };
 
-      threadPool.enqueue(task, batchId++);
+    bg.prepare();
+    if(options_->get<std::string>("decode-schedule", "in-order") == "cost") {
+      DecodeScheduler scheduler(options_, numDevices_);
+      std::vector<Ptr<data::CorpusBatch>> window;
+      for(auto batch : bg) {
+        window.push_back(batch);
+        if(window.size() == scheduler.window()) {
+          for(auto scheduled : scheduler.schedule(window))
+            threadPool.enqueue(task, scheduled);
+          window.clear();
+        }
+      }
+      for(auto scheduled : scheduler.schedule(window))
+        threadPool.enqueue(task, scheduled);
+    } else {
+      ABORT_IF(options_->get<std::string>("decode-schedule", "in-order") != "in-order",
+               "Unknown decode schedule {}, expected in-order or cost", options_->get<std::string>("decode-schedule"));
+      for(auto batch : bg)
+        threadPool.enqueue(task, batch);
     }
 
     // make sure threads are joined before other local variables get de-allocated
@@ -254,6 +316,10 @@ private:
 
   size_t numDevices_;
 
+  Ptr<data::BatchStats> stats_;      // batch sizes per source length with --mini-batch-fit
+  Ptr<PrefixSessionCache> sessions_; // states after the confirmed prefix of each prefix decoding session
+  std::mutex prefixMutex_;           // prefix decoding runs on the first graph
+
 public:
   virtual ~TranslateService() {}
 
@@ -277,10 +343,10 @@ public:
     auto srcVocab = srcVocabs_.front();
 
     std::vector<int> lshOpts = options_->get<std::vector<int>>("output-approx-knn");
-    ABORT_IF(lshOpts.size() != 0 && lshOpts.size() != 2, "--output-approx-knn takes 2 parameters");
+    ABORT_IF(lshOpts.size() != 0 && lshOpts.size() != 2 && lshOpts.size() != 3, "--output-approx-knn takes 2 or 3 parameters");
 
     // load lexical shortlist
-    if (lshOpts.size() == 2 || options_->hasAndNotEmpty("shortlist")) {
+    if (lshOpts.size() >= 2 || options_->hasAndNotEmpty("shortlist")) {
         shortlistGenerator_ = data::createShortlistGenerator(options_, srcVocab, trgVocab_, lshOpts, 0, 1, vocabPaths.front() == vocabPaths.back());
     }
 
@@ -290,27 +356,20 @@ public:
 
     // initialize scorers
     for(auto device : devices) {
-      auto graph = New<ExpressionGraph>(true);
-
-      auto precison = options_->get<std::vector<std::string>>("precision", {"float32"});
-      graph->setDefaultElementType(typeFromString(precison[0])); // only use first type, used for parameter type in graph
-      graph->setDevice(device);
-      if (device.type == DeviceType::cpu) {
-        graph->getBackend()->setOptimized(options_->get<bool>("optimize"));
-        graph->getBackend()->setGemmType(options_->get<std::string>("gemm-type"));
-        graph->getBackend()->setQuantizeRange(options_->get<float>("quantize-range"));
-      }
-      graph->reserveWorkspaceMB(options_->get<size_t>("workspace"));
+      auto graph = createTranslationGraph(options_, device);
       graphs_.push_back(graph);
 
       auto scorers = createScorers(options_);
-      for(auto scorer : scorers) {
-        scorer->init(graph);
-        if(shortlistGenerator_)
-          scorer->setShortlistGenerator(shortlistGenerator_);
-      }
+      if(auto draft = createDraftScorer(options_)) // last scorer, used by SpeculativeSearch
+        scorers.push_back(draft);
+      initScorers(options_, device, graph, scorers, shortlistGenerator_);
       scorers_.push_back(scorers);
     }
+
+    if(options_->get<bool>("mini-batch-fit", false))
+      stats_ = collectDecodingStats(options_, graphs_[0], scorers_[0], srcVocabs_, trgVocab_);
+
+    sessions_ = New<PrefixSessionCache>(options_->get<size_t>("prefix-sessions", 64));
   }
 
   std::string run(const std::string& input) override {
@@ -319,9 +378,10 @@ public:
                       ? convertTsvToLists(input, options_->get<size_t>("tsv-fields", 1))
                       : std::vector<std::string>({input});
     auto corpus_ = New<data::TextInput>(inputs, srcVocabs_, options_);
-    data::BatchGenerator<data::TextInput> batchGenerator(corpus_, options_);
+    data::BatchGenerator<data::TextInput> batchGenerator(corpus_, options_, stats_);
 
     auto collector = New<StringCollector>(options_->get<bool>("quiet-translation", false));
+    collector->setSegmenter(corpus_->getSegmenter());
     auto printer = New<OutputPrinter>(options_, trgVocab_);
     size_t batchId = 0;
 
@@ -344,10 +404,9 @@ public:
           auto histories = search->search(graph, batch);
 
           for(auto history : histories) {
-            std::stringstream best1;
-            std::stringstream bestn;
+            std::string best1, bestn;
             printer->print(history, best1, bestn);
-            collector->add((long)history->getLineNum(), best1.str(), bestn.str());
+            collector->add((long)history->getLineNum(), best1, bestn);
           }
         };
 
@@ -360,6 +419,34 @@ public:
     return utils::join(translations, "\n");
   }
 
+  std::string run(const std::string& input, const std::string& prefix, const std::string& sessionId) override {
+    ABORT_IF(input.find('\n') != std::string::npos, "Prefix decoding expects a single source line");
+    // the prefix continues the translation of the whole line
+    auto corpus = New<data::TextInput>(std::vector<std::string>({input}), srcVocabs_,
+                                       options_->with("split-long-inputs", (size_t)0));
+    data::BatchGenerator<data::TextInput> batchGenerator(corpus, options_);
+    batchGenerator.prepare();
+
+    auto prefixWords = trgVocab_->encode(prefix, /*addEOS=*/false, /*inference=*/true);
+    auto collector = New<StringCollector>(options_->get<bool>("quiet-translation", false));
+    auto printer = New<OutputPrinter>(options_, trgVocab_);
+
+    std::lock_guard<std::mutex> lock(prefixMutex_);
+    for(auto batch : batchGenerator) {
+      // sessions without an ID are not kept
+      auto session = sessionId.empty() ? nullptr : sessions_->get(sessionId);
+      auto search = New<Search>(options_, scorers_[0], trgVocab_);
+      auto histories = search->search(graphs_[0], batch, prefixWords, input, session);
+      if(!sessionId.empty())
+        sessions_->put(sessionId, session);
+
+      std::string best1, bestn;
+      printer->print(histories[0], best1, bestn);
+      collector->add((long)histories[0]->getLineNum(), best1, bestn);
+    }
+    return utils::join(collector->collect(options_->get<bool>("n-best")), "\n");
+  }
+
 private:
   // Converts a multi-line input with tab-separated source(s) and target sentences into separate lists
   // of sentences from source(s) and target sides, e.g.